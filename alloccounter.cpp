@@ -0,0 +1,125 @@
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+#include "logging.h"
+#include "alloccounter.h"
+
+// relaxed: these are statistics, and every thread allocates
+static std::atomic<unsigned long long> g_allocations(0);
+static std::atomic<unsigned long long> g_frees(0);
+static std::atomic<unsigned long long> g_bytes(0);
+
+static unsigned long long g_frame_start = 0;
+static bool g_steady = false;
+static bool g_skip = false;
+static unsigned long g_frames = 0;
+static unsigned long g_steady_frames = 0;
+static unsigned long g_violations = 0;
+static unsigned long g_worst_frame = 0;
+
+static void * counted_alloc(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_bytes.fetch_add(size, std::memory_order_relaxed);
+    void * p = malloc(size ? size : 1);
+    if(!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+static void counted_free(void * p) {
+    if(p) {
+        g_frees.fetch_add(1, std::memory_order_relaxed);
+        free(p);
+    }
+}
+
+void * operator new(size_t size) {
+    return counted_alloc(size);
+}
+
+void * operator new[](size_t size) {
+    return counted_alloc(size);
+}
+
+void * operator new(size_t size, const std::nothrow_t &) noexcept {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_bytes.fetch_add(size, std::memory_order_relaxed);
+    return malloc(size ? size : 1);
+}
+
+void * operator new[](size_t size, const std::nothrow_t &) noexcept {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_bytes.fetch_add(size, std::memory_order_relaxed);
+    return malloc(size ? size : 1);
+}
+
+void operator delete(void * p) noexcept {
+    counted_free(p);
+}
+
+void operator delete[](void * p) noexcept {
+    counted_free(p);
+}
+
+void operator delete(void * p, size_t) noexcept {
+    counted_free(p);
+}
+
+void operator delete[](void * p, size_t) noexcept {
+    counted_free(p);
+}
+
+unsigned long long alloc_counter_allocations() {
+    return g_allocations.load(std::memory_order_relaxed);
+}
+
+unsigned long long alloc_counter_frees() {
+    return g_frees.load(std::memory_order_relaxed);
+}
+
+unsigned long long alloc_counter_bytes() {
+    return g_bytes.load(std::memory_order_relaxed);
+}
+
+void alloc_counter_begin_frame() {
+    g_frame_start = alloc_counter_allocations();
+    g_skip = false;
+}
+
+void alloc_counter_skip_frame() {
+    g_skip = true;
+}
+
+unsigned long alloc_counter_end_frame() {
+    unsigned long allocations = (unsigned long)(alloc_counter_allocations() - g_frame_start);
+    g_frames++;
+    if(g_steady && !g_skip) {
+        g_steady_frames++;
+        if(allocations) {
+            // only the first few, a leak per frame would flood the log
+            if(g_violations < 8) {
+                gl_log_err("ERROR: steady-state frame %lu made %lu heap allocations\n", g_frames, allocations);
+            }
+            g_violations++;
+        }
+    }
+    if(allocations > g_worst_frame) {
+        g_worst_frame = allocations;
+    }
+    return allocations;
+}
+
+void alloc_counter_set_steady(bool steady) {
+    g_steady = steady;
+}
+
+unsigned long alloc_counter_steady_violations() {
+    return g_violations;
+}
+
+void log_alloc_counter_stats() {
+    gl_log("heap: %llu allocations (%llu bytes), %llu frees; worst frame %lu allocations, "
+        "%lu of %lu steady-state frames allocated\n", alloc_counter_allocations(), alloc_counter_bytes(),
+        alloc_counter_frees(), g_worst_frame, g_violations, g_steady_frames);
+}
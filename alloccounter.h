@@ -0,0 +1,22 @@
+#pragma once
+
+// Counts heap allocations made through operator new and delete, which is
+// where std::string, std::vector, std::function and the rest allocate.
+// Linking alloccounter.cpp replaces the global operators; plain malloc
+// calls and allocations inside the GL driver are not seen.
+//
+// Frame checks: alloc_counter_begin_frame() at the top of the frame,
+// alloc_counter_end_frame() at the bottom; once steady state is declared,
+// any frame that allocated is counted and logged.
+unsigned long long alloc_counter_allocations();
+unsigned long long alloc_counter_frees();
+unsigned long long alloc_counter_bytes();
+void alloc_counter_begin_frame();
+// returns the number of allocations made since alloc_counter_begin_frame()
+unsigned long alloc_counter_end_frame();
+// frames from here on are expected not to allocate
+void alloc_counter_set_steady(bool steady);
+// leaves the current frame out of the check, for one-off work like a reload
+void alloc_counter_skip_frame();
+unsigned long alloc_counter_steady_violations();
+void log_alloc_counter_stats();
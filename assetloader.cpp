@@ -0,0 +1,203 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include "logging.h"
+#include "assetloader.h"
+#include "profiler.h"
+
+// direct #includes of every file loaded so far, the edges of the dependency graph
+static std::map<std::string, std::vector<std::string> > g_includes;
+// shaders may be loaded from a compile worker thread
+static std::mutex g_includes_mutex;
+
+unsigned long long hash_bytes(const void * data, size_t length, unsigned long long hash) {
+    const unsigned char * bytes = (const unsigned char *)data;
+    for(size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+bool load_file(const char * path, std::string & content) {
+    PROFILE_ZONE("load_file");
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0) {
+        gl_log_err("ERROR: could not open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+        gl_log_err("ERROR: could not stat %s: %s\n", path, strerror(errno));
+        close(fd);
+        return false;
+    }
+    content.resize(st.st_size);
+    size_t done = 0;
+    while(done < (size_t)st.st_size) {
+        ssize_t got = read(fd, &content[done], st.st_size - done);
+        if(got < 0 && errno == EINTR) {
+            continue;
+        }
+        if(got <= 0) {
+            // file shrank underneath us or a real error
+            gl_log_err("ERROR: short read of %s (%zu of %zu bytes)\n", path, done, (size_t)st.st_size);
+            close(fd);
+            content.clear();
+            return false;
+        }
+        done += got;
+    }
+    close(fd);
+    return true;
+}
+
+bool map_file(const char * path, mapped_file * file) {
+    file->data = NULL;
+    file->size = 0;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0) {
+        gl_log_err("ERROR: could not open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0) {
+        gl_log_err("ERROR: could not map empty or unreadable %s\n", path);
+        close(fd);
+        return false;
+    }
+    void * data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps its own reference to the file
+    close(fd);
+    if(data == MAP_FAILED) {
+        gl_log_err("ERROR: could not map %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    file->data = data;
+    file->size = st.st_size;
+    return true;
+}
+
+void unmap_file(mapped_file * file) {
+    if(file->data) {
+        munmap((void *)file->data, file->size);
+    }
+    file->data = NULL;
+    file->size = 0;
+}
+
+static std::string directory_of(const std::string & path) {
+    size_t slash = path.rfind('/');
+    return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+// #include "name" at the start of a line, returns the name
+static bool parse_include(const std::string & text, size_t begin, size_t end, std::string & name) {
+    size_t p = begin;
+    while(p < end && (text[p] == ' ' || text[p] == '\t')) {
+        p++;
+    }
+    if(text.compare(p, 8, "#include") != 0) {
+        return false;
+    }
+    size_t open_quote = text.find('"', p + 8);
+    if(open_quote == std::string::npos || open_quote >= end) {
+        return false;
+    }
+    size_t close_quote = text.find('"', open_quote + 1);
+    if(close_quote == std::string::npos || close_quote >= end) {
+        return false;
+    }
+    name = text.substr(open_quote + 1, close_quote - open_quote - 1);
+    return true;
+}
+
+static bool resolve_includes(const std::string & path, shader_source * source, std::vector<std::string> & stack) {
+    if(std::find(stack.begin(), stack.end(), path) != stack.end()) {
+        gl_log_err("ERROR: #include cycle through %s\n", path.c_str());
+        return false;
+    }
+    std::string text;
+    if(!load_file(path.c_str(), text)) {
+        return false;
+    }
+    int source_number = (int)source->dependencies.size();
+    source->dependencies.push_back(path);
+    stack.push_back(path);
+    std::vector<std::string> & includes = g_includes[path];
+    includes.clear();
+
+    int line = 1;
+    size_t begin = 0;
+    while(begin < text.size()) {
+        size_t end = text.find('\n', begin);
+        if(end == std::string::npos) {
+            end = text.size();
+        }
+        std::string name;
+        if(parse_include(text, begin, end, name)) {
+            std::string included = directory_of(path) + name;
+            includes.push_back(included);
+            char directive[64];
+            snprintf(directive, sizeof(directive), "#line 1 %i\n", (int)source->dependencies.size());
+            source->text += directive;
+            if(!resolve_includes(included, source, stack)) {
+                gl_log_err("  included from %s:%i\n", path.c_str(), line);
+                return false;
+            }
+            // back in this file, on the line after the #include
+            snprintf(directive, sizeof(directive), "#line %i %i\n", line + 1, source_number);
+            source->text += directive;
+        } else {
+            source->text.append(text, begin, end - begin);
+            source->text += '\n';
+        }
+        begin = end + 1;
+        line++;
+    }
+    stack.pop_back();
+    return true;
+}
+
+bool load_shader_source(const char * path, shader_source * source) {
+    source->text.clear();
+    source->dependencies.clear();
+    std::vector<std::string> stack;
+    std::lock_guard<std::mutex> lock(g_includes_mutex);
+    if(!resolve_includes(path, source, stack)) {
+        source->text.clear();
+        return false;
+    }
+    source->hash = hash_bytes(source->text.data(), source->text.size());
+    return true;
+}
+
+void asset_dependencies(const char * root, std::vector<std::string> & files) {
+    std::vector<std::string> pending(1, root);
+    std::lock_guard<std::mutex> lock(g_includes_mutex);
+    while(!pending.empty()) {
+        std::string file = pending.back();
+        pending.pop_back();
+        if(std::find(files.begin(), files.end(), file) != files.end()) {
+            continue;
+        }
+        files.push_back(file);
+        std::map<std::string, std::vector<std::string> >::const_iterator it = g_includes.find(file);
+        if(it != g_includes.end()) {
+            pending.insert(pending.end(), it->second.begin(), it->second.end());
+        }
+    }
+}
+
+bool asset_depends_on(const char * root, const char * file) {
+    std::vector<std::string> files;
+    asset_dependencies(root, files);
+    return std::find(files.begin(), files.end(), std::string(file)) != files.end();
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// Shared file loading for shaders and other assets: one sized read() per
+// file (or an mmap for large binary assets), errors for missing files, GLSL
+// #include resolution and a 64-bit content hash.
+#define ASSET_HASH_SEED 0xcbf29ce484222325ULL
+
+struct shader_source {
+    std::string text;
+    // every file that went into text, root first; #line source numbers index this
+    std::vector<std::string> dependencies;
+    unsigned long long hash;
+};
+
+struct mapped_file {
+    const void * data;
+    size_t size;
+};
+
+unsigned long long hash_bytes(const void * data, size_t length, unsigned long long hash = ASSET_HASH_SEED);
+bool load_file(const char * path, std::string & content);
+bool map_file(const char * path, mapped_file * file);
+void unmap_file(mapped_file * file);
+bool load_shader_source(const char * path, shader_source * source);
+void asset_dependencies(const char * root, std::vector<std::string> & files);
+bool asset_depends_on(const char * root, const char * file);
@@ -0,0 +1,190 @@
+#include <GL/glew.h>
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include "logging.h"
+#include "shadermanager.h"
+#include "frametiming.h"
+#include "headless.h"
+#include "batchrenderer.h"
+#include "glstate.h"
+#include "glcapture.h"
+
+// Draw-call benchmark: N small triangles drawn one VAO + glDrawArrays each
+// (the hello-triangle way), as one glMultiDrawArrays, as one
+// glMultiDrawElementsBaseVertex, and as one instanced draw.
+
+struct bench_result {
+    int draw_calls;
+    double mean_ms;
+    double p95_ms;
+};
+
+static int g_frames = 30;
+
+static void object_triangle(int object, int object_count, GLfloat * out) {
+    int side = (int)ceil(sqrt((double)object_count));
+    float cell = 2.0f / side;
+    float x = -1.0f + cell * (object % side + 0.5f);
+    float y = -1.0f + cell * (object / side + 0.5f);
+    float size = cell * 0.4f;
+    GLfloat triangle[] = {
+        x,        y + size, 0.0f,
+        x + size, y - size, 0.0f,
+        x - size, y - size, 0.0f,
+    };
+    std::copy(triangle, triangle + 9, out);
+}
+
+template <typename Draw>
+static bench_result time_frames(Draw draw) {
+    std::vector<double> times;
+    // warm up so first-use driver work is not timed
+    for(int i = 0; i < 3; i++) {
+        draw();
+        headless_present();
+    }
+    glFinish();
+    bench_result result = { 0, 0.0, 0.0 };
+    for(int i = 0; i < g_frames; i++) {
+        double start = frame_timing_seconds();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        result.draw_calls = draw();
+        headless_present();
+        times.push_back((frame_timing_seconds() - start) * 1000.0);
+    }
+    glFinish();
+    std::sort(times.begin(), times.end());
+    double sum = 0.0;
+    for(size_t i = 0; i < times.size(); i++) {
+        sum += times[i];
+    }
+    result.mean_ms = sum / times.size();
+    result.p95_ms = times[(size_t)(0.95 * (times.size() - 1))];
+    return result;
+}
+
+static void report(const char * path, int objects, const bench_result & r) {
+    gl_log("  %-22s %9i %11i %10.3f %10.3f %14.0f\n", path, objects, r.draw_calls, r.mean_ms, r.p95_ms,
+        r.mean_ms > 0.0 ? objects / (r.mean_ms / 1000.0) : 0.0);
+}
+
+static void bench_naive(int objects) {
+    std::vector<GLuint> vbos(objects);
+    std::vector<GLuint> vaos(objects);
+    glGenBuffers(objects, vbos.data());
+    glGenVertexArrays(objects, vaos.data());
+    for(int i = 0; i < objects; i++) {
+        GLfloat points[9];
+        object_triangle(i, objects, points);
+        gl_state_bind_buffer(GL_ARRAY_BUFFER, vbos[i]);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(points), points, GL_STATIC_DRAW);
+        gl_state_bind_vertex_array(vaos[i]);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+    }
+    bench_result r = time_frames([&]() {
+        for(int i = 0; i < objects; i++) {
+            gl_state_bind_vertex_array(vaos[i]);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+        return objects;
+    });
+    report("vao per object", objects, r);
+    gl_state_delete_vertex_arrays(objects, vaos.data());
+    gl_state_delete_buffers(objects, vbos.data());
+}
+
+static void bench_batched(int objects) {
+    mesh_batch batch;
+    batch_init(&batch);
+    GLuint indices[] = { 0, 1, 2 };
+    for(int i = 0; i < objects; i++) {
+        GLfloat points[9];
+        object_triangle(i, objects, points);
+        batch_add_mesh(&batch, points, 3, indices, 3);
+    }
+    batch_upload(&batch);
+    bench_result r = time_frames([&]() {
+        batch.draw_calls = 0;
+        batch_draw_arrays(&batch, GL_TRIANGLES, 0, objects);
+        return batch.draw_calls;
+    });
+    report("glMultiDrawArrays", objects, r);
+    r = time_frames([&]() {
+        batch.draw_calls = 0;
+        batch_draw_elements(&batch, GL_TRIANGLES, 0, objects);
+        return batch.draw_calls;
+    });
+    report("glMultiDrawElementsBV", objects, r);
+    batch_destroy(&batch);
+}
+
+static void bench_instanced(int objects) {
+    mesh_batch batch;
+    batch_init(&batch);
+    // one unit triangle, placed and scaled per instance
+    GLfloat unit[] = {
+         0.0f,  1.0f, 0.0f,
+         1.0f, -1.0f, 0.0f,
+        -1.0f, -1.0f, 0.0f,
+    };
+    int mesh = batch_add_mesh(&batch, unit, 3, NULL, 0);
+    batch_upload(&batch);
+    std::vector<GLfloat> instances(objects * 4);
+    for(int i = 0; i < objects; i++) {
+        GLfloat points[9];
+        object_triangle(i, objects, points);
+        instances[i * 4 + 0] = points[0];
+        instances[i * 4 + 1] = points[4] + (points[1] - points[4]) * 0.5f;
+        instances[i * 4 + 2] = 0.0f;
+        instances[i * 4 + 3] = points[3] - points[0];
+    }
+    batch_set_instances(&batch, instances.data(), objects);
+    bench_result r = time_frames([&]() {
+        batch.draw_calls = 0;
+        batch_draw_instanced(&batch, GL_TRIANGLES, mesh);
+        return batch.draw_calls;
+    });
+    report("glDrawArraysInstanced", objects, r);
+    batch_destroy(&batch);
+}
+
+int main(int argc, char ** argv) {
+    headless_options options;
+    if(!parse_headless_args(argc, argv, &options)) {
+        return 1;
+    }
+    options.enabled = true;
+    if(options.frames > 0) {
+        g_frames = (int)options.frames;
+    }
+    if(!restart_gl_log()) {
+        fprintf(stderr, "Failed to open log file\n");
+        return 1;
+    }
+    gl_log_set_level(GL_LOG_WARN);
+    if(!headless_init(&options)) {
+        return 2;
+    }
+    gl_state_viewport(0, 0, options.width, options.height);
+    GLuint program = build_shader_program("./batch.vert", "./batch.frag");
+    gl_state_use_program(program);
+    set_uniform_vec4(program, "input_color", 0.0f, 0.0f, 0.0f, 1.0f);
+    glClearColor(0.6f, 0.6f, 0.8f, 1.0f);
+    gl_log_set_level(GL_LOG_INFO);
+
+    gl_log("\nbatch-bench: %s, %i frames per case\n", glGetString(GL_RENDERER), g_frames);
+    gl_log("  %-22s %9s %11s %10s %10s %14s\n", "path", "objects", "draws/frame", "mean ms", "p95 ms", "triangles/s");
+    int counts[] = { 1000, 10000, 100000 };
+    for(int i = 0; i < 3; i++) {
+        bench_naive(counts[i]);
+        bench_batched(counts[i]);
+        bench_instanced(counts[i]);
+    }
+    bench_instanced(1000000);
+
+    headless_shutdown();
+    return 0;
+}
@@ -0,0 +1,8 @@
+#version 410
+
+uniform vec4 input_color;
+out vec4 frag_colour;
+
+void main() {
+   frag_colour = input_color;
+};
@@ -0,0 +1,9 @@
+#version 410
+
+layout(location = 0) in vec3 vertex_position;
+// xyz offset, w scale; (0, 0, 0, 1) when instancing is off
+layout(location = 1) in vec4 instance_offset;
+
+void main() {
+    gl_Position = vec4(vertex_position * instance_offset.w + instance_offset.xyz, 1.0);
+};
@@ -0,0 +1,136 @@
+#include <GL/glew.h>
+#include <stdio.h>
+#include "logging.h"
+#include "batchrenderer.h"
+#include "glstate.h"
+#include "vertexformat.h"
+#include "profiler.h"
+#include "glcapture.h"
+
+void batch_init(mesh_batch * batch) {
+    batch->vertices.clear();
+    batch->indices.clear();
+    batch->meshes.clear();
+    batch->instance_count = 0;
+    batch->draw_calls = 0;
+
+    GLuint buffers[3];
+    GLuint vao = 0;
+    glGenBuffers(3, buffers);
+    glGenVertexArrays(1, &vao);
+    batch->vbo.reset(GL_RESOURCE_BUFFER, buffers[0]);
+    batch->ibo.reset(GL_RESOURCE_BUFFER, buffers[1]);
+    batch->instance_vbo.reset(GL_RESOURCE_BUFFER, buffers[2]);
+    batch->vao.reset(GL_RESOURCE_VERTEX_ARRAY, vao);
+    // positions per vertex, offset/scale per instance
+    vertex_format format;
+    vertex_format_init(&format);
+    vertex_format_add(&format, BATCH_POSITION_ATTRIB, 3, VERTEX_FLOAT32, 0);
+    vertex_format_add(&format, BATCH_INSTANCE_ATTRIB, 4, VERTEX_FLOAT32, 1);
+    vertex_format_set_divisor(&format, 1, 1);
+    GLuint streams[] = { batch->vbo.get(), batch->instance_vbo.get() };
+    GLintptr offsets[] = { 0, 0 };
+    vertex_format_apply(&format, batch->vao.get(), streams, offsets);
+    gl_state_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, batch->ibo.get());
+    // instancing is off until instances are set, so plain draws read the default (0, 0, 0, 1)
+    glDisableVertexAttribArray(BATCH_INSTANCE_ATTRIB);
+    glVertexAttrib4f(BATCH_INSTANCE_ATTRIB, 0.0f, 0.0f, 0.0f, 1.0f);
+    gl_state_bind_vertex_array(0);
+}
+
+// indices are relative to the mesh's own vertices; pass NULL for array-only meshes
+int batch_add_mesh(mesh_batch * batch, const GLfloat * positions, int vertex_count,
+    const GLuint * indices, int index_count) {
+    mesh_range range;
+    range.first_vertex = (GLint)(batch->vertices.size() / 3);
+    range.vertex_count = vertex_count;
+    range.first_index = (GLsizei)batch->indices.size();
+    range.index_count = indices ? index_count : 0;
+    batch->vertices.insert(batch->vertices.end(), positions, positions + vertex_count * 3);
+    if(indices) {
+        batch->indices.insert(batch->indices.end(), indices, indices + index_count);
+    }
+    batch->meshes.push_back(range);
+    return (int)batch->meshes.size() - 1;
+}
+
+void batch_upload(mesh_batch * batch) {
+    PROFILE_ZONE("batch_upload");
+    gl_state_bind_vertex_array(batch->vao.get());
+    gl_state_bind_buffer(GL_ARRAY_BUFFER, batch->vbo.get());
+    glBufferData(GL_ARRAY_BUFFER, batch->vertices.size() * sizeof(GLfloat),
+        batch->vertices.data(), GL_STATIC_DRAW);
+    if(!batch->indices.empty()) {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, batch->indices.size() * sizeof(GLuint),
+            batch->indices.data(), GL_STATIC_DRAW);
+    }
+    gl_state_bind_vertex_array(0);
+    size_t meshes = batch->meshes.size();
+    batch->draw_firsts.reserve(meshes);
+    batch->draw_counts.reserve(meshes);
+    batch->draw_offsets.reserve(meshes);
+    batch->draw_base_vertices.reserve(meshes);
+    gl_log("batch: %zu meshes, %zu vertices, %zu indices uploaded\n",
+        meshes, batch->vertices.size() / 3, batch->indices.size());
+}
+
+void batch_set_instances(mesh_batch * batch, const GLfloat * instances, int instance_count) {
+    gl_state_bind_vertex_array(batch->vao.get());
+    gl_state_bind_buffer(GL_ARRAY_BUFFER, batch->instance_vbo.get());
+    glBufferData(GL_ARRAY_BUFFER, instance_count * 4 * sizeof(GLfloat), instances, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(BATCH_INSTANCE_ATTRIB);
+    gl_state_bind_vertex_array(0);
+    batch->instance_count = instance_count;
+}
+
+void batch_draw_arrays(mesh_batch * batch, GLenum mode, int first_mesh, int mesh_count) {
+    batch->draw_firsts.clear();
+    batch->draw_counts.clear();
+    for(int i = first_mesh; i < first_mesh + mesh_count; i++) {
+        batch->draw_firsts.push_back(batch->meshes[i].first_vertex);
+        batch->draw_counts.push_back(batch->meshes[i].vertex_count);
+    }
+    gl_state_bind_vertex_array(batch->vao.get());
+    // instancing stays off for multi-draws
+    glDisableVertexAttribArray(BATCH_INSTANCE_ATTRIB);
+    glMultiDrawArrays(mode, batch->draw_firsts.data(), batch->draw_counts.data(), mesh_count);
+    batch->draw_calls++;
+}
+
+void batch_draw_elements(mesh_batch * batch, GLenum mode, int first_mesh, int mesh_count) {
+    batch->draw_counts.clear();
+    batch->draw_offsets.clear();
+    batch->draw_base_vertices.clear();
+    for(int i = first_mesh; i < first_mesh + mesh_count; i++) {
+        const mesh_range & range = batch->meshes[i];
+        batch->draw_counts.push_back(range.index_count);
+        batch->draw_offsets.push_back((const void *)(range.first_index * sizeof(GLuint)));
+        batch->draw_base_vertices.push_back(range.first_vertex);
+    }
+    gl_state_bind_vertex_array(batch->vao.get());
+    glDisableVertexAttribArray(BATCH_INSTANCE_ATTRIB);
+    glMultiDrawElementsBaseVertex(mode, batch->draw_counts.data(), GL_UNSIGNED_INT,
+        (const void * const *)batch->draw_offsets.data(), mesh_count, batch->draw_base_vertices.data());
+    batch->draw_calls++;
+}
+
+void batch_draw_instanced(mesh_batch * batch, GLenum mode, int mesh) {
+    const mesh_range & range = batch->meshes[mesh];
+    gl_state_bind_vertex_array(batch->vao.get());
+    glEnableVertexAttribArray(BATCH_INSTANCE_ATTRIB);
+    if(range.index_count > 0) {
+        glDrawElementsInstancedBaseVertex(mode, range.index_count, GL_UNSIGNED_INT,
+            (const void *)(range.first_index * sizeof(GLuint)), batch->instance_count, range.first_vertex);
+    } else {
+        glDrawArraysInstanced(mode, range.first_vertex, range.vertex_count, batch->instance_count);
+    }
+    batch->draw_calls++;
+}
+
+void batch_destroy(mesh_batch * batch) {
+    batch->vao.reset();
+    batch->vbo.reset();
+    batch->ibo.reset();
+    batch->instance_vbo.reset();
+    batch->meshes.clear();
+}
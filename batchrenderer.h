@@ -0,0 +1,47 @@
+#pragma once
+#include <GL/glew.h>
+#include <vector>
+#include "resourcepool.h"
+
+// Many meshes packed into one shared vertex buffer and one shared index
+// buffer behind a single VAO, drawn with one multi-draw call per mode.
+// Repeated geometry goes through instancing with a per-instance
+// vec4 (xyz offset, w scale) in attribute 1. The VAO and buffers are owned
+// through gl_handle, so they show up in log_gl_resource_stats() until
+// batch_destroy().
+#define BATCH_POSITION_ATTRIB 0
+#define BATCH_INSTANCE_ATTRIB 1
+
+struct mesh_range {
+    GLint first_vertex;
+    GLsizei vertex_count;
+    GLsizei first_index;
+    GLsizei index_count;
+};
+
+struct mesh_batch {
+    gl_handle vao;
+    gl_handle vbo;
+    gl_handle ibo;
+    gl_handle instance_vbo;
+    std::vector<GLfloat> vertices;
+    std::vector<GLuint> indices;
+    std::vector<mesh_range> meshes;
+    GLsizei instance_count;
+    // reused argument arrays for the multi-draw calls
+    std::vector<GLint> draw_firsts;
+    std::vector<GLsizei> draw_counts;
+    std::vector<const void *> draw_offsets;
+    std::vector<GLint> draw_base_vertices;
+    int draw_calls;
+};
+
+void batch_init(mesh_batch * batch);
+int batch_add_mesh(mesh_batch * batch, const GLfloat * positions, int vertex_count,
+    const GLuint * indices, int index_count);
+void batch_upload(mesh_batch * batch);
+void batch_set_instances(mesh_batch * batch, const GLfloat * instances, int instance_count);
+void batch_draw_arrays(mesh_batch * batch, GLenum mode, int first_mesh, int mesh_count);
+void batch_draw_elements(mesh_batch * batch, GLenum mode, int first_mesh, int mesh_count);
+void batch_draw_instanced(mesh_batch * batch, GLenum mode, int mesh);
+void batch_destroy(mesh_batch * batch);
@@ -0,0 +1,15 @@
+set -e
+# shader-minimal headless three ways: plain, recording every frame, and
+# checked against the committed golden image; after an intended change in
+# what it draws, refresh that with
+#   ./shader-minimal --headless --frames 300 --size 320x240 --golden 100 shader-minimal-golden.ppm --golden-update
+g++ shader-minimal.cpp framepacing.cpp framearena.cpp resourcepool.cpp alloccounter.cpp framecapture.cpp gldebug.cpp shadermanager.cpp shaderwatcher.cpp programcache.cpp frametiming.cpp headless.cpp \
+    streambuffer.cpp assetloader.cpp glstate.cpp logging.cpp \
+    ../glew/lib/libGLEW.a ../glfw/build/src/libglfw3.a \
+    -I ../glfw/include -I ../glew/include/ \
+    -lGL -lEGL -lX11 -lGLU -pthread \
+    -o shader-minimal
+./shader-minimal --headless --frames 300 --size 320x240
+# one appended raw stream: ffmpeg -f rawvideo -pix_fmt rgba -s 320x240 -i capture.raw capture.mp4
+./shader-minimal --headless --frames 300 --size 320x240 --record capture.raw
+./shader-minimal --headless --frames 300 --size 320x240 --golden 100 shader-minimal-golden.ppm
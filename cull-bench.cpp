@@ -0,0 +1,297 @@
+#include <GL/glew.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include "logging.h"
+#include "shadermanager.h"
+#include "frametiming.h"
+#include "headless.h"
+#include "glstate.h"
+#include "batchrenderer.h"
+#include "streambuffer.h"
+#include "vecmath.h"
+#include "gpuculling.h"
+#include "glcapture.h"
+
+// Culling benchmark: a field of small solids around a camera that turns in
+// place, so roughly a sixth of them are in view at any time. Compares
+//   cpu cull + one draw per visible object,
+//   cpu cull + commands streamed into one glMultiDrawElementsIndirect,
+//   compute-shader cull + one glMultiDrawElementsIndirect(Count)
+// at 10k and 100k objects. CPU ms is the time the render thread spends
+// culling and submitting; frame ms includes waiting for the GPU. Before the
+// timed runs the GPU's survivor list is checked against the CPU's.
+
+#define CULL_BENCH_FRAMES 40
+#define CULL_BENCH_CHECKS 8
+
+enum {
+    CULL_CPU_DRAWS = 0,
+    CULL_CPU_INDIRECT,
+    CULL_GPU_INDIRECT,
+};
+
+static const char * g_mode_names[] = {
+    "cpu cull + draw per object",
+    "cpu cull + multi-draw-indirect",
+    "gpu cull + multi-draw-indirect",
+};
+
+static int g_frames = CULL_BENCH_FRAMES;
+static float g_aspect = 640.0f / 480.0f;
+
+// unit radius solids: cube, octahedron, icosahedron
+static void add_meshes(mesh_batch * batch) {
+    float c = 1.0f / sqrtf(3.0f);
+    GLfloat cube[] = {
+        -c, -c, -c,  c, -c, -c,  c,  c, -c, -c,  c, -c,
+        -c, -c,  c,  c, -c,  c,  c,  c,  c, -c,  c,  c,
+    };
+    GLuint cube_indices[] = {
+        0, 2, 1, 0, 3, 2,  4, 5, 6, 4, 6, 7,  0, 1, 5, 0, 5, 4,
+        3, 6, 2, 3, 7, 6,  0, 4, 7, 0, 7, 3,  1, 2, 6, 1, 6, 5,
+    };
+    batch_add_mesh(batch, cube, 8, cube_indices, 36);
+    GLfloat octahedron[] = {
+        1, 0, 0,  -1, 0, 0,  0, 1, 0,  0, -1, 0,  0, 0, 1,  0, 0, -1,
+    };
+    GLuint octahedron_indices[] = {
+        0, 2, 4,  2, 1, 4,  1, 3, 4,  3, 0, 4,  2, 0, 5,  1, 2, 5,  3, 1, 5,  0, 3, 5,
+    };
+    batch_add_mesh(batch, octahedron, 6, octahedron_indices, 24);
+    float t = (1.0f + sqrtf(5.0f)) / 2.0f;
+    float s = 1.0f / sqrtf(1.0f + t * t);
+    t *= s;
+    GLfloat icosahedron[] = {
+        -s,  t,  0,   s,  t,  0,  -s, -t,  0,   s, -t,  0,
+         0, -s,  t,   0,  s,  t,   0, -s, -t,   0,  s, -t,
+         t,  0, -s,   t,  0,  s,  -t,  0, -s,  -t,  0,  s,
+    };
+    GLuint icosahedron_indices[] = {
+        0, 11, 5,  0, 5, 1,  0, 1, 7,  0, 7, 10,  0, 10, 11,
+        1, 5, 9,  5, 11, 4,  11, 10, 2,  10, 7, 6,  7, 1, 8,
+        3, 9, 4,  3, 4, 2,  3, 2, 6,  3, 6, 8,  3, 8, 9,
+        4, 9, 5,  2, 4, 11,  6, 2, 10,  8, 6, 7,  9, 8, 1,
+    };
+    batch_add_mesh(batch, icosahedron, 12, icosahedron_indices, 60);
+}
+
+static void make_objects(std::vector<cull_object> & objects, int count, int mesh_count) {
+    // same density whatever the count: the field grows with the cube root
+    float half = 2.0f * cbrtf((float)count);
+    srand(1234);
+    objects.resize(count);
+    for(int i = 0; i < count; i++) {
+        cull_object & o = objects[i];
+        for(int a = 0; a < 3; a++) {
+            o.sphere[a] = half * (2.0f * rand() / (float)RAND_MAX - 1.0f);
+        }
+        o.sphere[3] = 0.3f + 0.7f * rand() / (float)RAND_MAX;
+        o.mesh = (GLuint)(i % mesh_count);
+        o.pad[0] = o.pad[1] = o.pad[2] = 0;
+    }
+}
+
+static mat4 camera(int frame, int count) {
+    float angle = frame * 0.05f;
+    vec3 eye = vec3_make(0.0f, 0.0f, 0.0f);
+    vec3 target = vec3_make(sinf(angle), 0.1f * sinf(angle * 3.0f), -cosf(angle));
+    float far_plane = 4.0f * cbrtf((float)count);
+    return mat4_mul(mat4_perspective(1.0f, g_aspect, 0.1f, far_plane),
+        mat4_look_at(eye, target, vec3_make(0.0f, 1.0f, 0.0f)));
+}
+
+// how far outside the frustum the sphere is; about 0 means it grazes a plane
+static float frustum_margin(const mat4 & view_projection, const cull_object & o) {
+    vec4 planes[6];
+    mat4_frustum_planes(view_projection, planes);
+    float margin = 1e30f;
+    for(int p = 0; p < 6; p++) {
+        float d = planes[p].x * o.sphere[0] + planes[p].y * o.sphere[1] + planes[p].z * o.sphere[2]
+            + planes[p].w + o.sphere[3];
+        margin = std::min(margin, d);
+    }
+    return margin;
+}
+
+// survivors must match; a GPU without strict float order may only disagree
+// on spheres that touch a plane
+static bool check_gpu_cull(gpu_culler * culler, const std::vector<cull_object> & objects) {
+    std::vector<GLuint> cpu;
+    std::vector<GLuint> gpu;
+    int boundary = 0;
+    for(int i = 0; i < CULL_BENCH_CHECKS; i++) {
+        mat4 view_projection = camera(i * 17, (int)objects.size());
+        gpu_culler_cull(culler, view_projection);
+        gpu_culler_read_visible(culler, &gpu);
+        cpu_cull_objects(view_projection, objects.data(), (GLsizei)objects.size(), &cpu);
+        std::sort(gpu.begin(), gpu.end());
+        std::vector<GLuint> differ;
+        std::set_symmetric_difference(cpu.begin(), cpu.end(), gpu.begin(), gpu.end(), std::back_inserter(differ));
+        for(size_t d = 0; d < differ.size(); d++) {
+            if(fabsf(frustum_margin(view_projection, objects[differ[d]])) > 1e-3f) {
+                gl_log_err("ERROR: object %u culled differently (cpu %zu visible, gpu %zu)\n", differ[d],
+                    cpu.size(), gpu.size());
+                return false;
+            }
+            boundary++;
+        }
+    }
+    gl_log("  gpu survivors match cpu over %i views (%i boundary cases)\n", CULL_BENCH_CHECKS, boundary);
+    return true;
+}
+
+static void draw_cpu(mesh_batch * batch, const std::vector<cull_object> & objects,
+    const std::vector<GLuint> & visible) {
+    gl_state_bind_vertex_array(batch->vao.get());
+    glEnableVertexAttribArray(BATCH_INSTANCE_ATTRIB);
+    for(size_t i = 0; i < visible.size(); i++) {
+        const mesh_range & range = batch->meshes[objects[visible[i]].mesh];
+        glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, range.index_count, GL_UNSIGNED_INT,
+            (const void *)(range.first_index * sizeof(GLuint)), 1, range.first_vertex, visible[i]);
+    }
+}
+
+static bool draw_cpu_indirect(mesh_batch * batch, stream_buffer * stream,
+    const std::vector<cull_object> & objects, const std::vector<GLuint> & visible) {
+    GLsizeiptr size = visible.size() * sizeof(draw_elements_indirect_command);
+    stream_allocation allocation;
+    if(!stream_buffer_alloc(stream, size, sizeof(GLuint), &allocation)) {
+        return false;
+    }
+    draw_elements_indirect_command * commands = (draw_elements_indirect_command *)allocation.data;
+    for(size_t i = 0; i < visible.size(); i++) {
+        const mesh_range & range = batch->meshes[objects[visible[i]].mesh];
+        commands[i].count = range.index_count;
+        commands[i].instance_count = 1;
+        commands[i].first_index = range.first_index;
+        commands[i].base_vertex = range.first_vertex;
+        commands[i].base_instance = visible[i];
+    }
+    stream_buffer_commit(stream, &allocation);
+    gl_state_bind_vertex_array(batch->vao.get());
+    glEnableVertexAttribArray(BATCH_INSTANCE_ATTRIB);
+    gl_state_bind_buffer(GL_DRAW_INDIRECT_BUFFER, allocation.buffer);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void *)allocation.offset,
+        (GLsizei)visible.size(), 0);
+    return true;
+}
+
+static bool run(int mode, GLuint program, mesh_batch * batch, gpu_culler * culler, stream_buffer * stream,
+    const std::vector<cull_object> & objects) {
+    std::vector<GLuint> visible;
+    visible.reserve(objects.size());
+    double cpu_seconds = 0.0;
+    long survivors = 0;
+    glFinish();
+    double start = frame_timing_seconds();
+    for(int frame = 0; frame < g_frames; frame++) {
+        double frame_start = frame_timing_seconds();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        mat4 view_projection = camera(frame, (int)objects.size());
+        if(mode == CULL_GPU_INDIRECT) {
+            gpu_culler_cull(culler, view_projection);
+        } else {
+            survivors += cpu_cull_objects(view_projection, objects.data(), (GLsizei)objects.size(), &visible);
+        }
+        gl_state_use_program(program);
+        set_uniform_mat4(program, "view_projection", view_projection);
+        if(mode == CULL_CPU_DRAWS) {
+            draw_cpu(batch, objects, visible);
+        } else if(mode == CULL_CPU_INDIRECT) {
+            if(!draw_cpu_indirect(batch, stream, objects, visible)) {
+                return false;
+            }
+        } else {
+            gpu_culler_draw(culler, batch, GL_TRIANGLES);
+        }
+        stream_buffer_end_frame(stream);
+        gl_state_end_frame();
+        cpu_seconds += frame_timing_seconds() - frame_start;
+        headless_present();
+    }
+    glFinish();
+    double seconds = frame_timing_seconds() - start;
+    char visible_text[32] = "-";
+    if(mode != CULL_GPU_INDIRECT) {
+        snprintf(visible_text, sizeof(visible_text), "%li", survivors / g_frames);
+    }
+    gl_log("  %-32s %9.3f %9.3f %9s\n", g_mode_names[mode], cpu_seconds * 1000.0 / g_frames,
+        seconds * 1000.0 / g_frames, visible_text);
+    return true;
+}
+
+int main(int argc, char ** argv) {
+    headless_options options;
+    if(!parse_headless_args(argc, argv, &options)) {
+        return 1;
+    }
+    options.enabled = true;
+    if(options.frames > 0) {
+        g_frames = (int)options.frames;
+    }
+    if(!restart_gl_log()) {
+        fprintf(stderr, "Failed to open log file\n");
+        return 1;
+    }
+    gl_log_set_level(GL_LOG_WARN);
+    if(!headless_init(&options)) {
+        return 2;
+    }
+    g_aspect = (float)options.width / (float)options.height;
+    gl_state_reset();
+    gl_state_viewport(0, 0, options.width, options.height);
+    gl_state_enable(GL_DEPTH_TEST, true);
+    gl_state_depth_func(GL_LESS);
+    gl_state_enable(GL_CULL_FACE, true);
+    GLuint program = build_shader_program("./culled.vert", "./batch.frag");
+    if(!program) {
+        return 3;
+    }
+    set_uniform_vec4(program, "input_color", 0.9f, 0.5f, 0.2f, 1.0f);
+    mesh_batch batch;
+    batch_init(&batch);
+    add_meshes(&batch);
+    batch_upload(&batch);
+    gpu_culler culler;
+    if(!gpu_culler_init(&culler, "./cull.comp")) {
+        return 4;
+    }
+    gpu_culler_set_meshes(&culler, &batch);
+    gpu_culler_bind_instances(&culler, &batch);
+    stream_buffer stream;
+    if(!stream_buffer_init(&stream, GL_DRAW_INDIRECT_BUFFER, 100000 * sizeof(draw_elements_indirect_command))) {
+        return 5;
+    }
+    glClearColor(0.6f, 0.6f, 0.8f, 1.0f);
+    gl_log_set_level(GL_LOG_INFO);
+
+    gl_log("\ncull-bench: %s, %ix%i, %i frames per run, %s\n", glGetString(GL_RENDERER), options.width,
+        options.height, g_frames, culler.compact ? "ARB_indirect_parameters" : "no indirect count");
+    int counts[] = { 10000, 100000 };
+    std::vector<cull_object> objects;
+    for(int c = 0; c < 2; c++) {
+        make_objects(objects, counts[c], (int)batch.meshes.size());
+        gpu_culler_set_objects(&culler, objects.data(), counts[c]);
+        gl_log("\n%i objects\n", counts[c]);
+        if(!check_gpu_cull(&culler, objects)) {
+            return 6;
+        }
+        gl_log("  %-32s %9s %9s %9s\n", "path", "cpu ms", "frame ms", "visible");
+        for(int mode = CULL_CPU_DRAWS; mode <= CULL_GPU_INDIRECT; mode++) {
+            if(!run(mode, program, &batch, &culler, &stream, objects)) {
+                return 7;
+            }
+        }
+    }
+    log_gpu_culler_stats(&culler);
+    log_stream_buffer_stats(&stream);
+    stream_buffer_destroy(&stream);
+    gpu_culler_destroy(&culler);
+    batch_destroy(&batch);
+    headless_shutdown();
+    return 0;
+}
@@ -0,0 +1,11 @@
+#version 410
+
+layout(location = 0) in vec3 vertex_position;
+// xyz centre, w radius, fetched through the draw's base_instance
+layout(location = 1) in vec4 instance_sphere;
+
+uniform mat4 view_projection;
+
+void main() {
+    gl_Position = view_projection * vec4(vertex_position * instance_sphere.w + instance_sphere.xyz, 1.0);
+}
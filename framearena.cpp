@@ -0,0 +1,91 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "logging.h"
+#include "framearena.h"
+
+// heap spill for a frame that outgrew its half; freed when the half resets
+struct frame_arena_overflow {
+    frame_arena_overflow * next;
+};
+
+static size_t align_up(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+bool frame_arena_init(frame_arena * arena, size_t capacity) {
+    memset(arena, 0, sizeof(*arena));
+    arena->capacity = align_up(capacity, 64);
+    for(int i = 0; i < FRAME_ARENA_FRAMES; i++) {
+        arena->blocks[i] = (char *)aligned_alloc(64, arena->capacity);
+        if(!arena->blocks[i]) {
+            gl_log_err("ERROR: could not allocate a %lu byte frame arena\n", (unsigned long)arena->capacity);
+            frame_arena_destroy(arena);
+            return false;
+        }
+    }
+    gl_log("frame arena: %i x %lu bytes\n", FRAME_ARENA_FRAMES, (unsigned long)arena->capacity);
+    return true;
+}
+
+static void * overflow_alloc(frame_arena * arena, size_t size, size_t alignment) {
+    // the link sits in front of the aligned payload
+    size_t header = align_up(sizeof(frame_arena_overflow), alignment);
+    char * block = (char *)aligned_alloc(alignment, align_up(header + size, alignment));
+    if(!block) {
+        return NULL;
+    }
+    frame_arena_overflow * link = (frame_arena_overflow *)block;
+    link->next = arena->overflow[arena->frame];
+    arena->overflow[arena->frame] = link;
+    arena->overflow_allocations++;
+    return block + header;
+}
+
+void * frame_arena_alloc(frame_arena * arena, size_t size, size_t alignment) {
+    if(alignment < sizeof(void *)) {
+        alignment = sizeof(void *);
+    }
+    size_t offset = align_up(arena->used, alignment);
+    arena->bytes_allocated += size;
+    if(offset + size > arena->capacity) {
+        return overflow_alloc(arena, size, alignment);
+    }
+    arena->used = offset + size;
+    if(arena->used > arena->high_water) {
+        arena->high_water = arena->used;
+    }
+    return arena->blocks[arena->frame] + offset;
+}
+
+static void release_overflow(frame_arena * arena, int frame) {
+    frame_arena_overflow * link = arena->overflow[frame];
+    while(link) {
+        frame_arena_overflow * next = link->next;
+        free(link);
+        link = next;
+    }
+    arena->overflow[frame] = NULL;
+}
+
+void frame_arena_end_frame(frame_arena * arena) {
+    arena->frame = (arena->frame + 1) % FRAME_ARENA_FRAMES;
+    arena->used = 0;
+    release_overflow(arena, arena->frame);
+    arena->frames++;
+}
+
+void log_frame_arena_stats(const frame_arena * arena) {
+    gl_log("frame arena: %lu frames, %llu bytes allocated, high water %lu of %lu bytes, %lu overflow allocations\n",
+        arena->frames, arena->bytes_allocated, (unsigned long)arena->high_water, (unsigned long)arena->capacity,
+        arena->overflow_allocations);
+}
+
+void frame_arena_destroy(frame_arena * arena) {
+    for(int i = 0; i < FRAME_ARENA_FRAMES; i++) {
+        release_overflow(arena, i);
+        free(arena->blocks[i]);
+        arena->blocks[i] = NULL;
+    }
+    arena->used = 0;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <stddef.h>
+
+// Per-frame bump allocator for transient CPU data: command lists, uniform
+// blocks, cull results. Two halves alternate: frame_arena_end_frame(), called
+// next to the swap, flips to the other half and resets it, so what frame N
+// allocated stays valid while frame N+1 is built and the driver reads it.
+// Nothing is freed individually. A frame that outgrows its half spills into
+// heap blocks that are released when that half comes round again.
+#define FRAME_ARENA_FRAMES 2
+
+struct frame_arena_overflow;
+
+struct frame_arena {
+    char * blocks[FRAME_ARENA_FRAMES];
+    size_t capacity;
+    size_t used;
+    int frame;
+    frame_arena_overflow * overflow[FRAME_ARENA_FRAMES];
+    size_t high_water;
+    unsigned long frames;
+    unsigned long overflow_allocations;
+    unsigned long long bytes_allocated;
+};
+
+bool frame_arena_init(frame_arena * arena, size_t capacity);
+void * frame_arena_alloc(frame_arena * arena, size_t size, size_t alignment = 16);
+void frame_arena_end_frame(frame_arena * arena);
+void log_frame_arena_stats(const frame_arena * arena);
+void frame_arena_destroy(frame_arena * arena);
+
+// uninitialised storage for count Ts; only for types without destructors
+template <typename T>
+T * frame_arena_alloc_array(frame_arena * arena, size_t count) {
+    return (T *)frame_arena_alloc(arena, count * sizeof(T), alignof(T) > 16 ? alignof(T) : 16);
+}
@@ -0,0 +1,693 @@
+#define GL_CAPTURE_PASSTHROUGH
+#include <GL/glew.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "logging.h"
+#include "assetloader.h"
+#include "frametiming.h"
+#include "framecapture.h"
+#include "glstate.h"
+#include "profiler.h"
+#include "glcapture.h"
+
+enum capture_format {
+    CAPTURE_PPM,
+    CAPTURE_PNG,
+    CAPTURE_RAW,
+};
+
+// what a readback is for; one frame can serve several
+enum {
+    CAPTURE_RECORD = 1,
+    CAPTURE_SCREENSHOT = 2,
+    CAPTURE_GOLDEN = 4,
+};
+
+struct readback_slot {
+    GLuint buffer;
+    GLsync fence;
+    long frame;
+    int uses;
+    int width;
+    int height;
+};
+
+struct capture_image {
+    // RGBA, bottom row first as glReadPixels leaves it
+    unsigned char * pixels;
+    long frame;
+    int uses;
+    int width;
+    int height;
+};
+
+struct frame_capture {
+    frame_capture_options options;
+    bool active;
+    int width;
+    int height;
+    long frame;
+    readback_slot slots[FRAME_CAPTURE_SLOTS];
+    unsigned long head;
+    unsigned long tail;
+    capture_image images[FRAME_CAPTURE_IMAGES];
+    // guarded by mutex: the free list and the writer's queue
+    std::mutex mutex;
+    std::condition_variable work;
+    std::condition_variable space;
+    int free_images[FRAME_CAPTURE_IMAGES];
+    int free_count;
+    int queue[FRAME_CAPTURE_IMAGES];
+    int queue_head;
+    int queue_count;
+    bool stop;
+    std::thread writer;
+    // writer thread only
+    unsigned char * encode;
+    size_t encode_capacity;
+    FILE * stream;
+    bool golden_done;
+    bool golden_passed;
+    // statistics; the writer's are read after it has been joined
+    unsigned long readbacks;
+    unsigned long ring_stalls;
+    unsigned long writer_stalls;
+    double ring_wait;
+    double writer_wait;
+    double issue_time;
+    double copy_time;
+    double copy_max;
+    unsigned long latency_frames;
+    unsigned long images_written;
+    unsigned long long bytes_written;
+    double encode_time;
+    // counted on the writer and on the GL thread alike
+    std::atomic<unsigned long> write_errors;
+};
+
+static frame_capture g_capture;
+static uint32_t g_crc_table[256];
+
+bool parse_frame_capture_args(int * argc, char ** argv, frame_capture_options * options) {
+    options->record_pattern = NULL;
+    options->screenshot_frame = -1;
+    options->screenshot_path = NULL;
+    options->golden_frame = -1;
+    options->golden_path = NULL;
+    options->golden_update = false;
+    options->tolerance = 2;
+    options->max_bad_percent = 0.0;
+    int kept = 1;
+    for(int i = 1; i < *argc; i++) {
+        if(!strcmp(argv[i], "--record") && i + 1 < *argc) {
+            options->record_pattern = argv[++i];
+        } else if(!strcmp(argv[i], "--screenshot") && i + 2 < *argc) {
+            options->screenshot_frame = atol(argv[++i]);
+            options->screenshot_path = argv[++i];
+        } else if(!strcmp(argv[i], "--golden") && i + 2 < *argc) {
+            options->golden_frame = atol(argv[++i]);
+            options->golden_path = argv[++i];
+        } else if(!strcmp(argv[i], "--golden-update")) {
+            options->golden_update = true;
+        } else if(!strcmp(argv[i], "--tolerance") && i + 1 < *argc) {
+            options->tolerance = atoi(argv[++i]);
+        } else if(!strcmp(argv[i], "--max-bad-pixels") && i + 1 < *argc) {
+            options->max_bad_percent = atof(argv[++i]);
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    *argc = kept;
+    argv[kept] = NULL;
+    if(options->screenshot_path && options->screenshot_frame < 0) {
+        fprintf(stderr, "--screenshot expects a frame number from 0, got %li\n", options->screenshot_frame);
+        return false;
+    }
+    if(options->golden_path && options->golden_frame < 0) {
+        fprintf(stderr, "--golden expects a frame number from 0, got %li\n", options->golden_frame);
+        return false;
+    }
+    if(options->golden_update && !options->golden_path) {
+        fprintf(stderr, "--golden-update needs --golden N FILE to know what to write\n");
+        return false;
+    }
+    if(options->tolerance < 0 || options->tolerance > 255 || options->max_bad_percent < 0.0) {
+        fprintf(stderr, "--tolerance expects 0 to 255 and --max-bad-pixels a percentage\n");
+        return false;
+    }
+    return true;
+}
+
+static capture_format format_of(const char * path) {
+    const char * dot = strrchr(path, '.');
+    if(dot && !strcmp(dot, ".png")) {
+        return CAPTURE_PNG;
+    }
+    if(dot && !strcmp(dot, ".raw")) {
+        return CAPTURE_RAW;
+    }
+    return CAPTURE_PPM;
+}
+
+static void init_crc_table() {
+    for(uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for(int k = 0; k < 8; k++) {
+            c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        }
+        g_crc_table[n] = c;
+    }
+}
+
+static uint32_t crc32_update(uint32_t crc, const unsigned char * data, size_t length) {
+    for(size_t i = 0; i < length; i++) {
+        crc = g_crc_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+static void put_u32(unsigned char * p, uint32_t v) {
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+static bool write_png_chunk(FILE * file, const char * type, const unsigned char * data, size_t length) {
+    unsigned char header[8];
+    put_u32(header, (uint32_t)length);
+    memcpy(header + 4, type, 4);
+    uint32_t crc = crc32_update(0xffffffffu, header + 4, 4);
+    crc = crc32_update(crc, data, length) ^ 0xffffffffu;
+    unsigned char trailer[4];
+    put_u32(trailer, crc);
+    return fwrite(header, 1, 8, file) == 8 && fwrite(data, 1, length, file) == length
+        && fwrite(trailer, 1, 4, file) == 4;
+}
+
+static bool reserve_encode(size_t size) {
+    if(size <= g_capture.encode_capacity) {
+        return true;
+    }
+    unsigned char * grown = (unsigned char *)realloc(g_capture.encode, size);
+    if(!grown) {
+        return false;
+    }
+    g_capture.encode = grown;
+    g_capture.encode_capacity = size;
+    return true;
+}
+
+// RGB rows top first, each behind a filter byte when filtered is set
+static size_t flip_to_rgb(const capture_image * image, unsigned char * out, bool filtered) {
+    unsigned char * p = out;
+    for(int y = image->height - 1; y >= 0; y--) {
+        const unsigned char * row = image->pixels + (size_t)y * image->width * 4;
+        if(filtered) {
+            *p++ = 0;
+        }
+        for(int x = 0; x < image->width; x++) {
+            p[0] = row[x * 4];
+            p[1] = row[x * 4 + 1];
+            p[2] = row[x * 4 + 2];
+            p += 3;
+        }
+    }
+    return p - out;
+}
+
+// RGB PNG with stored (uncompressed) deflate blocks: no zlib dependency,
+// and the writer thread spends its time on disk rather than compression
+static bool write_png(FILE * file, const capture_image * image) {
+    size_t raw = (size_t)image->height * (1 + (size_t)image->width * 3);
+    size_t blocks = (raw + 65534) / 65535;
+    size_t idat = 2 + raw + blocks * 5 + 4;
+    // the scanlines go at the end so the stored blocks can be built in front of them
+    if(!reserve_encode(idat + raw)) {
+        return false;
+    }
+    unsigned char * scanlines = g_capture.encode + idat;
+    flip_to_rgb(image, scanlines, true);
+    unsigned char * p = g_capture.encode;
+    *p++ = 0x78;
+    *p++ = 0x01;
+    uint32_t a = 1, b = 0;
+    for(size_t offset = 0; offset < raw; offset += 65535) {
+        size_t length = raw - offset < 65535 ? raw - offset : 65535;
+        *p++ = offset + length == raw ? 1 : 0;
+        p[0] = (unsigned char)length;
+        p[1] = (unsigned char)(length >> 8);
+        p[2] = (unsigned char)~length;
+        p[3] = (unsigned char)(~length >> 8);
+        p += 4;
+        memmove(p, scanlines + offset, length);
+        for(size_t i = 0; i < length; i++) {
+            a = (a + p[i]) % 65521;
+            b = (b + a) % 65521;
+        }
+        p += length;
+    }
+    put_u32(p, (b << 16) | a);
+    unsigned char ihdr[13];
+    put_u32(ihdr, (uint32_t)image->width);
+    put_u32(ihdr + 4, (uint32_t)image->height);
+    // 8 bits per channel, RGB, deflate, no filtering choice, no interlace
+    ihdr[8] = 8;
+    ihdr[9] = 2;
+    ihdr[10] = ihdr[11] = ihdr[12] = 0;
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    return fwrite(signature, 1, 8, file) == 8 && write_png_chunk(file, "IHDR", ihdr, sizeof(ihdr))
+        && write_png_chunk(file, "IDAT", g_capture.encode, idat)
+        && write_png_chunk(file, "IEND", NULL, 0);
+}
+
+static bool write_image(FILE * file, const capture_image * image, capture_format format) {
+    if(format == CAPTURE_PNG) {
+        return write_png(file, image);
+    }
+    size_t row = (size_t)image->width * (format == CAPTURE_RAW ? 4 : 3);
+    if(!reserve_encode(row * image->height)) {
+        return false;
+    }
+    size_t size = row * image->height;
+    if(format == CAPTURE_RAW) {
+        for(int y = 0; y < image->height; y++) {
+            memcpy(g_capture.encode + y * row, image->pixels + (size_t)(image->height - 1 - y) * row, row);
+        }
+    } else {
+        fprintf(file, "P6\n%i %i\n255\n", image->width, image->height);
+        flip_to_rgb(image, g_capture.encode, false);
+    }
+    return fwrite(g_capture.encode, 1, size, file) == size;
+}
+
+static bool write_image_file(const char * path, const capture_image * image) {
+    FILE * file = fopen(path, "wb");
+    if(!file) {
+        gl_log_err("ERROR: could not open %s for the captured frame\n", path);
+        return false;
+    }
+    bool written = write_image(file, image, format_of(path));
+    long size = ftell(file);
+    if(fclose(file) != 0 || !written) {
+        gl_log_err("ERROR: could not write captured frame %li to %s\n", image->frame, path);
+        return false;
+    }
+    g_capture.bytes_written += size > 0 ? size : 0;
+    g_capture.images_written++;
+    return true;
+}
+
+// binary PPM: "P6 <width> <height> 255" then RGB bytes
+static bool parse_ppm(const mapped_file * file, int * width, int * height, const unsigned char ** pixels) {
+    const char * data = (const char *)file->data;
+    int values[3];
+    size_t p = 2;
+    if(file->size < 2 || data[0] != 'P' || data[1] != '6') {
+        return false;
+    }
+    for(int i = 0; i < 3; i++) {
+        while(p < file->size && (data[p] == ' ' || data[p] == '\t' || data[p] == '\r' || data[p] == '\n'
+            || data[p] == '#')) {
+            if(data[p] == '#') {
+                while(p < file->size && data[p] != '\n') {
+                    p++;
+                }
+            }
+            p++;
+        }
+        values[i] = 0;
+        while(p < file->size && data[p] >= '0' && data[p] <= '9') {
+            values[i] = values[i] * 10 + (data[p++] - '0');
+        }
+    }
+    *width = values[0];
+    *height = values[1];
+    *pixels = (const unsigned char *)data + p + 1;
+    return values[2] == 255 && *width > 0 && *height > 0 && p + 1 + (size_t)*width * *height * 3 <= file->size;
+}
+
+// next to the golden image, so a failed run leaves what it drew for inspection
+static void write_actual_image(const capture_image * image) {
+    char actual[512];
+    snprintf(actual, sizeof(actual), "%s.actual.ppm", g_capture.options.golden_path);
+    if(write_image_file(actual, image)) {
+        gl_log_err("  rendered frame written to %s\n", actual);
+    }
+}
+
+static bool compare_golden(const capture_image * image) {
+    const frame_capture_options & options = g_capture.options;
+    if(options.golden_update) {
+        gl_log("frame capture: writing frame %li as the golden image %s\n", image->frame, options.golden_path);
+        return write_image_file(options.golden_path, image);
+    }
+    struct stat st;
+    if(stat(options.golden_path, &st) != 0) {
+        // a check with nothing to check against fails; --golden-update makes one
+        gl_log_err("ERROR: no golden image at %s to compare frame %li with\n", options.golden_path, image->frame);
+        write_actual_image(image);
+        return false;
+    }
+    mapped_file file;
+    if(!map_file(options.golden_path, &file)) {
+        return false;
+    }
+    int width = 0;
+    int height = 0;
+    const unsigned char * golden = NULL;
+    bool passed = false;
+    if(!parse_ppm(&file, &width, &height, &golden)) {
+        gl_log_err("ERROR: golden image %s is not a binary PPM\n", options.golden_path);
+    } else if(width != image->width || height != image->height) {
+        gl_log_err("ERROR: golden image %s is %ix%i, frame %li is %ix%i\n", options.golden_path, width, height,
+            image->frame, image->width, image->height);
+    } else {
+        long bad = 0;
+        int worst = 0;
+        for(int y = 0; y < height; y++) {
+            const unsigned char * row = image->pixels + (size_t)(height - 1 - y) * width * 4;
+            const unsigned char * expected = golden + (size_t)y * width * 3;
+            for(int x = 0; x < width; x++) {
+                int diff = 0;
+                for(int c = 0; c < 3; c++) {
+                    int d = abs((int)row[x * 4 + c] - (int)expected[x * 3 + c]);
+                    diff = d > diff ? d : diff;
+                }
+                worst = diff > worst ? diff : worst;
+                bad += diff > options.tolerance;
+            }
+        }
+        double percent = 100.0 * bad / ((double)width * height);
+        passed = percent <= options.max_bad_percent;
+        gl_log_at(passed ? GL_LOG_INFO : GL_LOG_ERROR,
+            "%s: frame %li against %s: %li pixels (%.4f%%) past tolerance %i, worst channel difference %i\n",
+            passed ? "golden image" : "ERROR: golden image mismatch", image->frame, options.golden_path, bad,
+            percent, options.tolerance, worst);
+    }
+    unmap_file(&file);
+    if(!passed) {
+        write_actual_image(image);
+    }
+    return passed;
+}
+
+static void process_image(const capture_image * image) {
+    PROFILE_ZONE("capture_encode");
+    double start = frame_timing_seconds();
+    const frame_capture_options & options = g_capture.options;
+    if(image->uses & CAPTURE_RECORD) {
+        if(strchr(options.record_pattern, '%')) {
+            char path[512];
+            snprintf(path, sizeof(path), options.record_pattern, image->frame);
+            if(!write_image_file(path, image)) {
+                g_capture.write_errors++;
+            }
+        } else if(g_capture.stream) {
+            long before = ftell(g_capture.stream);
+            if(write_image(g_capture.stream, image, format_of(options.record_pattern))) {
+                g_capture.bytes_written += ftell(g_capture.stream) - before;
+                g_capture.images_written++;
+            } else {
+                gl_log_err("ERROR: could not append frame %li to %s\n", image->frame, options.record_pattern);
+                g_capture.write_errors++;
+            }
+        }
+    }
+    if((image->uses & CAPTURE_SCREENSHOT) && !write_image_file(options.screenshot_path, image)) {
+        g_capture.write_errors++;
+    }
+    if(image->uses & CAPTURE_GOLDEN) {
+        g_capture.golden_passed = compare_golden(image);
+        g_capture.golden_done = true;
+    }
+    g_capture.encode_time += frame_timing_seconds() - start;
+}
+
+static void writer_main() {
+    profiler_set_thread_name("capture writer");
+    for(;;) {
+        int index = -1;
+        {
+            std::unique_lock<std::mutex> lock(g_capture.mutex);
+            g_capture.work.wait(lock, []() { return g_capture.queue_count > 0 || g_capture.stop; });
+            if(g_capture.queue_count == 0) {
+                break;
+            }
+            index = g_capture.queue[g_capture.queue_head];
+            g_capture.queue_head = (g_capture.queue_head + 1) % FRAME_CAPTURE_IMAGES;
+            g_capture.queue_count--;
+        }
+        process_image(&g_capture.images[index]);
+        {
+            std::lock_guard<std::mutex> lock(g_capture.mutex);
+            g_capture.free_images[g_capture.free_count++] = index;
+        }
+        g_capture.space.notify_one();
+    }
+}
+
+static bool create_buffers(int width, int height) {
+    g_capture.width = width;
+    g_capture.height = height;
+    GLsizeiptr size = (GLsizeiptr)width * height * 4;
+    for(int i = 0; i < FRAME_CAPTURE_SLOTS; i++) {
+        readback_slot & slot = g_capture.slots[i];
+        if(!slot.buffer) {
+            glGenBuffers(1, &slot.buffer);
+        }
+        gl_state_bind_buffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+    }
+    gl_state_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+    for(int i = 0; i < FRAME_CAPTURE_IMAGES; i++) {
+        free(g_capture.images[i].pixels);
+        g_capture.images[i].pixels = (unsigned char *)malloc(size);
+        if(!g_capture.images[i].pixels) {
+            gl_log_err("ERROR: could not allocate %i frame capture images of %ix%i\n", FRAME_CAPTURE_IMAGES,
+                width, height);
+            // tried again on the next captured frame
+            g_capture.width = g_capture.height = 0;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool frame_capture_init(const frame_capture_options * options, int width, int height) {
+    g_capture.options = *options;
+    g_capture.active = options->record_pattern || options->screenshot_path || options->golden_path;
+    if(!g_capture.active) {
+        return true;
+    }
+    init_crc_table();
+    g_capture.frame = 0;
+    g_capture.head = g_capture.tail = 0;
+    g_capture.free_count = FRAME_CAPTURE_IMAGES;
+    for(int i = 0; i < FRAME_CAPTURE_IMAGES; i++) {
+        g_capture.free_images[i] = i;
+    }
+    g_capture.queue_head = g_capture.queue_count = 0;
+    g_capture.stop = false;
+    g_capture.golden_done = false;
+    g_capture.golden_passed = false;
+    if(!create_buffers(width, height)) {
+        return false;
+    }
+    if(options->record_pattern && !strchr(options->record_pattern, '%')) {
+        g_capture.stream = fopen(options->record_pattern, "wb");
+        if(!g_capture.stream) {
+            gl_log_err("ERROR: could not open %s for recording\n", options->record_pattern);
+            return false;
+        }
+    }
+    g_capture.writer = std::thread(writer_main);
+    gl_log("frame capture: %ix%i, %i readback buffers, %i images%s%s%s%s\n", width, height,
+        FRAME_CAPTURE_SLOTS, FRAME_CAPTURE_IMAGES, options->record_pattern ? ", recording to " : "",
+        options->record_pattern ? options->record_pattern : "", options->golden_path ? ", golden " : "",
+        options->golden_path ? options->golden_path : "");
+    return true;
+}
+
+// maps the oldest readback if its fence has signalled, or waits for it;
+// false if there was nothing to collect or it is still in flight
+static bool collect_oldest(bool wait) {
+    if(g_capture.tail == g_capture.head) {
+        return false;
+    }
+    readback_slot & slot = g_capture.slots[g_capture.tail % FRAME_CAPTURE_SLOTS];
+    GLenum status = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+        wait ? 1000000000ULL : 0);
+    if(status == GL_TIMEOUT_EXPIRED) {
+        if(!wait) {
+            return false;
+        }
+        gl_log_err("ERROR: frame capture readback of frame %li still pending after 1 s\n", slot.frame);
+    }
+    int index = -1;
+    {
+        std::unique_lock<std::mutex> lock(g_capture.mutex);
+        if(g_capture.free_count == 0) {
+            if(!wait) {
+                return false;
+            }
+            PROFILE_ZONE("capture_writer_wait");
+            double start = frame_timing_seconds();
+            g_capture.space.wait(lock, []() { return g_capture.free_count > 0; });
+            g_capture.writer_stalls++;
+            g_capture.writer_wait += frame_timing_seconds() - start;
+        }
+        index = g_capture.free_images[--g_capture.free_count];
+    }
+    double start = frame_timing_seconds();
+    capture_image & image = g_capture.images[index];
+    size_t size = (size_t)slot.width * slot.height * 4;
+    gl_state_bind_buffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    const void * mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if(mapped) {
+        memcpy(image.pixels, mapped, size);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    } else {
+        gl_log_err("ERROR: could not map the readback of frame %li\n", slot.frame);
+    }
+    gl_state_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+    glDeleteSync(slot.fence);
+    slot.fence = 0;
+    double copy = frame_timing_seconds() - start;
+    g_capture.copy_time += copy;
+    g_capture.copy_max = copy > g_capture.copy_max ? copy : g_capture.copy_max;
+    g_capture.latency_frames += g_capture.frame - slot.frame;
+    g_capture.tail++;
+    std::lock_guard<std::mutex> lock(g_capture.mutex);
+    if(!mapped) {
+        g_capture.free_images[g_capture.free_count++] = index;
+        return true;
+    }
+    image.frame = slot.frame;
+    image.uses = slot.uses;
+    image.width = slot.width;
+    image.height = slot.height;
+    g_capture.queue[(g_capture.queue_head + g_capture.queue_count) % FRAME_CAPTURE_IMAGES] = index;
+    g_capture.queue_count++;
+    g_capture.work.notify_one();
+    return true;
+}
+
+// everything read back so far is handed to the writer, and the writer is idle
+static void drain() {
+    while(collect_oldest(true)) {
+    }
+    std::unique_lock<std::mutex> lock(g_capture.mutex);
+    g_capture.space.wait(lock, []() { return g_capture.free_count == FRAME_CAPTURE_IMAGES; });
+}
+
+void frame_capture_frame(int width, int height) {
+    if(!g_capture.active) {
+        return;
+    }
+    PROFILE_ZONE("frame_capture");
+    long frame = g_capture.frame++;
+    // everything whose fence has signalled since the last frame
+    while(collect_oldest(false)) {
+    }
+    const frame_capture_options & options = g_capture.options;
+    int uses = 0;
+    uses |= options.record_pattern ? CAPTURE_RECORD : 0;
+    uses |= frame == options.screenshot_frame && options.screenshot_path ? CAPTURE_SCREENSHOT : 0;
+    uses |= frame == options.golden_frame && options.golden_path ? CAPTURE_GOLDEN : 0;
+    if(!uses) {
+        return;
+    }
+    if(width != g_capture.width || height != g_capture.height) {
+        // rare: a window resize; the buffers are only ever the current size
+        drain();
+        if(!create_buffers(width, height)) {
+            g_capture.write_errors++;
+            return;
+        }
+        gl_log("frame capture: resized to %ix%i at frame %li\n", width, height, frame);
+    }
+    if(g_capture.head - g_capture.tail == FRAME_CAPTURE_SLOTS) {
+        PROFILE_ZONE("capture_ring_wait");
+        double start = frame_timing_seconds();
+        collect_oldest(true);
+        g_capture.ring_stalls++;
+        g_capture.ring_wait += frame_timing_seconds() - start;
+    }
+    double start = frame_timing_seconds();
+    readback_slot & slot = g_capture.slots[g_capture.head % FRAME_CAPTURE_SLOTS];
+    gl_state_bind_buffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    // into the buffer, so this only queues the copy
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    gl_state_bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.frame = frame;
+    slot.uses = uses;
+    slot.width = width;
+    slot.height = height;
+    g_capture.head++;
+    g_capture.readbacks++;
+    g_capture.issue_time += frame_timing_seconds() - start;
+}
+
+void log_frame_capture_stats() {
+    if(!g_capture.readbacks) {
+        return;
+    }
+    unsigned long collected = g_capture.tail;
+    double per = collected ? 1000.0 / collected : 0.0;
+    gl_log("frame capture: %lu readbacks, %lu images written (%.1f MB), %lu write errors\n", g_capture.readbacks,
+        g_capture.images_written, g_capture.bytes_written / (1024.0 * 1024.0), g_capture.write_errors.load());
+    gl_log("  GL thread per frame: issue %.3f ms, map+copy %.3f ms (max %.3f), mapped %.1f frames after the read\n",
+        g_capture.readbacks ? g_capture.issue_time * 1000.0 / g_capture.readbacks : 0.0,
+        g_capture.copy_time * per, g_capture.copy_max * 1000.0, collected ? (double)g_capture.latency_frames / collected : 0.0);
+    gl_log("  stalls: %lu on the readback ring (%.3f ms), %lu on the writer (%.3f ms); writer %.3f ms per image\n",
+        g_capture.ring_stalls, g_capture.ring_wait * 1000.0, g_capture.writer_stalls, g_capture.writer_wait * 1000.0,
+        g_capture.encode_time * per);
+}
+
+bool frame_capture_shutdown() {
+    if(!g_capture.active) {
+        return true;
+    }
+    drain();
+    {
+        std::lock_guard<std::mutex> lock(g_capture.mutex);
+        g_capture.stop = true;
+    }
+    g_capture.work.notify_one();
+    g_capture.writer.join();
+    if(g_capture.stream) {
+        fclose(g_capture.stream);
+        g_capture.stream = NULL;
+    }
+    for(int i = 0; i < FRAME_CAPTURE_SLOTS; i++) {
+        gl_state_delete_buffers(1, &g_capture.slots[i].buffer);
+        g_capture.slots[i].buffer = 0;
+    }
+    for(int i = 0; i < FRAME_CAPTURE_IMAGES; i++) {
+        free(g_capture.images[i].pixels);
+        g_capture.images[i].pixels = NULL;
+    }
+    free(g_capture.encode);
+    g_capture.encode = NULL;
+    g_capture.encode_capacity = 0;
+    g_capture.active = false;
+    bool passed = true;
+    if(g_capture.options.golden_path && !g_capture.golden_done) {
+        gl_log_err("ERROR: golden frame %li was never rendered (%li frames)\n", g_capture.options.golden_frame,
+            g_capture.frame);
+        passed = false;
+    } else if(g_capture.options.golden_path) {
+        passed = g_capture.golden_passed;
+    }
+    return passed && g_capture.write_errors.load() == 0;
+}
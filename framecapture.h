@@ -0,0 +1,46 @@
+#pragma once
+#include <GL/glew.h>
+
+// Framebuffer capture without stalling the pipeline. frame_capture_frame()
+// reads the finished frame into the next of a ring of pixel-pack buffers
+// and fences it; a few frames later, once the fence has signalled, the
+// buffer is mapped and copied into a pooled image. A writer thread flips
+// and encodes that image and writes it out, or compares it against a
+// golden image. The GL thread only waits when the whole ring is in flight
+// or the writer has fallen behind, and both are counted.
+//
+//   --record PATTERN       every frame; PATTERN takes the frame number,
+//                          e.g. capture/frame-%05li.png. Without a % every
+//                          frame is appended to one stream, e.g. for
+//                          ffmpeg -f rawvideo -pix_fmt rgba or -f image2pipe
+//   --screenshot N FILE    frame N only
+//   --golden N FILE        compare frame N with FILE (binary PPM); a missing
+//                          FILE fails the run
+//   --golden-update        write frame N to the --golden FILE instead
+//   --tolerance T          per-channel difference still counted as equal (2)
+//   --max-bad-pixels P     percent of pixels allowed past the tolerance (0)
+//
+// The file extension picks the format: .png, .raw (RGBA, top row first) or
+// binary PPM for anything else.
+#define FRAME_CAPTURE_SLOTS 3
+// copied images waiting for, or being encoded by, the writer thread
+#define FRAME_CAPTURE_IMAGES 6
+
+struct frame_capture_options {
+    const char * record_pattern;
+    long screenshot_frame;
+    const char * screenshot_path;
+    long golden_frame;
+    const char * golden_path;
+    bool golden_update;
+    int tolerance;
+    double max_bad_percent;
+};
+
+bool parse_frame_capture_args(int * argc, char ** argv, frame_capture_options * options);
+bool frame_capture_init(const frame_capture_options * options, int width, int height);
+// after the frame is drawn and before it is presented; reads the bound read framebuffer
+void frame_capture_frame(int width, int height);
+void log_frame_capture_stats();
+// finishes outstanding readbacks and writes; false if the golden compare failed
+bool frame_capture_shutdown();
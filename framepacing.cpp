@@ -0,0 +1,234 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include "logging.h"
+#include "frametiming.h"
+#include "framepacing.h"
+#include "profiler.h"
+
+// the frame cost prediction is the worst of this many recent frames
+#define PACING_COST_FRAMES 16
+// slack between the predicted end of the frame and its deadline
+#define PACING_MARGIN_MS 0.5
+// below this the sleep turns into yielding, since sleep_for overshoots
+#define PACING_SPIN_MS 1.0
+
+struct frame_pacer {
+    GLFWwindow * window;
+    frame_pacing_options options;
+    bool active;
+    bool vsync;
+    double period;
+    double deadline;
+    double costs[PACING_COST_FRAMES];
+    int cost_index;
+    double frame_start;
+    double last_poll;
+    double previous_poll;
+    double last_present;
+    bool input;
+    unsigned long frames;
+    unsigned long input_frames;
+    unsigned long missed;
+    double slept;
+    double oversleep_max;
+    frame_histogram work;
+    frame_histogram interval;
+    frame_histogram newest_input;
+    frame_histogram oldest_input;
+};
+
+static frame_pacer g_pacer;
+
+bool parse_frame_pacing_args(int * argc, char ** argv, frame_pacing_options * options) {
+    options->target_fps = 0.0;
+    options->swap_interval = 1;
+    options->late_latch = false;
+    int kept = 1;
+    for(int i = 1; i < *argc; i++) {
+        if(!strcmp(argv[i], "--fps") && i + 1 < *argc) {
+            options->target_fps = atof(argv[++i]);
+            if(options->target_fps < 0.0) {
+                fprintf(stderr, "--fps expects a positive rate, got %s\n", argv[i]);
+                return false;
+            }
+        } else if(!strcmp(argv[i], "--swap-interval") && i + 1 < *argc) {
+            i++;
+            if(!strcmp(argv[i], "adaptive")) {
+                options->swap_interval = SWAP_INTERVAL_ADAPTIVE;
+            } else if(!strcmp(argv[i], "0") || !strcmp(argv[i], "1")) {
+                options->swap_interval = atoi(argv[i]);
+            } else {
+                fprintf(stderr, "--swap-interval expects 0, 1 or adaptive, got %s\n", argv[i]);
+                return false;
+            }
+        } else if(!strcmp(argv[i], "--late-latch")) {
+            options->late_latch = true;
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    *argc = kept;
+    argv[kept] = NULL;
+    return true;
+}
+
+void frame_pacing_init(GLFWwindow * window, const frame_pacing_options * options) {
+    memset(&g_pacer, 0, sizeof(g_pacer));
+    g_pacer.window = window;
+    g_pacer.options = *options;
+    int interval = window ? options->swap_interval : 0;
+    if(window) {
+        if(interval == SWAP_INTERVAL_ADAPTIVE && !glfwExtensionSupported("GLX_EXT_swap_control_tear")
+            && !glfwExtensionSupported("WGL_EXT_swap_control_tear")) {
+            gl_log("frame pacing: adaptive vsync unsupported, using vsync\n");
+            interval = 1;
+        }
+        glfwSwapInterval(interval);
+        g_pacer.vsync = interval != 0;
+    }
+    if(options->target_fps > 0.0) {
+        g_pacer.period = 1.0 / options->target_fps;
+    } else if(g_pacer.vsync) {
+        const GLFWvidmode * mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+        if(mode && mode->refreshRate > 0) {
+            g_pacer.period = 1.0 / mode->refreshRate;
+        }
+    }
+    g_pacer.active = window || g_pacer.period > 0.0;
+    if(!g_pacer.active) {
+        return;
+    }
+    g_pacer.last_present = g_pacer.last_poll = g_pacer.previous_poll = frame_timing_seconds();
+    gl_log("frame pacing: %s%.3f ms frames, swap interval %i, late latch %s\n",
+        g_pacer.period > 0.0 ? "" : "uncapped, ", g_pacer.period * 1000.0, interval,
+        options->late_latch ? "on" : "off");
+}
+
+static double predicted_cost() {
+    double cost = 0.0;
+    for(int i = 0; i < PACING_COST_FRAMES; i++) {
+        if(g_pacer.costs[i] > cost) {
+            cost = g_pacer.costs[i];
+        }
+    }
+    return cost;
+}
+
+static void sleep_until(double wake) {
+    double now = frame_timing_seconds();
+    if(now >= wake) {
+        return;
+    }
+    PROFILE_ZONE("pacing_sleep");
+    double start = now;
+    while(wake - now > PACING_SPIN_MS / 1000.0) {
+        std::this_thread::sleep_for(std::chrono::duration<double>(wake - now - PACING_SPIN_MS / 1000.0));
+        now = frame_timing_seconds();
+    }
+    while(now < wake) {
+        std::this_thread::yield();
+        now = frame_timing_seconds();
+    }
+    g_pacer.slept += now - start;
+    if(now - wake > g_pacer.oversleep_max) {
+        g_pacer.oversleep_max = now - wake;
+    }
+}
+
+static void poll_input() {
+    PROFILE_ZONE("poll_input");
+    if(g_pacer.window) {
+        glfwPollEvents();
+    }
+    g_pacer.last_poll = frame_timing_seconds();
+}
+
+void frame_pacing_begin_frame() {
+    if(!g_pacer.active) {
+        return;
+    }
+    if(g_pacer.period > 0.0) {
+        if(g_pacer.deadline <= 0.0) {
+            g_pacer.deadline = g_pacer.last_present + g_pacer.period;
+        }
+        sleep_until(g_pacer.deadline - predicted_cost() - PACING_MARGIN_MS / 1000.0);
+    }
+    g_pacer.input = false;
+    poll_input();
+    g_pacer.frame_start = g_pacer.last_poll;
+}
+
+void frame_pacing_input_event() {
+    g_pacer.input = true;
+}
+
+void frame_pacing_latch() {
+    if(g_pacer.active && g_pacer.options.late_latch) {
+        poll_input();
+    }
+}
+
+void frame_pacing_end_frame() {
+    if(!g_pacer.active) {
+        return;
+    }
+    double submit = frame_timing_seconds();
+    if(g_pacer.window) {
+        PROFILE_ZONE("swap_buffers");
+        glfwSwapBuffers(g_pacer.window);
+    }
+    double present = frame_timing_seconds();
+    // a vsynced swap blocks until the flip; that wait is not frame cost
+    double cost = (g_pacer.vsync ? submit : present) - g_pacer.frame_start;
+    g_pacer.costs[g_pacer.cost_index] = cost;
+    g_pacer.cost_index = (g_pacer.cost_index + 1) % PACING_COST_FRAMES;
+    frame_histogram_add(g_pacer.work, cost * 1000.0);
+    frame_histogram_add(g_pacer.interval, (present - g_pacer.last_present) * 1000.0);
+    frame_histogram_add(g_pacer.newest_input, (present - g_pacer.last_poll) * 1000.0);
+    frame_histogram_add(g_pacer.oldest_input, (present - g_pacer.previous_poll) * 1000.0);
+    g_pacer.frames++;
+    if(g_pacer.input) {
+        g_pacer.input_frames++;
+    }
+
+    if(g_pacer.period > 0.0) {
+        double late = present - g_pacer.deadline;
+        if(late > g_pacer.period * 0.5) {
+            // missed by a good part of a frame: start a new schedule from here
+            g_pacer.missed++;
+            g_pacer.deadline = present + g_pacer.period;
+        } else if(g_pacer.vsync) {
+            // the swap returns at the flip, so follow the display's clock
+            g_pacer.deadline = present + g_pacer.period;
+        } else {
+            g_pacer.deadline += g_pacer.period;
+        }
+    }
+    g_pacer.previous_poll = g_pacer.last_poll;
+    g_pacer.last_present = present;
+}
+
+static void log_histogram(const char * name, const frame_histogram & h) {
+    gl_log("  %-16s %8.3f %8.3f %8.3f %8.3f %8.3f\n", name, frame_histogram_mean(h),
+        frame_histogram_percentile(h, 0.50), frame_histogram_percentile(h, 0.95),
+        frame_histogram_percentile(h, 0.99), h.max_ms);
+}
+
+void log_frame_pacing_stats() {
+    if(!g_pacer.active) {
+        return;
+    }
+    gl_log("\nFrame pacing (%lu frames, %lu with input, %lu missed deadlines, %.3f s slept, "
+        "max oversleep %.3f ms):\n", g_pacer.frames, g_pacer.input_frames, g_pacer.missed, g_pacer.slept,
+        g_pacer.oversleep_max * 1000.0);
+    gl_log("  %-16s %8s %8s %8s %8s %8s\n", "name", "mean", "p50", "p95", "p99", "max");
+    log_histogram("frame_work", g_pacer.work);
+    log_histogram("present_interval", g_pacer.interval);
+    log_histogram("newest_input", g_pacer.newest_input);
+    log_histogram("oldest_input", g_pacer.oldest_input);
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <GLFW/glfw3.h>
+
+// Frame pacing for interactive runs. Rather than sleeping after the swap,
+// the pacer sleeps before the frame starts: until the next present deadline
+// minus the predicted cost of the frame, and only then polls input, so the
+// events a frame reacts to are as fresh as possible when it is shown. With
+// late latching, input is polled once more just before submission.
+// Input latency is recorded per frame as the age of the input at present:
+// from the frame's last poll (the newest event it could show) and from the
+// previous frame's last poll (an event that just missed it).
+#define SWAP_INTERVAL_ADAPTIVE -1
+
+struct frame_pacing_options {
+    // 0 paces to the monitor refresh under vsync, and is uncapped without it
+    double target_fps;
+    // 0 off, 1 vsync; adaptive tears instead of waiting a whole refresh when late
+    int swap_interval;
+    bool late_latch;
+};
+
+// removes --fps N, --swap-interval 0|1|adaptive and --late-latch from argv
+bool parse_frame_pacing_args(int * argc, char ** argv, frame_pacing_options * options);
+// headless runs without a target rate stay unthrottled: every call below
+// is then a no-op
+void frame_pacing_init(GLFWwindow * window, const frame_pacing_options * options);
+// sleeps until it is time to start the frame, then polls input
+void frame_pacing_begin_frame();
+// for input callbacks: counts frames that carried events
+void frame_pacing_input_event();
+// polls input again when late latching; call right before input is consumed
+void frame_pacing_latch();
+// swaps if there is a window and records the frame's timings
+void frame_pacing_end_frame();
+void log_frame_pacing_stats();
@@ -0,0 +1,340 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "logging.h"
+#include "frametiming.h"
+
+#define HISTOGRAM_MIN_MS 0.001
+#define HISTOGRAM_GROWTH 1.02
+// frames in flight before a query slot is reused
+#define QUERY_FRAMES 4
+#define MAX_PASSES 16
+
+struct pass_timing {
+    std::string name;
+    frame_histogram run;
+    frame_histogram window;
+};
+
+struct query_frame {
+    GLuint begin[MAX_PASSES];
+    GLuint end[MAX_PASSES];
+    int pass_index[MAX_PASSES];
+    int pass_count;
+    bool pending;
+};
+
+static std::chrono::steady_clock::time_point g_clock_start = std::chrono::steady_clock::now();
+static double g_frame_start = -1.0;
+static frame_histogram g_cpu_run;
+static frame_histogram g_cpu_window;
+static std::vector<pass_timing> g_passes;
+static query_frame g_query_frames[QUERY_FRAMES];
+static int g_query_frame = 0;
+static int g_open_pass = -1;
+static bool g_gpu_timing = false;
+static unsigned long g_gpu_late = 0;
+
+static std::string g_csv_path;
+static std::string g_json_path;
+static double g_dump_interval = 0.0;
+static double g_last_dump = 0.0;
+static double g_last_title = 0.0;
+
+void frame_histogram_clear(frame_histogram & h) {
+    memset(&h, 0, sizeof(h));
+}
+
+void frame_histogram_add(frame_histogram & h, double ms) {
+    int bucket = 0;
+    if(ms > HISTOGRAM_MIN_MS) {
+        bucket = (int)(log(ms / HISTOGRAM_MIN_MS) / log(HISTOGRAM_GROWTH));
+    }
+    if(bucket < 0) {
+        bucket = 0;
+    }
+    if(bucket >= HISTOGRAM_BUCKETS) {
+        bucket = HISTOGRAM_BUCKETS - 1;
+    }
+    h.counts[bucket]++;
+    h.total++;
+    h.sum_ms += ms;
+    if(ms > h.max_ms) {
+        h.max_ms = ms;
+    }
+}
+
+// upper edge of the bucket holding the given fraction of samples
+double frame_histogram_percentile(const frame_histogram & h, double fraction) {
+    if(h.total == 0) {
+        return 0.0;
+    }
+    unsigned long target = (unsigned long)(fraction * h.total);
+    if(target >= h.total) {
+        target = h.total - 1;
+    }
+    unsigned long seen = 0;
+    for(int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += h.counts[i];
+        if(seen > target) {
+            double edge = HISTOGRAM_MIN_MS * pow(HISTOGRAM_GROWTH, i + 1);
+            return edge < h.max_ms ? edge : h.max_ms;
+        }
+    }
+    return h.max_ms;
+}
+
+double frame_histogram_mean(const frame_histogram & h) {
+    return h.total ? h.sum_ms / h.total : 0.0;
+}
+
+double frame_timing_seconds() {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - g_clock_start;
+    return elapsed.count();
+}
+
+void frame_timing_init() {
+    frame_histogram_clear(g_cpu_run);
+    frame_histogram_clear(g_cpu_window);
+    g_passes.clear();
+    g_passes.reserve(MAX_PASSES);
+    // timer queries are core since 3.3, but be defensive about odd contexts
+    GLint bits = 0;
+    glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+    g_gpu_timing = bits > 0;
+    for(int i = 0; i < QUERY_FRAMES; i++) {
+        query_frame & frame = g_query_frames[i];
+        if(g_gpu_timing) {
+            glGenQueries(MAX_PASSES, frame.begin);
+            glGenQueries(MAX_PASSES, frame.end);
+        }
+        frame.pass_count = 0;
+        frame.pending = false;
+    }
+    g_query_frame = 0;
+    g_frame_start = -1.0;
+    g_last_dump = g_last_title = frame_timing_seconds();
+    gl_log("frame timing: GPU timestamps %s (%i bits)\n", g_gpu_timing ? "enabled" : "unavailable", bits);
+}
+
+// collects a finished frame's timestamps if the GPU is done with them
+static bool collect_query_frame(query_frame & frame) {
+    if(!frame.pending) {
+        return true;
+    }
+    if(frame.pass_count > 0) {
+        GLint available = 0;
+        glGetQueryObjectiv(frame.end[frame.pass_count - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if(!available) {
+            return false;
+        }
+    }
+    for(int i = 0; i < frame.pass_count; i++) {
+        GLuint64 begin = 0;
+        GLuint64 end = 0;
+        glGetQueryObjectui64v(frame.begin[i], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(frame.end[i], GL_QUERY_RESULT, &end);
+        double ms = (double)(end - begin) / 1000000.0;
+        pass_timing & pass = g_passes[frame.pass_index[i]];
+        frame_histogram_add(pass.run, ms);
+        frame_histogram_add(pass.window, ms);
+    }
+    frame.pending = false;
+    frame.pass_count = 0;
+    return true;
+}
+
+// prefix plus name, so the periodic dumps never build strings on the heap
+static void write_csv_rows(FILE * file, double now, const char * prefix, const char * name,
+    const frame_histogram & h) {
+    fprintf(file, "%.3f,%s%s,%lu,%.4f,%.4f,%.4f,%.4f,%.4f\n", now, prefix, name, h.total, frame_histogram_mean(h),
+        frame_histogram_percentile(h, 0.50), frame_histogram_percentile(h, 0.95),
+        frame_histogram_percentile(h, 0.99), h.max_ms);
+}
+
+static void write_json_entry(FILE * file, const char * prefix, const char * name, const frame_histogram & h,
+    bool last) {
+    fprintf(file, "    {\"name\": \"%s%s\", \"count\": %lu, \"mean_ms\": %.4f, \"p50_ms\": %.4f, "
+        "\"p95_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f}%s\n", prefix, name, h.total, frame_histogram_mean(h),
+        frame_histogram_percentile(h, 0.50), frame_histogram_percentile(h, 0.95),
+        frame_histogram_percentile(h, 0.99), h.max_ms, last ? "" : ",");
+}
+
+static void dump_stats(double now) {
+    if(!g_csv_path.empty()) {
+        FILE * file = fopen(g_csv_path.c_str(), "a");
+        if(file) {
+            // header only for a fresh file
+            if(ftell(file) == 0) {
+                fprintf(file, "time_s,name,count,mean_ms,p50_ms,p95_ms,p99_ms,max_ms\n");
+            }
+            write_csv_rows(file, now, "", "cpu_frame", g_cpu_window);
+            for(size_t i = 0; i < g_passes.size(); i++) {
+                write_csv_rows(file, now, "gpu:", g_passes[i].name.c_str(), g_passes[i].window);
+            }
+            fclose(file);
+        } else {
+            gl_log_err("ERROR: could not append frame timings to %s\n", g_csv_path.c_str());
+        }
+    }
+    if(!g_json_path.empty()) {
+        FILE * file = fopen(g_json_path.c_str(), "w");
+        if(file) {
+            fprintf(file, "{\n  \"time_s\": %.3f,\n  \"gpu_late_frames\": %lu,\n  \"timings\": [\n", now, g_gpu_late);
+            write_json_entry(file, "", "cpu_frame", g_cpu_run, g_passes.empty());
+            for(size_t i = 0; i < g_passes.size(); i++) {
+                write_json_entry(file, "gpu:", g_passes[i].name.c_str(), g_passes[i].run, i + 1 == g_passes.size());
+            }
+            fprintf(file, "  ]\n}\n");
+            fclose(file);
+        } else {
+            gl_log_err("ERROR: could not write frame timings to %s\n", g_json_path.c_str());
+        }
+    }
+    frame_histogram_clear(g_cpu_window);
+    for(size_t i = 0; i < g_passes.size(); i++) {
+        frame_histogram_clear(g_passes[i].window);
+    }
+}
+
+void frame_timing_begin_frame() {
+    double now = frame_timing_seconds();
+    if(g_frame_start >= 0.0) {
+        double ms = (now - g_frame_start) * 1000.0;
+        frame_histogram_add(g_cpu_run, ms);
+        frame_histogram_add(g_cpu_window, ms);
+    }
+    g_frame_start = now;
+
+    if(g_gpu_timing) {
+        // pick up whatever older frames have finished, oldest first
+        for(int i = 1; i <= QUERY_FRAMES; i++) {
+            collect_query_frame(g_query_frames[(g_query_frame + i) % QUERY_FRAMES]);
+        }
+        g_query_frame = (g_query_frame + 1) % QUERY_FRAMES;
+        query_frame & frame = g_query_frames[g_query_frame];
+        if(frame.pending) {
+            // GPU is more than QUERY_FRAMES behind; drop this sample instead of waiting
+            g_gpu_late++;
+            frame.pending = false;
+            frame.pass_count = 0;
+        }
+    }
+
+    if(g_dump_interval > 0.0 && now - g_last_dump >= g_dump_interval) {
+        dump_stats(now);
+        g_last_dump = now;
+    }
+}
+
+void frame_timing_begin_pass(const char * name) {
+    if(!g_gpu_timing) {
+        return;
+    }
+    query_frame & frame = g_query_frames[g_query_frame];
+    if(g_open_pass >= 0 || frame.pass_count >= MAX_PASSES) {
+        gl_log_err("ERROR: frame timing pass %s not recorded (nested or more than %i passes)\n", name, MAX_PASSES);
+        return;
+    }
+    int index = -1;
+    for(size_t i = 0; i < g_passes.size(); i++) {
+        if(g_passes[i].name == name) {
+            index = (int)i;
+            break;
+        }
+    }
+    if(index < 0) {
+        if(g_passes.size() >= MAX_PASSES) {
+            return;
+        }
+        pass_timing pass;
+        pass.name = name;
+        frame_histogram_clear(pass.run);
+        frame_histogram_clear(pass.window);
+        g_passes.push_back(pass);
+        index = (int)g_passes.size() - 1;
+    }
+    g_open_pass = frame.pass_count;
+    frame.pass_index[g_open_pass] = index;
+    glQueryCounter(frame.begin[g_open_pass], GL_TIMESTAMP);
+}
+
+void frame_timing_end_pass() {
+    if(!g_gpu_timing || g_open_pass < 0) {
+        return;
+    }
+    query_frame & frame = g_query_frames[g_query_frame];
+    glQueryCounter(frame.end[g_open_pass], GL_TIMESTAMP);
+    frame.pass_count = g_open_pass + 1;
+    frame.pending = true;
+    g_open_pass = -1;
+}
+
+void frame_timing_set_dump(const char * csv_path, const char * json_path, double interval_seconds) {
+    g_csv_path = csv_path ? csv_path : "";
+    g_json_path = json_path ? json_path : "";
+    g_dump_interval = interval_seconds;
+}
+
+bool frame_timing_percentiles(double * p50, double * p95, double * p99, double * max) {
+    *p50 = frame_histogram_percentile(g_cpu_run, 0.50);
+    *p95 = frame_histogram_percentile(g_cpu_run, 0.95);
+    *p99 = frame_histogram_percentile(g_cpu_run, 0.99);
+    *max = g_cpu_run.max_ms;
+    return g_cpu_run.total > 0;
+}
+
+void frame_timing_update_title(GLFWwindow* window) {
+    double now = frame_timing_seconds();
+    if(now - g_last_title < 0.25) {
+        return;
+    }
+    g_last_title = now;
+    double mean = frame_histogram_mean(g_cpu_run);
+    char tmp[128];
+    snprintf(tmp, sizeof(tmp), "opengl @ fps: %.2f p50: %.2f ms p99: %.2f ms max: %.2f ms",
+        mean > 0.0 ? 1000.0 / mean : 0.0, frame_histogram_percentile(g_cpu_run, 0.50),
+        frame_histogram_percentile(g_cpu_run, 0.99), g_cpu_run.max_ms);
+    glfwSetWindowTitle(window, tmp);
+}
+
+void frame_timing_shutdown() {
+    if(g_gpu_timing) {
+        // the context is still current; this is the one place allowed to wait
+        glFinish();
+        for(int i = 1; i <= QUERY_FRAMES; i++) {
+            collect_query_frame(g_query_frames[(g_query_frame + i) % QUERY_FRAMES]);
+        }
+    }
+    double now = frame_timing_seconds();
+    if(g_dump_interval > 0.0) {
+        dump_stats(now);
+    }
+    gl_log("\nFrame timing summary (%lu frames):\n", g_cpu_run.total);
+    gl_log("  %-16s %8s %8s %8s %8s %8s\n", "name", "mean", "p50", "p95", "p99", "max");
+    gl_log("  %-16s %8.3f %8.3f %8.3f %8.3f %8.3f\n", "cpu_frame", frame_histogram_mean(g_cpu_run),
+        frame_histogram_percentile(g_cpu_run, 0.50), frame_histogram_percentile(g_cpu_run, 0.95),
+        frame_histogram_percentile(g_cpu_run, 0.99), g_cpu_run.max_ms);
+    for(size_t i = 0; i < g_passes.size(); i++) {
+        const frame_histogram & h = g_passes[i].run;
+        std::string name = "gpu:" + g_passes[i].name;
+        gl_log("  %-16s %8.3f %8.3f %8.3f %8.3f %8.3f\n", name.c_str(), frame_histogram_mean(h),
+            frame_histogram_percentile(h, 0.50), frame_histogram_percentile(h, 0.95),
+            frame_histogram_percentile(h, 0.99), h.max_ms);
+    }
+    if(g_gpu_late) {
+        gl_log("  %lu frames of GPU timings dropped (GPU more than %i frames behind)\n", g_gpu_late, QUERY_FRAMES);
+    }
+    if(g_gpu_timing) {
+        for(int i = 0; i < QUERY_FRAMES; i++) {
+            glDeleteQueries(MAX_PASSES, g_query_frames[i].begin);
+            glDeleteQueries(MAX_PASSES, g_query_frames[i].end);
+        }
+        g_gpu_timing = false;
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+// CPU frame-time histogram plus per-pass GPU timestamps. GPU results are
+// read back a few frames late and only once available, so nothing here
+// waits on the driver.
+
+// log-spaced buckets, 2% wide, from 1 us to ~1 s; the ends catch the rest
+#define HISTOGRAM_BUCKETS 700
+
+struct frame_histogram {
+    unsigned int counts[HISTOGRAM_BUCKETS];
+    unsigned long total;
+    double sum_ms;
+    double max_ms;
+};
+
+void frame_histogram_clear(frame_histogram & h);
+void frame_histogram_add(frame_histogram & h, double ms);
+// upper edge of the bucket holding the given fraction of samples
+double frame_histogram_percentile(const frame_histogram & h, double fraction);
+double frame_histogram_mean(const frame_histogram & h);
+
+void frame_timing_init();
+void frame_timing_begin_frame();
+void frame_timing_begin_pass(const char * name);
+void frame_timing_end_pass();
+void frame_timing_set_dump(const char * csv_path, const char * json_path, double interval_seconds);
+bool frame_timing_percentiles(double * p50, double * p95, double * p99, double * max);
+double frame_timing_seconds();
+void frame_timing_update_title(GLFWwindow* window);
+void frame_timing_shutdown();
@@ -0,0 +1,827 @@
+#include <GL/glew.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include "logging.h"
+#include "frametiming.h"
+#include "headless.h"
+#include "assetloader.h"
+#include "glcapture.h"
+
+// Replays a trace written by a GL_CAPTURE build (--headless --capture FILE)
+// into a headless context, unthrottled, and reports per-frame CPU time
+// (issuing the frame's calls) and GPU time (GL_TIME_ELAPSED around the
+// frame). Results can be saved and compared against a saved baseline; a
+// regression beyond the thresholds makes the exit code non-zero.
+//   gl-replay trace.bin [--repeat N] [--skip N] [--save run.csv]
+//       [--compare baseline.csv] [--threshold PERCENT] [--min-delta MS]
+#define REPLAY_QUERIES 4
+
+struct replay_mapping {
+    char * data;
+    GLintptr offset;
+};
+
+struct replay_state {
+    std::unordered_map<GLuint, GLuint> buffers;
+    std::unordered_map<GLuint, GLuint> arrays;
+    std::unordered_map<GLuint, GLuint> textures;
+    std::unordered_map<GLuint, GLuint> shaders;
+    std::unordered_map<GLuint, GLuint> programs;
+    std::unordered_map<uint64_t, GLsync> syncs;
+    std::unordered_map<GLuint, replay_mapping> mapped;
+    GLuint unpack_buffer;
+};
+
+struct replay_reader {
+    const char * p;
+    const char * end;
+    bool ok;
+};
+
+struct frame_sample {
+    double cpu_ms;
+    double gpu_ms;
+};
+
+struct replay_summary {
+    double cpu_mean;
+    double cpu_p95;
+    double gpu_mean;
+    double gpu_p95;
+};
+
+static void read(replay_reader * r, void * out, size_t size) {
+    if(r->p + size > r->end) {
+        r->ok = false;
+        memset(out, 0, size);
+        return;
+    }
+    memcpy(out, r->p, size);
+    r->p += size;
+}
+
+static uint32_t get_u32(replay_reader * r) {
+    uint32_t v;
+    read(r, &v, sizeof(v));
+    return v;
+}
+
+static int32_t get_i32(replay_reader * r) {
+    int32_t v;
+    read(r, &v, sizeof(v));
+    return v;
+}
+
+static float get_f32(replay_reader * r) {
+    float v;
+    read(r, &v, sizeof(v));
+    return v;
+}
+
+static uint64_t get_u64(replay_reader * r) {
+    uint64_t v;
+    read(r, &v, sizeof(v));
+    return v;
+}
+
+// payloads are used in place; the trace stays loaded for the whole run
+static const char * get_bytes(replay_reader * r, size_t size) {
+    if(r->p + size > r->end) {
+        r->ok = false;
+        return NULL;
+    }
+    const char * bytes = r->p;
+    r->p += size;
+    return bytes;
+}
+
+static const char * get_blob(replay_reader * r, uint64_t * size) {
+    uint32_t present = get_u32(r);
+    *size = get_u64(r);
+    return present ? get_bytes(r, (size_t)*size) : NULL;
+}
+
+// pixels are either inline, absent, or (kind 2) an offset into the bound PBO
+static const void * get_pixels(replay_reader * r) {
+    uint32_t kind = get_u32(r);
+    uint64_t value = get_u64(r);
+    if(kind == 2) {
+        return (const void *)(uintptr_t)value;
+    }
+    return kind ? get_bytes(r, (size_t)value) : NULL;
+}
+
+static GLuint lookup(std::unordered_map<GLuint, GLuint> & names, GLuint name) {
+    if(!name) {
+        return 0;
+    }
+    std::unordered_map<GLuint, GLuint>::iterator it = names.find(name);
+    return it == names.end() ? 0 : it->second;
+}
+
+static void gen_names(replay_reader * r, std::unordered_map<GLuint, GLuint> & names,
+    void (*gen)(GLsizei, GLuint *)) {
+    GLsizei n = (GLsizei)get_u32(r);
+    std::vector<GLuint> created(n);
+    gen(n, created.data());
+    for(GLsizei i = 0; i < n; i++) {
+        names[get_u32(r)] = created[i];
+    }
+}
+
+static void delete_names(replay_reader * r, std::unordered_map<GLuint, GLuint> & names,
+    void (*del)(GLsizei, const GLuint *)) {
+    GLsizei n = (GLsizei)get_u32(r);
+    std::vector<GLuint> doomed;
+    for(GLsizei i = 0; i < n; i++) {
+        GLuint name = get_u32(r);
+        doomed.push_back(lookup(names, name));
+        names.erase(name);
+    }
+    del(n, doomed.data());
+}
+
+static void gen_buffers(GLsizei n, GLuint * names) { glGenBuffers(n, names); }
+static void delete_buffers(GLsizei n, const GLuint * names) { glDeleteBuffers(n, names); }
+static void gen_vertex_arrays(GLsizei n, GLuint * names) { glGenVertexArrays(n, names); }
+static void delete_vertex_arrays(GLsizei n, const GLuint * names) { glDeleteVertexArrays(n, names); }
+static void gen_textures(GLsizei n, GLuint * names) { glGenTextures(n, names); }
+static void delete_textures(GLsizei n, const GLuint * names) { glDeleteTextures(n, names); }
+
+static bool replay_call(replay_state * s, int op, replay_reader * r) {
+    switch(op) {
+        case CAPTURE_GEN_BUFFERS: gen_names(r, s->buffers, gen_buffers); break;
+        case CAPTURE_DELETE_BUFFERS: delete_names(r, s->buffers, delete_buffers); break;
+        case CAPTURE_GEN_VERTEX_ARRAYS: gen_names(r, s->arrays, gen_vertex_arrays); break;
+        case CAPTURE_DELETE_VERTEX_ARRAYS: delete_names(r, s->arrays, delete_vertex_arrays); break;
+        case CAPTURE_GEN_TEXTURES: gen_names(r, s->textures, gen_textures); break;
+        case CAPTURE_DELETE_TEXTURES: delete_names(r, s->textures, delete_textures); break;
+        case CAPTURE_CREATE_SHADER: {
+            GLenum type = get_u32(r);
+            s->shaders[get_u32(r)] = glCreateShader(type);
+            break;
+        }
+        case CAPTURE_DELETE_SHADER: {
+            GLuint shader = get_u32(r);
+            glDeleteShader(lookup(s->shaders, shader));
+            s->shaders.erase(shader);
+            break;
+        }
+        case CAPTURE_CREATE_PROGRAM: s->programs[get_u32(r)] = glCreateProgram(); break;
+        case CAPTURE_DELETE_PROGRAM: {
+            GLuint program = get_u32(r);
+            glDeleteProgram(lookup(s->programs, program));
+            s->programs.erase(program);
+            break;
+        }
+        case CAPTURE_BIND_BUFFER: {
+            GLenum target = get_u32(r);
+            GLuint buffer = lookup(s->buffers, get_u32(r));
+            glBindBuffer(target, buffer);
+            break;
+        }
+        case CAPTURE_BIND_BUFFER_BASE: {
+            GLenum target = get_u32(r);
+            GLuint index = get_u32(r);
+            glBindBufferBase(target, index, lookup(s->buffers, get_u32(r)));
+            break;
+        }
+        case CAPTURE_BUFFER_DATA: {
+            GLenum target = get_u32(r);
+            GLenum usage = get_u32(r);
+            GLsizeiptr size = (GLsizeiptr)get_u64(r);
+            uint64_t blob = 0;
+            const char * data = get_blob(r, &blob);
+            glBufferData(target, size, data, usage);
+            break;
+        }
+        case CAPTURE_BUFFER_SUB_DATA: {
+            GLenum target = get_u32(r);
+            GLintptr offset = (GLintptr)get_u64(r);
+            uint64_t size = 0;
+            const char * data = get_blob(r, &size);
+            glBufferSubData(target, offset, (GLsizeiptr)size, data);
+            break;
+        }
+        case CAPTURE_BUFFER_STORAGE: {
+            GLenum target = get_u32(r);
+            GLbitfield flags = get_u32(r);
+            GLsizeiptr size = (GLsizeiptr)get_u64(r);
+            uint64_t blob = 0;
+            const char * data = get_blob(r, &blob);
+            glBufferStorage(target, size, data, flags);
+            break;
+        }
+        case CAPTURE_CLEAR_BUFFER_DATA: {
+            GLenum target = get_u32(r);
+            GLenum internal_format = get_u32(r);
+            GLenum format = get_u32(r);
+            GLenum type = get_u32(r);
+            uint64_t size = 0;
+            const char * data = get_blob(r, &size);
+            glClearBufferData(target, internal_format, format, type, data);
+            break;
+        }
+        case CAPTURE_MAP_BUFFER_RANGE: {
+            GLenum target = get_u32(r);
+            GLuint buffer = lookup(s->buffers, get_u32(r));
+            GLintptr offset = (GLintptr)get_u64(r);
+            GLsizeiptr length = (GLsizeiptr)get_u64(r);
+            GLbitfield access = get_u32(r);
+            replay_mapping mapping;
+            mapping.data = (char *)glMapBufferRange(target, offset, length, access);
+            mapping.offset = offset;
+            if(!mapping.data) {
+                gl_log_err("ERROR: replay could not map buffer %u\n", buffer);
+                return false;
+            }
+            s->mapped[buffer] = mapping;
+            break;
+        }
+        case CAPTURE_UNMAP_BUFFER: {
+            GLenum target = get_u32(r);
+            s->mapped.erase(lookup(s->buffers, get_u32(r)));
+            glUnmapBuffer(target);
+            break;
+        }
+        case CAPTURE_BUFFER_WRITE: {
+            GLuint buffer = lookup(s->buffers, get_u32(r));
+            GLintptr offset = (GLintptr)get_u64(r);
+            size_t size = (size_t)get_u64(r);
+            const char * data = get_bytes(r, size);
+            std::unordered_map<GLuint, replay_mapping>::iterator it = s->mapped.find(buffer);
+            if(it == s->mapped.end() || !data) {
+                gl_log_err("ERROR: replay write into unmapped buffer %u\n", buffer);
+                return false;
+            }
+            memcpy(it->second.data + (offset - it->second.offset), data, size);
+            break;
+        }
+        case CAPTURE_BIND_VERTEX_ARRAY: glBindVertexArray(lookup(s->arrays, get_u32(r))); break;
+        case CAPTURE_ENABLE_VERTEX_ATTRIB_ARRAY: glEnableVertexAttribArray(get_u32(r)); break;
+        case CAPTURE_DISABLE_VERTEX_ATTRIB_ARRAY: glDisableVertexAttribArray(get_u32(r)); break;
+        case CAPTURE_VERTEX_ATTRIB_POINTER: {
+            GLuint index = get_u32(r);
+            GLint size = get_i32(r);
+            GLenum type = get_u32(r);
+            GLboolean normalized = (GLboolean)get_u32(r);
+            GLsizei stride = get_i32(r);
+            uint64_t offset = get_u64(r);
+            glVertexAttribPointer(index, size, type, normalized, stride, (const void *)(uintptr_t)offset);
+            break;
+        }
+        case CAPTURE_VERTEX_ATTRIB_DIVISOR: {
+            GLuint index = get_u32(r);
+            glVertexAttribDivisor(index, get_u32(r));
+            break;
+        }
+        case CAPTURE_VERTEX_ATTRIB_4F: {
+            GLuint index = get_u32(r);
+            float x = get_f32(r), y = get_f32(r), z = get_f32(r), w = get_f32(r);
+            glVertexAttrib4f(index, x, y, z, w);
+            break;
+        }
+        case CAPTURE_SHADER_SOURCE: {
+            GLuint shader = lookup(s->shaders, get_u32(r));
+            uint64_t size = 0;
+            const char * text = get_blob(r, &size);
+            GLint length = (GLint)size;
+            glShaderSource(shader, 1, &text, &length);
+            break;
+        }
+        case CAPTURE_COMPILE_SHADER: glCompileShader(lookup(s->shaders, get_u32(r))); break;
+        case CAPTURE_ATTACH_SHADER: {
+            GLuint program = lookup(s->programs, get_u32(r));
+            glAttachShader(program, lookup(s->shaders, get_u32(r)));
+            break;
+        }
+        case CAPTURE_DETACH_SHADER: {
+            GLuint program = lookup(s->programs, get_u32(r));
+            glDetachShader(program, lookup(s->shaders, get_u32(r)));
+            break;
+        }
+        case CAPTURE_LINK_PROGRAM: glLinkProgram(lookup(s->programs, get_u32(r))); break;
+        case CAPTURE_PROGRAM_PARAMETERI: {
+            GLuint program = lookup(s->programs, get_u32(r));
+            GLenum name = get_u32(r);
+            glProgramParameteri(program, name, get_i32(r));
+            break;
+        }
+        case CAPTURE_PROGRAM_BINARY: {
+            GLuint program = lookup(s->programs, get_u32(r));
+            GLenum format = get_u32(r);
+            uint64_t size = 0;
+            const char * binary = get_blob(r, &size);
+            glProgramBinary(program, format, binary, (GLsizei)size);
+            break;
+        }
+        case CAPTURE_USE_PROGRAM: glUseProgram(lookup(s->programs, get_u32(r))); break;
+        case CAPTURE_UNIFORM_BLOCK_BINDING: {
+            GLuint program = lookup(s->programs, get_u32(r));
+            GLuint block = get_u32(r);
+            glUniformBlockBinding(program, block, get_u32(r));
+            break;
+        }
+        case CAPTURE_PROGRAM_UNIFORM_1F: {
+            GLuint program = lookup(s->programs, get_u32(r));
+            GLint location = get_i32(r);
+            glProgramUniform1f(program, location, get_f32(r));
+            break;
+        }
+        case CAPTURE_PROGRAM_UNIFORM_1I: {
+            GLuint program = lookup(s->programs, get_u32(r));
+            GLint location = get_i32(r);
+            glProgramUniform1i(program, location, get_i32(r));
+            break;
+        }
+        case CAPTURE_PROGRAM_UNIFORM_FV:
+        case CAPTURE_PROGRAM_UNIFORM_MATRIX_FV: {
+            GLuint program = lookup(s->programs, get_u32(r));
+            GLint location = get_i32(r);
+            uint32_t components = get_u32(r);
+            GLsizei count = get_i32(r);
+            GLboolean transpose = (GLboolean)get_u32(r);
+            const GLfloat * value = (const GLfloat *)get_bytes(r, components * count * sizeof(GLfloat));
+            if(!value) {
+                break;
+            }
+            switch(components) {
+                case 2: glProgramUniform2fv(program, location, count, value); break;
+                case 3: glProgramUniform3fv(program, location, count, value); break;
+                case 4: glProgramUniform4fv(program, location, count, value); break;
+                case 9: glProgramUniformMatrix3fv(program, location, count, transpose, value); break;
+                case 16: glProgramUniformMatrix4fv(program, location, count, transpose, value); break;
+                default:
+                    gl_log_err("ERROR: replay uniform with %u components\n", components);
+                    return false;
+            }
+            break;
+        }
+        case CAPTURE_ACTIVE_TEXTURE: glActiveTexture(get_u32(r)); break;
+        case CAPTURE_BIND_TEXTURE: {
+            GLenum target = get_u32(r);
+            glBindTexture(target, lookup(s->textures, get_u32(r)));
+            break;
+        }
+        case CAPTURE_TEX_PARAMETERI: {
+            GLenum target = get_u32(r);
+            GLenum name = get_u32(r);
+            glTexParameteri(target, name, get_i32(r));
+            break;
+        }
+        case CAPTURE_TEX_IMAGE_2D: {
+            GLenum target = get_u32(r);
+            GLint level = get_i32(r);
+            GLint internal_format = get_i32(r);
+            GLsizei width = get_i32(r);
+            GLsizei height = get_i32(r);
+            GLint border = get_i32(r);
+            GLenum format = get_u32(r);
+            GLenum type = get_u32(r);
+            const void * pixels = get_pixels(r);
+            glTexImage2D(target, level, internal_format, width, height, border, format, type, pixels);
+            break;
+        }
+        case CAPTURE_TEX_SUB_IMAGE_2D: {
+            GLenum target = get_u32(r);
+            GLint level = get_i32(r);
+            GLint x = get_i32(r);
+            GLint y = get_i32(r);
+            GLsizei width = get_i32(r);
+            GLsizei height = get_i32(r);
+            GLenum format = get_u32(r);
+            GLenum type = get_u32(r);
+            const void * pixels = get_pixels(r);
+            glTexSubImage2D(target, level, x, y, width, height, format, type, pixels);
+            break;
+        }
+        case CAPTURE_GENERATE_MIPMAP: glGenerateMipmap(get_u32(r)); break;
+        case CAPTURE_VIEWPORT: {
+            GLint x = get_i32(r), y = get_i32(r);
+            GLsizei width = get_i32(r), height = get_i32(r);
+            glViewport(x, y, width, height);
+            break;
+        }
+        case CAPTURE_ENABLE: glEnable(get_u32(r)); break;
+        case CAPTURE_DISABLE: glDisable(get_u32(r)); break;
+        case CAPTURE_DEPTH_FUNC: glDepthFunc(get_u32(r)); break;
+        case CAPTURE_DEPTH_MASK: glDepthMask((GLboolean)get_u32(r)); break;
+        case CAPTURE_BLEND_FUNC: {
+            GLenum src = get_u32(r);
+            glBlendFunc(src, get_u32(r));
+            break;
+        }
+        case CAPTURE_POINT_SIZE: glPointSize(get_f32(r)); break;
+        case CAPTURE_CLEAR_COLOR: {
+            float red = get_f32(r), green = get_f32(r), blue = get_f32(r), alpha = get_f32(r);
+            glClearColor(red, green, blue, alpha);
+            break;
+        }
+        case CAPTURE_CLEAR: glClear(get_u32(r)); break;
+        case CAPTURE_DRAW_ARRAYS: {
+            GLenum mode = get_u32(r);
+            GLint first = get_i32(r);
+            glDrawArrays(mode, first, get_i32(r));
+            break;
+        }
+        case CAPTURE_DRAW_ARRAYS_INSTANCED: {
+            GLenum mode = get_u32(r);
+            GLint first = get_i32(r);
+            GLsizei count = get_i32(r);
+            glDrawArraysInstanced(mode, first, count, get_i32(r));
+            break;
+        }
+        case CAPTURE_DRAW_ELEMENTS: {
+            GLenum mode = get_u32(r);
+            GLsizei count = get_i32(r);
+            GLenum type = get_u32(r);
+            glDrawElements(mode, count, type, (const void *)(uintptr_t)get_u64(r));
+            break;
+        }
+        case CAPTURE_DRAW_ELEMENTS_INSTANCED_BASE_VERTEX: {
+            GLenum mode = get_u32(r);
+            GLsizei count = get_i32(r);
+            GLenum type = get_u32(r);
+            const void * indices = (const void *)(uintptr_t)get_u64(r);
+            GLsizei instances = get_i32(r);
+            glDrawElementsInstancedBaseVertex(mode, count, type, indices, instances, get_i32(r));
+            break;
+        }
+        case CAPTURE_DRAW_ELEMENTS_INSTANCED_BASE_VERTEX_BASE_INSTANCE: {
+            GLenum mode = get_u32(r);
+            GLsizei count = get_i32(r);
+            GLenum type = get_u32(r);
+            const void * indices = (const void *)(uintptr_t)get_u64(r);
+            GLsizei instances = get_i32(r);
+            GLint base_vertex = get_i32(r);
+            glDrawElementsInstancedBaseVertexBaseInstance(mode, count, type, indices, instances, base_vertex,
+                get_u32(r));
+            break;
+        }
+        case CAPTURE_MULTI_DRAW_ARRAYS: {
+            GLenum mode = get_u32(r);
+            GLsizei draws = get_i32(r);
+            const GLint * first = (const GLint *)get_bytes(r, draws * sizeof(GLint));
+            const GLsizei * count = (const GLsizei *)get_bytes(r, draws * sizeof(GLsizei));
+            if(first && count) {
+                glMultiDrawArrays(mode, first, count, draws);
+            }
+            break;
+        }
+        case CAPTURE_MULTI_DRAW_ELEMENTS_BASE_VERTEX: {
+            GLenum mode = get_u32(r);
+            GLenum type = get_u32(r);
+            GLsizei draws = get_i32(r);
+            const GLsizei * count = (const GLsizei *)get_bytes(r, draws * sizeof(GLsizei));
+            std::vector<const void *> indices(draws);
+            for(GLsizei i = 0; i < draws; i++) {
+                indices[i] = (const void *)(uintptr_t)get_u64(r);
+            }
+            const GLint * base_vertex = (const GLint *)get_bytes(r, draws * sizeof(GLint));
+            if(count && base_vertex) {
+                glMultiDrawElementsBaseVertex(mode, count, type, indices.data(), draws, base_vertex);
+            }
+            break;
+        }
+        case CAPTURE_MULTI_DRAW_ELEMENTS_INDIRECT: {
+            GLenum mode = get_u32(r);
+            GLenum type = get_u32(r);
+            const void * indirect = (const void *)(uintptr_t)get_u64(r);
+            GLsizei draws = get_i32(r);
+            glMultiDrawElementsIndirect(mode, type, indirect, draws, get_i32(r));
+            break;
+        }
+        case CAPTURE_COPY_BUFFER_SUB_DATA: {
+            GLenum read_target = get_u32(r);
+            GLenum write_target = get_u32(r);
+            GLintptr read_offset = (GLintptr)get_u64(r);
+            GLintptr write_offset = (GLintptr)get_u64(r);
+            glCopyBufferSubData(read_target, write_target, read_offset, write_offset, (GLsizeiptr)get_u64(r));
+            break;
+        }
+        case CAPTURE_DRAW_ARRAYS_INSTANCED_BASE_INSTANCE: {
+            GLenum mode = get_u32(r);
+            GLint first = get_i32(r);
+            GLsizei count = get_i32(r);
+            GLsizei instances = get_i32(r);
+            glDrawArraysInstancedBaseInstance(mode, first, count, instances, get_u32(r));
+            break;
+        }
+        case CAPTURE_MULTI_DRAW_ARRAYS_INDIRECT: {
+            GLenum mode = get_u32(r);
+            const void * indirect = (const void *)(uintptr_t)get_u64(r);
+            GLsizei draws = get_i32(r);
+            glMultiDrawArraysIndirect(mode, indirect, draws, get_i32(r));
+            break;
+        }
+        case CAPTURE_MULTI_DRAW_ELEMENTS_INDIRECT_COUNT: {
+            GLenum mode = get_u32(r);
+            GLenum type = get_u32(r);
+            const void * indirect = (const void *)(uintptr_t)get_u64(r);
+            GLintptr draw_count = (GLintptr)get_u64(r);
+            GLsizei max_draws = get_i32(r);
+            glMultiDrawElementsIndirectCountARB(mode, type, indirect, draw_count, max_draws, get_i32(r));
+            break;
+        }
+        case CAPTURE_DISPATCH_COMPUTE: {
+            GLuint x = get_u32(r), y = get_u32(r), z = get_u32(r);
+            glDispatchCompute(x, y, z);
+            break;
+        }
+        case CAPTURE_MEMORY_BARRIER: glMemoryBarrier(get_u32(r)); break;
+        case CAPTURE_FENCE_SYNC: {
+            GLenum condition = get_u32(r);
+            GLbitfield flags = get_u32(r);
+            s->syncs[get_u64(r)] = glFenceSync(condition, flags);
+            break;
+        }
+        case CAPTURE_CLIENT_WAIT_SYNC: {
+            uint64_t id = get_u64(r);
+            GLenum status = get_u32(r);
+            std::unordered_map<uint64_t, GLsync>::iterator it = s->syncs.find(id);
+            if(it != s->syncs.end() && (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)) {
+                // the app went on to reuse memory the GPU had finished with
+                while(glClientWaitSync(it->second, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ULL) == GL_TIMEOUT_EXPIRED) {
+                }
+            }
+            break;
+        }
+        case CAPTURE_DELETE_SYNC: {
+            uint64_t id = get_u64(r);
+            std::unordered_map<uint64_t, GLsync>::iterator it = s->syncs.find(id);
+            if(it != s->syncs.end()) {
+                glDeleteSync(it->second);
+                s->syncs.erase(it);
+            }
+            break;
+        }
+        default:
+            gl_log_err("ERROR: unknown trace op %i\n", op);
+            return false;
+    }
+    if(!r->ok) {
+        gl_log_err("ERROR: truncated %s record\n", gl_capture_op_name(op));
+        return false;
+    }
+    return true;
+}
+
+// whatever the trace left alive, so the next pass starts from nothing
+static void replay_release(replay_state * s) {
+    for(std::unordered_map<GLuint, replay_mapping>::iterator it = s->mapped.begin(); it != s->mapped.end(); ++it) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, it->first);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    }
+    for(std::unordered_map<GLuint, GLuint>::iterator it = s->buffers.begin(); it != s->buffers.end(); ++it) {
+        glDeleteBuffers(1, &it->second);
+    }
+    for(std::unordered_map<GLuint, GLuint>::iterator it = s->arrays.begin(); it != s->arrays.end(); ++it) {
+        glDeleteVertexArrays(1, &it->second);
+    }
+    for(std::unordered_map<GLuint, GLuint>::iterator it = s->textures.begin(); it != s->textures.end(); ++it) {
+        glDeleteTextures(1, &it->second);
+    }
+    for(std::unordered_map<GLuint, GLuint>::iterator it = s->shaders.begin(); it != s->shaders.end(); ++it) {
+        glDeleteShader(it->second);
+    }
+    for(std::unordered_map<GLuint, GLuint>::iterator it = s->programs.begin(); it != s->programs.end(); ++it) {
+        glDeleteProgram(it->second);
+    }
+    for(std::unordered_map<uint64_t, GLsync>::iterator it = s->syncs.begin(); it != s->syncs.end(); ++it) {
+        glDeleteSync(it->second);
+    }
+    glUseProgram(0);
+    glBindVertexArray(0);
+    *s = replay_state();
+}
+
+static bool replay_pass(const std::string & trace, int skip, GLuint queries[REPLAY_QUERIES],
+    std::vector<frame_sample> & samples) {
+    replay_state state = replay_state();
+    replay_reader r = { trace.data() + sizeof(gl_capture_header), trace.data() + trace.size(), true };
+    std::vector<frame_sample> pass;
+    frame_sample sample = { 0.0, 0.0 };
+    double frame_start = frame_timing_seconds();
+    glBeginQuery(GL_TIME_ELAPSED, queries[0]);
+    while(r.p < r.end) {
+        gl_capture_record record;
+        read(&r, &record, sizeof(record));
+        if(!r.ok || r.p + record.size > r.end) {
+            gl_log_err("ERROR: trace ends inside a record\n");
+            return false;
+        }
+        replay_reader args = { r.p, r.p + record.size, true };
+        r.p += record.size;
+        if(record.op != CAPTURE_FRAME) {
+            if(!replay_call(&state, record.op, &args)) {
+                return false;
+            }
+            continue;
+        }
+        sample.cpu_ms = (frame_timing_seconds() - frame_start) * 1000.0;
+        glEndQuery(GL_TIME_ELAPSED);
+        headless_present();
+        pass.push_back(sample);
+        // the oldest query in the ring is a few frames old and usually done
+        size_t frame = pass.size();
+        if(frame >= REPLAY_QUERIES) {
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(queries[frame % REPLAY_QUERIES], GL_QUERY_RESULT, &ns);
+            pass[frame - REPLAY_QUERIES].gpu_ms = ns / 1e6;
+        }
+        frame_start = frame_timing_seconds();
+        glBeginQuery(GL_TIME_ELAPSED, queries[frame % REPLAY_QUERIES]);
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    for(size_t frame = pass.size() >= REPLAY_QUERIES ? pass.size() - REPLAY_QUERIES + 1 : 0; frame < pass.size();
+        frame++) {
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(queries[frame % REPLAY_QUERIES], GL_QUERY_RESULT, &ns);
+        pass[frame].gpu_ms = ns / 1e6;
+    }
+    replay_release(&state);
+    glFinish();
+    if(pass.size() > (size_t)skip) {
+        samples.insert(samples.end(), pass.begin() + skip, pass.end());
+    }
+    return true;
+}
+
+static double percentile(std::vector<double> values, double p) {
+    if(values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[(size_t)(p * (values.size() - 1))];
+}
+
+static replay_summary summarize(const std::vector<frame_sample> & samples) {
+    replay_summary summary = { 0.0, 0.0, 0.0, 0.0 };
+    std::vector<double> cpu;
+    std::vector<double> gpu;
+    for(size_t i = 0; i < samples.size(); i++) {
+        cpu.push_back(samples[i].cpu_ms);
+        gpu.push_back(samples[i].gpu_ms);
+        summary.cpu_mean += samples[i].cpu_ms;
+        summary.gpu_mean += samples[i].gpu_ms;
+    }
+    if(!samples.empty()) {
+        summary.cpu_mean /= samples.size();
+        summary.gpu_mean /= samples.size();
+    }
+    summary.cpu_p95 = percentile(cpu, 0.95);
+    summary.gpu_p95 = percentile(gpu, 0.95);
+    return summary;
+}
+
+static bool save_samples(const char * path, const std::vector<frame_sample> & samples) {
+    FILE * file = fopen(path, "w");
+    if(!file) {
+        gl_log_err("ERROR: could not write %s\n", path);
+        return false;
+    }
+    fprintf(file, "frame,cpu_ms,gpu_ms\n");
+    for(size_t i = 0; i < samples.size(); i++) {
+        fprintf(file, "%zu,%.6f,%.6f\n", i, samples[i].cpu_ms, samples[i].gpu_ms);
+    }
+    fclose(file);
+    return true;
+}
+
+static bool load_samples(const char * path, std::vector<frame_sample> & samples) {
+    FILE * file = fopen(path, "r");
+    if(!file) {
+        gl_log_err("ERROR: could not read baseline %s\n", path);
+        return false;
+    }
+    char line[256];
+    if(!fgets(line, sizeof(line), file)) {
+        fclose(file);
+        return false;
+    }
+    size_t frame = 0;
+    frame_sample sample;
+    while(fscanf(file, "%zu,%lf,%lf\n", &frame, &sample.cpu_ms, &sample.gpu_ms) == 3) {
+        samples.push_back(sample);
+    }
+    fclose(file);
+    return !samples.empty();
+}
+
+// slower by more than threshold percent and by more than min_delta ms
+static bool regressed(const char * name, double baseline, double current, double threshold, double min_delta) {
+    double delta = current - baseline;
+    double percent = baseline > 0.0 ? delta * 100.0 / baseline : 0.0;
+    bool bad = delta > min_delta && percent > threshold;
+    gl_log("  %-10s %10.3f %10.3f %+9.1f%%%s\n", name, baseline, current, percent, bad ? "  REGRESSION" : "");
+    return bad;
+}
+
+int main(int argc, char ** argv) {
+    const char * trace_path = NULL;
+    const char * save_path = NULL;
+    const char * compare_path = NULL;
+    int repeat = 3;
+    int skip = 1;
+    double threshold = 10.0;
+    double min_delta = 0.05;
+    for(int i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "--repeat") && i + 1 < argc) {
+            repeat = std::max(1, atoi(argv[++i]));
+        } else if(!strcmp(argv[i], "--skip") && i + 1 < argc) {
+            skip = std::max(0, atoi(argv[++i]));
+        } else if(!strcmp(argv[i], "--save") && i + 1 < argc) {
+            save_path = argv[++i];
+        } else if(!strcmp(argv[i], "--compare") && i + 1 < argc) {
+            compare_path = argv[++i];
+        } else if(!strcmp(argv[i], "--threshold") && i + 1 < argc) {
+            threshold = atof(argv[++i]);
+        } else if(!strcmp(argv[i], "--min-delta") && i + 1 < argc) {
+            min_delta = atof(argv[++i]);
+        } else if(argv[i][0] != '-' && !trace_path) {
+            trace_path = argv[i];
+        } else {
+            trace_path = NULL;
+            break;
+        }
+    }
+    if(!trace_path) {
+        fprintf(stderr, "usage: %s TRACE [--repeat N] [--skip N] [--save CSV] [--compare CSV] "
+            "[--threshold PERCENT] [--min-delta MS]\n", argv[0]);
+        return 1;
+    }
+    if(!restart_gl_log()) {
+        fprintf(stderr, "Failed to open log file\n");
+        return 1;
+    }
+    std::string trace;
+    if(!load_file(trace_path, trace)) {
+        return 2;
+    }
+    gl_capture_header header;
+    if(trace.size() < sizeof(header)) {
+        gl_log_err("ERROR: %s is not a GL trace\n", trace_path);
+        return 2;
+    }
+    memcpy(&header, trace.data(), sizeof(header));
+    if(memcmp(header.magic, GL_CAPTURE_MAGIC, 4) != 0 || header.version != GL_CAPTURE_VERSION) {
+        gl_log_err("ERROR: %s is not a version %i GL trace\n", trace_path, GL_CAPTURE_VERSION);
+        return 2;
+    }
+
+    headless_options options;
+    memset(&options, 0, sizeof(options));
+    options.enabled = true;
+    options.width = (int)header.width;
+    options.height = (int)header.height;
+    gl_log_set_level(GL_LOG_WARN);
+    if(!headless_init(&options)) {
+        return 3;
+    }
+    gl_log_set_level(GL_LOG_INFO);
+    GLuint queries[REPLAY_QUERIES];
+    glGenQueries(REPLAY_QUERIES, queries);
+    std::vector<frame_sample> samples;
+    for(int pass = 0; pass < repeat; pass++) {
+        if(!replay_pass(trace, skip, queries, samples)) {
+            return 4;
+        }
+    }
+    glDeleteQueries(REPLAY_QUERIES, queries);
+
+    replay_summary current = summarize(samples);
+    gl_log("\ngl-replay %s: %s, %ix%i, %i passes, %zu frames timed, %zu bytes\n", trace_path,
+        glGetString(GL_RENDERER), options.width, options.height, repeat, samples.size(), trace.size());
+    gl_log("  cpu ms: mean %.3f  p95 %.3f\n", current.cpu_mean, current.cpu_p95);
+    gl_log("  gpu ms: mean %.3f  p95 %.3f\n", current.gpu_mean, current.gpu_p95);
+    if(save_path && !save_samples(save_path, samples)) {
+        return 5;
+    }
+    int result = 0;
+    if(compare_path) {
+        std::vector<frame_sample> baseline_samples;
+        if(!load_samples(compare_path, baseline_samples)) {
+            return 5;
+        }
+        replay_summary baseline = summarize(baseline_samples);
+        gl_log("\ncompared with %s (threshold %.1f%%, min delta %.3f ms)\n", compare_path, threshold, min_delta);
+        gl_log("  %-10s %10s %10s %10s\n", "", "baseline", "current", "change");
+        int regressions = 0;
+        regressions += regressed("cpu mean", baseline.cpu_mean, current.cpu_mean, threshold, min_delta);
+        regressions += regressed("cpu p95", baseline.cpu_p95, current.cpu_p95, threshold, min_delta);
+        regressions += regressed("gpu mean", baseline.gpu_mean, current.gpu_mean, threshold, min_delta);
+        regressions += regressed("gpu p95", baseline.gpu_p95, current.gpu_p95, threshold, min_delta);
+        if(regressions) {
+            gl_log_err("ERROR: %i timing regressions against %s\n", regressions, compare_path);
+            result = 6;
+        }
+    }
+    headless_shutdown();
+    return result;
+}
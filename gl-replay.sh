@@ -0,0 +1,16 @@
+set -e
+g++ gl-replay.cpp glcapture.cpp headless.cpp frametiming.cpp assetloader.cpp logging.cpp \
+    ../glew/lib/libGLEW.a ../glfw/build/src/libglfw3.a \
+    -I ../glfw/include -I ../glew/include/ \
+    -lGL -lEGL -lX11 -lGLU -pthread \
+    -o gl-replay
+# a capture build of shader-minimal records its GL calls
+g++ -DGL_CAPTURE shader-minimal.cpp framepacing.cpp framearena.cpp resourcepool.cpp alloccounter.cpp framecapture.cpp gldebug.cpp shadermanager.cpp shaderwatcher.cpp programcache.cpp frametiming.cpp \
+    headless.cpp streambuffer.cpp assetloader.cpp glstate.cpp logging.cpp glcapture.cpp \
+    ../glew/lib/libGLEW.a ../glfw/build/src/libglfw3.a \
+    -I ../glfw/include -I ../glew/include/ \
+    -lGL -lEGL -lX11 -lGLU -pthread \
+    -o shader-minimal-capture
+./shader-minimal-capture --headless --frames 300 --capture shader-minimal.trace
+./gl-replay shader-minimal.trace --save shader-minimal-baseline.csv
+./gl-replay shader-minimal.trace --compare shader-minimal-baseline.csv
@@ -0,0 +1,950 @@
+#define GL_CAPTURE_PASSTHROUGH
+#include <GL/glew.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "logging.h"
+#include "glcapture.h"
+
+static const char * g_op_names[CAPTURE_OP_COUNT] = {
+    "?", "frame", "gen_buffers", "delete_buffers", "gen_vertex_arrays", "delete_vertex_arrays",
+    "gen_textures", "delete_textures", "create_shader", "delete_shader", "create_program", "delete_program",
+    "bind_buffer", "bind_buffer_base", "buffer_data", "buffer_sub_data", "buffer_storage", "clear_buffer_data",
+    "map_buffer_range", "unmap_buffer", "buffer_write", "bind_vertex_array", "enable_vertex_attrib_array",
+    "disable_vertex_attrib_array", "vertex_attrib_pointer", "vertex_attrib_divisor", "vertex_attrib_4f",
+    "shader_source", "compile_shader", "attach_shader", "detach_shader", "link_program", "program_parameteri",
+    "program_binary", "use_program", "uniform_block_binding", "program_uniform_1f", "program_uniform_1i",
+    "program_uniform_fv", "program_uniform_matrix_fv", "active_texture", "bind_texture", "tex_parameteri",
+    "tex_image_2d", "tex_sub_image_2d", "generate_mipmap", "viewport", "enable", "disable", "depth_func",
+    "depth_mask", "blend_func", "point_size", "clear_color", "clear", "draw_arrays", "draw_arrays_instanced",
+    "draw_elements", "draw_elements_instanced_base_vertex", "draw_elements_instanced_base_vertex_base_instance",
+    "multi_draw_arrays", "multi_draw_elements_base_vertex", "multi_draw_elements_indirect",
+    "multi_draw_elements_indirect_count", "dispatch_compute", "memory_barrier", "fence_sync", "client_wait_sync",
+    "delete_sync", "copy_buffer_sub_data", "draw_arrays_instanced_base_instance", "multi_draw_arrays_indirect",
+};
+
+const char * gl_capture_op_name(int op) {
+    if(op <= 0 || op >= CAPTURE_OP_COUNT) {
+        return "?";
+    }
+    return g_op_names[op];
+}
+
+#ifdef GL_CAPTURE
+
+struct capture_writer {
+    FILE * file;
+    const char * path;
+    std::vector<unsigned char> record;
+    uint16_t op;
+    // the pixel unpack binding decides whether texture pointers are offsets
+    GLuint unpack_buffer;
+    unsigned long frames;
+    unsigned long records;
+    unsigned long long bytes;
+    // only the thread that began the capture records, against its own
+    // context; calls from other threads (shared-context shader workers)
+    // are counted and left out of the trace
+    std::thread::id owner;
+    std::atomic<bool> recording;
+    std::atomic<unsigned long> foreign_calls;
+};
+
+static capture_writer g_capture;
+
+static bool record_begin(int op) {
+    if(!g_capture.recording.load(std::memory_order_acquire)) {
+        return false;
+    }
+    if(std::this_thread::get_id() != g_capture.owner) {
+        g_capture.foreign_calls.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    g_capture.op = (uint16_t)op;
+    g_capture.record.clear();
+    return true;
+}
+
+static void put(const void * data, size_t size) {
+    const unsigned char * bytes = (const unsigned char *)data;
+    g_capture.record.insert(g_capture.record.end(), bytes, bytes + size);
+}
+
+static void put_u32(uint32_t value) {
+    put(&value, sizeof(value));
+}
+
+static void put_i32(int32_t value) {
+    put(&value, sizeof(value));
+}
+
+static void put_f32(float value) {
+    put(&value, sizeof(value));
+}
+
+static void put_u64(uint64_t value) {
+    put(&value, sizeof(value));
+}
+
+// size-prefixed blob; a NULL pointer is recorded as "no data"
+static void put_blob(const void * data, size_t size) {
+    put_u32(data ? 1 : 0);
+    put_u64(data ? size : 0);
+    if(data) {
+        put(data, size);
+    }
+}
+
+static void record_end() {
+    gl_capture_record header;
+    header.op = g_capture.op;
+    header.reserved = 0;
+    header.size = (uint32_t)g_capture.record.size();
+    fwrite(&header, sizeof(header), 1, g_capture.file);
+    if(!g_capture.record.empty()) {
+        fwrite(g_capture.record.data(), 1, g_capture.record.size(), g_capture.file);
+    }
+    g_capture.records++;
+    g_capture.bytes += sizeof(header) + g_capture.record.size();
+}
+
+static size_t format_bytes(GLenum format, GLenum type) {
+    size_t components = 4;
+    switch(format) {
+        case GL_RED: case GL_RED_INTEGER: components = 1; break;
+        case GL_RG: case GL_RG_INTEGER: components = 2; break;
+        case GL_RGB: case GL_RGB_INTEGER: components = 3; break;
+        default: components = 4; break;
+    }
+    switch(type) {
+        case GL_UNSIGNED_BYTE: case GL_BYTE: return components;
+        case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT: return components * 2;
+        default: return components * 4;
+    }
+}
+
+// client memory image size under the default GL_UNPACK_ALIGNMENT of 4
+static size_t image_bytes(GLsizei width, GLsizei height, GLenum format, GLenum type) {
+    size_t row = ((size_t)width * format_bytes(format, type) + 3) & ~(size_t)3;
+    return row * height;
+}
+
+static void put_pixels(GLsizei width, GLsizei height, GLenum format, GLenum type, const void * pixels) {
+    if(g_capture.unpack_buffer) {
+        // an offset into the bound PBO, whose contents were captured already
+        put_u32(2);
+        put_u64((uint64_t)(uintptr_t)pixels);
+        return;
+    }
+    put_blob(pixels, image_bytes(width, height, format, type));
+}
+
+static GLuint bound_buffer(GLenum target) {
+    GLenum binding = 0;
+    switch(target) {
+        case GL_ARRAY_BUFFER: binding = GL_ARRAY_BUFFER_BINDING; break;
+        case GL_ELEMENT_ARRAY_BUFFER: binding = GL_ELEMENT_ARRAY_BUFFER_BINDING; break;
+        case GL_UNIFORM_BUFFER: binding = GL_UNIFORM_BUFFER_BINDING; break;
+        case GL_SHADER_STORAGE_BUFFER: binding = GL_SHADER_STORAGE_BUFFER_BINDING; break;
+        case GL_DRAW_INDIRECT_BUFFER: binding = GL_DRAW_INDIRECT_BUFFER_BINDING; break;
+        case GL_PIXEL_PACK_BUFFER: binding = GL_PIXEL_PACK_BUFFER_BINDING; break;
+        case GL_PIXEL_UNPACK_BUFFER: binding = GL_PIXEL_UNPACK_BUFFER_BINDING; break;
+        case GL_COPY_READ_BUFFER: binding = GL_COPY_READ_BUFFER_BINDING; break;
+        case GL_COPY_WRITE_BUFFER: binding = GL_COPY_WRITE_BUFFER_BINDING; break;
+        default:
+            gl_log_err("ERROR: capture cannot name the buffer bound to 0x%x\n", target);
+            return 0;
+    }
+    GLint buffer = 0;
+    glGetIntegerv(binding, &buffer);
+    return (GLuint)buffer;
+}
+
+bool gl_capture_begin(const char * path, int width, int height) {
+    g_capture.file = fopen(path, "wb");
+    if(!g_capture.file) {
+        gl_log_err("ERROR: could not open capture file %s\n", path);
+        return false;
+    }
+    g_capture.path = path;
+    g_capture.frames = 0;
+    g_capture.records = 0;
+    g_capture.owner = std::this_thread::get_id();
+    g_capture.foreign_calls.store(0);
+    gl_capture_header header;
+    memcpy(header.magic, GL_CAPTURE_MAGIC, 4);
+    header.version = GL_CAPTURE_VERSION;
+    header.width = (uint32_t)width;
+    header.height = (uint32_t)height;
+    fwrite(&header, sizeof(header), 1, g_capture.file);
+    g_capture.bytes = sizeof(header);
+    g_capture.recording.store(true, std::memory_order_release);
+    gl_log("gl capture: recording %ix%i to %s\n", width, height, path);
+    return true;
+}
+
+bool gl_capture_active() {
+    return g_capture.recording.load(std::memory_order_acquire);
+}
+
+void gl_capture_end_frame() {
+    if(!record_begin(CAPTURE_FRAME)) {
+        return;
+    }
+    record_end();
+    g_capture.frames++;
+}
+
+void gl_capture_buffer_write(GLuint buffer, GLintptr offset, GLsizeiptr size, const void * data) {
+    if(!record_begin(CAPTURE_BUFFER_WRITE)) {
+        return;
+    }
+    put_u32(buffer);
+    put_u64(offset);
+    put_u64(size);
+    put(data, size);
+    record_end();
+}
+
+void gl_capture_end() {
+    if(!g_capture.file) {
+        return;
+    }
+    g_capture.recording.store(false, std::memory_order_release);
+    fclose(g_capture.file);
+    g_capture.file = NULL;
+    gl_log("gl capture: %lu frames, %lu calls, %llu bytes written to %s\n", g_capture.frames,
+        g_capture.records, g_capture.bytes, g_capture.path);
+    unsigned long foreign = g_capture.foreign_calls.load();
+    if(foreign) {
+        gl_log_at(GL_LOG_WARN, "gl capture: left out %lu calls made on other threads' contexts\n", foreign);
+    }
+}
+
+// names come back from the driver, so they are recorded after the call
+static void record_names(int op, GLsizei n, const GLuint * names) {
+    if(!record_begin(op)) {
+        return;
+    }
+    put_u32(n);
+    put(names, n * sizeof(GLuint));
+    record_end();
+}
+
+void gl_capture_gen_buffers(GLsizei n, GLuint * buffers) {
+    glGenBuffers(n, buffers);
+    record_names(CAPTURE_GEN_BUFFERS, n, buffers);
+}
+
+void gl_capture_delete_buffers(GLsizei n, const GLuint * buffers) {
+    record_names(CAPTURE_DELETE_BUFFERS, n, buffers);
+    glDeleteBuffers(n, buffers);
+}
+
+void gl_capture_gen_vertex_arrays(GLsizei n, GLuint * arrays) {
+    glGenVertexArrays(n, arrays);
+    record_names(CAPTURE_GEN_VERTEX_ARRAYS, n, arrays);
+}
+
+void gl_capture_delete_vertex_arrays(GLsizei n, const GLuint * arrays) {
+    record_names(CAPTURE_DELETE_VERTEX_ARRAYS, n, arrays);
+    glDeleteVertexArrays(n, arrays);
+}
+
+void gl_capture_gen_textures(GLsizei n, GLuint * textures) {
+    glGenTextures(n, textures);
+    record_names(CAPTURE_GEN_TEXTURES, n, textures);
+}
+
+void gl_capture_delete_textures(GLsizei n, const GLuint * textures) {
+    record_names(CAPTURE_DELETE_TEXTURES, n, textures);
+    glDeleteTextures(n, textures);
+}
+
+GLuint gl_capture_create_shader(GLenum type) {
+    GLuint shader = glCreateShader(type);
+    if(record_begin(CAPTURE_CREATE_SHADER)) {
+        put_u32(type);
+        put_u32(shader);
+        record_end();
+    }
+    return shader;
+}
+
+void gl_capture_delete_shader(GLuint shader) {
+    if(record_begin(CAPTURE_DELETE_SHADER)) {
+        put_u32(shader);
+        record_end();
+    }
+    glDeleteShader(shader);
+}
+
+GLuint gl_capture_create_program() {
+    GLuint program = glCreateProgram();
+    if(record_begin(CAPTURE_CREATE_PROGRAM)) {
+        put_u32(program);
+        record_end();
+    }
+    return program;
+}
+
+void gl_capture_delete_program(GLuint program) {
+    if(record_begin(CAPTURE_DELETE_PROGRAM)) {
+        put_u32(program);
+        record_end();
+    }
+    glDeleteProgram(program);
+}
+
+void gl_capture_bind_buffer(GLenum target, GLuint buffer) {
+    glBindBuffer(target, buffer);
+    if(target == GL_PIXEL_UNPACK_BUFFER) {
+        g_capture.unpack_buffer = buffer;
+    }
+    if(record_begin(CAPTURE_BIND_BUFFER)) {
+        put_u32(target);
+        put_u32(buffer);
+        record_end();
+    }
+}
+
+void gl_capture_bind_buffer_base(GLenum target, GLuint index, GLuint buffer) {
+    glBindBufferBase(target, index, buffer);
+    if(record_begin(CAPTURE_BIND_BUFFER_BASE)) {
+        put_u32(target);
+        put_u32(index);
+        put_u32(buffer);
+        record_end();
+    }
+}
+
+void gl_capture_buffer_data(GLenum target, GLsizeiptr size, const void * data, GLenum usage) {
+    glBufferData(target, size, data, usage);
+    if(record_begin(CAPTURE_BUFFER_DATA)) {
+        put_u32(target);
+        put_u32(usage);
+        put_u64(size);
+        put_blob(data, size);
+        record_end();
+    }
+}
+
+void gl_capture_buffer_sub_data(GLenum target, GLintptr offset, GLsizeiptr size, const void * data) {
+    glBufferSubData(target, offset, size, data);
+    if(record_begin(CAPTURE_BUFFER_SUB_DATA)) {
+        put_u32(target);
+        put_u64(offset);
+        put_blob(data, size);
+        record_end();
+    }
+}
+
+void gl_capture_buffer_storage(GLenum target, GLsizeiptr size, const void * data, GLbitfield flags) {
+    glBufferStorage(target, size, data, flags);
+    if(record_begin(CAPTURE_BUFFER_STORAGE)) {
+        put_u32(target);
+        put_u32(flags);
+        put_u64(size);
+        put_blob(data, size);
+        record_end();
+    }
+}
+
+void gl_capture_clear_buffer_data(GLenum target, GLenum internal_format, GLenum format, GLenum type,
+    const void * data) {
+    glClearBufferData(target, internal_format, format, type, data);
+    if(record_begin(CAPTURE_CLEAR_BUFFER_DATA)) {
+        put_u32(target);
+        put_u32(internal_format);
+        put_u32(format);
+        put_u32(type);
+        put_blob(data, format_bytes(format, type));
+        record_end();
+    }
+}
+
+void * gl_capture_map_buffer_range(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) {
+    void * mapped = glMapBufferRange(target, offset, length, access);
+    if(record_begin(CAPTURE_MAP_BUFFER_RANGE)) {
+        put_u32(target);
+        put_u32(bound_buffer(target));
+        put_u64(offset);
+        put_u64(length);
+        put_u32(access);
+        record_end();
+    }
+    return mapped;
+}
+
+GLboolean gl_capture_unmap_buffer(GLenum target) {
+    if(record_begin(CAPTURE_UNMAP_BUFFER)) {
+        put_u32(target);
+        put_u32(bound_buffer(target));
+        record_end();
+    }
+    return glUnmapBuffer(target);
+}
+
+void gl_capture_bind_vertex_array(GLuint array) {
+    glBindVertexArray(array);
+    if(record_begin(CAPTURE_BIND_VERTEX_ARRAY)) {
+        put_u32(array);
+        record_end();
+    }
+}
+
+void gl_capture_enable_vertex_attrib_array(GLuint index) {
+    glEnableVertexAttribArray(index);
+    if(record_begin(CAPTURE_ENABLE_VERTEX_ATTRIB_ARRAY)) {
+        put_u32(index);
+        record_end();
+    }
+}
+
+void gl_capture_disable_vertex_attrib_array(GLuint index) {
+    glDisableVertexAttribArray(index);
+    if(record_begin(CAPTURE_DISABLE_VERTEX_ATTRIB_ARRAY)) {
+        put_u32(index);
+        record_end();
+    }
+}
+
+// core profile: the pointer is always an offset into the bound array buffer
+void gl_capture_vertex_attrib_pointer(GLuint index, GLint size, GLenum type, GLboolean normalized,
+    GLsizei stride, const void * pointer) {
+    glVertexAttribPointer(index, size, type, normalized, stride, pointer);
+    if(record_begin(CAPTURE_VERTEX_ATTRIB_POINTER)) {
+        put_u32(index);
+        put_i32(size);
+        put_u32(type);
+        put_u32(normalized);
+        put_i32(stride);
+        put_u64((uint64_t)(uintptr_t)pointer);
+        record_end();
+    }
+}
+
+void gl_capture_vertex_attrib_divisor(GLuint index, GLuint divisor) {
+    glVertexAttribDivisor(index, divisor);
+    if(record_begin(CAPTURE_VERTEX_ATTRIB_DIVISOR)) {
+        put_u32(index);
+        put_u32(divisor);
+        record_end();
+    }
+}
+
+void gl_capture_vertex_attrib_4f(GLuint index, GLfloat x, GLfloat y, GLfloat z, GLfloat w) {
+    glVertexAttrib4f(index, x, y, z, w);
+    if(record_begin(CAPTURE_VERTEX_ATTRIB_4F)) {
+        put_u32(index);
+        put_f32(x);
+        put_f32(y);
+        put_f32(z);
+        put_f32(w);
+        record_end();
+    }
+}
+
+// the strings are joined; replay hands them back as one
+void gl_capture_shader_source(GLuint shader, GLsizei count, const GLchar * const * strings, const GLint * lengths) {
+    glShaderSource(shader, count, strings, lengths);
+    if(!record_begin(CAPTURE_SHADER_SOURCE)) {
+        return;
+    }
+    std::vector<char> text;
+    for(GLsizei i = 0; i < count; i++) {
+        size_t length = lengths && lengths[i] >= 0 ? (size_t)lengths[i] : strlen(strings[i]);
+        text.insert(text.end(), strings[i], strings[i] + length);
+    }
+    put_u32(shader);
+    put_blob(text.data(), text.size());
+    record_end();
+}
+
+void gl_capture_compile_shader(GLuint shader) {
+    glCompileShader(shader);
+    if(record_begin(CAPTURE_COMPILE_SHADER)) {
+        put_u32(shader);
+        record_end();
+    }
+}
+
+void gl_capture_attach_shader(GLuint program, GLuint shader) {
+    glAttachShader(program, shader);
+    if(record_begin(CAPTURE_ATTACH_SHADER)) {
+        put_u32(program);
+        put_u32(shader);
+        record_end();
+    }
+}
+
+void gl_capture_detach_shader(GLuint program, GLuint shader) {
+    glDetachShader(program, shader);
+    if(record_begin(CAPTURE_DETACH_SHADER)) {
+        put_u32(program);
+        put_u32(shader);
+        record_end();
+    }
+}
+
+void gl_capture_link_program(GLuint program) {
+    glLinkProgram(program);
+    if(record_begin(CAPTURE_LINK_PROGRAM)) {
+        put_u32(program);
+        record_end();
+    }
+}
+
+void gl_capture_program_parameteri(GLuint program, GLenum name, GLint value) {
+    glProgramParameteri(program, name, value);
+    if(record_begin(CAPTURE_PROGRAM_PARAMETERI)) {
+        put_u32(program);
+        put_u32(name);
+        put_i32(value);
+        record_end();
+    }
+}
+
+void gl_capture_program_binary(GLuint program, GLenum format, const void * binary, GLsizei length) {
+    glProgramBinary(program, format, binary, length);
+    if(record_begin(CAPTURE_PROGRAM_BINARY)) {
+        put_u32(program);
+        put_u32(format);
+        put_blob(binary, length);
+        record_end();
+    }
+}
+
+void gl_capture_use_program(GLuint program) {
+    glUseProgram(program);
+    if(record_begin(CAPTURE_USE_PROGRAM)) {
+        put_u32(program);
+        record_end();
+    }
+}
+
+void gl_capture_uniform_block_binding(GLuint program, GLuint block, GLuint binding) {
+    glUniformBlockBinding(program, block, binding);
+    if(record_begin(CAPTURE_UNIFORM_BLOCK_BINDING)) {
+        put_u32(program);
+        put_u32(block);
+        put_u32(binding);
+        record_end();
+    }
+}
+
+void gl_capture_program_uniform_1f(GLuint program, GLint location, GLfloat x) {
+    glProgramUniform1f(program, location, x);
+    if(record_begin(CAPTURE_PROGRAM_UNIFORM_1F)) {
+        put_u32(program);
+        put_i32(location);
+        put_f32(x);
+        record_end();
+    }
+}
+
+void gl_capture_program_uniform_1i(GLuint program, GLint location, GLint x) {
+    glProgramUniform1i(program, location, x);
+    if(record_begin(CAPTURE_PROGRAM_UNIFORM_1I)) {
+        put_u32(program);
+        put_i32(location);
+        put_i32(x);
+        record_end();
+    }
+}
+
+static void record_uniform_fv(int op, GLuint program, GLint location, int components, GLsizei count,
+    GLboolean transpose, const GLfloat * value) {
+    if(!record_begin(op)) {
+        return;
+    }
+    put_u32(program);
+    put_i32(location);
+    put_u32(components);
+    put_i32(count);
+    put_u32(transpose);
+    put(value, components * count * sizeof(GLfloat));
+    record_end();
+}
+
+void gl_capture_program_uniform_2fv(GLuint program, GLint location, GLsizei count, const GLfloat * value) {
+    glProgramUniform2fv(program, location, count, value);
+    record_uniform_fv(CAPTURE_PROGRAM_UNIFORM_FV, program, location, 2, count, GL_FALSE, value);
+}
+
+void gl_capture_program_uniform_3fv(GLuint program, GLint location, GLsizei count, const GLfloat * value) {
+    glProgramUniform3fv(program, location, count, value);
+    record_uniform_fv(CAPTURE_PROGRAM_UNIFORM_FV, program, location, 3, count, GL_FALSE, value);
+}
+
+void gl_capture_program_uniform_4fv(GLuint program, GLint location, GLsizei count, const GLfloat * value) {
+    glProgramUniform4fv(program, location, count, value);
+    record_uniform_fv(CAPTURE_PROGRAM_UNIFORM_FV, program, location, 4, count, GL_FALSE, value);
+}
+
+void gl_capture_program_uniform_matrix_3fv(GLuint program, GLint location, GLsizei count, GLboolean transpose,
+    const GLfloat * value) {
+    glProgramUniformMatrix3fv(program, location, count, transpose, value);
+    record_uniform_fv(CAPTURE_PROGRAM_UNIFORM_MATRIX_FV, program, location, 9, count, transpose, value);
+}
+
+void gl_capture_program_uniform_matrix_4fv(GLuint program, GLint location, GLsizei count, GLboolean transpose,
+    const GLfloat * value) {
+    glProgramUniformMatrix4fv(program, location, count, transpose, value);
+    record_uniform_fv(CAPTURE_PROGRAM_UNIFORM_MATRIX_FV, program, location, 16, count, transpose, value);
+}
+
+void gl_capture_active_texture(GLenum unit) {
+    glActiveTexture(unit);
+    if(record_begin(CAPTURE_ACTIVE_TEXTURE)) {
+        put_u32(unit);
+        record_end();
+    }
+}
+
+void gl_capture_bind_texture(GLenum target, GLuint texture) {
+    glBindTexture(target, texture);
+    if(record_begin(CAPTURE_BIND_TEXTURE)) {
+        put_u32(target);
+        put_u32(texture);
+        record_end();
+    }
+}
+
+void gl_capture_tex_parameteri(GLenum target, GLenum name, GLint value) {
+    glTexParameteri(target, name, value);
+    if(record_begin(CAPTURE_TEX_PARAMETERI)) {
+        put_u32(target);
+        put_u32(name);
+        put_i32(value);
+        record_end();
+    }
+}
+
+void gl_capture_tex_image_2d(GLenum target, GLint level, GLint internal_format, GLsizei width, GLsizei height,
+    GLint border, GLenum format, GLenum type, const void * pixels) {
+    glTexImage2D(target, level, internal_format, width, height, border, format, type, pixels);
+    if(record_begin(CAPTURE_TEX_IMAGE_2D)) {
+        put_u32(target);
+        put_i32(level);
+        put_i32(internal_format);
+        put_i32(width);
+        put_i32(height);
+        put_i32(border);
+        put_u32(format);
+        put_u32(type);
+        put_pixels(width, height, format, type, pixels);
+        record_end();
+    }
+}
+
+void gl_capture_tex_sub_image_2d(GLenum target, GLint level, GLint x, GLint y, GLsizei width, GLsizei height,
+    GLenum format, GLenum type, const void * pixels) {
+    glTexSubImage2D(target, level, x, y, width, height, format, type, pixels);
+    if(record_begin(CAPTURE_TEX_SUB_IMAGE_2D)) {
+        put_u32(target);
+        put_i32(level);
+        put_i32(x);
+        put_i32(y);
+        put_i32(width);
+        put_i32(height);
+        put_u32(format);
+        put_u32(type);
+        put_pixels(width, height, format, type, pixels);
+        record_end();
+    }
+}
+
+void gl_capture_generate_mipmap(GLenum target) {
+    glGenerateMipmap(target);
+    if(record_begin(CAPTURE_GENERATE_MIPMAP)) {
+        put_u32(target);
+        record_end();
+    }
+}
+
+void gl_capture_viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+    glViewport(x, y, width, height);
+    if(record_begin(CAPTURE_VIEWPORT)) {
+        put_i32(x);
+        put_i32(y);
+        put_i32(width);
+        put_i32(height);
+        record_end();
+    }
+}
+
+void gl_capture_enable(GLenum cap) {
+    glEnable(cap);
+    if(record_begin(CAPTURE_ENABLE)) {
+        put_u32(cap);
+        record_end();
+    }
+}
+
+void gl_capture_disable(GLenum cap) {
+    glDisable(cap);
+    if(record_begin(CAPTURE_DISABLE)) {
+        put_u32(cap);
+        record_end();
+    }
+}
+
+void gl_capture_depth_func(GLenum func) {
+    glDepthFunc(func);
+    if(record_begin(CAPTURE_DEPTH_FUNC)) {
+        put_u32(func);
+        record_end();
+    }
+}
+
+void gl_capture_depth_mask(GLboolean mask) {
+    glDepthMask(mask);
+    if(record_begin(CAPTURE_DEPTH_MASK)) {
+        put_u32(mask);
+        record_end();
+    }
+}
+
+void gl_capture_blend_func(GLenum src, GLenum dst) {
+    glBlendFunc(src, dst);
+    if(record_begin(CAPTURE_BLEND_FUNC)) {
+        put_u32(src);
+        put_u32(dst);
+        record_end();
+    }
+}
+
+void gl_capture_point_size(GLfloat size) {
+    glPointSize(size);
+    if(record_begin(CAPTURE_POINT_SIZE)) {
+        put_f32(size);
+        record_end();
+    }
+}
+
+void gl_capture_clear_color(GLfloat r, GLfloat g, GLfloat b, GLfloat a) {
+    glClearColor(r, g, b, a);
+    if(record_begin(CAPTURE_CLEAR_COLOR)) {
+        put_f32(r);
+        put_f32(g);
+        put_f32(b);
+        put_f32(a);
+        record_end();
+    }
+}
+
+void gl_capture_clear(GLbitfield mask) {
+    glClear(mask);
+    if(record_begin(CAPTURE_CLEAR)) {
+        put_u32(mask);
+        record_end();
+    }
+}
+
+void gl_capture_draw_arrays(GLenum mode, GLint first, GLsizei count) {
+    glDrawArrays(mode, first, count);
+    if(record_begin(CAPTURE_DRAW_ARRAYS)) {
+        put_u32(mode);
+        put_i32(first);
+        put_i32(count);
+        record_end();
+    }
+}
+
+void gl_capture_draw_arrays_instanced(GLenum mode, GLint first, GLsizei count, GLsizei instances) {
+    glDrawArraysInstanced(mode, first, count, instances);
+    if(record_begin(CAPTURE_DRAW_ARRAYS_INSTANCED)) {
+        put_u32(mode);
+        put_i32(first);
+        put_i32(count);
+        put_i32(instances);
+        record_end();
+    }
+}
+
+void gl_capture_draw_elements(GLenum mode, GLsizei count, GLenum type, const void * indices) {
+    glDrawElements(mode, count, type, indices);
+    if(record_begin(CAPTURE_DRAW_ELEMENTS)) {
+        put_u32(mode);
+        put_i32(count);
+        put_u32(type);
+        put_u64((uint64_t)(uintptr_t)indices);
+        record_end();
+    }
+}
+
+void gl_capture_draw_elements_instanced_base_vertex(GLenum mode, GLsizei count, GLenum type, const void * indices,
+    GLsizei instances, GLint base_vertex) {
+    glDrawElementsInstancedBaseVertex(mode, count, type, indices, instances, base_vertex);
+    if(record_begin(CAPTURE_DRAW_ELEMENTS_INSTANCED_BASE_VERTEX)) {
+        put_u32(mode);
+        put_i32(count);
+        put_u32(type);
+        put_u64((uint64_t)(uintptr_t)indices);
+        put_i32(instances);
+        put_i32(base_vertex);
+        record_end();
+    }
+}
+
+void gl_capture_draw_elements_instanced_base_vertex_base_instance(GLenum mode, GLsizei count, GLenum type,
+    const void * indices, GLsizei instances, GLint base_vertex, GLuint base_instance) {
+    glDrawElementsInstancedBaseVertexBaseInstance(mode, count, type, indices, instances, base_vertex, base_instance);
+    if(record_begin(CAPTURE_DRAW_ELEMENTS_INSTANCED_BASE_VERTEX_BASE_INSTANCE)) {
+        put_u32(mode);
+        put_i32(count);
+        put_u32(type);
+        put_u64((uint64_t)(uintptr_t)indices);
+        put_i32(instances);
+        put_i32(base_vertex);
+        put_u32(base_instance);
+        record_end();
+    }
+}
+
+void gl_capture_multi_draw_arrays(GLenum mode, const GLint * first, const GLsizei * count, GLsizei draws) {
+    glMultiDrawArrays(mode, first, count, draws);
+    if(record_begin(CAPTURE_MULTI_DRAW_ARRAYS)) {
+        put_u32(mode);
+        put_i32(draws);
+        put(first, draws * sizeof(GLint));
+        put(count, draws * sizeof(GLsizei));
+        record_end();
+    }
+}
+
+// copies between buffers stay on the GPU; replay repeats them from the replayed contents
+void gl_capture_copy_buffer_sub_data(GLenum read_target, GLenum write_target, GLintptr read_offset,
+    GLintptr write_offset, GLsizeiptr size) {
+    glCopyBufferSubData(read_target, write_target, read_offset, write_offset, size);
+    if(record_begin(CAPTURE_COPY_BUFFER_SUB_DATA)) {
+        put_u32(read_target);
+        put_u32(write_target);
+        put_u64(read_offset);
+        put_u64(write_offset);
+        put_u64(size);
+        record_end();
+    }
+}
+
+void gl_capture_draw_arrays_instanced_base_instance(GLenum mode, GLint first, GLsizei count, GLsizei instances,
+    GLuint base_instance) {
+    glDrawArraysInstancedBaseInstance(mode, first, count, instances, base_instance);
+    if(record_begin(CAPTURE_DRAW_ARRAYS_INSTANCED_BASE_INSTANCE)) {
+        put_u32(mode);
+        put_i32(first);
+        put_i32(count);
+        put_i32(instances);
+        put_u32(base_instance);
+        record_end();
+    }
+}
+
+void gl_capture_multi_draw_arrays_indirect(GLenum mode, const void * indirect, GLsizei draws, GLsizei stride) {
+    glMultiDrawArraysIndirect(mode, indirect, draws, stride);
+    if(record_begin(CAPTURE_MULTI_DRAW_ARRAYS_INDIRECT)) {
+        put_u32(mode);
+        put_u64((uint64_t)(uintptr_t)indirect);
+        put_i32(draws);
+        put_i32(stride);
+        record_end();
+    }
+}
+
+void gl_capture_multi_draw_elements_base_vertex(GLenum mode, const GLsizei * count, GLenum type,
+    const void * const * indices, GLsizei draws, const GLint * base_vertex) {
+    glMultiDrawElementsBaseVertex(mode, count, type, indices, draws, base_vertex);
+    if(record_begin(CAPTURE_MULTI_DRAW_ELEMENTS_BASE_VERTEX)) {
+        put_u32(mode);
+        put_u32(type);
+        put_i32(draws);
+        put(count, draws * sizeof(GLsizei));
+        for(GLsizei i = 0; i < draws; i++) {
+            put_u64((uint64_t)(uintptr_t)indices[i]);
+        }
+        put(base_vertex, draws * sizeof(GLint));
+        record_end();
+    }
+}
+
+void gl_capture_multi_draw_elements_indirect(GLenum mode, GLenum type, const void * indirect, GLsizei draws,
+    GLsizei stride) {
+    glMultiDrawElementsIndirect(mode, type, indirect, draws, stride);
+    if(record_begin(CAPTURE_MULTI_DRAW_ELEMENTS_INDIRECT)) {
+        put_u32(mode);
+        put_u32(type);
+        put_u64((uint64_t)(uintptr_t)indirect);
+        put_i32(draws);
+        put_i32(stride);
+        record_end();
+    }
+}
+
+void gl_capture_multi_draw_elements_indirect_count(GLenum mode, GLenum type, const void * indirect,
+    GLintptr draw_count, GLsizei max_draws, GLsizei stride) {
+    glMultiDrawElementsIndirectCountARB(mode, type, indirect, draw_count, max_draws, stride);
+    if(record_begin(CAPTURE_MULTI_DRAW_ELEMENTS_INDIRECT_COUNT)) {
+        put_u32(mode);
+        put_u32(type);
+        put_u64((uint64_t)(uintptr_t)indirect);
+        put_u64(draw_count);
+        put_i32(max_draws);
+        put_i32(stride);
+        record_end();
+    }
+}
+
+void gl_capture_dispatch_compute(GLuint x, GLuint y, GLuint z) {
+    glDispatchCompute(x, y, z);
+    if(record_begin(CAPTURE_DISPATCH_COMPUTE)) {
+        put_u32(x);
+        put_u32(y);
+        put_u32(z);
+        record_end();
+    }
+}
+
+void gl_capture_memory_barrier(GLbitfield barriers) {
+    glMemoryBarrier(barriers);
+    if(record_begin(CAPTURE_MEMORY_BARRIER)) {
+        put_u32(barriers);
+        record_end();
+    }
+}
+
+// syncs are identified by the pointer value seen at capture time
+GLsync gl_capture_fence_sync(GLenum condition, GLbitfield flags) {
+    GLsync sync = glFenceSync(condition, flags);
+    if(record_begin(CAPTURE_FENCE_SYNC)) {
+        put_u32(condition);
+        put_u32(flags);
+        put_u64((uint64_t)(uintptr_t)sync);
+        record_end();
+    }
+    return sync;
+}
+
+// replay only needs the waits that completed: they ordered CPU writes
+// after GPU reads, polls that timed out changed nothing
+GLenum gl_capture_client_wait_sync(GLsync sync, GLbitfield flags, GLuint64 timeout) {
+    GLenum status = glClientWaitSync(sync, flags, timeout);
+    if(record_begin(CAPTURE_CLIENT_WAIT_SYNC)) {
+        put_u64((uint64_t)(uintptr_t)sync);
+        put_u32(status);
+        record_end();
+    }
+    return status;
+}
+
+void gl_capture_delete_sync(GLsync sync) {
+    if(record_begin(CAPTURE_DELETE_SYNC)) {
+        put_u64((uint64_t)(uintptr_t)sync);
+        record_end();
+    }
+    glDeleteSync(sync);
+}
+
+#endif
@@ -0,0 +1,349 @@
+#pragma once
+#include <GL/glew.h>
+#include <stdint.h>
+
+// GL call capture for offline replay (gl-replay). Built with -DGL_CAPTURE,
+// every file that includes this header after glew.h has the GL entry points
+// the project uses redirected to recording wrappers; without it the header
+// only declares the trace format and the calls below compile to nothing.
+// Capture runs between gl_capture_begin() and gl_capture_end() (headless
+// --capture FILE) and writes calls, buffer, texture and uniform payloads
+// to a binary trace, one CAPTURE_FRAME record per presented frame. Files
+// that are harness rather than app (the capture itself, headless) define
+// GL_CAPTURE_PASSTHROUGH first to keep the real entry points.
+// Object names, syncs and mappings are remapped at replay time; uniform
+// locations and program binaries are not, so replay on the driver that
+// captured the trace.
+#define GL_CAPTURE_MAGIC "AGLT"
+#define GL_CAPTURE_VERSION 1
+
+struct gl_capture_header {
+    char magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+};
+
+// every record: this, then size bytes of arguments in call order
+struct gl_capture_record {
+    uint16_t op;
+    uint16_t reserved;
+    uint32_t size;
+};
+
+enum gl_capture_op {
+    CAPTURE_FRAME = 1,
+    CAPTURE_GEN_BUFFERS,
+    CAPTURE_DELETE_BUFFERS,
+    CAPTURE_GEN_VERTEX_ARRAYS,
+    CAPTURE_DELETE_VERTEX_ARRAYS,
+    CAPTURE_GEN_TEXTURES,
+    CAPTURE_DELETE_TEXTURES,
+    CAPTURE_CREATE_SHADER,
+    CAPTURE_DELETE_SHADER,
+    CAPTURE_CREATE_PROGRAM,
+    CAPTURE_DELETE_PROGRAM,
+    CAPTURE_BIND_BUFFER,
+    CAPTURE_BIND_BUFFER_BASE,
+    CAPTURE_BUFFER_DATA,
+    CAPTURE_BUFFER_SUB_DATA,
+    CAPTURE_BUFFER_STORAGE,
+    CAPTURE_CLEAR_BUFFER_DATA,
+    CAPTURE_MAP_BUFFER_RANGE,
+    CAPTURE_UNMAP_BUFFER,
+    CAPTURE_BUFFER_WRITE,
+    CAPTURE_BIND_VERTEX_ARRAY,
+    CAPTURE_ENABLE_VERTEX_ATTRIB_ARRAY,
+    CAPTURE_DISABLE_VERTEX_ATTRIB_ARRAY,
+    CAPTURE_VERTEX_ATTRIB_POINTER,
+    CAPTURE_VERTEX_ATTRIB_DIVISOR,
+    CAPTURE_VERTEX_ATTRIB_4F,
+    CAPTURE_SHADER_SOURCE,
+    CAPTURE_COMPILE_SHADER,
+    CAPTURE_ATTACH_SHADER,
+    CAPTURE_DETACH_SHADER,
+    CAPTURE_LINK_PROGRAM,
+    CAPTURE_PROGRAM_PARAMETERI,
+    CAPTURE_PROGRAM_BINARY,
+    CAPTURE_USE_PROGRAM,
+    CAPTURE_UNIFORM_BLOCK_BINDING,
+    CAPTURE_PROGRAM_UNIFORM_1F,
+    CAPTURE_PROGRAM_UNIFORM_1I,
+    CAPTURE_PROGRAM_UNIFORM_FV,
+    CAPTURE_PROGRAM_UNIFORM_MATRIX_FV,
+    CAPTURE_ACTIVE_TEXTURE,
+    CAPTURE_BIND_TEXTURE,
+    CAPTURE_TEX_PARAMETERI,
+    CAPTURE_TEX_IMAGE_2D,
+    CAPTURE_TEX_SUB_IMAGE_2D,
+    CAPTURE_GENERATE_MIPMAP,
+    CAPTURE_VIEWPORT,
+    CAPTURE_ENABLE,
+    CAPTURE_DISABLE,
+    CAPTURE_DEPTH_FUNC,
+    CAPTURE_DEPTH_MASK,
+    CAPTURE_BLEND_FUNC,
+    CAPTURE_POINT_SIZE,
+    CAPTURE_CLEAR_COLOR,
+    CAPTURE_CLEAR,
+    CAPTURE_DRAW_ARRAYS,
+    CAPTURE_DRAW_ARRAYS_INSTANCED,
+    CAPTURE_DRAW_ELEMENTS,
+    CAPTURE_DRAW_ELEMENTS_INSTANCED_BASE_VERTEX,
+    CAPTURE_DRAW_ELEMENTS_INSTANCED_BASE_VERTEX_BASE_INSTANCE,
+    CAPTURE_MULTI_DRAW_ARRAYS,
+    CAPTURE_MULTI_DRAW_ELEMENTS_BASE_VERTEX,
+    CAPTURE_MULTI_DRAW_ELEMENTS_INDIRECT,
+    CAPTURE_MULTI_DRAW_ELEMENTS_INDIRECT_COUNT,
+    CAPTURE_DISPATCH_COMPUTE,
+    CAPTURE_MEMORY_BARRIER,
+    CAPTURE_FENCE_SYNC,
+    CAPTURE_CLIENT_WAIT_SYNC,
+    CAPTURE_DELETE_SYNC,
+    CAPTURE_COPY_BUFFER_SUB_DATA,
+    CAPTURE_DRAW_ARRAYS_INSTANCED_BASE_INSTANCE,
+    CAPTURE_MULTI_DRAW_ARRAYS_INDIRECT,
+    CAPTURE_OP_COUNT
+};
+
+const char * gl_capture_op_name(int op);
+
+#ifdef GL_CAPTURE
+bool gl_capture_begin(const char * path, int width, int height);
+bool gl_capture_active();
+void gl_capture_end_frame();
+// writes that reach GL without a GL call, i.e. into persistent mappings
+void gl_capture_buffer_write(GLuint buffer, GLintptr offset, GLsizeiptr size, const void * data);
+void gl_capture_end();
+
+void gl_capture_gen_buffers(GLsizei n, GLuint * buffers);
+void gl_capture_delete_buffers(GLsizei n, const GLuint * buffers);
+void gl_capture_gen_vertex_arrays(GLsizei n, GLuint * arrays);
+void gl_capture_delete_vertex_arrays(GLsizei n, const GLuint * arrays);
+void gl_capture_gen_textures(GLsizei n, GLuint * textures);
+void gl_capture_delete_textures(GLsizei n, const GLuint * textures);
+GLuint gl_capture_create_shader(GLenum type);
+void gl_capture_delete_shader(GLuint shader);
+GLuint gl_capture_create_program();
+void gl_capture_delete_program(GLuint program);
+void gl_capture_bind_buffer(GLenum target, GLuint buffer);
+void gl_capture_bind_buffer_base(GLenum target, GLuint index, GLuint buffer);
+void gl_capture_buffer_data(GLenum target, GLsizeiptr size, const void * data, GLenum usage);
+void gl_capture_buffer_sub_data(GLenum target, GLintptr offset, GLsizeiptr size, const void * data);
+void gl_capture_buffer_storage(GLenum target, GLsizeiptr size, const void * data, GLbitfield flags);
+void gl_capture_clear_buffer_data(GLenum target, GLenum internal_format, GLenum format, GLenum type, const void * data);
+void * gl_capture_map_buffer_range(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+GLboolean gl_capture_unmap_buffer(GLenum target);
+void gl_capture_bind_vertex_array(GLuint array);
+void gl_capture_enable_vertex_attrib_array(GLuint index);
+void gl_capture_disable_vertex_attrib_array(GLuint index);
+void gl_capture_vertex_attrib_pointer(GLuint index, GLint size, GLenum type, GLboolean normalized,
+    GLsizei stride, const void * pointer);
+void gl_capture_vertex_attrib_divisor(GLuint index, GLuint divisor);
+void gl_capture_vertex_attrib_4f(GLuint index, GLfloat x, GLfloat y, GLfloat z, GLfloat w);
+void gl_capture_shader_source(GLuint shader, GLsizei count, const GLchar * const * strings, const GLint * lengths);
+void gl_capture_compile_shader(GLuint shader);
+void gl_capture_attach_shader(GLuint program, GLuint shader);
+void gl_capture_detach_shader(GLuint program, GLuint shader);
+void gl_capture_link_program(GLuint program);
+void gl_capture_program_parameteri(GLuint program, GLenum name, GLint value);
+void gl_capture_program_binary(GLuint program, GLenum format, const void * binary, GLsizei length);
+void gl_capture_use_program(GLuint program);
+void gl_capture_uniform_block_binding(GLuint program, GLuint block, GLuint binding);
+void gl_capture_program_uniform_1f(GLuint program, GLint location, GLfloat x);
+void gl_capture_program_uniform_1i(GLuint program, GLint location, GLint x);
+void gl_capture_program_uniform_2fv(GLuint program, GLint location, GLsizei count, const GLfloat * value);
+void gl_capture_program_uniform_3fv(GLuint program, GLint location, GLsizei count, const GLfloat * value);
+void gl_capture_program_uniform_4fv(GLuint program, GLint location, GLsizei count, const GLfloat * value);
+void gl_capture_program_uniform_matrix_3fv(GLuint program, GLint location, GLsizei count, GLboolean transpose,
+    const GLfloat * value);
+void gl_capture_program_uniform_matrix_4fv(GLuint program, GLint location, GLsizei count, GLboolean transpose,
+    const GLfloat * value);
+void gl_capture_active_texture(GLenum unit);
+void gl_capture_bind_texture(GLenum target, GLuint texture);
+void gl_capture_tex_parameteri(GLenum target, GLenum name, GLint value);
+void gl_capture_tex_image_2d(GLenum target, GLint level, GLint internal_format, GLsizei width, GLsizei height,
+    GLint border, GLenum format, GLenum type, const void * pixels);
+void gl_capture_tex_sub_image_2d(GLenum target, GLint level, GLint x, GLint y, GLsizei width, GLsizei height,
+    GLenum format, GLenum type, const void * pixels);
+void gl_capture_generate_mipmap(GLenum target);
+void gl_capture_viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+void gl_capture_enable(GLenum cap);
+void gl_capture_disable(GLenum cap);
+void gl_capture_depth_func(GLenum func);
+void gl_capture_depth_mask(GLboolean mask);
+void gl_capture_blend_func(GLenum src, GLenum dst);
+void gl_capture_point_size(GLfloat size);
+void gl_capture_clear_color(GLfloat r, GLfloat g, GLfloat b, GLfloat a);
+void gl_capture_clear(GLbitfield mask);
+void gl_capture_draw_arrays(GLenum mode, GLint first, GLsizei count);
+void gl_capture_draw_arrays_instanced(GLenum mode, GLint first, GLsizei count, GLsizei instances);
+void gl_capture_draw_elements(GLenum mode, GLsizei count, GLenum type, const void * indices);
+void gl_capture_draw_elements_instanced_base_vertex(GLenum mode, GLsizei count, GLenum type, const void * indices,
+    GLsizei instances, GLint base_vertex);
+void gl_capture_draw_elements_instanced_base_vertex_base_instance(GLenum mode, GLsizei count, GLenum type,
+    const void * indices, GLsizei instances, GLint base_vertex, GLuint base_instance);
+void gl_capture_multi_draw_arrays(GLenum mode, const GLint * first, const GLsizei * count, GLsizei draws);
+void gl_capture_copy_buffer_sub_data(GLenum read_target, GLenum write_target, GLintptr read_offset,
+    GLintptr write_offset, GLsizeiptr size);
+void gl_capture_draw_arrays_instanced_base_instance(GLenum mode, GLint first, GLsizei count, GLsizei instances,
+    GLuint base_instance);
+void gl_capture_multi_draw_arrays_indirect(GLenum mode, const void * indirect, GLsizei draws, GLsizei stride);
+void gl_capture_multi_draw_elements_base_vertex(GLenum mode, const GLsizei * count, GLenum type,
+    const void * const * indices, GLsizei draws, const GLint * base_vertex);
+void gl_capture_multi_draw_elements_indirect(GLenum mode, GLenum type, const void * indirect, GLsizei draws,
+    GLsizei stride);
+void gl_capture_multi_draw_elements_indirect_count(GLenum mode, GLenum type, const void * indirect,
+    GLintptr draw_count, GLsizei max_draws, GLsizei stride);
+void gl_capture_dispatch_compute(GLuint x, GLuint y, GLuint z);
+void gl_capture_memory_barrier(GLbitfield barriers);
+GLsync gl_capture_fence_sync(GLenum condition, GLbitfield flags);
+GLenum gl_capture_client_wait_sync(GLsync sync, GLbitfield flags, GLuint64 timeout);
+void gl_capture_delete_sync(GLsync sync);
+
+#ifndef GL_CAPTURE_PASSTHROUGH
+#undef glGenBuffers
+#undef glDeleteBuffers
+#undef glGenVertexArrays
+#undef glDeleteVertexArrays
+#undef glGenTextures
+#undef glDeleteTextures
+#undef glCreateShader
+#undef glDeleteShader
+#undef glCreateProgram
+#undef glDeleteProgram
+#undef glBindBuffer
+#undef glBindBufferBase
+#undef glBufferData
+#undef glBufferSubData
+#undef glBufferStorage
+#undef glClearBufferData
+#undef glMapBufferRange
+#undef glUnmapBuffer
+#undef glBindVertexArray
+#undef glEnableVertexAttribArray
+#undef glDisableVertexAttribArray
+#undef glVertexAttribPointer
+#undef glVertexAttribDivisor
+#undef glVertexAttrib4f
+#undef glShaderSource
+#undef glCompileShader
+#undef glAttachShader
+#undef glDetachShader
+#undef glLinkProgram
+#undef glProgramParameteri
+#undef glProgramBinary
+#undef glUseProgram
+#undef glUniformBlockBinding
+#undef glProgramUniform1f
+#undef glProgramUniform1i
+#undef glProgramUniform2fv
+#undef glProgramUniform3fv
+#undef glProgramUniform4fv
+#undef glProgramUniformMatrix3fv
+#undef glProgramUniformMatrix4fv
+#undef glActiveTexture
+#undef glBindTexture
+#undef glTexParameteri
+#undef glTexImage2D
+#undef glTexSubImage2D
+#undef glGenerateMipmap
+#undef glViewport
+#undef glEnable
+#undef glDisable
+#undef glDepthFunc
+#undef glDepthMask
+#undef glBlendFunc
+#undef glPointSize
+#undef glClearColor
+#undef glClear
+#undef glDrawArrays
+#undef glDrawArraysInstanced
+#undef glDrawElements
+#undef glDrawElementsInstancedBaseVertex
+#undef glDrawElementsInstancedBaseVertexBaseInstance
+#undef glMultiDrawArrays
+#undef glMultiDrawElementsBaseVertex
+#undef glMultiDrawElementsIndirect
+#undef glMultiDrawElementsIndirectCountARB
+#undef glDispatchCompute
+#undef glMemoryBarrier
+#undef glFenceSync
+#undef glClientWaitSync
+#undef glDeleteSync
+#define glGenBuffers gl_capture_gen_buffers
+#define glDeleteBuffers gl_capture_delete_buffers
+#define glGenVertexArrays gl_capture_gen_vertex_arrays
+#define glDeleteVertexArrays gl_capture_delete_vertex_arrays
+#define glGenTextures gl_capture_gen_textures
+#define glDeleteTextures gl_capture_delete_textures
+#define glCreateShader gl_capture_create_shader
+#define glDeleteShader gl_capture_delete_shader
+#define glCreateProgram gl_capture_create_program
+#define glDeleteProgram gl_capture_delete_program
+#define glBindBuffer gl_capture_bind_buffer
+#define glBindBufferBase gl_capture_bind_buffer_base
+#define glBufferData gl_capture_buffer_data
+#define glBufferSubData gl_capture_buffer_sub_data
+#define glBufferStorage gl_capture_buffer_storage
+#define glClearBufferData gl_capture_clear_buffer_data
+#define glMapBufferRange gl_capture_map_buffer_range
+#define glUnmapBuffer gl_capture_unmap_buffer
+#define glBindVertexArray gl_capture_bind_vertex_array
+#define glEnableVertexAttribArray gl_capture_enable_vertex_attrib_array
+#define glDisableVertexAttribArray gl_capture_disable_vertex_attrib_array
+#define glVertexAttribPointer gl_capture_vertex_attrib_pointer
+#define glVertexAttribDivisor gl_capture_vertex_attrib_divisor
+#define glVertexAttrib4f gl_capture_vertex_attrib_4f
+#define glShaderSource gl_capture_shader_source
+#define glCompileShader gl_capture_compile_shader
+#define glAttachShader gl_capture_attach_shader
+#define glDetachShader gl_capture_detach_shader
+#define glLinkProgram gl_capture_link_program
+#define glProgramParameteri gl_capture_program_parameteri
+#define glProgramBinary gl_capture_program_binary
+#define glUseProgram gl_capture_use_program
+#define glUniformBlockBinding gl_capture_uniform_block_binding
+#define glProgramUniform1f gl_capture_program_uniform_1f
+#define glProgramUniform1i gl_capture_program_uniform_1i
+#define glProgramUniform2fv gl_capture_program_uniform_2fv
+#define glProgramUniform3fv gl_capture_program_uniform_3fv
+#define glProgramUniform4fv gl_capture_program_uniform_4fv
+#define glProgramUniformMatrix3fv gl_capture_program_uniform_matrix_3fv
+#define glProgramUniformMatrix4fv gl_capture_program_uniform_matrix_4fv
+#define glActiveTexture gl_capture_active_texture
+#define glBindTexture gl_capture_bind_texture
+#define glTexParameteri gl_capture_tex_parameteri
+#define glTexImage2D gl_capture_tex_image_2d
+#define glTexSubImage2D gl_capture_tex_sub_image_2d
+#define glGenerateMipmap gl_capture_generate_mipmap
+#define glViewport gl_capture_viewport
+#define glEnable gl_capture_enable
+#define glDisable gl_capture_disable
+#define glDepthFunc gl_capture_depth_func
+#define glDepthMask gl_capture_depth_mask
+#define glBlendFunc gl_capture_blend_func
+#define glPointSize gl_capture_point_size
+#define glClearColor gl_capture_clear_color
+#define glClear gl_capture_clear
+#define glDrawArrays gl_capture_draw_arrays
+#define glDrawArraysInstanced gl_capture_draw_arrays_instanced
+#define glDrawElements gl_capture_draw_elements
+#define glDrawElementsInstancedBaseVertex gl_capture_draw_elements_instanced_base_vertex
+#define glDrawElementsInstancedBaseVertexBaseInstance gl_capture_draw_elements_instanced_base_vertex_base_instance
+#define glMultiDrawArrays gl_capture_multi_draw_arrays
+#define glCopyBufferSubData gl_capture_copy_buffer_sub_data
+#define glDrawArraysInstancedBaseInstance gl_capture_draw_arrays_instanced_base_instance
+#define glMultiDrawArraysIndirect gl_capture_multi_draw_arrays_indirect
+#define glMultiDrawElementsBaseVertex gl_capture_multi_draw_elements_base_vertex
+#define glMultiDrawElementsIndirect gl_capture_multi_draw_elements_indirect
+#define glMultiDrawElementsIndirectCountARB gl_capture_multi_draw_elements_indirect_count
+#define glDispatchCompute gl_capture_dispatch_compute
+#define glMemoryBarrier gl_capture_memory_barrier
+#define glFenceSync gl_capture_fence_sync
+#define glClientWaitSync gl_capture_client_wait_sync
+#define glDeleteSync gl_capture_delete_sync
+#endif
+#else
+inline void gl_capture_buffer_write(GLuint, GLintptr, GLsizeiptr, const void *) {}
+#endif
@@ -0,0 +1,413 @@
+#define GL_CAPTURE_PASSTHROUGH
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "logging.h"
+#include "assetloader.h"
+#include "gldebug.h"
+#include "glcapture.h"
+
+struct debug_name {
+    const char * name;
+    GLenum value;
+};
+
+static const debug_name g_source_names[] = {
+    { "api", GL_DEBUG_SOURCE_API },
+    { "window", GL_DEBUG_SOURCE_WINDOW_SYSTEM },
+    { "compiler", GL_DEBUG_SOURCE_SHADER_COMPILER },
+    { "third-party", GL_DEBUG_SOURCE_THIRD_PARTY },
+    { "application", GL_DEBUG_SOURCE_APPLICATION },
+    { "other", GL_DEBUG_SOURCE_OTHER },
+};
+
+// group covers both push and pop
+static const debug_name g_type_names[] = {
+    { "error", GL_DEBUG_TYPE_ERROR },
+    { "deprecated", GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR },
+    { "undefined", GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR },
+    { "portability", GL_DEBUG_TYPE_PORTABILITY },
+    { "performance", GL_DEBUG_TYPE_PERFORMANCE },
+    { "other", GL_DEBUG_TYPE_OTHER },
+    { "marker", GL_DEBUG_TYPE_MARKER },
+    { "group", GL_DEBUG_TYPE_PUSH_GROUP },
+};
+
+// most severe first
+static const debug_name g_severity_names[] = {
+    { "high", GL_DEBUG_SEVERITY_HIGH },
+    { "medium", GL_DEBUG_SEVERITY_MEDIUM },
+    { "low", GL_DEBUG_SEVERITY_LOW },
+    { "notification", GL_DEBUG_SEVERITY_NOTIFICATION },
+};
+
+#define DEBUG_SOURCE_COUNT (int)(sizeof(g_source_names) / sizeof(g_source_names[0]))
+#define DEBUG_TYPE_COUNT (int)(sizeof(g_type_names) / sizeof(g_type_names[0]))
+#define DEBUG_SEVERITY_COUNT (int)(sizeof(g_severity_names) / sizeof(g_severity_names[0]))
+#define DEBUG_TYPE_GROUP_BIT (1u << 7)
+
+struct debug_message {
+    // 0 while the entry is free
+    unsigned long long hash;
+    GLenum source;
+    GLenum type;
+    GLenum severity;
+    GLuint id;
+    // of the normalised text, for API errors only; 0 otherwise
+    unsigned long long text_hash;
+    char text[GL_DEBUG_TEXT_SIZE];
+    unsigned long total;
+    unsigned long this_frame;
+    unsigned long max_per_frame;
+    unsigned long frames_seen;
+    // since the last "still firing" line
+    unsigned long recent;
+    long first_frame;
+};
+
+static gl_debug_options g_options;
+static bool g_active = false;
+static debug_message g_messages[GL_DEBUG_MESSAGES];
+static int g_distinct = 0;
+// the callback may run on driver threads unless the output is synchronous
+static std::mutex g_messages_mutex;
+static std::atomic<long> g_frame(0);
+static std::atomic<unsigned long> g_received(0);
+static std::atomic<unsigned long> g_filtered(0);
+static unsigned long g_untracked = 0;
+
+static const char * name_of(const debug_name * names, int count, GLenum value) {
+    for(int i = 0; i < count; i++) {
+        if(names[i].value == value) {
+            return names[i].name;
+        }
+    }
+    // pop groups share the push entry
+    return value == GL_DEBUG_TYPE_POP_GROUP ? "group" : "unknown";
+}
+
+static int severity_rank(GLenum severity) {
+    for(int i = 0; i < DEBUG_SEVERITY_COUNT; i++) {
+        if(g_severity_names[i].value == severity) {
+            return i;
+        }
+    }
+    return DEBUG_SEVERITY_COUNT;
+}
+
+static unsigned bit_of(const debug_name * names, int count, GLenum value) {
+    if(value == GL_DEBUG_TYPE_POP_GROUP) {
+        return DEBUG_TYPE_GROUP_BIT;
+    }
+    for(int i = 0; i < count; i++) {
+        if(names[i].value == value) {
+            return 1u << i;
+        }
+    }
+    return 0;
+}
+
+static bool parse_list(const char * list, const debug_name * names, int count, unsigned * bits) {
+    *bits = 0;
+    const char * p = list;
+    while(*p) {
+        size_t length = strcspn(p, ",");
+        bool found = false;
+        for(int i = 0; i < count; i++) {
+            if(strlen(names[i].name) == length && !strncmp(p, names[i].name, length)) {
+                *bits |= 1u << i;
+                found = true;
+            }
+        }
+        if(!found) {
+            fprintf(stderr, "unknown debug message category %.*s\n", (int)length, p);
+            return false;
+        }
+        p += length;
+        p += *p == ',';
+    }
+    return true;
+}
+
+bool parse_gl_debug_args(int * argc, char ** argv, gl_debug_options * options) {
+    options->enabled = true;
+    options->sources = (1u << DEBUG_SOURCE_COUNT) - 1;
+    options->types = (1u << DEBUG_TYPE_COUNT) - 1;
+    options->types &= ~(bit_of(g_type_names, DEBUG_TYPE_COUNT, GL_DEBUG_TYPE_MARKER) | DEBUG_TYPE_GROUP_BIT);
+    options->min_severity = GL_DEBUG_SEVERITY_LOW;
+    options->synchronous = false;
+    int kept = 1;
+    for(int i = 1; i < *argc; i++) {
+        if(!strcmp(argv[i], "--gl-debug") && i + 1 < *argc) {
+            const char * level = argv[++i];
+            options->enabled = strcmp(level, "off") != 0;
+            unsigned bits = 0;
+            if(options->enabled) {
+                if(!parse_list(level, g_severity_names, DEBUG_SEVERITY_COUNT, &bits) || (bits & (bits - 1))) {
+                    fprintf(stderr, "--gl-debug expects off, high, medium, low or notification\n");
+                    return false;
+                }
+                for(int s = 0; s < DEBUG_SEVERITY_COUNT; s++) {
+                    if(bits & (1u << s)) {
+                        options->min_severity = g_severity_names[s].value;
+                    }
+                }
+            }
+        } else if(!strcmp(argv[i], "--gl-debug-sources") && i + 1 < *argc) {
+            if(!parse_list(argv[++i], g_source_names, DEBUG_SOURCE_COUNT, &options->sources)) {
+                return false;
+            }
+        } else if(!strcmp(argv[i], "--gl-debug-types") && i + 1 < *argc) {
+            if(!parse_list(argv[++i], g_type_names, DEBUG_TYPE_COUNT, &options->types)) {
+                return false;
+            }
+        } else if(!strcmp(argv[i], "--gl-debug-sync")) {
+            options->synchronous = true;
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    *argc = kept;
+    argv[kept] = NULL;
+    return true;
+}
+
+void gl_debug_context_hints(const gl_debug_options * options) {
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, options->enabled ? GLFW_TRUE : GLFW_FALSE);
+}
+
+static bool accepted(GLenum source, GLenum type, GLenum severity) {
+    return (g_options.sources & bit_of(g_source_names, DEBUG_SOURCE_COUNT, source))
+        && (g_options.types & bit_of(g_type_names, DEBUG_TYPE_COUNT, type))
+        && severity_rank(severity) <= severity_rank(g_options.min_severity);
+}
+
+static int log_level_of(GLenum severity) {
+    switch(severity) {
+        case GL_DEBUG_SEVERITY_HIGH: return GL_LOG_ERROR;
+        case GL_DEBUG_SEVERITY_MEDIUM: return GL_LOG_WARN;
+        default: break;
+    }
+    return GL_LOG_INFO;
+}
+
+// hash of an error's text with every number and quoted name replaced by
+// '#', so "buffer 12 is mapped" and "buffer 7 is mapped" are one entry while
+// "buffer 12 is not bound" is another
+static unsigned long long error_text_hash(const GLchar * message, size_t length) {
+    char shape[GL_DEBUG_TEXT_SIZE];
+    size_t used = 0;
+    for(size_t i = 0; i < length && used < sizeof(shape); i++) {
+        char c = message[i];
+        // digits inside identifiers such as glUniform4fv are kept
+        bool word = i > 0 && (isalnum((unsigned char)message[i - 1]) || message[i - 1] == '_');
+        if(c >= '0' && c <= '9' && !word) {
+            while(i + 1 < length && (isalnum((unsigned char)message[i + 1]) || message[i + 1] == '.')) {
+                i++;
+            }
+            c = '#';
+        } else if(c == '\'' || c == '"') {
+            const char * close = (const char *)memchr(message + i + 1, c, length - i - 1);
+            if(close) {
+                i = close - message;
+                c = '#';
+            }
+        }
+        shape[used++] = c;
+    }
+    unsigned long long hash = hash_bytes(shape, used);
+    return hash + (hash == 0);
+}
+
+static void GLAPIENTRY debug_callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+    const GLchar * message, const void *) {
+    // the driver filters too, but some ignore glDebugMessageControl for their own messages
+    if(!accepted(source, type, severity)) {
+        g_filtered++;
+        return;
+    }
+    g_received++;
+    // keyed without the raw text: drivers put object names and sizes in it,
+    // which would make every occurrence of one message look distinct. API
+    // errors do add the text's shape, since drivers such as Mesa give them
+    // all the same id
+    size_t text_length = length < 0 ? strlen(message) : (size_t)length;
+    unsigned long long text_hash = type == GL_DEBUG_TYPE_ERROR ? error_text_hash(message, text_length) : 0;
+    unsigned int key[] = { source, type, id, severity };
+    unsigned long long hash = hash_bytes(key, sizeof(key), text_hash ? text_hash : ASSET_HASH_SEED);
+    hash += hash == 0;
+    std::lock_guard<std::mutex> lock(g_messages_mutex);
+    // open addressing; a full table only loses the per-message breakdown
+    for(int probe = 0; probe < GL_DEBUG_MESSAGES; probe++) {
+        debug_message & entry = g_messages[(hash + probe) & (GL_DEBUG_MESSAGES - 1)];
+        if(entry.hash == hash && entry.source == source && entry.type == type && entry.id == id
+            && entry.severity == severity && entry.text_hash == text_hash) {
+            entry.total++;
+            entry.this_frame++;
+            return;
+        }
+        if(entry.hash == 0) {
+            entry.hash = hash;
+            entry.source = source;
+            entry.type = type;
+            entry.severity = severity;
+            entry.id = id;
+            entry.text_hash = text_hash;
+            // the first text stands for all of them
+            size_t copied = std::min(text_length, sizeof(entry.text) - 1);
+            memcpy(entry.text, message, copied);
+            entry.text[copied] = '\0';
+            // drivers often end with a newline, the log line adds its own
+            while(copied > 0 && (entry.text[copied - 1] == '\n' || entry.text[copied - 1] == ' ')) {
+                entry.text[--copied] = '\0';
+            }
+            entry.total = entry.this_frame = 1;
+            entry.first_frame = g_frame.load();
+            g_distinct++;
+            gl_log_at(log_level_of(severity), "GL %s %s (%s, id %u) in frame %li: %s\n",
+                name_of(g_type_names, DEBUG_TYPE_COUNT, type), name_of(g_severity_names, DEBUG_SEVERITY_COUNT, severity),
+                name_of(g_source_names, DEBUG_SOURCE_COUNT, source), id, entry.first_frame, entry.text);
+            return;
+        }
+    }
+    g_untracked++;
+}
+
+static void log_names(char * out, size_t size, const debug_name * names, int count, unsigned bits) {
+    out[0] = '\0';
+    for(int i = 0; i < count; i++) {
+        if(bits & (1u << i)) {
+            size_t used = strlen(out);
+            snprintf(out + used, size - used, "%s%s", used ? "," : "", names[i].name);
+        }
+    }
+}
+
+bool gl_debug_init(const gl_debug_options * options) {
+    g_options = *options;
+    memset(g_messages, 0, sizeof(g_messages));
+    g_distinct = 0;
+    g_untracked = 0;
+    g_frame.store(0);
+    g_received.store(0);
+    g_filtered.store(0);
+    g_active = false;
+    if(!options->enabled) {
+        return true;
+    }
+    if(!GLEW_VERSION_4_3 && !GLEW_KHR_debug) {
+        gl_log("gl debug: no KHR_debug, driver messages are not captured\n");
+        return true;
+    }
+    GLint flags = 0;
+    glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+    glDebugMessageCallback(debug_callback, NULL);
+    // switched off in the driver, filtered messages are never even formatted
+    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, NULL, GL_FALSE);
+    for(int s = 0; s < DEBUG_SOURCE_COUNT; s++) {
+        for(int t = 0; t < DEBUG_TYPE_COUNT; t++) {
+            if(!(options->sources & (1u << s)) || !(options->types & (1u << t))) {
+                continue;
+            }
+            for(int v = 0; v <= severity_rank(options->min_severity) && v < DEBUG_SEVERITY_COUNT; v++) {
+                glDebugMessageControl(g_source_names[s].value, g_type_names[t].value, g_severity_names[v].value,
+                    0, NULL, GL_TRUE);
+                if(g_type_names[t].value == GL_DEBUG_TYPE_PUSH_GROUP) {
+                    glDebugMessageControl(g_source_names[s].value, GL_DEBUG_TYPE_POP_GROUP,
+                        g_severity_names[v].value, 0, NULL, GL_TRUE);
+                }
+            }
+        }
+    }
+    options->synchronous ? glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS) : glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    glEnable(GL_DEBUG_OUTPUT);
+    g_active = true;
+    char sources[128];
+    char types[128];
+    log_names(sources, sizeof(sources), g_source_names, DEBUG_SOURCE_COUNT, options->sources);
+    log_names(types, sizeof(types), g_type_names, DEBUG_TYPE_COUNT, options->types);
+    gl_log("gl debug: %s context, %s and above, sources %s, types %s, %s\n",
+        (flags & GL_CONTEXT_FLAG_DEBUG_BIT) ? "debug" : "non-debug",
+        name_of(g_severity_names, DEBUG_SEVERITY_COUNT, options->min_severity), sources, types,
+        options->synchronous ? "synchronous" : "asynchronous");
+    return true;
+}
+
+void gl_debug_end_frame() {
+    if(!g_active) {
+        return;
+    }
+    long frame = g_frame.load();
+    bool report = (frame + 1) % GL_DEBUG_REPEAT_FRAMES == 0;
+    std::lock_guard<std::mutex> lock(g_messages_mutex);
+    for(int i = 0; i < GL_DEBUG_MESSAGES; i++) {
+        debug_message & entry = g_messages[i];
+        if(entry.hash == 0) {
+            continue;
+        }
+        if(entry.this_frame > 0) {
+            entry.frames_seen++;
+            entry.max_per_frame = std::max(entry.max_per_frame, entry.this_frame);
+            entry.recent += entry.this_frame;
+            entry.this_frame = 0;
+        }
+        // messages that only ever fired once were logged in full already
+        if(report && entry.recent > 0 && entry.total > 1) {
+            gl_log_at(log_level_of(entry.severity), "GL %s still firing: %lu times in the last %i frames: %.80s\n",
+                name_of(g_type_names, DEBUG_TYPE_COUNT, entry.type), entry.recent, GL_DEBUG_REPEAT_FRAMES,
+                entry.text);
+        }
+        if(report) {
+            entry.recent = 0;
+        }
+    }
+    g_frame.store(frame + 1);
+}
+
+unsigned long gl_debug_message_count() {
+    return g_received.load();
+}
+
+void log_gl_debug_stats() {
+    if(!g_active) {
+        return;
+    }
+    std::vector<debug_message> messages;
+    {
+        std::lock_guard<std::mutex> lock(g_messages_mutex);
+        for(int i = 0; i < GL_DEBUG_MESSAGES; i++) {
+            if(g_messages[i].hash) {
+                messages.push_back(g_messages[i]);
+            }
+        }
+    }
+    std::sort(messages.begin(), messages.end(), [](const debug_message & a, const debug_message & b) {
+        return a.total > b.total;
+    });
+    gl_log("gl debug: %lu messages, %i distinct, over %li frames (%lu filtered out, %lu past the table)\n",
+        g_received.load(), g_distinct, g_frame.load(), g_filtered.load(), g_untracked);
+    for(size_t i = 0; i < messages.size() && i < GL_DEBUG_TOP; i++) {
+        const debug_message & entry = messages[i];
+        gl_log("  %8lux in %li frames (max %lu/frame, first in frame %li) %s %s %s id %u: %.100s\n",
+            entry.total, (long)entry.frames_seen, entry.max_per_frame, entry.first_frame,
+            name_of(g_source_names, DEBUG_SOURCE_COUNT, entry.source),
+            name_of(g_type_names, DEBUG_TYPE_COUNT, entry.type),
+            name_of(g_severity_names, DEBUG_SEVERITY_COUNT, entry.severity), entry.id, entry.text);
+    }
+}
+
+void gl_debug_shutdown() {
+    if(!g_active) {
+        return;
+    }
+    glDisable(GL_DEBUG_OUTPUT);
+    glDebugMessageCallback(NULL, NULL);
+    g_active = false;
+}
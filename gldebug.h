@@ -0,0 +1,50 @@
+#pragma once
+#include <GL/glew.h>
+
+// Driver debug output (KHR_debug / GL 4.3) in gl.log. The context is created
+// with the debug flag where the window system allows it, filtered messages
+// are switched off in the driver with glDebugMessageControl, and the rest
+// arrive in a callback that files them by source, type, id and severity, so
+// one message whose text names different objects is still one entry. API
+// errors are also told apart by their text with numbers and quoted names
+// taken out, since some drivers (Mesa) give every error the same id. Each
+// entry is logged in full the first time only, and that text is kept as its
+// sample; after that it is counted per frame, with one "still firing" line
+// per GL_DEBUG_REPEAT_FRAMES frames while it keeps coming.
+// log_gl_debug_stats() ends the run with the most frequent messages.
+//
+//   --gl-debug LEVEL         lowest severity reported: off, high, medium,
+//                            low (default) or notification
+//   --gl-debug-sources LIST  comma-separated: api, window, compiler,
+//                            third-party, application, other (default all)
+//   --gl-debug-types LIST    comma-separated: error, deprecated, undefined,
+//                            portability, performance, other, marker, group
+//                            (default all but marker and group)
+//   --gl-debug-sync          deliver messages on the thread making the call,
+//                            so a breakpoint in the callback shows the caller
+#define GL_DEBUG_MESSAGES 256
+#define GL_DEBUG_TEXT_SIZE 256
+#define GL_DEBUG_REPEAT_FRAMES 300
+#define GL_DEBUG_TOP 10
+
+struct gl_debug_options {
+    bool enabled;
+    // bits in the order of the lists above
+    unsigned sources;
+    unsigned types;
+    // GL_DEBUG_SEVERITY_*
+    GLenum min_severity;
+    bool synchronous;
+};
+
+bool parse_gl_debug_args(int * argc, char ** argv, gl_debug_options * options);
+// GLFW windows need the hint before they are created; headless takes
+// headless_options.debug_context instead
+void gl_debug_context_hints(const gl_debug_options * options);
+// with the context current, after glewInit; false only for bad options
+bool gl_debug_init(const gl_debug_options * options);
+void gl_debug_end_frame();
+unsigned long gl_debug_message_count();
+void log_gl_debug_stats();
+// while the context is still current
+void gl_debug_shutdown();
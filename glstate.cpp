@@ -0,0 +1,438 @@
+#include <GL/glew.h>
+#include <stdlib.h>
+#include <string.h>
+#include "logging.h"
+#include "glstate.h"
+#include "glcapture.h"
+
+// shadow value meaning "not known, always issue the call"
+#define UNKNOWN_NAME 0xffffffffu
+#define MAX_TEXTURE_UNITS 32
+
+enum {
+    BUFFER_ARRAY,
+    BUFFER_ELEMENT_ARRAY,
+    BUFFER_UNIFORM,
+    BUFFER_SHADER_STORAGE,
+    BUFFER_DRAW_INDIRECT,
+    BUFFER_DISPATCH_INDIRECT,
+    BUFFER_PIXEL_PACK,
+    BUFFER_PIXEL_UNPACK,
+    BUFFER_COPY_READ,
+    BUFFER_COPY_WRITE,
+    BUFFER_TARGETS,
+};
+
+enum {
+    TEXTURE_2D,
+    TEXTURE_2D_ARRAY,
+    TEXTURE_3D,
+    TEXTURE_CUBE_MAP,
+    TEXTURE_TARGETS,
+};
+
+enum {
+    CAP_DEPTH_TEST,
+    CAP_BLEND,
+    CAP_CULL_FACE,
+    CAP_PROGRAM_POINT_SIZE,
+    CAPS,
+};
+
+struct shadow_state {
+    GLuint program;
+    GLuint vao;
+    GLuint buffers[BUFFER_TARGETS];
+    GLuint active_texture;
+    GLuint textures[MAX_TEXTURE_UNITS][TEXTURE_TARGETS];
+    GLint viewport[4];
+    int caps[CAPS];
+    GLenum depth_func;
+    int depth_mask;
+    GLenum blend_src;
+    GLenum blend_dst;
+    GLfloat point_size;
+};
+
+static shadow_state g_shadow;
+static bool g_debug = getenv("GL_STATE_DEBUG") != NULL;
+static unsigned long g_issued = 0;
+static unsigned long g_elided = 0;
+static unsigned long g_last_issued = 0;
+static unsigned long g_last_elided = 0;
+static unsigned long long g_total_issued = 0;
+static unsigned long long g_total_elided = 0;
+static unsigned long g_desyncs = 0;
+static bool g_initialized = false;
+
+static int buffer_slot(GLenum target) {
+    switch(target) {
+        case GL_ARRAY_BUFFER: return BUFFER_ARRAY;
+        case GL_ELEMENT_ARRAY_BUFFER: return BUFFER_ELEMENT_ARRAY;
+        case GL_UNIFORM_BUFFER: return BUFFER_UNIFORM;
+        case GL_SHADER_STORAGE_BUFFER: return BUFFER_SHADER_STORAGE;
+        case GL_DRAW_INDIRECT_BUFFER: return BUFFER_DRAW_INDIRECT;
+        case GL_DISPATCH_INDIRECT_BUFFER: return BUFFER_DISPATCH_INDIRECT;
+        case GL_PIXEL_PACK_BUFFER: return BUFFER_PIXEL_PACK;
+        case GL_PIXEL_UNPACK_BUFFER: return BUFFER_PIXEL_UNPACK;
+        case GL_COPY_READ_BUFFER: return BUFFER_COPY_READ;
+        case GL_COPY_WRITE_BUFFER: return BUFFER_COPY_WRITE;
+        default: break;
+    }
+    return -1;
+}
+
+static GLenum buffer_binding_query(int slot) {
+    static const GLenum queries[BUFFER_TARGETS] = {
+        GL_ARRAY_BUFFER_BINDING, GL_ELEMENT_ARRAY_BUFFER_BINDING, GL_UNIFORM_BUFFER_BINDING,
+        GL_SHADER_STORAGE_BUFFER_BINDING, GL_DRAW_INDIRECT_BUFFER_BINDING,
+        GL_DISPATCH_INDIRECT_BUFFER_BINDING, GL_PIXEL_PACK_BUFFER_BINDING,
+        GL_PIXEL_UNPACK_BUFFER_BINDING, GL_COPY_READ_BUFFER_BINDING, GL_COPY_WRITE_BUFFER_BINDING,
+    };
+    return queries[slot];
+}
+
+static int texture_slot(GLenum target) {
+    switch(target) {
+        case GL_TEXTURE_2D: return TEXTURE_2D;
+        case GL_TEXTURE_2D_ARRAY: return TEXTURE_2D_ARRAY;
+        case GL_TEXTURE_3D: return TEXTURE_3D;
+        case GL_TEXTURE_CUBE_MAP: return TEXTURE_CUBE_MAP;
+        default: break;
+    }
+    return -1;
+}
+
+static GLenum texture_binding_query(int slot) {
+    static const GLenum queries[TEXTURE_TARGETS] = {
+        GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_2D_ARRAY, GL_TEXTURE_BINDING_3D, GL_TEXTURE_BINDING_CUBE_MAP,
+    };
+    return queries[slot];
+}
+
+static int cap_slot(GLenum cap) {
+    switch(cap) {
+        case GL_DEPTH_TEST: return CAP_DEPTH_TEST;
+        case GL_BLEND: return CAP_BLEND;
+        case GL_CULL_FACE: return CAP_CULL_FACE;
+        case GL_PROGRAM_POINT_SIZE: return CAP_PROGRAM_POINT_SIZE;
+        default: break;
+    }
+    return -1;
+}
+
+static GLenum cap_enum(int slot) {
+    static const GLenum caps[CAPS] = { GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE, GL_PROGRAM_POINT_SIZE };
+    return caps[slot];
+}
+
+void gl_state_reset() {
+    // unknown everywhere: the first call of each kind is always issued
+    memset(&g_shadow, 0xff, sizeof(g_shadow));
+    for(int i = 0; i < CAPS; i++) {
+        g_shadow.caps[i] = -1;
+    }
+    g_shadow.depth_mask = -1;
+    g_shadow.point_size = -1.0f;
+    g_initialized = true;
+}
+
+void gl_state_set_debug(bool enabled) {
+    g_debug = enabled;
+}
+
+static void desync(const char * what, long shadow, long actual) {
+    g_desyncs++;
+    gl_log_err("ERROR: GL state desync on %s: shadow %li, driver %li\n", what, shadow, actual);
+}
+
+static GLint query_int(GLenum pname) {
+    GLint value = 0;
+    glGetIntegerv(pname, &value);
+    return value;
+}
+
+// elided calls are only safe if the driver really has the shadow value
+static void check_int(const char * what, GLenum pname, GLuint shadow) {
+    if(!g_debug || shadow == UNKNOWN_NAME) {
+        return;
+    }
+    GLint actual = query_int(pname);
+    if((GLuint)actual != shadow) {
+        desync(what, (long)shadow, (long)actual);
+    }
+}
+
+// true if the call has to be issued; counts either way
+static bool changed(bool differs) {
+    if(!g_initialized) {
+        gl_state_reset();
+    }
+    if(differs) {
+        g_issued++;
+        return true;
+    }
+    g_elided++;
+    return false;
+}
+
+void gl_state_use_program(GLuint program) {
+    if(!changed(g_shadow.program != program)) {
+        check_int("program", GL_CURRENT_PROGRAM, g_shadow.program);
+        return;
+    }
+    glUseProgram(program);
+    g_shadow.program = program;
+}
+
+void gl_state_bind_vertex_array(GLuint vao) {
+    if(!changed(g_shadow.vao != vao)) {
+        check_int("vertex array", GL_VERTEX_ARRAY_BINDING, g_shadow.vao);
+        return;
+    }
+    glBindVertexArray(vao);
+    g_shadow.vao = vao;
+    // the element array binding belongs to the VAO
+    g_shadow.buffers[BUFFER_ELEMENT_ARRAY] = UNKNOWN_NAME;
+}
+
+void gl_state_bind_buffer(GLenum target, GLuint buffer) {
+    int slot = buffer_slot(target);
+    if(slot < 0) {
+        g_issued++;
+        glBindBuffer(target, buffer);
+        return;
+    }
+    if(!changed(g_shadow.buffers[slot] != buffer)) {
+        check_int("buffer binding", buffer_binding_query(slot), g_shadow.buffers[slot]);
+        return;
+    }
+    glBindBuffer(target, buffer);
+    g_shadow.buffers[slot] = buffer;
+}
+
+void gl_state_active_texture(GLenum unit) {
+    if(!changed(g_shadow.active_texture != unit)) {
+        check_int("active texture", GL_ACTIVE_TEXTURE, g_shadow.active_texture);
+        return;
+    }
+    glActiveTexture(unit);
+    g_shadow.active_texture = unit;
+}
+
+void gl_state_bind_texture(GLenum target, GLuint texture) {
+    int slot = texture_slot(target);
+    GLuint unit = g_shadow.active_texture - GL_TEXTURE0;
+    if(slot < 0 || g_shadow.active_texture == UNKNOWN_NAME || unit >= MAX_TEXTURE_UNITS) {
+        g_issued++;
+        glBindTexture(target, texture);
+        return;
+    }
+    if(!changed(g_shadow.textures[unit][slot] != texture)) {
+        check_int("texture binding", texture_binding_query(slot), g_shadow.textures[unit][slot]);
+        return;
+    }
+    glBindTexture(target, texture);
+    g_shadow.textures[unit][slot] = texture;
+}
+
+void gl_state_viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+    GLint viewport[4] = { x, y, width, height };
+    if(!changed(memcmp(g_shadow.viewport, viewport, sizeof(viewport)) != 0)) {
+        if(g_debug) {
+            GLint actual[4];
+            glGetIntegerv(GL_VIEWPORT, actual);
+            if(memcmp(actual, viewport, sizeof(viewport)) != 0) {
+                desync("viewport width", width, actual[2]);
+            }
+        }
+        return;
+    }
+    glViewport(x, y, width, height);
+    memcpy(g_shadow.viewport, viewport, sizeof(viewport));
+}
+
+void gl_state_enable(GLenum cap, bool enabled) {
+    int slot = cap_slot(cap);
+    if(slot < 0) {
+        g_issued++;
+        enabled ? glEnable(cap) : glDisable(cap);
+        return;
+    }
+    if(!changed(g_shadow.caps[slot] != (int)enabled)) {
+        if(g_debug && glIsEnabled(cap) != (GLboolean)enabled) {
+            desync("capability", enabled, !enabled);
+        }
+        return;
+    }
+    enabled ? glEnable(cap) : glDisable(cap);
+    g_shadow.caps[slot] = enabled;
+}
+
+void gl_state_depth_func(GLenum func) {
+    if(!changed(g_shadow.depth_func != func)) {
+        check_int("depth func", GL_DEPTH_FUNC, g_shadow.depth_func);
+        return;
+    }
+    glDepthFunc(func);
+    g_shadow.depth_func = func;
+}
+
+void gl_state_depth_mask(GLboolean mask) {
+    if(!changed(g_shadow.depth_mask != (int)mask)) {
+        check_int("depth mask", GL_DEPTH_WRITEMASK, g_shadow.depth_mask);
+        return;
+    }
+    glDepthMask(mask);
+    g_shadow.depth_mask = mask;
+}
+
+void gl_state_blend_func(GLenum src, GLenum dst) {
+    if(!changed(g_shadow.blend_src != src || g_shadow.blend_dst != dst)) {
+        check_int("blend src", GL_BLEND_SRC_RGB, g_shadow.blend_src);
+        check_int("blend dst", GL_BLEND_DST_RGB, g_shadow.blend_dst);
+        return;
+    }
+    glBlendFunc(src, dst);
+    g_shadow.blend_src = src;
+    g_shadow.blend_dst = dst;
+}
+
+void gl_state_point_size(GLfloat size) {
+    if(!changed(g_shadow.point_size != size)) {
+        if(g_debug) {
+            GLfloat actual = 0.0f;
+            glGetFloatv(GL_POINT_SIZE, &actual);
+            if(actual != size) {
+                desync("point size", (long)size, (long)actual);
+            }
+        }
+        return;
+    }
+    glPointSize(size);
+    g_shadow.point_size = size;
+}
+
+// a deleted program stays current until replaced, but its name may be reused
+void gl_state_delete_program(GLuint program) {
+    glDeleteProgram(program);
+    if(g_shadow.program == program) {
+        g_shadow.program = UNKNOWN_NAME;
+    }
+}
+
+// deleting a bound object reverts the binding to 0
+void gl_state_delete_vertex_arrays(GLsizei count, const GLuint * vaos) {
+    glDeleteVertexArrays(count, vaos);
+    for(GLsizei i = 0; i < count; i++) {
+        if(g_shadow.vao == vaos[i]) {
+            g_shadow.vao = 0;
+            g_shadow.buffers[BUFFER_ELEMENT_ARRAY] = UNKNOWN_NAME;
+        }
+    }
+}
+
+void gl_state_delete_buffers(GLsizei count, const GLuint * buffers) {
+    glDeleteBuffers(count, buffers);
+    for(GLsizei i = 0; i < count; i++) {
+        for(int slot = 0; slot < BUFFER_TARGETS; slot++) {
+            if(g_shadow.buffers[slot] == buffers[i]) {
+                g_shadow.buffers[slot] = 0;
+            }
+        }
+    }
+}
+
+void gl_state_delete_textures(GLsizei count, const GLuint * textures) {
+    glDeleteTextures(count, textures);
+    for(GLsizei i = 0; i < count; i++) {
+        for(int unit = 0; unit < MAX_TEXTURE_UNITS; unit++) {
+            for(int slot = 0; slot < TEXTURE_TARGETS; slot++) {
+                if(g_shadow.textures[unit][slot] == textures[i]) {
+                    g_shadow.textures[unit][slot] = 0;
+                }
+            }
+        }
+    }
+}
+
+// full comparison of the shadow against the driver; resyncs what differs
+bool gl_state_verify() {
+    unsigned long before = g_desyncs;
+    bool debug = g_debug;
+    g_debug = true;
+    check_int("program", GL_CURRENT_PROGRAM, g_shadow.program);
+    check_int("vertex array", GL_VERTEX_ARRAY_BINDING, g_shadow.vao);
+    for(int slot = 0; slot < BUFFER_TARGETS; slot++) {
+        check_int("buffer binding", buffer_binding_query(slot), g_shadow.buffers[slot]);
+    }
+    check_int("active texture", GL_ACTIVE_TEXTURE, g_shadow.active_texture);
+    // texture bindings are per unit, so each known unit is made active in
+    // turn and the driver's active unit put back afterwards
+    GLint active = query_int(GL_ACTIVE_TEXTURE);
+    for(int unit = 0; unit < MAX_TEXTURE_UNITS; unit++) {
+        bool known = false;
+        for(int slot = 0; slot < TEXTURE_TARGETS; slot++) {
+            known = known || g_shadow.textures[unit][slot] != UNKNOWN_NAME;
+        }
+        if(!known) {
+            continue;
+        }
+        glActiveTexture(GL_TEXTURE0 + unit);
+        for(int slot = 0; slot < TEXTURE_TARGETS; slot++) {
+            check_int("texture binding", texture_binding_query(slot), g_shadow.textures[unit][slot]);
+        }
+    }
+    glActiveTexture(active);
+    if(g_shadow.viewport[2] >= 0) {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        if(memcmp(viewport, g_shadow.viewport, sizeof(viewport)) != 0) {
+            desync("viewport width", g_shadow.viewport[2], viewport[2]);
+        }
+    }
+    // -1 for an unknown cap or depth mask reads as UNKNOWN_NAME here
+    for(int slot = 0; slot < CAPS; slot++) {
+        check_int("capability", cap_enum(slot), g_shadow.caps[slot]);
+    }
+    check_int("depth func", GL_DEPTH_FUNC, g_shadow.depth_func);
+    check_int("depth mask", GL_DEPTH_WRITEMASK, g_shadow.depth_mask);
+    check_int("blend src", GL_BLEND_SRC_RGB, g_shadow.blend_src);
+    check_int("blend dst", GL_BLEND_DST_RGB, g_shadow.blend_dst);
+    if(g_shadow.point_size >= 0.0f) {
+        GLfloat point_size = 0.0f;
+        glGetFloatv(GL_POINT_SIZE, &point_size);
+        if(point_size != g_shadow.point_size) {
+            desync("point size", (long)g_shadow.point_size, (long)point_size);
+        }
+    }
+    g_debug = debug;
+    if(g_desyncs != before) {
+        gl_state_reset();
+        return false;
+    }
+    return true;
+}
+
+void gl_state_end_frame() {
+    if(g_debug) {
+        gl_state_verify();
+    }
+    g_last_issued = g_issued;
+    g_last_elided = g_elided;
+    g_total_issued += g_issued;
+    g_total_elided += g_elided;
+    g_issued = g_elided = 0;
+}
+
+void gl_state_frame_counters(unsigned long * issued, unsigned long * elided) {
+    *issued = g_last_issued;
+    *elided = g_last_elided;
+}
+
+void log_gl_state_stats() {
+    unsigned long long total = g_total_issued + g_total_elided;
+    gl_log("gl state: %llu calls issued, %llu elided (%.1f%%), last frame %lu/%lu, %lu desyncs%s\n",
+        g_total_issued, g_total_elided, total ? 100.0 * g_total_elided / total : 0.0,
+        g_last_issued, g_last_elided, g_desyncs, g_debug ? " (debug checks on)" : "");
+}
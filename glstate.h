@@ -0,0 +1,29 @@
+#pragma once
+#include <GL/glew.h>
+
+// Shadow copy of the GL state the renderer touches. Calls that would not
+// change anything are skipped and counted. All rendering code binds and
+// deletes through here so the shadow stays in sync; with debug checking on,
+// every skipped call is cross-checked against glGet*.
+void gl_state_reset();
+void gl_state_set_debug(bool enabled);
+void gl_state_use_program(GLuint program);
+void gl_state_bind_vertex_array(GLuint vao);
+void gl_state_bind_buffer(GLenum target, GLuint buffer);
+void gl_state_active_texture(GLenum unit);
+void gl_state_bind_texture(GLenum target, GLuint texture);
+void gl_state_viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+void gl_state_enable(GLenum cap, bool enabled);
+void gl_state_depth_func(GLenum func);
+void gl_state_depth_mask(GLboolean mask);
+void gl_state_blend_func(GLenum src, GLenum dst);
+void gl_state_point_size(GLfloat size);
+void gl_state_delete_program(GLuint program);
+void gl_state_delete_vertex_arrays(GLsizei count, const GLuint * vaos);
+void gl_state_delete_buffers(GLsizei count, const GLuint * buffers);
+void gl_state_delete_textures(GLsizei count, const GLuint * textures);
+// compares every known shadow value with glGet*; on a mismatch the shadow is reset
+bool gl_state_verify();
+void gl_state_end_frame();
+void gl_state_frame_counters(unsigned long * issued, unsigned long * elided);
+void log_gl_state_stats();
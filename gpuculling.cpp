@@ -0,0 +1,178 @@
+#include <GL/glew.h>
+#include <string.h>
+#include "logging.h"
+#include "shadermanager.h"
+#include "glstate.h"
+#include "gpuculling.h"
+#include "profiler.h"
+#include "glcapture.h"
+
+#define CULL_OBJECTS_BINDING 0
+#define CULL_MESHES_BINDING 1
+#define CULL_COMMANDS_BINDING 2
+#define CULL_DRAW_COUNT_BINDING 3
+#define CULL_FRUSTUM_BINDING 0
+
+bool gpu_culler_init(gpu_culler * culler, const char * compute_file) {
+    memset(culler, 0, sizeof(*culler));
+    if(!(GLEW_VERSION_4_3 || (GLEW_ARB_compute_shader && GLEW_ARB_shader_storage_buffer_object
+        && GLEW_ARB_multi_draw_indirect))) {
+        gl_log_err("ERROR: GPU culling needs compute shaders, SSBOs and multi-draw-indirect\n");
+        return false;
+    }
+    culler->program = build_compute_program(compute_file);
+    if(!culler->program) {
+        return false;
+    }
+    culler->compact = GLEW_ARB_indirect_parameters;
+    GLuint buffers[5];
+    glGenBuffers(5, buffers);
+    culler->objects = buffers[0];
+    culler->meshes = buffers[1];
+    culler->commands = buffers[2];
+    culler->draw_count = buffers[3];
+    culler->frustum = buffers[4];
+    gl_state_bind_buffer(GL_SHADER_STORAGE_BUFFER, culler->draw_count);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+    gl_state_bind_buffer(GL_UNIFORM_BUFFER, culler->frustum);
+    glBufferData(GL_UNIFORM_BUFFER, 6 * sizeof(vec4), NULL, GL_DYNAMIC_DRAW);
+    set_uniform_int(culler->program, "compact", culler->compact ? 1 : 0);
+    gl_log("gpu culler: program %u, %s\n", culler->program,
+        culler->compact ? "compacted commands, GPU draw count" : "one command slot per object");
+    return true;
+}
+
+void gpu_culler_set_meshes(gpu_culler * culler, const mesh_batch * batch) {
+    std::vector<cull_mesh> meshes(batch->meshes.size());
+    for(size_t i = 0; i < meshes.size(); i++) {
+        const mesh_range & range = batch->meshes[i];
+        meshes[i].index_count = range.index_count;
+        meshes[i].first_index = range.first_index;
+        // batch indices are relative to each mesh's first vertex
+        meshes[i].base_vertex = range.first_vertex;
+        meshes[i].pad = 0;
+    }
+    culler->mesh_count = (GLsizei)meshes.size();
+    gl_state_bind_buffer(GL_SHADER_STORAGE_BUFFER, culler->meshes);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, meshes.size() * sizeof(cull_mesh), meshes.data(), GL_STATIC_DRAW);
+}
+
+void gpu_culler_set_objects(gpu_culler * culler, const cull_object * objects, GLsizei count) {
+    culler->object_count = count;
+    gl_state_bind_buffer(GL_SHADER_STORAGE_BUFFER, culler->objects);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(cull_object), objects, GL_STATIC_DRAW);
+    // written by the GPU only; never touched by the CPU
+    gl_state_bind_buffer(GL_SHADER_STORAGE_BUFFER, culler->commands);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(draw_elements_indirect_command), NULL, GL_DYNAMIC_COPY);
+    set_uniform_int(culler->program, "object_count", count);
+}
+
+void gpu_culler_bind_instances(gpu_culler * culler, mesh_batch * batch) {
+    gl_state_bind_vertex_array(batch->vao.get());
+    gl_state_bind_buffer(GL_ARRAY_BUFFER, culler->objects);
+    glEnableVertexAttribArray(BATCH_INSTANCE_ATTRIB);
+    glVertexAttribPointer(BATCH_INSTANCE_ATTRIB, 4, GL_FLOAT, GL_FALSE, sizeof(cull_object), NULL);
+    glVertexAttribDivisor(BATCH_INSTANCE_ATTRIB, 1);
+    gl_state_bind_vertex_array(0);
+}
+
+// indexed binds also move the generic binding; going through the shadow
+// first keeps it in sync
+static void bind_storage_buffer(GLuint binding, GLuint buffer) {
+    gl_state_bind_buffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer);
+}
+
+void gpu_culler_cull(gpu_culler * culler, const mat4 & view_projection) {
+    PROFILE_GPU_ZONE("gpu_cull");
+    vec4 planes[6];
+    mat4_frustum_planes(view_projection, planes);
+    gl_state_bind_buffer(GL_UNIFORM_BUFFER, culler->frustum);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(planes), planes);
+    glBindBufferBase(GL_UNIFORM_BUFFER, CULL_FRUSTUM_BINDING, culler->frustum);
+    if(culler->compact) {
+        GLuint zero = 0;
+        gl_state_bind_buffer(GL_SHADER_STORAGE_BUFFER, culler->draw_count);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    }
+    bind_storage_buffer(CULL_OBJECTS_BINDING, culler->objects);
+    bind_storage_buffer(CULL_MESHES_BINDING, culler->meshes);
+    bind_storage_buffer(CULL_COMMANDS_BINDING, culler->commands);
+    bind_storage_buffer(CULL_DRAW_COUNT_BINDING, culler->draw_count);
+    gl_state_use_program(culler->program);
+    glDispatchCompute((culler->object_count + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+    // the draw reads commands and count as indirect parameters
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    culler->dispatches++;
+}
+
+void gpu_culler_draw(gpu_culler * culler, mesh_batch * batch, GLenum mode) {
+    PROFILE_GPU_ZONE("gpu_cull_draw");
+    gl_state_bind_vertex_array(batch->vao.get());
+    // the batch's multi-draws switch instancing off again
+    glEnableVertexAttribArray(BATCH_INSTANCE_ATTRIB);
+    gl_state_bind_buffer(GL_DRAW_INDIRECT_BUFFER, culler->commands);
+    if(culler->compact) {
+        gl_state_bind_buffer(GL_PARAMETER_BUFFER_ARB, culler->draw_count);
+        glMultiDrawElementsIndirectCountARB(mode, GL_UNSIGNED_INT, NULL, 0, culler->object_count, 0);
+    } else {
+        glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, NULL, culler->object_count, 0);
+    }
+    culler->draws++;
+}
+
+GLsizei gpu_culler_read_visible(gpu_culler * culler, std::vector<GLuint> * visible) {
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    GLuint count = culler->object_count;
+    if(culler->compact) {
+        gl_state_bind_buffer(GL_SHADER_STORAGE_BUFFER, culler->draw_count);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(count), &count);
+    }
+    std::vector<draw_elements_indirect_command> commands(count);
+    gl_state_bind_buffer(GL_SHADER_STORAGE_BUFFER, culler->commands);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(draw_elements_indirect_command),
+        commands.data());
+    visible->clear();
+    for(GLuint i = 0; i < count; i++) {
+        if(commands[i].instance_count) {
+            visible->push_back(commands[i].base_instance);
+        }
+    }
+    return (GLsizei)visible->size();
+}
+
+void log_gpu_culler_stats(const gpu_culler * culler) {
+    gl_log("gpu culler %u: %i objects, %i meshes, %lu dispatches, %lu indirect draws\n", culler->program,
+        culler->object_count, culler->mesh_count, culler->dispatches, culler->draws);
+}
+
+void gpu_culler_destroy(gpu_culler * culler) {
+    GLuint buffers[] = { culler->objects, culler->meshes, culler->commands, culler->draw_count, culler->frustum };
+    gl_state_delete_buffers(5, buffers);
+    release_uniform_table(culler->program);
+    gl_state_delete_program(culler->program);
+    memset(culler, 0, sizeof(*culler));
+}
+
+bool sphere_in_frustum(const vec4 planes[6], const GLfloat sphere[4]) {
+    for(int p = 0; p < 6; p++) {
+        const vec4 & plane = planes[p];
+        if(plane.x * sphere[0] + plane.y * sphere[1] + plane.z * sphere[2] + plane.w < -sphere[3]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+GLsizei cpu_cull_objects(const mat4 & view_projection, const cull_object * objects, GLsizei count,
+    std::vector<GLuint> * visible) {
+    vec4 planes[6];
+    mat4_frustum_planes(view_projection, planes);
+    visible->clear();
+    for(GLsizei i = 0; i < count; i++) {
+        if(sphere_in_frustum(planes, objects[i].sphere)) {
+            visible->push_back((GLuint)i);
+        }
+    }
+    return (GLsizei)visible->size();
+}
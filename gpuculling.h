@@ -0,0 +1,72 @@
+#pragma once
+#include <GL/glew.h>
+#include <vector>
+#include "vecmath.h"
+#include "batchrenderer.h"
+
+// GPU-driven drawing of many objects that share a mesh_batch. Per-object
+// bounding spheres and the per-mesh draw ranges live in shader storage
+// buffers; a compute shader frustum-culls every object and writes one
+// DrawElementsIndirectCommand per survivor, and a single
+// glMultiDrawElementsIndirect draws them all. With ARB_indirect_parameters
+// the commands are compacted and the draw count comes from the GPU too;
+// without it every object keeps its slot and culled ones get 0 instances.
+// The object buffer doubles as the per-instance attribute (xyz centre,
+// w radius, the batch renderer's offset/scale convention), selected per draw
+// through base_instance.
+#define CULL_GROUP_SIZE 64
+
+// std430 layouts, mirrored in cull.comp
+struct cull_object {
+    GLfloat sphere[4];
+    GLuint mesh;
+    GLuint pad[3];
+};
+
+struct cull_mesh {
+    GLuint index_count;
+    GLuint first_index;
+    GLint base_vertex;
+    GLuint pad;
+};
+
+struct draw_elements_indirect_command {
+    GLuint count;
+    GLuint instance_count;
+    GLuint first_index;
+    GLint base_vertex;
+    GLuint base_instance;
+};
+
+struct gpu_culler {
+    GLuint program;
+    GLuint objects;
+    GLuint meshes;
+    GLuint commands;
+    GLuint draw_count;
+    GLuint frustum;
+    GLsizei object_count;
+    GLsizei mesh_count;
+    // compacted commands plus glMultiDrawElementsIndirectCount
+    bool compact;
+    unsigned long dispatches;
+    unsigned long draws;
+};
+
+bool gpu_culler_init(gpu_culler * culler, const char * compute_file);
+void gpu_culler_set_meshes(gpu_culler * culler, const mesh_batch * batch);
+void gpu_culler_set_objects(gpu_culler * culler, const cull_object * objects, GLsizei count);
+// points the batch's instance attribute at the object buffer, replacing
+// whatever batch_set_instances uploaded
+void gpu_culler_bind_instances(gpu_culler * culler, mesh_batch * batch);
+void gpu_culler_cull(gpu_culler * culler, const mat4 & view_projection);
+void gpu_culler_draw(gpu_culler * culler, mesh_batch * batch, GLenum mode);
+// reads back the surviving object indices; stalls, for checks only
+GLsizei gpu_culler_read_visible(gpu_culler * culler, std::vector<GLuint> * visible);
+void log_gpu_culler_stats(const gpu_culler * culler);
+void gpu_culler_destroy(gpu_culler * culler);
+
+// the same sphere test on the CPU, for fallbacks and comparisons
+bool sphere_in_frustum(const vec4 planes[6], const GLfloat sphere[4]);
+GLsizei cpu_cull_objects(const mat4 & view_projection, const cull_object * objects, GLsizei count,
+    std::vector<GLuint> * visible);
@@ -0,0 +1,250 @@
+#define GL_CAPTURE_PASSTHROUGH
+#include <GL/glew.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "logging.h"
+#include "frametiming.h"
+#include "headless.h"
+#include "profiler.h"
+#include "glcapture.h"
+
+// frames the CPU may run ahead of the GPU before headless_present() waits
+#define HEADLESS_FRAMES_IN_FLIGHT 2
+
+static EGLDisplay g_display = EGL_NO_DISPLAY;
+static EGLContext g_context = EGL_NO_CONTEXT;
+static EGLSurface g_surface = EGL_NO_SURFACE;
+static GLuint g_fbo = 0;
+static GLuint g_color_rb = 0;
+static GLuint g_depth_rb = 0;
+static GLsync g_fences[HEADLESS_FRAMES_IN_FLIGHT];
+static headless_options g_options;
+static long g_frames = 0;
+static double g_start = 0.0;
+
+bool parse_headless_args(int argc, char ** argv, headless_options * options) {
+    options->enabled = false;
+    options->width = 640;
+    options->height = 480;
+    options->frames = 0;
+    options->duration = 0.0;
+    options->capture_path = NULL;
+    options->debug_context = false;
+    for(int i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "--headless")) {
+            options->enabled = true;
+        } else if(!strcmp(argv[i], "--frames") && i + 1 < argc) {
+            options->frames = atol(argv[++i]);
+        } else if(!strcmp(argv[i], "--duration") && i + 1 < argc) {
+            options->duration = atof(argv[++i]);
+        } else if(!strcmp(argv[i], "--capture") && i + 1 < argc) {
+            options->capture_path = argv[++i];
+        } else if(!strcmp(argv[i], "--size") && i + 1 < argc) {
+            if(sscanf(argv[++i], "%ix%i", &options->width, &options->height) != 2) {
+                fprintf(stderr, "--size expects WIDTHxHEIGHT, got %s\n", argv[i]);
+                return false;
+            }
+        } else {
+            fprintf(stderr, "usage: %s [--headless] [--frames N] [--duration SECONDS] [--size WxH] [--capture FILE]\n", argv[0]);
+            return false;
+        }
+    }
+    if(options->enabled && options->frames <= 0 && options->duration <= 0.0) {
+        options->frames = 1000;
+    }
+    return true;
+}
+
+static bool has_extension(const char * extensions, const char * name) {
+    if(!extensions) {
+        return false;
+    }
+    size_t length = strlen(name);
+    for(const char * p = strstr(extensions, name); p; p = strstr(p + length, name)) {
+        if((p == extensions || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// surfaceless Mesa display first, the default display with a pbuffer otherwise
+static bool open_display(bool * surfaceless) {
+    const char * client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    *surfaceless = false;
+    if(has_extension(client_extensions, "EGL_MESA_platform_surfaceless")) {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if(get_platform_display) {
+            g_display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+            *surfaceless = g_display != EGL_NO_DISPLAY;
+        }
+    }
+    if(g_display == EGL_NO_DISPLAY) {
+        g_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    EGLint major = 0;
+    EGLint minor = 0;
+    if(g_display == EGL_NO_DISPLAY || !eglInitialize(g_display, &major, &minor)) {
+        gl_log_err("ERROR: could not initialize an EGL display (0x%x)\n", eglGetError());
+        return false;
+    }
+    gl_log("EGL: %i.%i %s, %s\n", major, minor, eglQueryString(g_display, EGL_VENDOR),
+        *surfaceless ? "surfaceless" : "pbuffer");
+    return true;
+}
+
+bool headless_init(const headless_options * options) {
+    g_options = *options;
+    bool surfaceless = false;
+    if(!open_display(&surfaceless)) {
+        return false;
+    }
+    if(!eglBindAPI(EGL_OPENGL_API)) {
+        gl_log_err("ERROR: EGL has no desktop OpenGL API\n");
+        return false;
+    }
+    EGLConfig config = NULL;
+    EGLint config_count = 0;
+    EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+        EGL_NONE
+    };
+    bool have_config = eglChooseConfig(g_display, config_attribs, &config, 1, &config_count) && config_count > 0;
+    if(!have_config && !surfaceless) {
+        gl_log_err("ERROR: no EGL pbuffer config for OpenGL\n");
+        return false;
+    }
+    // the drivers hand back the newest core profile compatible with 4.1, so
+    // compute and SSBOs (4.3) are there whenever the driver has them
+    EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 1,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_CONTEXT_OPENGL_DEBUG, options->debug_context ? EGL_TRUE : EGL_FALSE,
+        EGL_NONE
+    };
+    g_context = eglCreateContext(g_display, have_config ? config : (EGLConfig)0, EGL_NO_CONTEXT, context_attribs);
+    if(g_context == EGL_NO_CONTEXT && options->debug_context) {
+        // the debug attribute is EGL 1.5; debug output still works without it
+        gl_log("headless: no EGL debug context (0x%x), using a plain one\n", eglGetError());
+        context_attribs[6] = EGL_NONE;
+        g_context = eglCreateContext(g_display, have_config ? config : (EGLConfig)0, EGL_NO_CONTEXT, context_attribs);
+    }
+    if(g_context == EGL_NO_CONTEXT) {
+        gl_log_err("ERROR: could not create an EGL OpenGL 4.1 core context (0x%x)\n", eglGetError());
+        return false;
+    }
+    if(!surfaceless) {
+        EGLint pbuffer_attribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        g_surface = eglCreatePbufferSurface(g_display, config, pbuffer_attribs);
+    }
+    if(!eglMakeCurrent(g_display, g_surface, g_surface, g_context)) {
+        gl_log_err("ERROR: could not make the EGL context current (0x%x)\n", eglGetError());
+        return false;
+    }
+
+    // GLEW resolves entry points through the loader, which works for an EGL
+    // context too; its GLX-specific init may still report an error here
+    glewExperimental = GL_TRUE;
+    glewInit();
+    glGetError();
+
+    glGenRenderbuffers(1, &g_color_rb);
+    glBindRenderbuffer(GL_RENDERBUFFER, g_color_rb);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, options->width, options->height);
+    glGenRenderbuffers(1, &g_depth_rb);
+    glBindRenderbuffer(GL_RENDERBUFFER, g_depth_rb);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, options->width, options->height);
+    glGenFramebuffers(1, &g_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, g_fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, g_color_rb);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, g_depth_rb);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if(status != GL_FRAMEBUFFER_COMPLETE) {
+        gl_log_err("ERROR: headless framebuffer incomplete (0x%x)\n", status);
+        return false;
+    }
+    memset(g_fences, 0, sizeof(g_fences));
+    g_frames = 0;
+    g_start = frame_timing_seconds();
+    gl_log("headless: %ix%i FBO, %li frames, %.1f s\n", options->width, options->height,
+        options->frames, options->duration);
+    if(options->capture_path) {
+#ifdef GL_CAPTURE
+        // starts after the FBO so the trace holds only what the app does
+        return gl_capture_begin(options->capture_path, options->width, options->height);
+#else
+        gl_log_err("ERROR: --capture needs a build with -DGL_CAPTURE and glcapture.cpp\n");
+        return false;
+#endif
+    }
+    return true;
+}
+
+bool headless_should_close() {
+    if(g_options.frames > 0 && g_frames >= g_options.frames) {
+        return true;
+    }
+    if(g_options.duration > 0.0 && frame_timing_seconds() - g_start >= g_options.duration) {
+        return true;
+    }
+    return false;
+}
+
+void headless_present() {
+#ifdef GL_CAPTURE
+    gl_capture_end_frame();
+#endif
+    // bound the queue like a swap chain would, so frame times reflect GPU throughput
+    int slot = (int)(g_frames % HEADLESS_FRAMES_IN_FLIGHT);
+    if(g_fences[slot]) {
+        PROFILE_ZONE("present_wait");
+        glClientWaitSync(g_fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ULL);
+        glDeleteSync(g_fences[slot]);
+    }
+    g_fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    g_frames++;
+}
+
+void headless_report(const char * name, long triangles_per_frame, long points_per_frame) {
+    glFinish();
+    double elapsed = frame_timing_seconds() - g_start;
+    double p50 = 0.0, p95 = 0.0, p99 = 0.0, max = 0.0;
+    frame_timing_percentiles(&p50, &p95, &p99, &max);
+    double fps = elapsed > 0.0 ? g_frames / elapsed : 0.0;
+    gl_log("\nheadless benchmark %s: %li frames in %.3f s (%ix%i)\n", name, g_frames, elapsed,
+        g_options.width, g_options.height);
+    gl_log("  frames/s:    %.1f\n", fps);
+    gl_log("  triangles/s: %.0f\n", fps * triangles_per_frame);
+    gl_log("  points/s:    %.0f\n", fps * points_per_frame);
+    gl_log("  frame ms:    p50 %.3f  p95 %.3f  p99 %.3f  max %.3f\n", p50, p95, p99, max);
+}
+
+void headless_shutdown() {
+#ifdef GL_CAPTURE
+    gl_capture_end();
+#endif
+    for(int i = 0; i < HEADLESS_FRAMES_IN_FLIGHT; i++) {
+        if(g_fences[i]) {
+            glDeleteSync(g_fences[i]);
+            g_fences[i] = 0;
+        }
+    }
+    glDeleteFramebuffers(1, &g_fbo);
+    glDeleteRenderbuffers(1, &g_color_rb);
+    glDeleteRenderbuffers(1, &g_depth_rb);
+    eglMakeCurrent(g_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if(g_surface != EGL_NO_SURFACE) {
+        eglDestroySurface(g_display, g_surface);
+    }
+    eglDestroyContext(g_display, g_context);
+    eglTerminate(g_display);
+    g_display = EGL_NO_DISPLAY;
+}
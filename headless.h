@@ -0,0 +1,23 @@
+#pragma once
+#include <GL/glew.h>
+
+// Offscreen benchmark mode: an EGL context with no window, rendering into an
+// FBO, running a fixed number of frames or a fixed duration unthrottled.
+// --capture FILE records the run's GL calls for gl-replay (GL_CAPTURE builds).
+struct headless_options {
+    bool enabled;
+    int width;
+    int height;
+    long frames;
+    double duration;
+    const char * capture_path;
+    // set by the caller, e.g. from gl_debug_options
+    bool debug_context;
+};
+
+bool parse_headless_args(int argc, char ** argv, headless_options * options);
+bool headless_init(const headless_options * options);
+bool headless_should_close();
+void headless_present();
+void headless_report(const char * name, long triangles_per_frame, long points_per_frame);
+void headless_shutdown();
@@ -1,11 +1,24 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <stdio.h>
-#include <unistd.h>
-#include <fstream>
 #include <string>
 #include <iostream>
 #include "logging.h"
+#include "frametiming.h"
+#include "framepacing.h"
+#include "headless.h"
+#include "batchrenderer.h"
+#include "glstate.h"
+#include "shadermanager.h"
+#include "vecmath.h"
+#include "renderqueue.h"
+#include "jobsystem.h"
+#include "resourcepool.h"
+#include "alloccounter.h"
+#include "framecapture.h"
+#include "gldebug.h"
+#include "profiler.h"
+#include "glcapture.h"
 
 // window
 int g_window_width = 640;
@@ -26,54 +39,104 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     g_fb_height = height;
 }
 
-void read_file(const char * file, std::string & content) {
-    std::ifstream ifs(file);
-    std::string line;
-    while(std::getline(ifs, line)) {
-        content += line + "\n";
-    }
-}
-
 void error_callback(int error, const char* description) {
     gl_log_err("GLFW ERROR: code %i msg: %s\n", error, description);
 }
 
-int main() {
+struct scene_recording {
+    render_queue * queue;
+    GLuint program;
+    const mesh_batch * batch;
+    int points_mesh;
+    int triangle_mesh;
+};
+
+// scene code only records; the queue sorts and issues the GL calls
+void record_scene(render_queue * queue, GLuint program, const mesh_batch * batch, int points_mesh, int triangle_mesh) {
+    render_command * c = render_queue_record(queue);
+    c->key = render_sort_key(0, program, batch->vao.get(), 0.5f);
+    c->program = program;
+    c->vao = batch->vao.get();
+    c->mode = GL_POINTS;
+    c->first = batch->meshes[points_mesh].first_vertex;
+    c->count = batch->meshes[points_mesh].vertex_count;
+    c->point_size = 40.0f;
+    c = render_queue_record(queue);
+    c->key = render_sort_key(0, program, batch->vao.get(), 0.5f);
+    c->program = program;
+    c->vao = batch->vao.get();
+    c->mode = GL_TRIANGLES;
+    c->first = batch->meshes[triangle_mesh].first_vertex;
+    c->count = batch->meshes[triangle_mesh].vertex_count;
+}
+
+int main(int argc, char ** argv) {
+    frame_pacing_options pacing;
+    if(!parse_frame_pacing_args(&argc, argv, &pacing)) {
+        return 1;
+    }
+    frame_capture_options capture;
+    if(!parse_frame_capture_args(&argc, argv, &capture)) {
+        return 1;
+    }
+    gl_debug_options debug;
+    if(!parse_gl_debug_args(&argc, argv, &debug)) {
+        return 1;
+    }
+    headless_options headless;
+    if(!parse_headless_args(argc, argv, &headless)) {
+        return 1;
+    }
+    headless.debug_context = debug.enabled;
     if(!restart_gl_log()) {
         fprintf(stderr, "Failed to open log file\n");
         return 1;
     }
-    gl_log("Starting GLFW: %s\n", glfwGetVersionString());
-    glfwSetErrorCallback(error_callback);
-    if(!glfwInit()) {
-        fprintf(stderr, "Failed to initialize GLFW3\n");
-        return 2;
-    }
+    GLFWwindow* window = NULL;
+    if(headless.enabled) {
+        // no display or monitor needed: EGL context rendering into an FBO
+        if(!headless_init(&headless)) {
+            return 2;
+        }
+        g_window_width = g_fb_width = headless.width;
+        g_window_height = g_fb_height = headless.height;
+    } else {
+        gl_log("Starting GLFW: %s\n", glfwGetVersionString());
+        glfwSetErrorCallback(error_callback);
+        if(!glfwInit()) {
+            fprintf(stderr, "Failed to initialize GLFW3\n");
+            return 2;
+        }
 
-    glfwWindowHint(GLFW_SAMPLES, 4);
-    GLFWmonitor* monitor = glfwGetPrimaryMonitor();
-    const GLFWvidmode* vmode = glfwGetVideoMode(monitor);
-    // GLFWwindow* window = glfwCreateWindow(vmode->width, vmode->height, "Extended GL Init", monitor, NULL);
-    GLFWwindow* window = glfwCreateWindow(vmode->width, vmode->height, "HelloWindow", NULL, NULL);
-    if(!window){
-        fprintf(stderr, "Failed to open GLFW3 window\n");
-        glfwTerminate();
-        return 3;
-    }
-    glfwSetWindowSizeCallback(window, window_size_callback);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwMakeContextCurrent(window);
+        glfwWindowHint(GLFW_SAMPLES, 4);
+        gl_debug_context_hints(&debug);
+        GLFWmonitor* monitor = glfwGetPrimaryMonitor();
+        const GLFWvidmode* vmode = glfwGetVideoMode(monitor);
+        // GLFWwindow* window = glfwCreateWindow(vmode->width, vmode->height, "Extended GL Init", monitor, NULL);
+        window = glfwCreateWindow(vmode->width, vmode->height, "HelloWindow", NULL, NULL);
+        if(!window){
+            fprintf(stderr, "Failed to open GLFW3 window\n");
+            glfwTerminate();
+            return 3;
+        }
+        glfwSetWindowSizeCallback(window, window_size_callback);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwMakeContextCurrent(window);
 
-    glewExperimental = true;
-    glewInit();
+        glewExperimental = true;
+        glewInit();
+    }
 
     const GLubyte* renderer = glGetString(GL_RENDERER);
     const GLubyte* version = glGetString(GL_VERSION);
     printf("Renderer: %s\n", renderer);
     printf("OpenGL version supported %s\n", version);
     log_gl_params();
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LESS);
+    // driver messages from here on, first occurrences logged as they arrive
+    gl_debug_init(&debug);
+    gl_state_reset();
+    gl_state_enable(GL_DEPTH_TEST, true);
+    gl_state_depth_func(GL_LESS);
 
     /* Other stuff goes here*/
     float size = 0.2;
@@ -89,83 +152,114 @@ int main() {
         -size + offset, -size, 0.0f,
     };
 
-    // points
-    GLuint vbo = 0;
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(points), points, GL_STATIC_DRAW);
-
-    GLuint vao = 0;
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
-    glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-
-    // points2
-    GLuint vbo2 = 0;
-    glGenBuffers(1, &vbo2);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo2);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(points2), points2, GL_STATIC_DRAW);
-
-    GLuint vao2 = 0;
-    glGenVertexArrays(1, &vao2);
-    glBindVertexArray(vao2);
-    glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo2);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-
-    std::string vertex_shader_file;
-    read_file("./hello-triangle..vert", vertex_shader_file);
-    const char * vertex_shader = vertex_shader_file.c_str();
-
-    std::string fragment_shader_file;
-    read_file("./hello-triangle..frag", fragment_shader_file);
-    const char * fragment_shader = fragment_shader_file.c_str();
-    
-    GLuint vs = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vs, 1, &vertex_shader, NULL);
-    glCompileShader(vs);
-
-    GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fs, 1, &fragment_shader, NULL);
-    glCompileShader(fs);
-
-    GLuint shader_programme = glCreateProgram();
-    glAttachShader(shader_programme, fs);
-    glAttachShader(shader_programme, vs);
-    glLinkProgram(shader_programme);
+    // both objects share one vertex buffer and VAO
+    mesh_batch batch;
+    batch_init(&batch);
+    int points_mesh = batch_add_mesh(&batch, points, 3, NULL, 0);
+    int triangle_mesh = batch_add_mesh(&batch, points2, 3, NULL, 0);
+    batch_upload(&batch);
+
+    // compile and link failures are logged with the driver's info log
+    gl_handle program(GL_RESOURCE_PROGRAM, build_shader_program("./hello-triangle.vert", "./hello-triangle.frag"));
+    GLuint shader_programme = program.get();
+    if(!shader_programme) {
+        return 4;
+    }
+    // the offset used to be hard-coded in the vertex shader
+    if(!set_uniform_mat4(shader_programme, "model", mat4_translate(-0.3f, 0.3f, 0.0f))) {
+        return 5;
+    }
 
+    // frame N+1 is recorded on the job system while frame N is submitted
+    job_system_init(0);
+    render_queue queues[2];
+    render_queue_init(&queues[0]);
+    render_queue_init(&queues[1]);
+    record_scene(&queues[0], shader_programme, &batch, points_mesh, triangle_mesh);
+    long frame = 0;
+
+    frame_timing_init();
+    frame_timing_set_dump("frametimes.csv", "frametimes.json", 5.0);
+    frame_pacing_init(window, &pacing);
+    // a no-op unless built with -DGL_PROFILE
+    profiler_init("profile-trace.json");
+    if(!frame_capture_init(&capture, g_fb_width, g_fb_height)) {
+        return 9;
+    }
     glClearColor(0.6f, 0.6f, 0.8f, 1.0f);
-    while(!glfwWindowShouldClose(window)) {
-        // _update_fps_counter(window);
+    while(headless.enabled ? !headless_should_close() : !glfwWindowShouldClose(window)) {
+        // sleeps until the frame is due, then polls input
+        frame_pacing_begin_frame();
+        frame_timing_begin_frame();
+        // after warm-up the loop is expected to run without touching the heap
+        alloc_counter_set_steady(frame >= 60);
+        alloc_counter_begin_frame();
+        if(window) {
+            frame_timing_update_title(window);
+        }
+        frame_timing_begin_pass("scene");
         // wipe the drawing surface clear
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glViewport(0, 0, g_fb_width, g_fb_height);
-
-        glUseProgram(shader_programme);
-        
-        // draw points 0-3 from the currently bound VAO with current in-use shader
-        glBindVertexArray(vao);
-        // glDrawArrays(GL_TRIANGLES, 0, 3);
-        glPointSize(40.0f);
-        glDrawArrays(GL_POINTS, 0, 3);
-
-        glBindVertexArray(vao2);
-        glDrawArrays(GL_TRIANGLES, 0, 3);
-
-        // update other events like input handling
-        glfwPollEvents();
-        
-        // put the stuff we've been drawing onto the display
-        glfwSwapBuffers(window);
-        // usleep(10000);
-        if(GLFW_PRESS == glfwGetKey(window, GLFW_KEY_ESCAPE)) {
+        gl_state_viewport(0, 0, g_fb_width, g_fb_height);
+
+        job_counter recorded;
+        job_counter_init(&recorded);
+        // one captured pointer fits std::function's inline storage, so no allocation
+        scene_recording recording = { &queues[(frame + 1) & 1], shader_programme, &batch, points_mesh, triangle_mesh };
+        job_run([&recording]() {
+            record_scene(recording.queue, recording.program, recording.batch, recording.points_mesh,
+                recording.triangle_mesh);
+        }, &recorded);
+        render_queue_submit(&queues[frame & 1]);
+        frame_timing_end_pass();
+        gl_state_end_frame();
+        job_wait(&recorded);
+        frame++;
+        frame_capture_frame(g_fb_width, g_fb_height);
+
+        // put the stuff we've been drawing onto the display; the pacer swaps
+        // the window's buffers, headless runs resolve their FBO
+        if(headless.enabled) {
+            headless_present();
+        }
+        frame_pacing_end_frame();
+        gl_debug_end_frame();
+        alloc_counter_end_frame();
+        PROFILE_FRAME();
+        if(!headless.enabled && GLFW_PRESS == glfwGetKey(window, GLFW_KEY_ESCAPE)) {
             glfwSetWindowShouldClose(window, 1);
         }
     }
 
-
+    if(headless.enabled) {
+        headless_report("hello-triangle", 1, 3);
+    }
+    log_frame_pacing_stats();
+    log_job_system_stats();
+    job_system_shutdown();
+    log_render_queue_stats(&queues[0]);
+    log_render_queue_stats(&queues[1]);
+    render_queue_destroy(&queues[0]);
+    render_queue_destroy(&queues[1]);
+    log_gl_state_stats();
+    log_alloc_counter_stats();
+    batch_destroy(&batch);
+    program.reset();
+    log_gl_resource_stats();
+    log_gl_debug_stats();
+    gl_debug_shutdown();
+    bool captured = frame_capture_shutdown();
+    log_frame_capture_stats();
+    profiler_shutdown();
+    frame_timing_shutdown();
+    if(headless.enabled) {
+        headless_shutdown();
+        // benchmark runs double as the zero-allocation check
+        if(alloc_counter_steady_violations()) {
+            return 8;
+        }
+        return captured ? 0 : 9;
+    }
     glfwTerminate();
-    return 0;
+    return captured ? 0 : 9;
 }
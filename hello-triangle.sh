@@ -1,7 +1,7 @@
 set -e
-g++ hello-triangle.cpp ../glew/lib/libGLEW.a ../glfw/build/src/libglfw3.a \
+g++ hello-triangle.cpp framepacing.cpp resourcepool.cpp alloccounter.cpp framecapture.cpp gldebug.cpp renderqueue.cpp jobsystem.cpp vecmath.cpp batchrenderer.cpp assetloader.cpp frametiming.cpp headless.cpp vertexformat.cpp glstate.cpp shadermanager.cpp programcache.cpp logging.cpp \
+    ../glew/lib/libGLEW.a ../glfw/build/src/libglfw3.a \
     -I ../glfw/include -I ../glew/include/ \
-    -lGL -lX11 -lGLU \
+    -lGL -lEGL -lX11 -lGLU -pthread \
     -o hello-triangle
 ./hello-triangle
- 
\ No newline at end of file
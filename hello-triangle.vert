@@ -1,6 +1,7 @@
 #version 410
 
 in vec3 vp;
+uniform mat4 model;
 void main() {
-    gl_Position = vec4(vp.x -0.3, vp.y + 0.3, vp.z, 1.0);
+    gl_Position = model * vec4(vp, 1.0);
 };
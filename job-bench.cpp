@@ -0,0 +1,158 @@
+#include <GL/glew.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include "logging.h"
+#include "shadermanager.h"
+#include "frametiming.h"
+#include "headless.h"
+#include "streambuffer.h"
+#include "glstate.h"
+#include "jobsystem.h"
+#include "glcapture.h"
+
+// Job system benchmark: the hello-triangle points scaled up to millions,
+// animated every frame with a parallel-for. Simulation of frame N+1 runs on
+// the pool while the main thread streams and draws frame N, for 1..N threads.
+
+static int g_frames = 30;
+
+static void simulate(const GLfloat * base, GLfloat * out, size_t first, size_t last, float t) {
+    for(size_t i = first; i < last; i++) {
+        const GLfloat * p = base + i * 3;
+        GLfloat * q = out + i * 3;
+        float phase = p[0] * 7.0f + p[1] * 11.0f;
+        q[0] = p[0] + 0.01f * sinf(t * 2.0f + phase);
+        q[1] = p[1] + 0.01f * cosf(t * 3.0f + phase);
+        q[2] = p[2];
+    }
+}
+
+static void bench(int threads, size_t points, const GLfloat * base, std::vector<GLfloat> * frames,
+        stream_buffer * stream, GLuint vao, double * serial_ms) {
+    job_system_init(threads);
+    // simulation alone, to separate CPU scaling from GL submission
+    std::vector<double> sim_times;
+    for(int i = 0; i < g_frames; i++) {
+        double start = frame_timing_seconds();
+        job_counter done;
+        job_counter_init(&done);
+        GLfloat * out = frames[0].data();
+        job_parallel_for(0, points, 0, [=](size_t first, size_t last) {
+            simulate(base, out, first, last, i * 0.016f);
+        }, &done);
+        job_wait(&done);
+        sim_times.push_back((frame_timing_seconds() - start) * 1000.0);
+    }
+
+    // pipelined: frame N+1 simulates while frame N is submitted
+    std::vector<double> frame_times;
+    job_counter simulated;
+    job_counter_init(&simulated);
+    simulate(base, frames[0].data(), 0, points, 0.0f);
+    for(int frame = 0; frame < g_frames + 3; frame++) {
+        double start = frame_timing_seconds();
+        GLfloat * next = frames[(frame + 1) & 1].data();
+        job_parallel_for(0, points, 0, [=](size_t first, size_t last) {
+            simulate(base, next, first, last, (frame + 1) * 0.016f);
+        }, &simulated);
+
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        stream_allocation allocation;
+        if(!stream_buffer_alloc(stream, points * 3 * sizeof(GLfloat), sizeof(GLfloat), &allocation)) {
+            break;
+        }
+        memcpy(allocation.data, frames[frame & 1].data(), points * 3 * sizeof(GLfloat));
+        stream_buffer_commit(stream, &allocation);
+        stream_buffer_vertex_attrib(&allocation, vao, 0, 3, GL_FLOAT, 0);
+        gl_state_bind_vertex_array(vao);
+        glDrawArrays(GL_POINTS, 0, (GLsizei)points);
+        stream_buffer_end_frame(stream);
+        headless_present();
+
+        // the main thread helps with whatever simulation is left
+        job_wait(&simulated);
+        if(frame >= 3) {
+            frame_times.push_back((frame_timing_seconds() - start) * 1000.0);
+        }
+    }
+    glFinish();
+    std::sort(sim_times.begin(), sim_times.end());
+    std::sort(frame_times.begin(), frame_times.end());
+    double sim_ms = sim_times[sim_times.size() / 2];
+    double frame_ms = frame_times[frame_times.size() / 2];
+    if(threads == 1) {
+        *serial_ms = sim_ms;
+    }
+    gl_log("  %9zu %8i %10.3f %8.2fx %10.3f %14.0f\n", points, threads, sim_ms,
+        sim_ms > 0.0 ? *serial_ms / sim_ms : 0.0, frame_ms, points / (frame_ms / 1000.0));
+    log_job_system_stats();
+    job_system_shutdown();
+}
+
+int main(int argc, char ** argv) {
+    headless_options options;
+    if(!parse_headless_args(argc, argv, &options)) {
+        return 1;
+    }
+    options.enabled = true;
+    if(options.frames > 0) {
+        g_frames = (int)options.frames;
+    }
+    if(!restart_gl_log()) {
+        fprintf(stderr, "Failed to open log file\n");
+        return 1;
+    }
+    gl_log_set_level(GL_LOG_WARN);
+    if(!headless_init(&options)) {
+        return 2;
+    }
+    gl_state_viewport(0, 0, options.width, options.height);
+    GLuint program = build_shader_program("./batch.vert", "./batch.frag");
+    if(!program) {
+        return 3;
+    }
+    gl_state_use_program(program);
+    set_uniform_vec4(program, "input_color", 0.0f, 0.0f, 1.0f, 1.0f);
+    glClearColor(0.6f, 0.6f, 0.8f, 1.0f);
+    GLuint vao = 0;
+    glGenVertexArrays(1, &vao);
+
+    size_t max_points = 4000000;
+    stream_buffer stream;
+    if(!stream_buffer_init(&stream, GL_ARRAY_BUFFER, max_points * 3 * sizeof(GLfloat))) {
+        return 4;
+    }
+    std::vector<GLfloat> base(max_points * 3);
+    int side = (int)ceil(sqrt((double)max_points));
+    for(size_t i = 0; i < max_points; i++) {
+        base[i * 3 + 0] = -1.0f + 2.0f * (i % side) / side;
+        base[i * 3 + 1] = -1.0f + 2.0f * (i / side) / side;
+        base[i * 3 + 2] = 0.0f;
+    }
+    std::vector<GLfloat> frames[2];
+    frames[0].resize(max_points * 3);
+    frames[1].resize(max_points * 3);
+    gl_log_set_level(GL_LOG_INFO);
+
+    int max_threads = std::max(4, (int)std::thread::hardware_concurrency());
+    gl_log("\njob-bench: %s, %i frames per case, %u hardware threads\n", glGetString(GL_RENDERER), g_frames,
+        std::thread::hardware_concurrency());
+    gl_log("  %9s %8s %10s %9s %10s %14s\n", "points", "threads", "sim ms", "speedup", "frame ms", "points/s");
+    size_t counts[] = { 1000000, 4000000 };
+    for(int c = 0; c < 2; c++) {
+        double serial_ms = 0.0;
+        for(int threads = 1; threads <= max_threads; threads *= 2) {
+            bench(threads, counts[c], base.data(), frames, &stream, vao, &serial_ms);
+        }
+    }
+
+    log_stream_buffer_stats(&stream);
+    stream_buffer_destroy(&stream);
+    gl_state_delete_vertex_arrays(1, &vao);
+    headless_shutdown();
+    return 0;
+}
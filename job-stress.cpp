@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <new>
+#include "logging.h"
+#include "frametiming.h"
+#include "jobsystem.h"
+
+// Job system stress test: the pattern hello-triangle and job-bench use every
+// frame, a job_counter on the stack that is waited on and then goes out of
+// scope, repeated many times with continuations in the mix. The counter's
+// storage is scribbled over as soon as job_wait returns, so a worker still
+// touching it shows up as a hang, a crash or a wrong total; build with
+// -fsanitize=thread to have the race reported directly.
+//   job-stress [--iterations N] [--threads N]
+
+#define JOB_STRESS_JOBS 16
+
+static bool parse_stress_args(int * argc, char ** argv, int * iterations, int * threads) {
+    *iterations = 20000;
+    *threads = 0;
+    int kept = 1;
+    for(int i = 1; i < *argc; i++) {
+        if(!strcmp(argv[i], "--iterations") && i + 1 < *argc) {
+            *iterations = atoi(argv[++i]);
+        } else if(!strcmp(argv[i], "--threads") && i + 1 < *argc) {
+            *threads = atoi(argv[++i]);
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    *argc = kept;
+    argv[kept] = NULL;
+    if(*iterations <= 0 || *threads < 0) {
+        fprintf(stderr, "--iterations expects a positive number and --threads zero or more\n");
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char ** argv) {
+    int iterations = 0;
+    int threads = 0;
+    if(!parse_stress_args(&argc, argv, &iterations, &threads)) {
+        return 1;
+    }
+    if(!restart_gl_log()) {
+        fprintf(stderr, "Failed to open log file\n");
+        return 1;
+    }
+    job_system_init(threads);
+    std::atomic<long> ran(0);
+    long expected = 0;
+    double start = frame_timing_seconds();
+    for(int i = 0; i < iterations; i++) {
+        alignas(job_counter) unsigned char storage[sizeof(job_counter)];
+        job_counter * done = new(storage) job_counter();
+        job_counter_init(done);
+        job_counter * first = done;
+        alignas(job_counter) unsigned char first_storage[sizeof(job_counter)];
+        // every other iteration, half the jobs only start once the rest are done
+        if(i & 1) {
+            first = new(first_storage) job_counter();
+            job_counter_init(first);
+        }
+        for(int j = 0; j < JOB_STRESS_JOBS / 2; j++) {
+            job_run([&ran]() { ran++; }, first);
+        }
+        for(int j = 0; j < JOB_STRESS_JOBS / 2; j++) {
+            if(first != done) {
+                job_run_after(first, [&ran]() { ran++; }, done);
+            } else {
+                job_run([&ran]() { ran++; }, done);
+            }
+        }
+        expected += JOB_STRESS_JOBS;
+        if(first != done) {
+            job_wait(first);
+            first->~job_counter();
+            memset(first_storage, 0xdd, sizeof(first_storage));
+        }
+        job_wait(done);
+        done->~job_counter();
+        memset(storage, 0xdd, sizeof(storage));
+        if(ran.load() != expected) {
+            gl_log_err("ERROR: job-stress iteration %i: %li jobs ran, %li expected\n", i, ran.load(), expected);
+            job_system_shutdown();
+            return 2;
+        }
+    }
+    double seconds = frame_timing_seconds() - start;
+    gl_log("job-stress: %i iterations of %i jobs on %i threads, %.1f us per wait\n", iterations, JOB_STRESS_JOBS,
+        job_system_threads(), seconds * 1e6 / iterations);
+    log_job_system_stats();
+    job_system_shutdown();
+    return 0;
+}
@@ -0,0 +1,8 @@
+set -e
+# add -fsanitize=thread -g to have a race on the counters reported by TSAN
+g++ job-stress.cpp jobsystem.cpp frametiming.cpp logging.cpp \
+    ../glew/lib/libGLEW.a ../glfw/build/src/libglfw3.a \
+    -I ../glfw/include -I ../glew/include/ \
+    -lGL -lEGL -lX11 -lGLU -pthread \
+    -o job-stress
+./job-stress
@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <thread>
+#include <deque>
+#include <condition_variable>
+#include "logging.h"
+#include "jobsystem.h"
+#include "profiler.h"
+
+struct job_deque {
+    std::mutex mutex;
+    std::deque<job> jobs;
+};
+
+static std::vector<job_deque *> g_deques;
+static std::vector<std::thread> g_threads;
+static std::atomic<bool> g_running(false);
+// jobs sitting in any deque; idle workers sleep while it is zero
+static std::atomic<int> g_queued(0);
+static std::mutex g_sleep_mutex;
+static std::condition_variable g_sleep_cv;
+
+static std::mutex g_main_mutex;
+static std::vector<std::function<void()> > g_main_jobs;
+
+static std::atomic<unsigned long> g_executed(0);
+static std::atomic<unsigned long> g_stolen(0);
+
+// index of the calling thread's deque; -1 for threads outside the pool,
+// which push to and pop from the main thread's deque
+static thread_local int t_worker = -1;
+
+static job_deque * own_deque() {
+    return g_deques[t_worker > 0 ? t_worker : 0];
+}
+
+// jobs are moved, never copied: copying a std::function can allocate
+static void push(job && j) {
+    job_deque * d = own_deque();
+    {
+        std::lock_guard<std::mutex> lock(d->mutex);
+        d->jobs.push_back(std::move(j));
+    }
+    g_queued++;
+    {
+        // a worker between its empty check and its wait holds this lock
+        std::lock_guard<std::mutex> lock(g_sleep_mutex);
+    }
+    g_sleep_cv.notify_one();
+}
+
+static bool pop_or_steal(job * out) {
+    job_deque * own = own_deque();
+    {
+        std::lock_guard<std::mutex> lock(own->mutex);
+        if(!own->jobs.empty()) {
+            *out = std::move(own->jobs.back());
+            own->jobs.pop_back();
+            g_queued--;
+            return true;
+        }
+    }
+    int count = (int)g_deques.size();
+    int self = t_worker > 0 ? t_worker : 0;
+    for(int i = 1; i < count; i++) {
+        job_deque * victim = g_deques[(self + i) % count];
+        std::lock_guard<std::mutex> lock(victim->mutex);
+        if(!victim->jobs.empty()) {
+            *out = std::move(victim->jobs.front());
+            victim->jobs.pop_front();
+            g_queued--;
+            g_stolen++;
+            return true;
+        }
+    }
+    return false;
+}
+
+// the decrement and the swap happen under the counter's mutex, and job_wait
+// takes that mutex before returning: once pending reads zero the waiter may
+// destroy the counter, so nothing here touches it after the unlock
+static void finish(job_counter * counter) {
+    if(!counter) {
+        return;
+    }
+    std::vector<job> released;
+    {
+        std::lock_guard<std::mutex> lock(counter->mutex);
+        if(counter->pending.fetch_sub(1) != 1) {
+            return;
+        }
+        released.swap(counter->continuations);
+    }
+    for(size_t i = 0; i < released.size(); i++) {
+        push(std::move(released[i]));
+    }
+}
+
+static void execute(job & j) {
+    PROFILE_ZONE("job");
+    j.fn();
+    g_executed++;
+    finish(j.counter);
+}
+
+static void worker_main(int index) {
+    t_worker = index;
+    char name[32];
+    snprintf(name, sizeof(name), "worker %i", index);
+    profiler_set_thread_name(name);
+    while(g_running) {
+        job j;
+        if(pop_or_steal(&j)) {
+            execute(j);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(g_sleep_mutex);
+        g_sleep_cv.wait(lock, []() { return g_queued > 0 || !g_running; });
+    }
+}
+
+bool job_system_init(int threads) {
+    if(g_running) {
+        job_system_shutdown();
+    }
+    if(threads <= 0) {
+        threads = (int)std::thread::hardware_concurrency();
+    }
+    if(threads <= 0) {
+        threads = 1;
+    }
+    t_worker = 0;
+    g_running = true;
+    g_queued = 0;
+    g_executed = 0;
+    g_stolen = 0;
+    for(int i = 0; i < threads; i++) {
+        g_deques.push_back(new job_deque());
+    }
+    // the main thread is worker 0 and helps whenever it waits
+    for(int i = 1; i < threads; i++) {
+        g_threads.push_back(std::thread(worker_main, i));
+    }
+    gl_log("job system: %i threads\n", threads);
+    return true;
+}
+
+int job_system_threads() {
+    return (int)g_deques.size();
+}
+
+void job_counter_init(job_counter * counter) {
+    counter->pending = 0;
+    counter->continuations.clear();
+}
+
+bool job_done(job_counter * counter) {
+    return counter->pending.load() == 0;
+}
+
+void job_run(std::function<void()> fn, job_counter * counter) {
+    if(counter) {
+        counter->pending++;
+    }
+    job j = { std::move(fn), counter };
+    if(g_deques.empty()) {
+        // no pool: run inline so callers work before init and after shutdown
+        execute(j);
+        return;
+    }
+    push(std::move(j));
+}
+
+void job_run_after(job_counter * dependency, std::function<void()> fn, job_counter * counter) {
+    if(counter) {
+        counter->pending++;
+    }
+    job j = { std::move(fn), counter };
+    {
+        std::lock_guard<std::mutex> lock(dependency->mutex);
+        if(dependency->pending > 0) {
+            dependency->continuations.push_back(std::move(j));
+            return;
+        }
+    }
+    if(g_deques.empty()) {
+        execute(j);
+        return;
+    }
+    push(std::move(j));
+}
+
+void job_parallel_for(size_t begin, size_t end, size_t grain,
+        std::function<void(size_t, size_t)> fn, job_counter * counter) {
+    if(grain == 0) {
+        // a few chunks per thread so stealing can even out the load
+        size_t chunks = g_deques.empty() ? 1 : g_deques.size() * 4;
+        grain = (end - begin + chunks - 1) / chunks;
+        if(grain == 0) {
+            grain = 1;
+        }
+    }
+    for(size_t first = begin; first < end; first += grain) {
+        size_t last = first + grain < end ? first + grain : end;
+        job_run([fn, first, last]() { fn(first, last); }, counter);
+    }
+}
+
+void job_wait(job_counter * counter) {
+    while(counter->pending > 0) {
+        job j;
+        if(!g_deques.empty() && pop_or_steal(&j)) {
+            execute(j);
+            continue;
+        }
+        // a job may be blocked on GL work only the main thread can run
+        if(t_worker != 0 || job_drain_main() == 0) {
+            std::this_thread::yield();
+        }
+    }
+    // the last finish() may still hold the mutex; once it is released the counter is the caller's to destroy
+    std::lock_guard<std::mutex> lock(counter->mutex);
+}
+
+void job_run_on_main(std::function<void()> fn) {
+    std::lock_guard<std::mutex> lock(g_main_mutex);
+    g_main_jobs.push_back(fn);
+}
+
+int job_drain_main() {
+    std::vector<std::function<void()> > jobs;
+    {
+        std::lock_guard<std::mutex> lock(g_main_mutex);
+        jobs.swap(g_main_jobs);
+    }
+    for(size_t i = 0; i < jobs.size(); i++) {
+        jobs[i]();
+    }
+    return (int)jobs.size();
+}
+
+void log_job_system_stats() {
+    gl_log("job system: %lu jobs executed, %lu stolen, %i threads\n",
+        g_executed.load(), g_stolen.load(), job_system_threads());
+}
+
+void job_system_shutdown() {
+    job j;
+    while(!g_deques.empty() && pop_or_steal(&j)) {
+        execute(j);
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_sleep_mutex);
+        g_running = false;
+    }
+    g_sleep_cv.notify_all();
+    for(size_t i = 0; i < g_threads.size(); i++) {
+        g_threads[i].join();
+    }
+    g_threads.clear();
+    // anything the workers released while stopping still runs, on this thread
+    while(!g_deques.empty() && pop_or_steal(&j)) {
+        execute(j);
+    }
+    for(size_t i = 0; i < g_deques.size(); i++) {
+        delete g_deques[i];
+    }
+    g_deques.clear();
+    g_queued = 0;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// Work-stealing job scheduler. Every worker thread, and the main thread as
+// worker 0, owns a deque: it pushes and pops at the back, idle workers steal
+// from the front of the others. Completion is tracked with counters; a job
+// can be held back until another counter reaches zero. GL calls go through
+// the main-thread queue, which only the thread owning the context drains.
+// A counter may live on the stack: it can be destroyed as soon as job_wait()
+// on it returns.
+struct job_counter;
+
+struct job {
+    std::function<void()> fn;
+    job_counter * counter;
+};
+
+struct job_counter {
+    std::atomic<int> pending;
+    std::mutex mutex;
+    // jobs released when pending drops to zero
+    std::vector<job> continuations;
+};
+
+bool job_system_init(int threads);
+int job_system_threads();
+void job_counter_init(job_counter * counter);
+bool job_done(job_counter * counter);
+void job_run(std::function<void()> fn, job_counter * counter);
+void job_run_after(job_counter * dependency, std::function<void()> fn, job_counter * counter);
+void job_parallel_for(size_t begin, size_t end, size_t grain,
+    std::function<void(size_t, size_t)> fn, job_counter * counter);
+void job_wait(job_counter * counter);
+void job_run_on_main(std::function<void()> fn);
+int job_drain_main();
+void log_job_system_stats();
+void job_system_shutdown();
@@ -2,10 +2,216 @@
 #include <GLFW/glfw3.h>
 #include <time.h>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include "logging.h"
 #define GL_LOG_FILE "gl.log"
 
+// Callers format straight into a slot of a bounded MPSC ring (Vyukov style
+// sequence numbers, no locks on the producer side); a writer thread drains
+// it in batches and owns the only FILE handle to gl.log.
+#define GL_LOG_SLOTS 1024
+#define GL_LOG_SLOT_SIZE 512
+#define GL_LOG_FLUSH_MS 5
+
+struct log_slot {
+    std::atomic<size_t> sequence;
+    int level;
+    char text[GL_LOG_SLOT_SIZE];
+};
+
+static log_slot g_log_ring[GL_LOG_SLOTS];
+static std::atomic<size_t> g_log_tail(0);
+static std::atomic<size_t> g_log_head(0);
+static std::atomic<int> g_log_level(GL_LOG_INFO);
+static std::atomic<int> g_log_overflow(GL_LOG_OVERFLOW_BLOCK);
+static std::atomic<unsigned long> g_log_dropped(0);
+static std::atomic<bool> g_log_running(false);
+static std::atomic<bool> g_log_stop(false);
+static std::thread g_log_writer;
+static std::mutex g_log_mutex;
+static std::condition_variable g_log_wake;
+static FILE * g_log_file = NULL;
+
+static void write_message(int level, const char * text) {
+    fputs(text, g_log_file);
+    fputs(text, level >= GL_LOG_ERROR ? stderr : stdout);
+}
+
+// drains everything published so far, returns the number of messages written
+static int drain_ring() {
+    int written = 0;
+    size_t head = g_log_head.load(std::memory_order_relaxed);
+    for(;;) {
+        log_slot & slot = g_log_ring[head & (GL_LOG_SLOTS - 1)];
+        if(slot.sequence.load(std::memory_order_acquire) != head + 1) {
+            break;
+        }
+        write_message(slot.level, slot.text);
+        slot.sequence.store(head + GL_LOG_SLOTS, std::memory_order_release);
+        head++;
+        written++;
+    }
+    g_log_head.store(head, std::memory_order_release);
+    return written;
+}
+
+static void log_writer_main() {
+    unsigned long reported_drops = 0;
+    for(;;) {
+        bool stopping = g_log_stop.load(std::memory_order_acquire);
+        int written = drain_ring();
+        unsigned long drops = g_log_dropped.load(std::memory_order_relaxed);
+        if(drops != reported_drops) {
+            fprintf(g_log_file, "gl_log: dropped %lu messages (ring full)\n", drops - reported_drops);
+            reported_drops = drops;
+            written++;
+        }
+        if(written > 0) {
+            fflush(g_log_file);
+            fflush(stdout);
+        }
+        if(stopping) {
+            break;
+        }
+        std::unique_lock<std::mutex> lock(g_log_mutex);
+        g_log_wake.wait_for(lock, std::chrono::milliseconds(GL_LOG_FLUSH_MS));
+    }
+}
+
+static void wake_writer() {
+    g_log_wake.notify_one();
+}
+
+// used before restart_gl_log() has started the writer, and after shutdown
+static bool log_sync(int level, const char * message, va_list argptr) {
+    FILE * file = fopen(GL_LOG_FILE, "a");
+    if (!file) {
+        fprintf(stderr, "ERROR: could not open GL_LOG_FILE %s file for appending\n", GL_LOG_FILE);
+        return false;
+    }
+    va_list copy;
+    va_copy(copy, argptr);
+    vfprintf(file, message, argptr);
+    vfprintf(level >= GL_LOG_ERROR ? stderr : stdout, message, copy);
+    va_end(copy);
+    fclose(file);
+    return true;
+}
+
+// a message longer than a slot is split across consecutive slots, claimed
+// together so other producers cannot interleave with it
+static bool log_async(int level, const char * message, va_list argptr) {
+    char local[GL_LOG_SLOT_SIZE];
+    va_list copy;
+    va_copy(copy, argptr);
+    int length = vsnprintf(local, sizeof(local), message, copy);
+    va_end(copy);
+    if(length < 0) {
+        return false;
+    }
+    const char * text = local;
+    char * long_text = NULL;
+    if(length >= GL_LOG_SLOT_SIZE) {
+        // info logs and program dumps; malloc keeps it out of the steady-state allocation count
+        long_text = (char *)malloc(length + 1);
+        if(!long_text) {
+            length = GL_LOG_SLOT_SIZE - 1;
+        } else {
+            vsnprintf(long_text, length + 1, message, argptr);
+            text = long_text;
+        }
+    }
+    const size_t chunk = GL_LOG_SLOT_SIZE - 1;
+    size_t count = ((size_t)length + chunk - 1) / chunk;
+    count = std::max(count, (size_t)1);
+    if(count > GL_LOG_SLOTS / 2) {
+        count = GL_LOG_SLOTS / 2;
+        length = (int)(count * chunk);
+    }
+    size_t pos = g_log_tail.load(std::memory_order_relaxed);
+    for(;;) {
+        // the writer frees slots in order, so the last one being free means all are
+        log_slot * last = &g_log_ring[(pos + count - 1) & (GL_LOG_SLOTS - 1)];
+        size_t sequence = last->sequence.load(std::memory_order_acquire);
+        long diff = (long)sequence - (long)(pos + count - 1);
+        if(diff == 0) {
+            if(g_log_tail.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if(diff < 0) {
+            // ring is full
+            if(g_log_overflow.load(std::memory_order_relaxed) == GL_LOG_OVERFLOW_DROP) {
+                g_log_dropped.fetch_add(1, std::memory_order_relaxed);
+                free(long_text);
+                return false;
+            }
+            wake_writer();
+            std::this_thread::yield();
+            pos = g_log_tail.load(std::memory_order_relaxed);
+        } else {
+            pos = g_log_tail.load(std::memory_order_relaxed);
+        }
+    }
+    for(size_t i = 0; i < count; i++) {
+        log_slot * slot = &g_log_ring[(pos + i) & (GL_LOG_SLOTS - 1)];
+        size_t offset = i * chunk;
+        size_t size = std::min(chunk, (size_t)length - offset);
+        slot->level = level;
+        memcpy(slot->text, text + offset, size);
+        slot->text[size] = '\0';
+        slot->sequence.store(pos + i + 1, std::memory_order_release);
+    }
+    free(long_text);
+    if(level >= GL_LOG_ERROR) {
+        wake_writer();
+    }
+    return true;
+}
+
+static bool log_message(int level, const char * message, va_list argptr) {
+    if(level < g_log_level.load(std::memory_order_relaxed)) {
+        return true;
+    }
+    if(!g_log_running.load(std::memory_order_acquire)) {
+        return log_sync(level, message, argptr);
+    }
+    return log_async(level, message, argptr);
+}
+
+void gl_log_shutdown() {
+    if(!g_log_running.exchange(false)) {
+        return;
+    }
+    g_log_stop.store(true, std::memory_order_release);
+    wake_writer();
+    g_log_writer.join();
+    // a producer may have claimed a slot just before the flag dropped
+    drain_ring();
+    fclose(g_log_file);
+    g_log_file = NULL;
+}
+
+void gl_log_flush() {
+    if(!g_log_running.load(std::memory_order_acquire)) {
+        return;
+    }
+    size_t target = g_log_tail.load(std::memory_order_acquire);
+    while(g_log_running.load(std::memory_order_acquire)
+        && g_log_head.load(std::memory_order_acquire) < target) {
+        wake_writer();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
 bool restart_gl_log() {
+    gl_log_shutdown();
     FILE * file = fopen(GL_LOG_FILE, "w");
     if (!file) {
         fprintf(stderr, "ERROR: could not open GL_LOG_FILE log file %s for writing\n", GL_LOG_FILE);
@@ -13,43 +219,58 @@ bool restart_gl_log() {
     }
     time_t now = time(NULL);
     char * date = ctime(&now);
-    fclose(file);
+
+    static bool registered = false;
+    if(!registered) {
+        for(size_t i = 0; i < GL_LOG_SLOTS; i++) {
+            g_log_ring[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        atexit(gl_log_shutdown);
+        registered = true;
+    }
+    setvbuf(file, NULL, _IOFBF, 64 * 1024);
+    g_log_file = file;
+    g_log_stop.store(false, std::memory_order_relaxed);
+    g_log_writer = std::thread(log_writer_main);
+    g_log_running.store(true, std::memory_order_release);
     gl_log("\n\nGL_LOG_FILE log. local time %s\n", date);
     return true;
 }
 
 bool gl_log(const char * message, ...) {
     va_list argptr;
-    FILE * file = fopen(GL_LOG_FILE, "a");
-    if (!file) {
-        return false;
-    }
-    va_start(argptr, message);
-    vfprintf(file, message, argptr);
-    va_end(argptr);
-    fclose(file);
-
     va_start(argptr, message);
-    vprintf(message, argptr);
+    bool result = log_message(GL_LOG_INFO, message, argptr);
     va_end(argptr);
-    return true;
+    return result;
 }
 
 bool gl_log_err(const char * message, ...) {
     va_list argptr;
-    FILE * file = fopen(GL_LOG_FILE, "a");
-    if (!file) {
-        fprintf(stderr, "ERROR: could not open GL_LOG_FILE %s file for appending\n", GL_LOG_FILE);
-        return false;
-    }
     va_start(argptr, message);
-    vfprintf(file, message, argptr);
+    bool result = log_message(GL_LOG_ERROR, message, argptr);
     va_end(argptr);
+    return result;
+}
+
+bool gl_log_at(int level, const char * message, ...) {
+    va_list argptr;
     va_start(argptr, message);
-    vfprintf(stderr, message, argptr);
+    bool result = log_message(level, message, argptr);
     va_end(argptr);
-    fclose(file);
-    return true;
+    return result;
+}
+
+void gl_log_set_level(int level) {
+    g_log_level.store(level, std::memory_order_relaxed);
+}
+
+void gl_log_set_overflow_policy(int policy) {
+    g_log_overflow.store(policy, std::memory_order_relaxed);
+}
+
+unsigned long gl_log_dropped() {
+    return g_log_dropped.load(std::memory_order_relaxed);
 }
 
 void log_gl_params() {
@@ -97,23 +318,3 @@ void log_gl_params() {
     gl_log("-----------------------------\n");
 }
 
-
-double previous_seconds = 0;
-int frame_count = 0;
-
-void update_fps_counter(GLFWwindow* window) {
-    double current_seconds;
-    double elapsed_seconds;
-    current_seconds = glfwGetTime();
-    elapsed_seconds = current_seconds - previous_seconds;
-    if(elapsed_seconds > 0.25) {
-        previous_seconds = current_seconds;
-        double fps = (double)frame_count / elapsed_seconds;
-        char tmp[128];
-        sprintf(tmp, "opengl @ fps: %.2f", fps);
-        glfwSetWindowTitle(window, tmp);
-        frame_count = 0;
-    }
-    frame_count++;
-}
-
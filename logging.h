@@ -1,8 +1,28 @@
 #pragma once
 #include <stdarg.h>
 
+// severity, lowest first; messages below the current level are filtered
+// before any formatting happens
+enum {
+    GL_LOG_DEBUG = 0,
+    GL_LOG_INFO,
+    GL_LOG_WARN,
+    GL_LOG_ERROR,
+};
+
+// what a caller does when the ring buffer is full
+enum {
+    GL_LOG_OVERFLOW_DROP = 0,
+    GL_LOG_OVERFLOW_BLOCK,
+};
+
 bool restart_gl_log();
 bool gl_log(const char * message, ...);
 bool gl_log_err(const char * message, ...);
-void update_fps_counter(GLFWwindow* window);
-void log_gl_params();
\ No newline at end of file
+bool gl_log_at(int level, const char * message, ...);
+void gl_log_set_level(int level);
+void gl_log_set_overflow_policy(int policy);
+unsigned long gl_log_dropped();
+void gl_log_flush();
+void gl_log_shutdown();
+void log_gl_params();
@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include "logging.h"
+#include "frametiming.h"
+#include "vecmath.h"
+
+// Math kernel benchmark: every SIMD level is first checked against the
+// scalar reference (bit-exact for transforms and matrix products, equal for
+// bounds), then timed. Exits non-zero on any mismatch.
+
+#define MATH_BENCH_RUNS 20
+
+static float random_float() {
+    return (float)rand() / RAND_MAX * 200.0f - 100.0f;
+}
+
+template <typename Kernel>
+static double time_kernel(Kernel kernel) {
+    std::vector<double> times;
+    kernel();
+    for(int i = 0; i < MATH_BENCH_RUNS; i++) {
+        double start = frame_timing_seconds();
+        kernel();
+        times.push_back(frame_timing_seconds() - start);
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+static void report(const char * kernel, int level, size_t items, double seconds, double scalar_seconds, bool exact) {
+    gl_log("  %-16s %-7s %9zu %10.3f %10.2f %8.2fx  %s\n", kernel, math_simd_name(level), items, seconds * 1000.0,
+        seconds * 1e9 / items, seconds > 0.0 ? scalar_seconds / seconds : 0.0, exact ? "exact" : "MISMATCH");
+}
+
+static bool check_scalar_helpers() {
+    // spot checks of the non-batch helpers against hand-computed results
+    mat4 t = mat4_translate(1.0f, 2.0f, 3.0f);
+    vec3 p = mat4_transform_point(t, vec3_make(1.0f, 1.0f, 1.0f));
+    bool ok = p.x == 2.0f && p.y == 3.0f && p.z == 4.0f;
+    quat q = quat_from_axis_angle(vec3_make(0.0f, 0.0f, 1.0f), (float)M_PI * 0.5f);
+    vec3 r = quat_rotate(q, vec3_make(1.0f, 0.0f, 0.0f));
+    vec3 rm = mat4_transform_point(mat4_from_quat(q), vec3_make(1.0f, 0.0f, 0.0f));
+    ok = ok && fabsf(r.x) < 1e-6f && fabsf(r.y - 1.0f) < 1e-6f && fabsf(rm.x - r.x) < 1e-6f && fabsf(rm.y - r.y) < 1e-6f;
+    quat half = quat_slerp(quat_identity(), q, 0.5f);
+    vec3 h = quat_rotate(half, vec3_make(1.0f, 0.0f, 0.0f));
+    ok = ok && fabsf(h.x - h.y) < 1e-6f;
+    mat4 identity = mat4_mul(t, mat4_translate(-1.0f, -2.0f, -3.0f));
+    ok = ok && memcmp(identity.m, mat4_identity().m, sizeof(identity.m)) == 0;
+    gl_log("  scalar helpers: %s\n", ok ? "ok" : "MISMATCH");
+    return ok;
+}
+
+// bit-exact, except that any NaN matches any other NaN
+static bool same_or_both_nan(const float * a, const float * b, size_t n) {
+    for(size_t i = 0; i < n; i++) {
+        if(memcmp(&a[i], &b[i], sizeof(float)) != 0 && !(isnan(a[i]) && isnan(b[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool check_special_values(int widest) {
+    // NaN, infinities and both zeros scattered through otherwise plain data,
+    // at offsets that land in SIMD bodies as well as scalar tails
+    const float specials[] = { NAN, -NAN, INFINITY, -INFINITY, 0.0f, -0.0f };
+    const size_t n = 203;
+    std::vector<float> x(n), y(n), z(n);
+    for(size_t i = 0; i < n; i++) {
+        x[i] = random_float();
+        y[i] = random_float();
+        z[i] = random_float();
+    }
+    for(size_t i = 0; i < n; i += 7) {
+        x[i] = specials[i % 6];
+        y[(i * 3) % n] = specials[(i + 1) % 6];
+        z[(i * 5) % n] = specials[(i + 2) % 6];
+    }
+    // every bound lands on a zero, reached from either sign
+    for(size_t i = 150; i < n; i++) {
+        x[i] = (i & 1) ? 0.0f : -0.0f;
+    }
+    const unsigned first[] = { 0, 3, 17, 40, 150, 160 };
+    const unsigned count[] = { 203, 29, 8, 100, 53, 4 };
+    const size_t objects = sizeof(first) / sizeof(first[0]);
+    mat4 m = mat4_mul(mat4_translate(-0.0f, 1.0f, NAN), mat4_scale(2.0f, -0.0f, INFINITY));
+    std::vector<mat4> a(objects), b(objects);
+    for(size_t i = 0; i < objects; i++) {
+        for(int k = 0; k < 16; k++) {
+            a[i].m[k] = k % 5 == 0 ? specials[(i + k) % 6] : random_float();
+            b[i].m[k] = k % 3 == 0 ? specials[(i + k + 1) % 6] : random_float();
+        }
+    }
+
+    std::vector<float> ox(n * 3), rx(n * 3), bounds(objects * 6), reference_bounds(objects * 6);
+    std::vector<mat4> product(objects), reference_product(objects);
+    bool ok = true;
+    for(int level = MATH_SCALAR; level <= widest; level++) {
+        math_force_simd_level(level);
+        std::vector<float> & out = level == MATH_SCALAR ? rx : ox;
+        transform_points(m, x.data(), y.data(), z.data(), out.data(), out.data() + n, out.data() + n * 2, n);
+        std::vector<float> & bo = level == MATH_SCALAR ? reference_bounds : bounds;
+        compute_bounds(x.data(), y.data(), z.data(), first, count, objects, bo.data(), bo.data() + objects,
+            bo.data() + objects * 2, bo.data() + objects * 3, bo.data() + objects * 4, bo.data() + objects * 5);
+        mat4_mul_batch(a.data(), b.data(), level == MATH_SCALAR ? reference_product.data() : product.data(), objects);
+        if(level == MATH_SCALAR) {
+            continue;
+        }
+        bool exact = same_or_both_nan(ox.data(), rx.data(), ox.size())
+            && same_or_both_nan(product[0].m, reference_product[0].m, objects * 16);
+        // bounds skip NaNs, so they must match with == (zeros of either sign)
+        for(size_t i = 0; i < bounds.size(); i++) {
+            exact = exact && bounds[i] == reference_bounds[i];
+        }
+        gl_log("  special values %-7s %s\n", math_simd_name(level), exact ? "exact" : "MISMATCH");
+        ok = ok && exact;
+    }
+    return ok;
+}
+
+int main() {
+    if(!restart_gl_log()) {
+        fprintf(stderr, "Failed to open log file\n");
+        return 1;
+    }
+    srand(1);
+    size_t points = 1 << 20;
+    std::vector<float> x(points), y(points), z(points);
+    for(size_t i = 0; i < points; i++) {
+        x[i] = random_float();
+        y[i] = random_float();
+        z[i] = random_float();
+    }
+    std::vector<float> ox(points), oy(points), oz(points);
+    std::vector<float> rx(points), ry(points), rz(points);
+    mat4 model = mat4_mul(mat4_translate(1.5f, -2.0f, 0.25f),
+        mat4_mul(mat4_from_quat(quat_from_axis_angle(vec3_make(1.0f, 1.0f, 0.0f), 0.7f)), mat4_scale(2.0f, 2.0f, 2.0f)));
+
+    // bounds: objects of uneven size so the SIMD tails get exercised
+    size_t objects = 10000;
+    std::vector<unsigned> first(objects), count(objects);
+    unsigned next = 0;
+    for(size_t i = 0; i < objects; i++) {
+        first[i] = next;
+        count[i] = 1 + rand() % 200;
+        next = (next + count[i]) % (unsigned)(points - 256);
+    }
+    std::vector<float> bounds(objects * 6), reference_bounds(objects * 6);
+
+    size_t matrices = 100000;
+    std::vector<mat4> a(matrices), b(matrices), product(matrices), reference_product(matrices);
+    for(size_t i = 0; i < matrices; i++) {
+        for(int k = 0; k < 16; k++) {
+            a[i].m[k] = random_float();
+            b[i].m[k] = random_float();
+        }
+    }
+
+    bool ok = true;
+    gl_log("\nmath-bench: widest path %s\n", math_simd_name(math_simd_level()));
+    ok = check_scalar_helpers() && ok;
+    ok = check_special_values(math_simd_level()) && ok;
+    gl_log("  %-16s %-7s %9s %10s %10s %9s\n", "kernel", "path", "items", "ms", "ns/item", "speedup");
+    int widest = math_simd_level();
+    double scalar_transform = 0.0, scalar_bounds = 0.0, scalar_multiply = 0.0;
+    for(int level = MATH_SCALAR; level <= widest; level++) {
+        math_force_simd_level(level);
+        double s = time_kernel([&]() {
+            transform_points(model, x.data(), y.data(), z.data(), ox.data(), oy.data(), oz.data(), points);
+        });
+        if(level == MATH_SCALAR) {
+            scalar_transform = s;
+            rx = ox;
+            ry = oy;
+            rz = oz;
+        }
+        bool exact = memcmp(ox.data(), rx.data(), points * sizeof(float)) == 0
+            && memcmp(oy.data(), ry.data(), points * sizeof(float)) == 0
+            && memcmp(oz.data(), rz.data(), points * sizeof(float)) == 0;
+        report("transform_points", level, points, s, scalar_transform, exact);
+        ok = ok && exact;
+
+        float * bo = bounds.data();
+        s = time_kernel([&]() {
+            compute_bounds(x.data(), y.data(), z.data(), first.data(), count.data(), objects,
+                bo, bo + objects, bo + objects * 2, bo + objects * 3, bo + objects * 4, bo + objects * 5);
+        });
+        if(level == MATH_SCALAR) {
+            scalar_bounds = s;
+            reference_bounds = bounds;
+        }
+        exact = true;
+        for(size_t i = 0; i < bounds.size(); i++) {
+            exact = exact && bounds[i] == reference_bounds[i];
+        }
+        report("compute_bounds", level, objects, s, scalar_bounds, exact);
+        ok = ok && exact;
+
+        s = time_kernel([&]() {
+            mat4_mul_batch(a.data(), b.data(), product.data(), matrices);
+        });
+        if(level == MATH_SCALAR) {
+            scalar_multiply = s;
+            reference_product = product;
+        }
+        exact = memcmp(product.data(), reference_product.data(), matrices * sizeof(mat4)) == 0;
+        report("mat4_mul_batch", level, matrices, s, scalar_multiply, exact);
+        ok = ok && exact;
+    }
+    // in place, as a model-view chain would be updated
+    std::vector<mat4> in_place = a;
+    math_force_simd_level(widest);
+    mat4_mul_batch(in_place.data(), b.data(), in_place.data(), matrices);
+    bool aliased = memcmp(in_place.data(), reference_product.data(), matrices * sizeof(mat4)) == 0;
+    gl_log("  aliased output: %s\n", aliased ? "exact" : "MISMATCH");
+    ok = ok && aliased;
+    gl_log("math-bench: %s\n", ok ? "all paths match the scalar reference" : "FAILED");
+    gl_log_shutdown();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,7 @@
+set -e
+g++ math-bench.cpp vecmath.cpp frametiming.cpp logging.cpp \
+    ../glew/lib/libGLEW.a ../glfw/build/src/libglfw3.a \
+    -I ../glfw/include -I ../glew/include/ \
+    -lGL -lEGL -lX11 -lGLU -pthread \
+    -o math-bench
+./math-bench
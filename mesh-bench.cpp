@@ -0,0 +1,161 @@
+#include <GL/glew.h>
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include "logging.h"
+#include "frametiming.h"
+#include "headless.h"
+#include "glstate.h"
+#include "meshfile.h"
+#include "objimport.h"
+#include "glcapture.h"
+
+// Mesh load benchmark: a generated OBJ (a sphere with normals and uvs) is
+// parsed and uploaded, versus the same mesh converted once and then mapped
+// and uploaded from the binary file. Each load ends with glFinish so the
+// driver's copy is counted.
+
+#define MESH_BENCH_OBJ "mesh-bench.obj"
+#define MESH_BENCH_MESH "mesh-bench.mesh"
+
+static int g_runs = 5;
+
+static bool write_sphere_obj(const char * path, int rings, int segments) {
+    FILE * file = fopen(path, "w");
+    if(!file) {
+        gl_log_err("ERROR: could not write %s\n", path);
+        return false;
+    }
+    for(int r = 0; r <= rings; r++) {
+        float theta = (float)M_PI * r / rings;
+        for(int s = 0; s <= segments; s++) {
+            float phi = 2.0f * (float)M_PI * s / segments;
+            float x = sinf(theta) * cosf(phi), y = cosf(theta), z = sinf(theta) * sinf(phi);
+            fprintf(file, "v %f %f %f\nvn %f %f %f\nvt %f %f\n", x, y, z, x, y, z,
+                (float)s / segments, (float)r / rings);
+        }
+    }
+    // two materials so the sub-mesh table has more than one entry
+    for(int r = 0; r < rings; r++) {
+        if(r == 0 || r == rings / 2) {
+            fprintf(file, "usemtl %s\n", r == 0 ? "north" : "south");
+        }
+        for(int s = 0; s < segments; s++) {
+            int a = r * (segments + 1) + s + 1;
+            int b = a + segments + 1;
+            fprintf(file, "f %i/%i/%i %i/%i/%i %i/%i/%i %i/%i/%i\n", a, a, a, b, b, b, b + 1, b + 1, b + 1,
+                a + 1, a + 1, a + 1);
+        }
+    }
+    return fclose(file) == 0;
+}
+
+static void upload_mesh_data(const mesh_data * mesh, mesh_gpu * gpu) {
+    gpu->index_type = GL_UNSIGNED_INT;
+    gpu->submeshes = mesh->submeshes;
+    glGenVertexArrays(1, &gpu->vao);
+    glGenBuffers(1, &gpu->vbo);
+    glGenBuffers(1, &gpu->ibo);
+    gl_state_bind_vertex_array(gpu->vao);
+    gl_state_bind_buffer(GL_ARRAY_BUFFER, gpu->vbo);
+    glBufferData(GL_ARRAY_BUFFER, mesh->vertices.size(), mesh->vertices.data(), GL_STATIC_DRAW);
+    gl_state_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, gpu->ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh->indices.size() * sizeof(uint32_t), mesh->indices.data(),
+        GL_STATIC_DRAW);
+    GLintptr offset = 0;
+    vertex_format_apply(&mesh->format, gpu->vao, &gpu->vbo, &offset);
+    gl_state_bind_vertex_array(0);
+}
+
+template <typename Load>
+static double time_load(Load load) {
+    std::vector<double> times;
+    for(int i = 0; i < g_runs; i++) {
+        double start = frame_timing_seconds();
+        if(!load()) {
+            return -1.0;
+        }
+        glFinish();
+        times.push_back((frame_timing_seconds() - start) * 1000.0);
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+static void report(const char * path, double ms, size_t bytes) {
+    gl_log("  %-28s %10.3f %10.1f\n", path, ms, ms > 0.0 ? bytes / (ms / 1000.0) / (1024.0 * 1024.0) : 0.0);
+}
+
+int main(int argc, char ** argv) {
+    headless_options options;
+    if(!parse_headless_args(argc, argv, &options)) {
+        return 1;
+    }
+    options.enabled = true;
+    if(!restart_gl_log()) {
+        fprintf(stderr, "Failed to open log file\n");
+        return 1;
+    }
+    gl_log_set_level(GL_LOG_WARN);
+    if(!headless_init(&options)) {
+        return 2;
+    }
+    gl_log_set_level(GL_LOG_INFO);
+    int rings = 512;
+    int segments = 1024;
+    if(!write_sphere_obj(MESH_BENCH_OBJ, rings, segments)) {
+        return 3;
+    }
+    mesh_data converted;
+    obj_import_stats stats;
+    double convert_start = frame_timing_seconds();
+    if(!obj_load(MESH_BENCH_OBJ, true, &converted, &stats) || !mesh_file_write(MESH_BENCH_MESH, &converted)) {
+        return 4;
+    }
+    double convert_ms = (frame_timing_seconds() - convert_start) * 1000.0;
+    mapped_file obj_file;
+    mapped_file mesh_bytes;
+    if(!map_file(MESH_BENCH_OBJ, &obj_file) || !map_file(MESH_BENCH_MESH, &mesh_bytes)) {
+        return 5;
+    }
+    size_t obj_size = obj_file.size;
+    size_t mesh_size = mesh_bytes.size;
+    unmap_file(&obj_file);
+    unmap_file(&mesh_bytes);
+
+    gl_log("\nmesh-bench: %s, %zu triangles, %zu vertices, median of %i loads\n", glGetString(GL_RENDERER),
+        stats.triangles, stats.vertices, g_runs);
+    gl_log("  obj %.1f MB, mesh %.1f MB, one-off conversion %.1f ms, ACMR %.3f -> %.3f\n",
+        obj_size / (1024.0 * 1024.0), mesh_size / (1024.0 * 1024.0), convert_ms, stats.acmr_before, stats.acmr_after);
+    gl_log("  %-28s %10s %10s\n", "path", "ms", "MB/s");
+    double ms = time_load([&]() {
+        mesh_data mesh;
+        obj_import_stats s;
+        mesh_gpu gpu;
+        if(!obj_load(MESH_BENCH_OBJ, false, &mesh, &s)) {
+            return false;
+        }
+        upload_mesh_data(&mesh, &gpu);
+        mesh_gpu_destroy(&gpu);
+        return true;
+    });
+    report("obj parse + dedup + upload", ms, obj_size);
+    ms = time_load([&]() {
+        mesh_file mesh;
+        mesh_gpu gpu;
+        if(!mesh_file_open(MESH_BENCH_MESH, &mesh)) {
+            return false;
+        }
+        mesh_file_upload(&mesh, &gpu);
+        mesh_file_close(&mesh);
+        mesh_gpu_destroy(&gpu);
+        return true;
+    });
+    report("mesh map + upload", ms, mesh_size);
+
+    remove(MESH_BENCH_OBJ);
+    remove(MESH_BENCH_MESH);
+    headless_shutdown();
+    return 0;
+}
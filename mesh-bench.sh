@@ -0,0 +1,7 @@
+set -e
+g++ mesh-bench.cpp meshfile.cpp objimport.cpp assetloader.cpp frametiming.cpp headless.cpp vertexformat.cpp glstate.cpp logging.cpp \
+    ../glew/lib/libGLEW.a ../glfw/build/src/libglfw3.a \
+    -I ../glfw/include -I ../glew/include/ \
+    -lGL -lEGL -lX11 -lGLU -pthread \
+    -o mesh-bench
+./mesh-bench
@@ -0,0 +1,51 @@
+#include <stdio.h>
+#include <string.h>
+#include "logging.h"
+#include "frametiming.h"
+#include "meshfile.h"
+#include "objimport.h"
+
+// Offline OBJ to binary mesh converter:
+//   mesh-convert input.obj output.mesh [--no-optimize]
+
+int main(int argc, char ** argv) {
+    bool optimize = true;
+    const char * paths[2] = { NULL, NULL };
+    int path_count = 0;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--no-optimize") == 0) {
+            optimize = false;
+        } else if(path_count < 2) {
+            paths[path_count++] = argv[i];
+        } else {
+            path_count = 3;
+        }
+    }
+    if(path_count != 2) {
+        fprintf(stderr, "usage: %s input.obj output.mesh [--no-optimize]\n", argv[0]);
+        return 1;
+    }
+    if(!restart_gl_log()) {
+        fprintf(stderr, "Failed to open log file\n");
+        return 1;
+    }
+    double start = frame_timing_seconds();
+    mesh_data mesh;
+    obj_import_stats stats;
+    if(!obj_load(paths[0], optimize, &mesh, &stats)) {
+        fprintf(stderr, "could not import %s, see gl.log\n", paths[0]);
+        return 2;
+    }
+    if(!mesh_file_write(paths[1], &mesh)) {
+        fprintf(stderr, "could not write %s, see gl.log\n", paths[1]);
+        return 3;
+    }
+    double seconds = frame_timing_seconds() - start;
+    printf("%s: %zu triangles, %zu positions, %zu corners -> %zu vertices, %zu sub-meshes\n",
+        paths[1], stats.triangles, stats.positions, stats.corners, stats.vertices, mesh.submeshes.size());
+    printf("  ACMR (%i-entry FIFO): %.3f -> %.3f, %.1f ms\n", VERTEX_CACHE_SIZE,
+        stats.acmr_before, stats.acmr_after, seconds * 1000.0);
+    gl_log("mesh-convert %s -> %s: %zu triangles, %zu vertices, ACMR %.3f -> %.3f, %.1f ms\n", paths[0], paths[1],
+        stats.triangles, stats.vertices, stats.acmr_before, stats.acmr_after, seconds * 1000.0);
+    return 0;
+}
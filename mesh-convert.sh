@@ -0,0 +1,7 @@
+set -e
+g++ mesh-convert.cpp meshfile.cpp objimport.cpp assetloader.cpp frametiming.cpp vertexformat.cpp glstate.cpp logging.cpp \
+    ../glew/lib/libGLEW.a ../glfw/build/src/libglfw3.a \
+    -I ../glfw/include -I ../glew/include/ \
+    -lGL -lEGL -lX11 -lGLU -pthread \
+    -o mesh-convert
+./mesh-convert "$@"
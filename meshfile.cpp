@@ -0,0 +1,195 @@
+#include <GL/glew.h>
+#include <stdio.h>
+#include <string.h>
+#include "logging.h"
+#include "glstate.h"
+#include "meshfile.h"
+#include "glcapture.h"
+
+static uint64_t align_up(uint64_t value) {
+    return (value + MESH_FILE_ALIGN - 1) & ~(uint64_t)(MESH_FILE_ALIGN - 1);
+}
+
+static uint32_t index_size(uint32_t type) {
+    return type == GL_UNSIGNED_SHORT ? 2 : 4;
+}
+
+// rebuilds the format the writer laid the vertices out with; every
+// attribute has to sit exactly where that format puts it, which also keeps
+// each one whole inside the vertex
+static bool format_from_attributes(const mesh_attribute * attributes, uint32_t count, uint32_t stride,
+    vertex_format * format) {
+    vertex_format_init(format);
+    for(uint32_t i = 0; i < count; i++) {
+        const mesh_attribute & a = attributes[i];
+        int encoding = vertex_encoding_of(a.type, a.normalized != 0);
+        if(encoding < 0 || a.components < 1 || a.components > 4) {
+            return false;
+        }
+        int element = vertex_format_add(format, a.location, (int)a.components, encoding, 0);
+        if(element < 0 || format->elements[element].offset != a.offset
+            || format->elements[element].components != (int)a.components) {
+            return false;
+        }
+    }
+    return (uint32_t)vertex_format_stride(format, 0) == stride;
+}
+
+static bool section_fits(uint64_t offset, uint64_t size, uint64_t file_size) {
+    return offset % MESH_FILE_ALIGN == 0 && offset <= file_size && size <= file_size - offset;
+}
+
+bool mesh_file_open(const char * path, mesh_file * mesh) {
+    memset(mesh, 0, sizeof(*mesh));
+    if(!map_file(path, &mesh->file)) {
+        return false;
+    }
+    const char * base = (const char *)mesh->file.data;
+    uint64_t size = mesh->file.size;
+    const mesh_file_header * h = (const mesh_file_header *)base;
+    // everything is range-checked once here so the tables can be used directly
+    bool ok = size >= sizeof(mesh_file_header) && memcmp(h->magic, MESH_FILE_MAGIC, 4) == 0
+        && h->version == MESH_FILE_VERSION
+        && (h->index_type == GL_UNSIGNED_SHORT || h->index_type == GL_UNSIGNED_INT)
+        && section_fits(h->attributes_offset, (uint64_t)h->attribute_count * sizeof(mesh_attribute), size)
+        && section_fits(h->submeshes_offset, (uint64_t)h->submesh_count * sizeof(mesh_submesh), size)
+        && section_fits(h->vertices_offset, (uint64_t)h->vertex_count * h->vertex_stride, size)
+        && section_fits(h->indices_offset, (uint64_t)h->index_count * index_size(h->index_type), size);
+    if(ok) {
+        const mesh_attribute * attributes = (const mesh_attribute *)(base + h->attributes_offset);
+        ok = h->attribute_count <= VERTEX_FORMAT_MAX_ELEMENTS
+            && format_from_attributes(attributes, h->attribute_count, h->vertex_stride, &mesh->format);
+        const mesh_submesh * submeshes = (const mesh_submesh *)(base + h->submeshes_offset);
+        for(uint32_t i = 0; i < h->submesh_count; i++) {
+            ok = ok && submeshes[i].first_index <= h->index_count
+                && submeshes[i].index_count <= h->index_count - submeshes[i].first_index;
+        }
+    }
+    if(!ok) {
+        gl_log_err("ERROR: %s is not a valid version %i mesh file\n", path, MESH_FILE_VERSION);
+        unmap_file(&mesh->file);
+        return false;
+    }
+    mesh->header = h;
+    mesh->attributes = (const mesh_attribute *)(base + h->attributes_offset);
+    mesh->submeshes = (const mesh_submesh *)(base + h->submeshes_offset);
+    mesh->vertices = base + h->vertices_offset;
+    mesh->indices = base + h->indices_offset;
+    return true;
+}
+
+void mesh_file_close(mesh_file * mesh) {
+    unmap_file(&mesh->file);
+    mesh->header = NULL;
+}
+
+// the mapped pages go straight to the driver, no staging copy on our side
+static void upload_buffer(GLenum target, GLuint buffer, GLsizeiptr size, const void * data) {
+    gl_state_bind_buffer(target, buffer);
+    if(GLEW_ARB_buffer_storage) {
+        glBufferStorage(target, size, data, 0);
+    } else {
+        glBufferData(target, size, data, GL_STATIC_DRAW);
+    }
+}
+
+bool mesh_file_upload(const mesh_file * mesh, mesh_gpu * gpu) {
+    const mesh_file_header * h = mesh->header;
+    gpu->index_type = h->index_type;
+    gpu->submeshes.assign(mesh->submeshes, mesh->submeshes + h->submesh_count);
+    glGenVertexArrays(1, &gpu->vao);
+    glGenBuffers(1, &gpu->vbo);
+    glGenBuffers(1, &gpu->ibo);
+    gl_state_bind_vertex_array(gpu->vao);
+    upload_buffer(GL_ARRAY_BUFFER, gpu->vbo, (GLsizeiptr)h->vertex_count * h->vertex_stride, mesh->vertices);
+    // the element binding is VAO state, so it is set with the VAO bound
+    upload_buffer(GL_ELEMENT_ARRAY_BUFFER, gpu->ibo, (GLsizeiptr)h->index_count * index_size(h->index_type),
+        mesh->indices);
+    GLintptr offset = 0;
+    vertex_format_apply(&mesh->format, gpu->vao, &gpu->vbo, &offset);
+    gl_state_bind_vertex_array(0);
+    return true;
+}
+
+void mesh_gpu_draw(const mesh_gpu * gpu, int submesh) {
+    const mesh_submesh & s = gpu->submeshes[submesh];
+    gl_state_bind_vertex_array(gpu->vao);
+    glDrawElements(GL_TRIANGLES, s.index_count, gpu->index_type,
+        (const void *)(uintptr_t)(s.first_index * (gpu->index_type == GL_UNSIGNED_SHORT ? 2 : 4)));
+}
+
+void mesh_gpu_destroy(mesh_gpu * gpu) {
+    gl_state_delete_vertex_arrays(1, &gpu->vao);
+    gl_state_delete_buffers(1, &gpu->vbo);
+    gl_state_delete_buffers(1, &gpu->ibo);
+    gpu->vao = gpu->vbo = gpu->ibo = 0;
+    gpu->submeshes.clear();
+}
+
+static bool write_at(FILE * file, uint64_t offset, const void * data, size_t size) {
+    // zero padding up to the section start
+    static const char zeros[MESH_FILE_ALIGN] = { 0 };
+    long position = ftell(file);
+    while(position >= 0 && (uint64_t)position < offset) {
+        size_t pad = (size_t)(offset - position) < sizeof(zeros) ? (size_t)(offset - position) : sizeof(zeros);
+        if(fwrite(zeros, 1, pad, file) != pad) {
+            return false;
+        }
+        position += pad;
+    }
+    return size == 0 || fwrite(data, 1, size, file) == size;
+}
+
+bool mesh_file_write(const char * path, const mesh_data * data) {
+    mesh_file_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, MESH_FILE_MAGIC, 4);
+    h.version = MESH_FILE_VERSION;
+    h.vertex_count = data->vertex_count;
+    h.vertex_stride = (uint32_t)vertex_format_stride(&data->format, 0);
+    h.index_count = (uint32_t)data->indices.size();
+    h.index_type = data->vertex_count <= 0xffff ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    std::vector<mesh_attribute> attributes(data->format.element_count);
+    for(int i = 0; i < data->format.element_count; i++) {
+        const vertex_element & e = data->format.elements[i];
+        memset(&attributes[i], 0, sizeof(mesh_attribute));
+        attributes[i].location = e.location;
+        attributes[i].components = (uint32_t)e.components;
+        attributes[i].type = vertex_encoding_type(e.encoding);
+        attributes[i].normalized = vertex_encoding_normalized(e.encoding);
+        attributes[i].offset = e.offset;
+    }
+    h.attribute_count = (uint32_t)attributes.size();
+    h.submesh_count = (uint32_t)data->submeshes.size();
+    h.attributes_offset = align_up(sizeof(h));
+    h.submeshes_offset = align_up(h.attributes_offset + h.attribute_count * sizeof(mesh_attribute));
+    h.vertices_offset = align_up(h.submeshes_offset + h.submesh_count * sizeof(mesh_submesh));
+    h.indices_offset = align_up(h.vertices_offset + (uint64_t)h.vertex_count * h.vertex_stride);
+
+    std::vector<uint16_t> short_indices;
+    const void * indices = data->indices.data();
+    if(h.index_type == GL_UNSIGNED_SHORT) {
+        short_indices.assign(data->indices.begin(), data->indices.end());
+        indices = short_indices.data();
+    }
+
+    char tmp_path[1024];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE * file = fopen(tmp_path, "wb");
+    if(!file) {
+        gl_log_err("ERROR: could not write mesh file %s\n", tmp_path);
+        return false;
+    }
+    bool ok = write_at(file, 0, &h, sizeof(h))
+        && write_at(file, h.attributes_offset, attributes.data(), h.attribute_count * sizeof(mesh_attribute))
+        && write_at(file, h.submeshes_offset, data->submeshes.data(), h.submesh_count * sizeof(mesh_submesh))
+        && write_at(file, h.vertices_offset, data->vertices.data(), (size_t)h.vertex_count * h.vertex_stride)
+        && write_at(file, h.indices_offset, indices, (size_t)h.index_count * index_size(h.index_type));
+    ok = fclose(file) == 0 && ok;
+    if(!ok || rename(tmp_path, path) != 0) {
+        gl_log_err("ERROR: could not write mesh file %s\n", path);
+        remove(tmp_path);
+        return false;
+    }
+    return true;
+}
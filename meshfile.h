@@ -0,0 +1,99 @@
+#pragma once
+#include <GL/glew.h>
+#include <stdint.h>
+#include <vector>
+#include "assetloader.h"
+#include "vertexformat.h"
+
+// Binary mesh container laid out so a mapped file can be handed to
+// glBufferStorage/glBufferData as-is:
+//
+//   header | attribute table | sub-mesh table | vertices | indices
+//
+// Every section starts on a MESH_FILE_ALIGN boundary, offsets are from the
+// start of the file, everything is little-endian. Vertices are interleaved
+// with vertex_stride bytes each, laid out as one vertex_format stream: the
+// attribute table is that format's elements in order, and a file whose
+// table is not one is rejected. Indices are GL_UNSIGNED_SHORT when every
+// vertex fits, GL_UNSIGNED_INT otherwise.
+#define MESH_FILE_MAGIC "AMSH"
+#define MESH_FILE_VERSION 1
+#define MESH_FILE_ALIGN 64
+
+#define MESH_ATTRIB_POSITION 0
+#define MESH_ATTRIB_NORMAL 2
+#define MESH_ATTRIB_TEXCOORD 3
+
+struct mesh_file_header {
+    char magic[4];
+    uint32_t version;
+    uint32_t vertex_count;
+    uint32_t vertex_stride;
+    uint32_t index_count;
+    uint32_t index_type;
+    uint32_t attribute_count;
+    uint32_t submesh_count;
+    uint64_t attributes_offset;
+    uint64_t submeshes_offset;
+    uint64_t vertices_offset;
+    uint64_t indices_offset;
+};
+
+struct mesh_attribute {
+    uint32_t location;
+    uint32_t components;
+    uint32_t type;
+    uint32_t normalized;
+    uint32_t offset;
+    uint32_t reserved[3];
+};
+
+struct mesh_submesh {
+    uint32_t first_index;
+    uint32_t index_count;
+    uint32_t material;
+    uint32_t reserved;
+    float min[3];
+    float max[3];
+};
+
+static_assert(sizeof(mesh_file_header) == 64, "mesh_file_header must stay 64 bytes");
+static_assert(sizeof(mesh_attribute) == 32, "mesh_attribute must stay 32 bytes");
+static_assert(sizeof(mesh_submesh) == 40, "mesh_submesh must stay 40 bytes");
+
+// a validated view into a mapped file; nothing is copied
+struct mesh_file {
+    mapped_file file;
+    const mesh_file_header * header;
+    const mesh_attribute * attributes;
+    const mesh_submesh * submeshes;
+    // the attribute table as a single-stream format
+    vertex_format format;
+    const void * vertices;
+    const void * indices;
+};
+
+struct mesh_gpu {
+    GLuint vao;
+    GLuint vbo;
+    GLuint ibo;
+    GLenum index_type;
+    std::vector<mesh_submesh> submeshes;
+};
+
+// what the converter fills in before writing
+struct mesh_data {
+    // stream 0 only; the attribute table and vertex stride come from it
+    vertex_format format;
+    uint32_t vertex_count;
+    std::vector<unsigned char> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<mesh_submesh> submeshes;
+};
+
+bool mesh_file_open(const char * path, mesh_file * mesh);
+void mesh_file_close(mesh_file * mesh);
+bool mesh_file_upload(const mesh_file * mesh, mesh_gpu * gpu);
+void mesh_gpu_draw(const mesh_gpu * gpu, int submesh);
+void mesh_gpu_destroy(mesh_gpu * gpu);
+bool mesh_file_write(const char * path, const mesh_data * data);
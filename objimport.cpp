@@ -0,0 +1,387 @@
+#include <GL/glew.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "logging.h"
+#include "assetloader.h"
+#include "objimport.h"
+
+struct obj_corner {
+    int position;
+    int texcoord;
+    int normal;
+
+    bool operator==(const obj_corner & other) const {
+        return position == other.position && texcoord == other.texcoord && normal == other.normal;
+    }
+};
+
+struct obj_corner_hash {
+    size_t operator()(const obj_corner & c) const {
+        return hash_bytes(&c, sizeof(c));
+    }
+};
+
+static const char * skip_spaces(const char * p, const char * end) {
+    while(p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+    return p;
+}
+
+// OBJ indices are 1-based, negative ones count back from the latest element
+static int resolve_index(long index, size_t count) {
+    if(index > 0) {
+        return index <= (long)count ? (int)(index - 1) : -1;
+    }
+    if(index < 0) {
+        return -index <= (long)count ? (int)(count + index) : -1;
+    }
+    return -1;
+}
+
+static const char * parse_floats(const char * p, const char * end, float * out, int count, std::vector<float> & into) {
+    for(int i = 0; i < count; i++) {
+        p = skip_spaces(p, end);
+        char * next = NULL;
+        out[i] = strtof(p, &next);
+        p = next;
+    }
+    into.insert(into.end(), out, out + count);
+    return p;
+}
+
+bool obj_load(const char * path, bool optimize, mesh_data * mesh, obj_import_stats * stats) {
+    std::string text;
+    if(!load_file(path, text)) {
+        return false;
+    }
+    std::vector<float> positions;
+    std::vector<float> texcoords;
+    std::vector<float> normals;
+    std::vector<obj_corner> corners;
+    // first corner of each material run
+    std::vector<std::pair<size_t, uint32_t> > runs;
+    std::map<std::string, uint32_t> materials;
+    // one face's corners, reused; n-gons of any size are fanned
+    std::vector<obj_corner> polygon;
+    const char * p = text.data();
+    const char * end = p + text.size();
+    int line = 0;
+    while(p < end) {
+        const char * eol = (const char *)memchr(p, '\n', end - p);
+        if(!eol) {
+            eol = end;
+        }
+        line++;
+        float v[3];
+        if(p + 2 < eol && p[0] == 'v' && p[1] == ' ') {
+            parse_floats(p + 2, eol, v, 3, positions);
+        } else if(p + 3 < eol && p[0] == 'v' && p[1] == 't' && p[2] == ' ') {
+            parse_floats(p + 3, eol, v, 2, texcoords);
+        } else if(p + 3 < eol && p[0] == 'v' && p[1] == 'n' && p[2] == ' ') {
+            parse_floats(p + 3, eol, v, 3, normals);
+        } else if(p + 2 < eol && p[0] == 'f' && p[1] == ' ') {
+            polygon.clear();
+            const char * q = skip_spaces(p + 2, eol);
+            while(q < eol && *q != '\r') {
+                char * next = NULL;
+                obj_corner c = { -1, -1, -1 };
+                c.position = resolve_index(strtol(q, &next, 10), positions.size() / 3);
+                q = next;
+                if(q < eol && *q == '/') {
+                    q++;
+                    if(*q != '/') {
+                        c.texcoord = resolve_index(strtol(q, &next, 10), texcoords.size() / 2);
+                        q = next;
+                    }
+                    if(q < eol && *q == '/') {
+                        c.normal = resolve_index(strtol(q + 1, &next, 10), normals.size() / 3);
+                        q = next;
+                    }
+                }
+                if(c.position < 0) {
+                    gl_log_err("ERROR: %s:%i: bad face index\n", path, line);
+                    return false;
+                }
+                polygon.push_back(c);
+                q = skip_spaces(q, eol);
+            }
+            // fan polygons into triangles
+            for(size_t i = 2; i < polygon.size(); i++) {
+                corners.push_back(polygon[0]);
+                corners.push_back(polygon[i - 1]);
+                corners.push_back(polygon[i]);
+            }
+        } else if(eol - p > 7 && strncmp(p, "usemtl ", 7) == 0) {
+            std::string name(p + 7, eol - p - 7);
+            while(!name.empty() && (name[name.size() - 1] == '\r' || name[name.size() - 1] == ' ')) {
+                name.erase(name.size() - 1);
+            }
+            uint32_t material = materials.insert(std::make_pair(name, (uint32_t)materials.size())).first->second;
+            runs.push_back(std::make_pair(corners.size(), material));
+        }
+        p = eol + 1;
+    }
+    if(corners.empty()) {
+        gl_log_err("ERROR: %s has no faces\n", path);
+        return false;
+    }
+
+    bool has_texcoords = !texcoords.empty();
+    bool has_normals = !normals.empty();
+    // float position, then normal and texcoord when the file has them
+    vertex_format_init(&mesh->format);
+    vertex_format_add(&mesh->format, MESH_ATTRIB_POSITION, 3, VERTEX_FLOAT32);
+    if(has_normals) {
+        vertex_format_add(&mesh->format, MESH_ATTRIB_NORMAL, 3, VERTEX_FLOAT32);
+    }
+    if(has_texcoords) {
+        vertex_format_add(&mesh->format, MESH_ATTRIB_TEXCOORD, 2, VERTEX_FLOAT32);
+    }
+    uint32_t stride = (uint32_t)vertex_format_stride(&mesh->format, 0);
+
+    // merge identical corners
+    std::unordered_map<obj_corner, uint32_t, obj_corner_hash> unique;
+    unique.reserve(corners.size());
+    mesh->vertices.clear();
+    mesh->indices.resize(corners.size());
+    for(size_t i = 0; i < corners.size(); i++) {
+        std::pair<std::unordered_map<obj_corner, uint32_t, obj_corner_hash>::iterator, bool> found =
+            unique.insert(std::make_pair(corners[i], (uint32_t)unique.size()));
+        mesh->indices[i] = found.first->second;
+        if(!found.second) {
+            continue;
+        }
+        float vertex[8] = { 0.0f };
+        const obj_corner & c = corners[i];
+        memcpy(vertex, &positions[c.position * 3], 12);
+        int n = 3;
+        if(has_normals) {
+            if(c.normal >= 0) {
+                memcpy(vertex + n, &normals[c.normal * 3], 12);
+            }
+            n += 3;
+        }
+        if(has_texcoords) {
+            if(c.texcoord >= 0) {
+                memcpy(vertex + n, &texcoords[c.texcoord * 2], 8);
+            }
+            n += 2;
+        }
+        const unsigned char * bytes = (const unsigned char *)vertex;
+        mesh->vertices.insert(mesh->vertices.end(), bytes, bytes + stride);
+    }
+    mesh->vertex_count = (uint32_t)unique.size();
+
+    // sub-meshes: one per material run, faces before any usemtl get material 0
+    if(runs.empty() || runs[0].first != 0) {
+        runs.insert(runs.begin(), std::make_pair((size_t)0, (uint32_t)0));
+    }
+    mesh->submeshes.clear();
+    for(size_t r = 0; r < runs.size(); r++) {
+        size_t first = runs[r].first;
+        size_t last = r + 1 < runs.size() ? runs[r + 1].first : corners.size();
+        if(last == first) {
+            continue;
+        }
+        mesh_submesh s;
+        memset(&s, 0, sizeof(s));
+        s.first_index = (uint32_t)first;
+        s.index_count = (uint32_t)(last - first);
+        s.material = runs[r].second;
+        for(int k = 0; k < 3; k++) {
+            s.min[k] = INFINITY;
+            s.max[k] = -INFINITY;
+        }
+        for(size_t i = first; i < last; i++) {
+            const float * v = &positions[corners[i].position * 3];
+            for(int k = 0; k < 3; k++) {
+                s.min[k] = fminf(s.min[k], v[k]);
+                s.max[k] = fmaxf(s.max[k], v[k]);
+            }
+        }
+        mesh->submeshes.push_back(s);
+    }
+
+    stats->positions = positions.size() / 3;
+    stats->corners = corners.size();
+    stats->vertices = mesh->vertex_count;
+    stats->triangles = corners.size() / 3;
+    stats->acmr_before = vertex_cache_acmr(mesh->indices.data(), mesh->indices.size(), VERTEX_CACHE_SIZE);
+    if(optimize) {
+        for(size_t i = 0; i < mesh->submeshes.size(); i++) {
+            const mesh_submesh & s = mesh->submeshes[i];
+            optimize_vertex_cache(&mesh->indices[s.first_index], s.index_count, mesh->vertex_count);
+        }
+        optimize_vertex_fetch(mesh);
+    }
+    stats->acmr_after = vertex_cache_acmr(mesh->indices.data(), mesh->indices.size(), VERTEX_CACHE_SIZE);
+    return true;
+}
+
+// Forsyth's linear-speed vertex cache optimisation: greedily emit the
+// triangle whose vertices score highest, favouring vertices already in a
+// simulated LRU cache and vertices with few triangles left
+static float vertex_score(int cache_position, int remaining) {
+    if(remaining == 0) {
+        return -1.0f;
+    }
+    float score = 0.0f;
+    if(cache_position >= 0) {
+        if(cache_position < 3) {
+            score = 0.75f;
+        } else {
+            score = powf(1.0f - (float)(cache_position - 3) / (VERTEX_CACHE_SIZE - 3), 1.5f);
+        }
+    }
+    return score + 2.0f * powf((float)remaining, -0.5f);
+}
+
+void optimize_vertex_cache(uint32_t * indices, size_t index_count, uint32_t vertex_count) {
+    size_t triangle_count = index_count / 3;
+    if(triangle_count < 2) {
+        return;
+    }
+    std::vector<int> remaining(vertex_count, 0);
+    for(size_t i = 0; i < index_count; i++) {
+        remaining[indices[i]]++;
+    }
+    std::vector<uint32_t> adjacency_offset(vertex_count + 1, 0);
+    for(uint32_t v = 0; v < vertex_count; v++) {
+        adjacency_offset[v + 1] = adjacency_offset[v] + remaining[v];
+    }
+    std::vector<uint32_t> adjacency(index_count);
+    std::vector<uint32_t> fill(adjacency_offset.begin(), adjacency_offset.end() - 1);
+    for(size_t i = 0; i < index_count; i++) {
+        adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+    }
+    std::vector<int> cache_position(vertex_count, -1);
+    std::vector<float> score(vertex_count);
+    for(uint32_t v = 0; v < vertex_count; v++) {
+        score[v] = vertex_score(-1, remaining[v]);
+    }
+    std::vector<float> triangle_score(triangle_count);
+    std::vector<char> emitted(triangle_count, 0);
+    for(size_t t = 0; t < triangle_count; t++) {
+        triangle_score[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+    }
+    std::vector<uint32_t> output;
+    output.reserve(index_count);
+    uint32_t cache[VERTEX_CACHE_SIZE + 3];
+    int cache_count = 0;
+    size_t scan = 0;
+    long best = 0;
+    for(size_t t = 1; t < triangle_count; t++) {
+        if(triangle_score[t] > triangle_score[best]) {
+            best = (long)t;
+        }
+    }
+    while(best >= 0) {
+        emitted[best] = 1;
+        const uint32_t * tri = indices + best * 3;
+        output.insert(output.end(), tri, tri + 3);
+        // move the triangle's vertices to the front of the cache
+        uint32_t next_cache[VERTEX_CACHE_SIZE + 3];
+        int next_count = 0;
+        for(int k = 0; k < 3; k++) {
+            next_cache[next_count++] = tri[k];
+            remaining[tri[k]]--;
+            // drop the triangle from the vertex's live list
+            uint32_t * list = &adjacency[adjacency_offset[tri[k]]];
+            int live = remaining[tri[k]] + 1;
+            for(int a = 0; a < live; a++) {
+                if(list[a] == (uint32_t)best) {
+                    list[a] = list[live - 1];
+                    break;
+                }
+            }
+        }
+        for(int c = 0; c < cache_count; c++) {
+            uint32_t v = cache[c];
+            if(v != tri[0] && v != tri[1] && v != tri[2]) {
+                next_cache[next_count++] = v;
+            }
+        }
+        // rescore everything that was or is in the cache
+        for(int c = 0; c < next_count; c++) {
+            uint32_t v = next_cache[c];
+            cache_position[v] = c < VERTEX_CACHE_SIZE ? c : -1;
+            score[v] = vertex_score(cache_position[v], remaining[v]);
+        }
+        best = -1;
+        float best_score = -1.0f;
+        for(int c = 0; c < next_count; c++) {
+            uint32_t v = next_cache[c];
+            const uint32_t * list = &adjacency[adjacency_offset[v]];
+            for(int a = 0; a < remaining[v]; a++) {
+                uint32_t t = list[a];
+                const uint32_t * n = indices + t * 3;
+                triangle_score[t] = score[n[0]] + score[n[1]] + score[n[2]];
+                if(triangle_score[t] > best_score) {
+                    best_score = triangle_score[t];
+                    best = (long)t;
+                }
+            }
+        }
+        cache_count = next_count < VERTEX_CACHE_SIZE ? next_count : VERTEX_CACHE_SIZE;
+        memcpy(cache, next_cache, cache_count * sizeof(uint32_t));
+        if(best < 0) {
+            // nothing adjacent to the cache is left: take the next unemitted triangle
+            while(scan < triangle_count && emitted[scan]) {
+                scan++;
+            }
+            best = scan < triangle_count ? (long)scan : -1;
+        }
+    }
+    memcpy(indices, output.data(), index_count * sizeof(uint32_t));
+}
+
+// renumber vertices in the order the index buffer first touches them
+void optimize_vertex_fetch(mesh_data * mesh) {
+    std::vector<uint32_t> remap(mesh->vertex_count, 0xffffffffu);
+    std::vector<unsigned char> vertices(mesh->vertices.size());
+    uint32_t next = 0;
+    uint32_t stride = (uint32_t)vertex_format_stride(&mesh->format, 0);
+    for(size_t i = 0; i < mesh->indices.size(); i++) {
+        uint32_t v = mesh->indices[i];
+        if(remap[v] == 0xffffffffu) {
+            remap[v] = next;
+            memcpy(&vertices[(size_t)next * stride], &mesh->vertices[(size_t)v * stride], stride);
+            next++;
+        }
+        mesh->indices[i] = remap[v];
+    }
+    vertices.resize((size_t)next * stride);
+    mesh->vertices.swap(vertices);
+    mesh->vertex_count = next;
+}
+
+// average cache misses per triangle with a FIFO post-transform cache
+float vertex_cache_acmr(const uint32_t * indices, size_t index_count, int cache_size) {
+    if(index_count < 3) {
+        return 0.0f;
+    }
+    std::vector<uint32_t> fifo(cache_size, 0xffffffffu);
+    int head = 0;
+    size_t misses = 0;
+    for(size_t i = 0; i < index_count; i++) {
+        bool hit = false;
+        for(int c = 0; c < cache_size; c++) {
+            if(fifo[c] == indices[i]) {
+                hit = true;
+                break;
+            }
+        }
+        if(!hit) {
+            fifo[head] = indices[i];
+            head = (head + 1) % cache_size;
+            misses++;
+        }
+    }
+    return (float)misses / (index_count / 3);
+}
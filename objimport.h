@@ -0,0 +1,25 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "meshfile.h"
+
+// Wavefront OBJ import for the mesh converter and the load benchmark:
+// positions, texture coordinates and normals, polygons fanned into
+// triangles, one sub-mesh per usemtl run. Identical position/uv/normal
+// corners are merged into one vertex; triangles are then reordered for the
+// post-transform cache and vertices renumbered in first-use order.
+#define VERTEX_CACHE_SIZE 32
+
+struct obj_import_stats {
+    size_t positions;
+    size_t corners;
+    size_t vertices;
+    size_t triangles;
+    float acmr_before;
+    float acmr_after;
+};
+
+bool obj_load(const char * path, bool optimize, mesh_data * mesh, obj_import_stats * stats);
+void optimize_vertex_cache(uint32_t * indices, size_t index_count, uint32_t vertex_count);
+void optimize_vertex_fetch(mesh_data * mesh);
+float vertex_cache_acmr(const uint32_t * indices, size_t index_count, int cache_size);
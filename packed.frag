@@ -0,0 +1,9 @@
+#version 410
+
+in vec3 normal;
+in vec2 texcoord;
+out vec4 frag_colour;
+
+void main() {
+   frag_colour = vec4(normalize(normal) * 0.5 + 0.5, 1.0) * (0.75 + 0.25 * texcoord.x);
+};
@@ -0,0 +1,16 @@
+#version 410
+
+layout(location = 0) in vec3 vertex_position;
+layout(location = 2) in vec3 vertex_normal;
+layout(location = 3) in vec2 vertex_texcoord;
+// unorm16 positions arrive in [0, 1]; float and half ones use scale 1, bias 0
+uniform vec3 position_scale;
+uniform vec3 position_bias;
+out vec3 normal;
+out vec2 texcoord;
+
+void main() {
+    normal = vertex_normal;
+    texcoord = vertex_texcoord;
+    gl_Position = vec4((vertex_position * position_scale + position_bias) * 0.9, 1.0);
+};
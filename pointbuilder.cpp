@@ -0,0 +1,617 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "logging.h"
+#include "frametiming.h"
+#include "pointcloud.h"
+#include "pointbuilder.h"
+
+// point counts for pass 2 live on a 2^7 grid per axis (8 MB of counters)
+#define BUILD_COUNT_DEPTH 7
+#define BUILD_COUNT_CELLS (1 << BUILD_COUNT_DEPTH)
+// beyond this, points that do not fit a node are dropped (duplicates)
+#define BUILD_MAX_DEPTH 24
+#define BUILD_BATCH 65536
+#define BUILD_GRID_BYTES (POINT_NODE_GRID * POINT_NODE_GRID * POINT_NODE_GRID / 8)
+// synthetic trees stand on a grid this many units apart
+#define SYNTHETIC_TREE_SPACING 40.0f
+
+struct build_bucket {
+    point_input * buffer;
+    size_t buffered;
+    uint64_t count;
+    // offsets of spilled full blocks in the temporary file
+    std::vector<uint64_t> blocks;
+};
+
+struct build_node {
+    float min[3];
+    float size;
+    int depth;
+    int children[8];
+    // above the cut: samples points during pass 3; at the cut: a chunk
+    bool chunk;
+    int bucket;
+    unsigned char * grid;
+    uint32_t taken;
+    uint64_t first_point;
+    uint32_t point_count;
+};
+
+struct point_builder {
+    point_source * source;
+    point_build_options options;
+    point_build_stats * stats;
+    float min[3];
+    float size;
+    // pass 2 counts, one level per depth, finest last
+    std::vector<uint32_t> counts[BUILD_COUNT_DEPTH + 1];
+    uint64_t chunk_points;
+    std::vector<build_node> nodes;
+    std::vector<build_bucket> buckets;
+    size_t block_points;
+    FILE * temp;
+    FILE * out;
+    uint64_t points_written;
+    std::vector<point_record> records;
+    unsigned char grid[BUILD_GRID_BYTES];
+};
+
+static size_t read_file_points(point_source * source, uint64_t first, point_input * points, size_t capacity) {
+    if(first >= source->count) {
+        return 0;
+    }
+    size_t n = (size_t)std::min((uint64_t)capacity, source->count - first);
+    if(fseeko(source->file, (off_t)(first * sizeof(point_input)), SEEK_SET) != 0) {
+        return 0;
+    }
+    return fread(points, sizeof(point_input), n, source->file);
+}
+
+bool point_source_open_file(const char * path, point_source * source) {
+    memset(source, 0, sizeof(*source));
+    source->file = fopen(path, "rb");
+    if(!source->file) {
+        gl_log_err("ERROR: could not open point input %s\n", path);
+        return false;
+    }
+    fseeko(source->file, 0, SEEK_END);
+    source->count = (uint64_t)ftello(source->file) / sizeof(point_input);
+    source->read = read_file_points;
+    return true;
+}
+
+static uint64_t hash64(uint64_t x) {
+    // splitmix64 finalizer
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static float unit(uint64_t bits) {
+    return (bits & 0xffffff) / 16777216.0f;
+}
+
+static float terrain_height(float x, float z, float extent) {
+    float h = 0.0f;
+    float amplitude = extent * 0.03f;
+    float frequency = 6.2831853f * 1.5f / extent;
+    for(int octave = 0; octave < 6; octave++) {
+        h += amplitude * sinf(x * frequency + octave * 1.7f) * cosf(z * frequency * 1.31f + octave * 0.9f);
+        amplitude *= 0.45f;
+        frequency *= 2.13f;
+    }
+    return h;
+}
+
+static void set_color(point_input * p, float r, float g, float b, float noise) {
+    float c[3] = { r, g, b };
+    for(int i = 0; i < 3; i++) {
+        float v = (c[i] + noise) * 255.0f;
+        p->color[i] = (uint8_t)std::min(std::max(v, 0.0f), 255.0f);
+    }
+    p->color[3] = 255;
+}
+
+// y is up; one point in ten is on a tree crown
+static size_t read_synthetic_points(point_source * source, uint64_t first, point_input * points, size_t capacity) {
+    if(first >= source->count) {
+        return 0;
+    }
+    size_t n = (size_t)std::min((uint64_t)capacity, source->count - first);
+    float extent = source->extent;
+    int trees_per_row = (int)(extent / SYNTHETIC_TREE_SPACING);
+    for(size_t i = 0; i < n; i++) {
+        uint64_t r = hash64(first + i);
+        uint64_t s = hash64(r);
+        point_input & p = points[i];
+        float noise = (unit(s >> 40) - 0.5f) * 0.1f;
+        if(r % 10 == 0 && trees_per_row > 0) {
+            // a crown: a sphere on a trunk, at a jittered grid position
+            uint64_t tree = (s >> 8) % ((uint64_t)trees_per_row * trees_per_row);
+            uint64_t t = hash64(tree);
+            float cx = ((tree % trees_per_row) + 0.2f + 0.6f * unit(t)) * SYNTHETIC_TREE_SPACING;
+            float cz = ((tree / trees_per_row) + 0.2f + 0.6f * unit(t >> 24)) * SYNTHETIC_TREE_SPACING;
+            float radius = 3.0f + 3.0f * unit(t >> 48);
+            float cy = terrain_height(cx, cz, extent) + radius * 1.6f;
+            float theta = 6.2831853f * unit(r >> 8);
+            float cos_phi = 2.0f * unit(r >> 32) - 1.0f;
+            float sin_phi = sqrtf(1.0f - cos_phi * cos_phi);
+            p.position[0] = cx + radius * sin_phi * cosf(theta);
+            p.position[1] = cy + radius * cos_phi;
+            p.position[2] = cz + radius * sin_phi * sinf(theta);
+            set_color(&p, 0.15f, 0.45f + 0.2f * unit(t >> 12), 0.12f, noise);
+        } else {
+            float x = unit(r >> 8) * extent;
+            float z = unit(r >> 32) * extent;
+            float y = terrain_height(x, z, extent);
+            p.position[0] = x;
+            p.position[1] = y;
+            p.position[2] = z;
+            // grass low, rock higher up, snow on the peaks
+            float t = y / (extent * 0.05f);
+            if(t < 0.3f) {
+                set_color(&p, 0.30f, 0.55f, 0.20f, noise);
+            } else if(t < 0.8f) {
+                set_color(&p, 0.50f, 0.42f, 0.33f, noise);
+            } else {
+                set_color(&p, 0.92f, 0.92f, 0.95f, noise);
+            }
+        }
+    }
+    return n;
+}
+
+void point_source_synthetic(uint64_t count, point_source * source) {
+    memset(source, 0, sizeof(*source));
+    source->count = count;
+    source->read = read_synthetic_points;
+    // about six points per square unit of ground
+    source->extent = std::max(256.0f, sqrtf((float)count / 6.0f));
+}
+
+void point_source_close(point_source * source) {
+    if(source->file) {
+        fclose(source->file);
+        source->file = NULL;
+    }
+}
+
+static int count_index(int depth, int x, int y, int z) {
+    int cells = 1 << depth;
+    return (x * cells + y) * cells + z;
+}
+
+static void count_cell(const point_builder * b, const point_input & p, int cell[3]) {
+    for(int a = 0; a < 3; a++) {
+        int c = (int)((p.position[a] - b->min[a]) / b->size * BUILD_COUNT_CELLS);
+        cell[a] = std::min(std::max(c, 0), BUILD_COUNT_CELLS - 1);
+    }
+}
+
+static int grid_cell(const build_node & node, const point_input & p) {
+    int g[3];
+    for(int a = 0; a < 3; a++) {
+        int c = (int)((p.position[a] - node.min[a]) / node.size * POINT_NODE_GRID);
+        g[a] = std::min(std::max(c, 0), POINT_NODE_GRID - 1);
+    }
+    return (g[0] * POINT_NODE_GRID + g[1]) * POINT_NODE_GRID + g[2];
+}
+
+// claims the point's sampling cell if it is free and the node has room
+static bool claim_cell(unsigned char * grid, uint32_t * taken, int cell) {
+    if(*taken >= POINT_NODE_MAX || (grid[cell >> 3] & (1 << (cell & 7)))) {
+        return false;
+    }
+    grid[cell >> 3] |= (unsigned char)(1 << (cell & 7));
+    (*taken)++;
+    return true;
+}
+
+static int add_node(point_builder * b, const float min[3], float size, int depth) {
+    build_node node;
+    memset(&node, 0, sizeof(node));
+    memcpy(node.min, min, sizeof(node.min));
+    node.size = size;
+    node.depth = depth;
+    node.bucket = -1;
+    for(int o = 0; o < 8; o++) {
+        node.children[o] = -1;
+    }
+    b->nodes.push_back(node);
+    b->stats->depth = std::max(b->stats->depth, (uint32_t)depth);
+    return (int)b->nodes.size() - 1;
+}
+
+static void octant_min(const float parent[3], float half, int octant, float out[3]) {
+    out[0] = parent[0] + ((octant & 1) ? half : 0.0f);
+    out[1] = parent[1] + ((octant & 2) ? half : 0.0f);
+    out[2] = parent[2] + ((octant & 4) ? half : 0.0f);
+}
+
+// above the cut while a node covers more points than fit in memory at once
+static int create_hierarchy(point_builder * b, int depth, int x, int y, int z) {
+    float size = b->size / (float)(1 << depth);
+    float min[3] = { b->min[0] + x * size, b->min[1] + y * size, b->min[2] + z * size };
+    int index = add_node(b, min, size, depth);
+    uint64_t count = b->counts[depth][count_index(depth, x, y, z)];
+    b->nodes[index].bucket = (int)b->buckets.size();
+    b->buckets.push_back(build_bucket());
+    if(count <= b->chunk_points || depth == BUILD_COUNT_DEPTH) {
+        b->nodes[index].chunk = true;
+        b->stats->chunks++;
+        return index;
+    }
+    b->nodes[index].grid = (unsigned char *)calloc(1, BUILD_GRID_BYTES);
+    for(int o = 0; o < 8; o++) {
+        int cx = x * 2 + (o & 1), cy = y * 2 + ((o >> 1) & 1), cz = z * 2 + ((o >> 2) & 1);
+        if(b->counts[depth + 1][count_index(depth + 1, cx, cy, cz)] > 0) {
+            int child = create_hierarchy(b, depth + 1, cx, cy, cz);
+            b->nodes[index].children[o] = child;
+        }
+    }
+    return index;
+}
+
+static bool bucket_append(point_builder * b, build_bucket * bucket, const point_input & p) {
+    if(!bucket->buffer) {
+        bucket->buffer = (point_input *)malloc(b->block_points * sizeof(point_input));
+        if(!bucket->buffer) {
+            gl_log_err("ERROR: out of memory for point cloud bucket buffers\n");
+            return false;
+        }
+    }
+    bucket->buffer[bucket->buffered++] = p;
+    bucket->count++;
+    if(bucket->buffered == b->block_points) {
+        bucket->blocks.push_back(b->stats->temp_bytes);
+        if(fwrite(bucket->buffer, sizeof(point_input), b->block_points, b->temp) != b->block_points) {
+            gl_log_err("ERROR: could not write the point cloud temporary file %s\n", b->options.temp_path);
+            return false;
+        }
+        b->stats->temp_bytes += b->block_points * sizeof(point_input);
+        bucket->buffered = 0;
+    }
+    return true;
+}
+
+static bool bucket_read(point_builder * b, build_bucket * bucket, std::vector<point_input> & points) {
+    points.resize(bucket->count);
+    size_t n = 0;
+    for(size_t i = 0; i < bucket->blocks.size(); i++) {
+        if(fseeko(b->temp, (off_t)bucket->blocks[i], SEEK_SET) != 0
+                || fread(&points[n], sizeof(point_input), b->block_points, b->temp) != b->block_points) {
+            gl_log_err("ERROR: could not read back the point cloud temporary file %s\n", b->options.temp_path);
+            return false;
+        }
+        n += b->block_points;
+    }
+    if(bucket->buffered) {
+        memcpy(&points[n], bucket->buffer, bucket->buffered * sizeof(point_input));
+    }
+    free(bucket->buffer);
+    bucket->buffer = NULL;
+    bucket->blocks.clear();
+    return true;
+}
+
+static bool write_node_points(point_builder * b, int index, const point_input * points, size_t count) {
+    build_node & node = b->nodes[index];
+    node.first_point = b->points_written;
+    node.point_count = (uint32_t)count;
+    b->records.resize(count);
+    float scale = 65535.0f / node.size;
+    for(size_t i = 0; i < count; i++) {
+        point_record & r = b->records[i];
+        for(int a = 0; a < 3; a++) {
+            float q = (points[i].position[a] - node.min[a]) * scale + 0.5f;
+            r.position[a] = (uint16_t)std::min(std::max(q, 0.0f), 65535.0f);
+        }
+        r.pad = 0;
+        memcpy(r.color, points[i].color, 4);
+    }
+    if(fwrite(b->records.data(), sizeof(point_record), count, b->out) != count) {
+        gl_log_err("ERROR: could not write point data\n");
+        return false;
+    }
+    b->points_written += count;
+    return true;
+}
+
+// in memory below the cut: sample this node, split the rest by octant, recurse
+static bool build_subtree(point_builder * b, int index, point_input * points, size_t count, point_input * scratch) {
+    int depth = b->nodes[index].depth;
+    if(count <= POINT_NODE_MAX || depth >= BUILD_MAX_DEPTH) {
+        size_t kept = std::min(count, (size_t)POINT_NODE_MAX);
+        b->stats->dropped += count - kept;
+        return write_node_points(b, index, points, kept);
+    }
+    memset(b->grid, 0, sizeof(b->grid));
+    uint32_t taken = 0;
+    for(size_t i = 0; i < count && taken < POINT_NODE_MAX; i++) {
+        uint32_t before = taken;
+        if(claim_cell(b->grid, &taken, grid_cell(b->nodes[index], points[i]))) {
+            std::swap(points[i], points[before]);
+        }
+    }
+    if(!write_node_points(b, index, points, taken)) {
+        return false;
+    }
+    point_input * rest = points + taken;
+    size_t remaining = count - taken;
+    float min[3];
+    memcpy(min, b->nodes[index].min, sizeof(min));
+    float half = b->nodes[index].size * 0.5f;
+    size_t offsets[9] = { 0 };
+    for(size_t i = 0; i < remaining; i++) {
+        const float * p = rest[i].position;
+        int o = (p[0] >= min[0] + half) | ((p[1] >= min[1] + half) << 1) | ((p[2] >= min[2] + half) << 2);
+        offsets[o + 1]++;
+    }
+    for(int o = 0; o < 8; o++) {
+        offsets[o + 1] += offsets[o];
+    }
+    size_t fill[8];
+    memcpy(fill, offsets, sizeof(fill));
+    for(size_t i = 0; i < remaining; i++) {
+        const float * p = rest[i].position;
+        int o = (p[0] >= min[0] + half) | ((p[1] >= min[1] + half) << 1) | ((p[2] >= min[2] + half) << 2);
+        scratch[fill[o]++] = rest[i];
+    }
+    memcpy(rest, scratch, remaining * sizeof(point_input));
+    for(int o = 0; o < 8; o++) {
+        size_t n = offsets[o + 1] - offsets[o];
+        if(n == 0) {
+            continue;
+        }
+        float child_min[3];
+        octant_min(min, half, o, child_min);
+        int child = add_node(b, child_min, half, depth + 1);
+        b->nodes[index].children[o] = child;
+        if(!build_subtree(b, child, rest + offsets[o], n, scratch)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool bounds_pass(point_builder * b, point_input * batch) {
+    float lo[3] = { 1e30f, 1e30f, 1e30f };
+    float hi[3] = { -1e30f, -1e30f, -1e30f };
+    for(uint64_t first = 0; first < b->source->count; first += BUILD_BATCH) {
+        size_t n = b->source->read(b->source, first, batch, BUILD_BATCH);
+        for(size_t i = 0; i < n; i++) {
+            for(int a = 0; a < 3; a++) {
+                lo[a] = std::min(lo[a], batch[i].position[a]);
+                hi[a] = std::max(hi[a], batch[i].position[a]);
+            }
+        }
+    }
+    float size = std::max(std::max(hi[0] - lo[0], hi[1] - lo[1]), hi[2] - lo[2]);
+    if(!(size >= 0.0f)) {
+        gl_log_err("ERROR: point input has no points with finite positions\n");
+        return false;
+    }
+    // a little slack so the far faces fall inside the last cells
+    size = std::max(size * 1.0001f, 1e-3f);
+    memcpy(b->min, lo, sizeof(lo));
+    b->size = size;
+    return true;
+}
+
+static void count_pass(point_builder * b, point_input * batch) {
+    b->counts[BUILD_COUNT_DEPTH].assign((size_t)1 << (3 * BUILD_COUNT_DEPTH), 0);
+    std::vector<uint32_t> & finest = b->counts[BUILD_COUNT_DEPTH];
+    for(uint64_t first = 0; first < b->source->count; first += BUILD_BATCH) {
+        size_t n = b->source->read(b->source, first, batch, BUILD_BATCH);
+        for(size_t i = 0; i < n; i++) {
+            int c[3];
+            count_cell(b, batch[i], c);
+            finest[count_index(BUILD_COUNT_DEPTH, c[0], c[1], c[2])]++;
+        }
+    }
+    for(int depth = BUILD_COUNT_DEPTH - 1; depth >= 0; depth--) {
+        int cells = 1 << depth;
+        b->counts[depth].assign((size_t)cells * cells * cells, 0);
+        for(int x = 0; x < cells; x++) {
+            for(int y = 0; y < cells; y++) {
+                for(int z = 0; z < cells; z++) {
+                    uint32_t sum = 0;
+                    for(int o = 0; o < 8; o++) {
+                        sum += b->counts[depth + 1][count_index(depth + 1, x * 2 + (o & 1), y * 2 + ((o >> 1) & 1),
+                            z * 2 + ((o >> 2) & 1))];
+                    }
+                    b->counts[depth][count_index(depth, x, y, z)] = sum;
+                }
+            }
+        }
+    }
+}
+
+static bool distribute_pass(point_builder * b, point_input * batch) {
+    for(uint64_t first = 0; first < b->source->count; first += BUILD_BATCH) {
+        size_t n = b->source->read(b->source, first, batch, BUILD_BATCH);
+        for(size_t i = 0; i < n; i++) {
+            const point_input & p = batch[i];
+            int c[3];
+            count_cell(b, p, c);
+            int index = 0;
+            for(;;) {
+                build_node & node = b->nodes[index];
+                if(node.chunk || claim_cell(node.grid, &node.taken, grid_cell(node, p))) {
+                    if(!bucket_append(b, &b->buckets[node.bucket], p)) {
+                        return false;
+                    }
+                    break;
+                }
+                // the octant follows the count grid's bits, so it always has a child
+                int shift = BUILD_COUNT_DEPTH - 1 - node.depth;
+                int o = ((c[0] >> shift) & 1) | (((c[1] >> shift) & 1) << 1) | (((c[2] >> shift) & 1) << 2);
+                index = node.children[o];
+            }
+        }
+    }
+    return true;
+}
+
+static bool build_chunks(point_builder * b) {
+    std::vector<point_input> points;
+    std::vector<point_input> scratch;
+    size_t upper_nodes = b->nodes.size();
+    for(size_t i = 0; i < upper_nodes; i++) {
+        build_bucket * bucket = &b->buckets[b->nodes[i].bucket];
+        if(!bucket_read(b, bucket, points)) {
+            return false;
+        }
+        if(!b->nodes[i].chunk) {
+            free(b->nodes[i].grid);
+            b->nodes[i].grid = NULL;
+            if(!write_node_points(b, (int)i, points.data(), points.size())) {
+                return false;
+            }
+            continue;
+        }
+        b->stats->largest_chunk = std::max(b->stats->largest_chunk, (uint64_t)points.size());
+        scratch.resize(points.size());
+        if(!points.empty() && !build_subtree(b, (int)i, points.data(), points.size(), scratch.data())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool node_empty(const build_node & node) {
+    if(node.point_count > 0) {
+        return false;
+    }
+    for(int o = 0; o < 8; o++) {
+        if(node.children[o] >= 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool write_node_table(point_builder * b, point_cloud_header * header) {
+    // breadth first, so every node's children are contiguous
+    std::vector<int> order;
+    std::vector<point_node> table;
+    order.push_back(0);
+    for(size_t i = 0; i < order.size(); i++) {
+        const build_node & node = b->nodes[order[i]];
+        point_node out;
+        memset(&out, 0, sizeof(out));
+        memcpy(out.min, node.min, sizeof(out.min));
+        out.size = node.size;
+        out.first_point = node.first_point;
+        out.point_count = node.point_count;
+        out.depth = (uint8_t)node.depth;
+        out.first_child = POINT_NODE_NONE;
+        for(int o = 0; o < 8; o++) {
+            int child = node.children[o];
+            if(child < 0 || node_empty(b->nodes[child])) {
+                continue;
+            }
+            if(out.first_child == POINT_NODE_NONE) {
+                out.first_child = (uint32_t)order.size();
+            }
+            out.child_mask |= (uint8_t)(1 << o);
+            order.push_back(child);
+        }
+        table.push_back(out);
+    }
+    uint64_t end = header->points_offset + b->points_written * sizeof(point_record);
+    header->nodes_offset = (end + POINT_CLOUD_ALIGN - 1) / POINT_CLOUD_ALIGN * POINT_CLOUD_ALIGN;
+    header->node_count = (uint32_t)table.size();
+    static const char padding[POINT_CLOUD_ALIGN] = { 0 };
+    b->stats->nodes = header->node_count;
+    return fwrite(padding, 1, header->nodes_offset - end, b->out) == header->nodes_offset - end
+        && fwrite(table.data(), sizeof(point_node), table.size(), b->out) == table.size();
+}
+
+bool point_cloud_build(point_source * source, const char * path, const point_build_options * options,
+    point_build_stats * stats) {
+    memset(stats, 0, sizeof(*stats));
+    if(source->count == 0) {
+        gl_log_err("ERROR: no points to build %s from\n", path);
+        return false;
+    }
+    // big: the sampling grid and the count pyramid
+    point_builder * b = new point_builder();
+    b->source = source;
+    b->options = *options;
+    b->stats = stats;
+    // a chunk and its partition scratch have to fit in memory together
+    b->chunk_points = std::max((uint64_t)POINT_NODE_MAX, (uint64_t)(options->memory_bytes / (2 * sizeof(point_input))));
+    std::vector<point_input> batch(BUILD_BATCH);
+    bool ok = false;
+    double start = frame_timing_seconds();
+    b->temp = fopen(options->temp_path, "w+b");
+    b->out = fopen(path, "wb");
+    if(!b->temp || !b->out) {
+        gl_log_err("ERROR: could not create %s or the temporary file %s\n", path, options->temp_path);
+    } else if(bounds_pass(b, batch.data())) {
+        stats->seconds[0] = frame_timing_seconds() - start;
+        count_pass(b, batch.data());
+        stats->seconds[1] = frame_timing_seconds() - start - stats->seconds[0];
+        create_hierarchy(b, 0, 0, 0, 0);
+        for(int d = 0; d <= BUILD_COUNT_DEPTH; d++) {
+            std::vector<uint32_t>().swap(b->counts[d]);
+        }
+        // bucket buffers get a quarter of the memory, the rest is for chunks
+        b->block_points = std::min((size_t)65536, std::max((size_t)256,
+            options->memory_bytes / 4 / sizeof(point_input) / b->buckets.size()));
+        point_cloud_header header;
+        memset(&header, 0, sizeof(header));
+        header.points_offset = sizeof(point_cloud_header);
+        // placeholder until the node table is known
+        fwrite(&header, sizeof(header), 1, b->out);
+        if(distribute_pass(b, batch.data())) {
+            stats->seconds[2] = frame_timing_seconds() - start - stats->seconds[0] - stats->seconds[1];
+            if(build_chunks(b) && write_node_table(b, &header)) {
+                memcpy(header.magic, POINT_CLOUD_MAGIC, 4);
+                header.version = POINT_CLOUD_VERSION;
+                header.point_count = b->points_written;
+                header.node_max = POINT_NODE_MAX;
+                header.grid = POINT_NODE_GRID;
+                header.depth = stats->depth;
+                memcpy(header.min, b->min, sizeof(header.min));
+                header.size = b->size;
+                ok = fseeko(b->out, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, b->out) == 1;
+            }
+            stats->seconds[3] = frame_timing_seconds() - start - stats->seconds[0] - stats->seconds[1]
+                - stats->seconds[2];
+        }
+    }
+    stats->points = b->points_written;
+    for(size_t i = 0; i < b->nodes.size(); i++) {
+        free(b->nodes[i].grid);
+    }
+    for(size_t i = 0; i < b->buckets.size(); i++) {
+        free(b->buckets[i].buffer);
+    }
+    if(b->temp) {
+        fclose(b->temp);
+        remove(options->temp_path);
+    }
+    if(b->out && fclose(b->out) != 0) {
+        ok = false;
+    }
+    delete b;
+    if(!ok) {
+        gl_log_err("ERROR: could not build point cloud %s\n", path);
+        remove(path);
+        return false;
+    }
+    gl_log("point cloud %s: %llu points (%llu dropped), %u nodes, depth %u, %u chunks (largest %llu points)\n", path,
+        (unsigned long long)stats->points, (unsigned long long)stats->dropped, stats->nodes, stats->depth,
+        stats->chunks, (unsigned long long)stats->largest_chunk);
+    gl_log("  passes: bounds %.1f s, counts %.1f s, distribute %.1f s, chunks %.1f s; %.1f MB spilled\n",
+        stats->seconds[0], stats->seconds[1], stats->seconds[2], stats->seconds[3],
+        stats->temp_bytes / (1024.0 * 1024.0));
+    return true;
+}
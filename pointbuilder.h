@@ -0,0 +1,56 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Offline builder for the point cloud octree in pointcloud.h, for inputs
+// far larger than memory. The input is streamed three times:
+//   1. bounds, which fix the root cube
+//   2. point counts on a fine grid, which decide where the tree is cut
+//      into chunks small enough to build in memory
+//   3. distribution: walking down from the root, each point lands in the
+//      first node above the cut with a free sampling cell, or else in its
+//      chunk; node and chunk buckets spill to a temporary file in blocks
+// then each chunk is read back and its subtree built in memory, and the
+// node table is written last, in breadth-first order.
+//
+// Raw input files are packed point_input records.
+struct point_input {
+    float position[3];
+    uint8_t color[4];
+};
+
+// read fills points with up to capacity records from index first on and
+// returns how many it wrote; every pass starts again from index 0
+struct point_source {
+    uint64_t count;
+    size_t (*read)(point_source * source, uint64_t first, point_input * points, size_t capacity);
+    FILE * file;
+    // synthetic terrain edge length, in units
+    float extent;
+};
+
+struct point_build_options {
+    // for the in-memory chunk builds plus the bucket buffers
+    size_t memory_bytes;
+    const char * temp_path;
+};
+
+struct point_build_stats {
+    uint64_t points;
+    uint64_t dropped;
+    uint32_t nodes;
+    uint32_t depth;
+    uint32_t chunks;
+    uint64_t largest_chunk;
+    unsigned long long temp_bytes;
+    double seconds[4];
+};
+
+bool point_source_open_file(const char * path, point_source * source);
+// terrain with trees, generated from each point's index so any pass
+// reproduces it without storing anything
+void point_source_synthetic(uint64_t count, point_source * source);
+void point_source_close(point_source * source);
+bool point_cloud_build(point_source * source, const char * path, const point_build_options * options,
+    point_build_stats * stats);
@@ -0,0 +1,223 @@
+#include <GL/glew.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <thread>
+#include "logging.h"
+#include "shadermanager.h"
+#include "frametiming.h"
+#include "headless.h"
+#include "glstate.h"
+#include "jobsystem.h"
+#include "vecmath.h"
+#include "pointcloud.h"
+#include "pointbuilder.h"
+#include "glcapture.h"
+
+// Out-of-core point cloud benchmark: builds a synthetic terrain of
+// --points points (100M by default, about 1.2 GB on disk) once with the
+// offline builder, then flies a camera low over it in a circle. Every
+// frame selects nodes by screen-space error under the point budget,
+// streams missing ones in from the mapped file and draws the selection.
+// Reports points drawn per second, frame times and how long nodes take
+// from request to resident. --cold drops the file from the page cache
+// first, so the loads include the disk.
+//   pointcloud-bench [--points N] [--file F] [--rebuild] [--budget POINTS]
+//                    [--gpu-mb MB] [--cold] [--frames N] [--size WxH]
+
+#define POINT_BENCH_FRAMES 600
+// one lap takes this many frames
+#define POINT_BENCH_LAP 1200
+#define POINT_BENCH_FOVY 1.0f
+
+struct bench_options {
+    unsigned long long points;
+    const char * file;
+    bool rebuild;
+    long budget;
+    size_t gpu_mb;
+    bool cold;
+};
+
+static bool parse_bench_args(int * argc, char ** argv, bench_options * options) {
+    options->points = 100000000ULL;
+    options->file = "pointcloud-bench.pcl";
+    options->rebuild = false;
+    options->budget = 2000000;
+    options->gpu_mb = 256;
+    options->cold = false;
+    int kept = 1;
+    for(int i = 1; i < *argc; i++) {
+        if(!strcmp(argv[i], "--points") && i + 1 < *argc) {
+            options->points = strtoull(argv[++i], NULL, 10);
+        } else if(!strcmp(argv[i], "--file") && i + 1 < *argc) {
+            options->file = argv[++i];
+        } else if(!strcmp(argv[i], "--rebuild")) {
+            options->rebuild = true;
+        } else if(!strcmp(argv[i], "--budget") && i + 1 < *argc) {
+            options->budget = atol(argv[++i]);
+        } else if(!strcmp(argv[i], "--gpu-mb") && i + 1 < *argc) {
+            options->gpu_mb = strtoul(argv[++i], NULL, 10);
+        } else if(!strcmp(argv[i], "--cold")) {
+            options->cold = true;
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    *argc = kept;
+    argv[kept] = NULL;
+    if(options->points == 0 || options->budget <= 0 || options->gpu_mb == 0) {
+        fprintf(stderr, "--points, --budget and --gpu-mb expect positive numbers\n");
+        return false;
+    }
+    return true;
+}
+
+// the existing file is reused when it holds the asked-for number of points
+static bool ensure_built(const bench_options * options) {
+    struct stat st;
+    if(!options->rebuild && stat(options->file, &st) == 0) {
+        point_cloud cloud;
+        if(point_cloud_open(options->file, &cloud)) {
+            bool same = cloud.header->point_count == options->points;
+            point_cloud_close(&cloud);
+            if(same) {
+                return true;
+            }
+        }
+    }
+    gl_log("building %s from %llu synthetic points\n", options->file, options->points);
+    char temp_path[512];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", options->file);
+    point_build_options build;
+    build.memory_bytes = 512ULL * 1024 * 1024;
+    build.temp_path = temp_path;
+    point_source source;
+    point_source_synthetic(options->points, &source);
+    point_build_stats stats;
+    return point_cloud_build(&source, options->file, &build, &stats);
+}
+
+// written pages have to reach the disk before the kernel will drop them
+static void drop_page_cache(const char * path) {
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        return;
+    }
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+int main(int argc, char ** argv) {
+    bench_options bench;
+    if(!parse_bench_args(&argc, argv, &bench)) {
+        return 1;
+    }
+    headless_options options;
+    if(!parse_headless_args(argc, argv, &options)) {
+        return 1;
+    }
+    options.enabled = true;
+    int frames = options.frames > 0 ? (int)options.frames : POINT_BENCH_FRAMES;
+    if(!restart_gl_log()) {
+        fprintf(stderr, "Failed to open log file\n");
+        return 1;
+    }
+    if(!ensure_built(&bench)) {
+        return 4;
+    }
+    if(bench.cold) {
+        drop_page_cache(bench.file);
+    }
+    if(!headless_init(&options)) {
+        return 2;
+    }
+    gl_state_reset();
+    gl_state_viewport(0, 0, options.width, options.height);
+    gl_state_enable(GL_DEPTH_TEST, true);
+    gl_state_depth_func(GL_LESS);
+    gl_state_point_size(2.0f);
+    GLuint program = build_shader_program("./pointcloud.vert", "./pointcloud.frag");
+    if(!program) {
+        return 3;
+    }
+    // node loads need a worker besides the render thread, even on one core
+    job_system_init(std::max(2, (int)std::thread::hardware_concurrency()));
+    point_cloud cloud;
+    if(!point_cloud_open(bench.file, &cloud)) {
+        return 5;
+    }
+    point_renderer_options renderer_options;
+    renderer_options.point_budget = bench.budget;
+    renderer_options.gpu_bytes = bench.gpu_mb * 1024 * 1024;
+    renderer_options.upload_bytes = 16 * 1024 * 1024;
+    renderer_options.pixel_error = 2.0f;
+    point_renderer renderer;
+    if(!point_renderer_init(&renderer, &cloud, &renderer_options)) {
+        return 5;
+    }
+    glClearColor(0.55f, 0.7f, 0.9f, 1.0f);
+
+    const point_cloud_header * header = cloud.header;
+    float extent = header->size;
+    vec3 centre = vec3_make(header->min[0] + extent * 0.5f, 0.0f, header->min[2] + extent * 0.5f);
+    float radius = extent * 0.3f;
+    float altitude = extent * 0.08f;
+    float aspect = (float)options.width / (float)options.height;
+    mat4 projection = mat4_perspective(POINT_BENCH_FOVY, aspect, 1.0f, extent * 1.5f);
+    frame_histogram frame_ms;
+    frame_histogram_clear(frame_ms);
+    double update_seconds = 0.0;
+    int first_full_frame = -1;
+    gl_log("\npointcloud-bench: %s, %ix%i, %i frames, budget %li points\n", glGetString(GL_RENDERER),
+        options.width, options.height, frames, bench.budget);
+    glFinish();
+    double start = frame_timing_seconds();
+    for(int frame = 0; frame < frames; frame++) {
+        double frame_start = frame_timing_seconds();
+        float angle = 6.2831853f * frame / POINT_BENCH_LAP;
+        vec3 eye = vec3_add(centre, vec3_make(cosf(angle) * radius, altitude, sinf(angle) * radius));
+        // along the circle, looking a little down
+        vec3 ahead = vec3_make(-sinf(angle), -0.35f, cosf(angle));
+        mat4 view_projection = mat4_mul(projection, mat4_look_at(eye, vec3_add(eye, ahead),
+            vec3_make(0.0f, 1.0f, 0.0f)));
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        point_renderer_update(&renderer, view_projection, eye, POINT_BENCH_FOVY, options.height);
+        update_seconds += frame_timing_seconds() - frame_start;
+        if(first_full_frame < 0 && renderer.selected_points >= bench.budget * 9 / 10) {
+            first_full_frame = frame;
+        }
+        gl_state_use_program(program);
+        set_uniform_mat4(program, "view_projection", view_projection);
+        point_renderer_draw(&renderer);
+        gl_state_end_frame();
+        headless_present();
+        frame_histogram_add(frame_ms, (frame_timing_seconds() - frame_start) * 1000.0);
+    }
+    glFinish();
+    double seconds = frame_timing_seconds() - start;
+    gl_log("  points/s drawn:   %.0f (%.0f per frame)\n", renderer.points_drawn / seconds,
+        (double)renderer.points_drawn / frames);
+    gl_log("  frame ms:         p50 %.3f  p95 %.3f  max %.3f; selection and uploads %.3f\n",
+        frame_histogram_percentile(frame_ms, 0.5), frame_histogram_percentile(frame_ms, 0.95), frame_ms.max_ms,
+        update_seconds * 1000.0 / frames);
+    if(first_full_frame >= 0) {
+        gl_log("  90%% of the budget first drawn at frame %i\n", first_full_frame);
+    } else {
+        gl_log("  the view never filled 90%% of the budget\n");
+    }
+    log_point_renderer_stats(&renderer);
+    log_stream_buffer_stats(&renderer.upload);
+    point_renderer_destroy(&renderer);
+    point_cloud_close(&cloud);
+    job_system_shutdown();
+    log_gl_state_stats();
+    headless_shutdown();
+    return 0;
+}
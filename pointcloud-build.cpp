@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "logging.h"
+#include "pointbuilder.h"
+
+// Offline point cloud to LOD octree converter:
+//   pointcloud-build input.points output.pcl [--memory MB]
+//   pointcloud-build --synthetic COUNT output.pcl [--memory MB]
+// input.points is packed point_input records (xyz float, rgba8).
+
+int main(int argc, char ** argv) {
+    const char * paths[2] = { NULL, NULL };
+    int path_count = 0;
+    unsigned long long synthetic = 0;
+    point_build_options options;
+    options.memory_bytes = 512ULL * 1024 * 1024;
+    options.temp_path = NULL;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--synthetic") == 0 && i + 1 < argc) {
+            synthetic = strtoull(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "--memory") == 0 && i + 1 < argc) {
+            options.memory_bytes = strtoull(argv[++i], NULL, 10) * 1024 * 1024;
+        } else if(path_count < 2) {
+            paths[path_count++] = argv[i];
+        } else {
+            path_count = 3;
+        }
+    }
+    if(synthetic && path_count == 1) {
+        // only the output was given
+        paths[1] = paths[0];
+        paths[0] = NULL;
+        path_count = 2;
+    }
+    if(path_count != 2 || (synthetic != 0) != (paths[0] == NULL)) {
+        fprintf(stderr, "usage: %s (input.points | --synthetic COUNT) output.pcl [--memory MB]\n", argv[0]);
+        return 1;
+    }
+    if(!restart_gl_log()) {
+        fprintf(stderr, "Failed to open log file\n");
+        return 1;
+    }
+    char temp_path[512];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", paths[1]);
+    options.temp_path = temp_path;
+    point_source source;
+    if(synthetic) {
+        point_source_synthetic(synthetic, &source);
+    } else if(!point_source_open_file(paths[0], &source)) {
+        fprintf(stderr, "could not open %s, see gl.log\n", paths[0]);
+        return 2;
+    }
+    point_build_stats stats;
+    bool built = point_cloud_build(&source, paths[1], &options, &stats);
+    point_source_close(&source);
+    if(!built) {
+        fprintf(stderr, "could not build %s, see gl.log\n", paths[1]);
+        return 3;
+    }
+    return 0;
+}
@@ -0,0 +1,7 @@
+set -e
+g++ pointcloud-build.cpp pointbuilder.cpp frametiming.cpp logging.cpp \
+    ../glew/lib/libGLEW.a ../glfw/build/src/libglfw3.a \
+    -I ../glfw/include -I ../glew/include/ \
+    -lGL -lEGL -lX11 -lGLU -pthread \
+    -o pointcloud-build
+./pointcloud-build "$@"
@@ -0,0 +1,457 @@
+#include <GL/glew.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include "logging.h"
+#include "glstate.h"
+#include "pointcloud.h"
+#include "vertexformat.h"
+#include "profiler.h"
+#include "glcapture.h"
+
+#define POINT_POSITION_ATTRIB 0
+#define POINT_COLOR_ATTRIB 1
+#define POINT_CUBE_ATTRIB 2
+
+struct draw_arrays_indirect_command {
+    GLuint count;
+    GLuint instance_count;
+    GLuint first;
+    GLuint base_instance;
+};
+
+bool point_cloud_open(const char * path, point_cloud * cloud) {
+    memset(cloud, 0, sizeof(*cloud));
+    if(!map_file(path, &cloud->file)) {
+        return false;
+    }
+    const char * base = (const char *)cloud->file.data;
+    size_t size = cloud->file.size;
+    const point_cloud_header * header = (const point_cloud_header *)base;
+    if(size < sizeof(point_cloud_header) || memcmp(header->magic, POINT_CLOUD_MAGIC, 4) != 0
+            || header->version != POINT_CLOUD_VERSION) {
+        gl_log_err("ERROR: %s is not a version %i point cloud\n", path, POINT_CLOUD_VERSION);
+        point_cloud_close(cloud);
+        return false;
+    }
+    if(header->node_count == 0 || header->node_max > POINT_NODE_MAX
+            || header->nodes_offset % alignof(point_node) != 0 || header->points_offset % alignof(point_record) != 0
+            || header->nodes_offset > size || header->points_offset > size
+            || header->node_count > (size - header->nodes_offset) / sizeof(point_node)
+            || header->point_count > (size - header->points_offset) / sizeof(point_record)) {
+        gl_log_err("ERROR: point cloud %s is truncated or was built for a different POINT_NODE_MAX\n", path);
+        point_cloud_close(cloud);
+        return false;
+    }
+    // once here, so loads can copy a node's points and the selection can
+    // follow first_child without checking again; children come after their
+    // parent in breadth-first order, which also rules out cycles
+    const point_node * nodes = (const point_node *)(base + header->nodes_offset);
+    for(uint32_t i = 0; i < header->node_count; i++) {
+        const point_node & node = nodes[i];
+        int children = __builtin_popcount(node.child_mask);
+        if(node.point_count > header->node_max || node.first_point > header->point_count
+                || node.point_count > header->point_count - node.first_point
+                || (children > 0 && (node.first_child <= i
+                    || (uint64_t)node.first_child + children > header->node_count))) {
+            gl_log_err("ERROR: point cloud %s has a bad node %u\n", path, i);
+            point_cloud_close(cloud);
+            return false;
+        }
+    }
+    cloud->header = header;
+    cloud->nodes = nodes;
+    cloud->points = (const point_record *)(base + header->points_offset);
+    gl_log("point cloud %s: %llu points in %u nodes, depth %u, %.1f MB\n", path,
+        (unsigned long long)header->point_count, header->node_count, header->depth, size / (1024.0 * 1024.0));
+    return true;
+}
+
+void point_cloud_close(point_cloud * cloud) {
+    unmap_file(&cloud->file);
+    cloud->header = NULL;
+    cloud->nodes = NULL;
+    cloud->points = NULL;
+}
+
+static void lru_unlink(point_renderer * r, int slot) {
+    point_slot & s = r->slots[slot];
+    if(s.prev >= 0) {
+        r->slots[s.prev].next = s.next;
+    } else {
+        r->lru_head = s.next;
+    }
+    if(s.next >= 0) {
+        r->slots[s.next].prev = s.prev;
+    } else {
+        r->lru_tail = s.prev;
+    }
+    s.prev = s.next = -1;
+}
+
+static void lru_push_front(point_renderer * r, int slot) {
+    point_slot & s = r->slots[slot];
+    s.prev = -1;
+    s.next = r->lru_head;
+    if(r->lru_head >= 0) {
+        r->slots[r->lru_head].prev = slot;
+    } else {
+        r->lru_tail = slot;
+    }
+    r->lru_head = slot;
+}
+
+static void lru_push_back(point_renderer * r, int slot) {
+    point_slot & s = r->slots[slot];
+    s.next = -1;
+    s.prev = r->lru_tail;
+    if(r->lru_tail >= 0) {
+        r->slots[r->lru_tail].next = slot;
+    } else {
+        r->lru_head = slot;
+    }
+    r->lru_tail = slot;
+}
+
+bool point_renderer_init(point_renderer * r, const point_cloud * cloud, const point_renderer_options * options) {
+    r->cloud = cloud;
+    r->options = *options;
+    uint32_t node_count = cloud->header->node_count;
+    size_t slot_bytes = POINT_NODE_MAX * sizeof(point_record);
+    r->slot_count = (int)std::min((size_t)node_count, options->gpu_bytes / slot_bytes);
+    if(r->slot_count < 1 || options->upload_bytes < slot_bytes) {
+        gl_log_err("ERROR: point renderer needs a pool and an upload budget of at least one node (%zu bytes)\n",
+            slot_bytes);
+        return false;
+    }
+    glGenBuffers(1, &r->pool);
+    gl_state_bind_buffer(GL_ARRAY_BUFFER, r->pool);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)r->slot_count * slot_bytes, NULL, GL_STATIC_DRAW);
+    glGenBuffers(1, &r->cubes);
+    gl_state_bind_buffer(GL_ARRAY_BUFFER, r->cubes);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)r->slot_count * 4 * sizeof(GLfloat), NULL, GL_STATIC_DRAW);
+
+    glGenVertexArrays(1, &r->vao);
+    // point_record per vertex (the padding after the position is the 4-byte
+    // element alignment), the node's cube per instance
+    vertex_format format;
+    vertex_format_init(&format);
+    vertex_format_add(&format, POINT_POSITION_ATTRIB, 3, VERTEX_UNORM16, 0);
+    vertex_format_add(&format, POINT_COLOR_ATTRIB, 4, VERTEX_UNORM8, 0);
+    vertex_format_add(&format, POINT_CUBE_ATTRIB, 4, VERTEX_FLOAT32, 1);
+    vertex_format_set_divisor(&format, 1, 1);
+    if(vertex_format_stride(&format, 0) != sizeof(point_record)
+            || format.elements[1].offset != offsetof(point_record, color)) {
+        gl_log_err("ERROR: point vertex format does not match point_record\n");
+        return false;
+    }
+    GLuint streams[] = { r->pool, r->cubes };
+    GLintptr offsets[] = { 0, 0 };
+    vertex_format_apply(&format, r->vao, streams, offsets);
+
+    if(!stream_buffer_init(&r->upload, GL_COPY_READ_BUFFER, options->upload_bytes)
+            || !stream_buffer_init(&r->commands, GL_DRAW_INDIRECT_BUFFER,
+                r->slot_count * sizeof(draw_arrays_indirect_command))) {
+        return false;
+    }
+    r->multi_draw = GLEW_ARB_multi_draw_indirect || GLEW_VERSION_4_3;
+
+    point_node_state empty = { -1, -1, 0, 0 };
+    r->nodes.assign(node_count, empty);
+    r->slots.resize(r->slot_count);
+    r->lru_head = r->lru_tail = -1;
+    for(int i = 0; i < r->slot_count; i++) {
+        r->slots[i].node = POINT_NODE_NONE;
+        lru_push_back(r, i);
+    }
+    for(int i = 0; i < POINT_LOADS_IN_FLIGHT; i++) {
+        point_load & load = r->loads[i];
+        load.renderer = r;
+        load.node = POINT_NODE_NONE;
+        load.staging = (point_record *)malloc(slot_bytes);
+        load.done = false;
+        if(!load.staging) {
+            gl_log_err("ERROR: could not allocate point cloud staging memory\n");
+            return false;
+        }
+    }
+    job_counter_init(&r->load_jobs);
+    // every node can be on the heap at once in the worst case
+    r->heap.resize(node_count);
+    r->selected.resize(r->slot_count);
+    r->selected_count = 0;
+    r->selected_points = 0;
+    r->frame = 0;
+    r->loads_started = r->loads_finished = r->loads_dropped = 0;
+    r->evictions = r->pool_full = 0;
+    r->bytes_loaded = 0;
+    r->points_drawn = 0;
+    r->nodes_drawn = r->frames_drawn = 0;
+    frame_histogram_clear(r->load_ms);
+    gl_log("point renderer: %i node slots (%.1f MB), %.1f MB uploads per frame, budget %li points, %s\n",
+        r->slot_count, r->slot_count * slot_bytes / (1024.0 * 1024.0), options->upload_bytes / (1024.0 * 1024.0),
+        options->point_budget, r->multi_draw ? "multi-draw-indirect" : "one draw per node");
+    return true;
+}
+
+// runs on a worker: touching the mapping is what pulls the node off disk
+static void load_node(point_load * load) {
+    PROFILE_ZONE("point_node_load");
+    const point_cloud * cloud = load->renderer->cloud;
+    const point_node & node = cloud->nodes[load->node];
+    memcpy(load->staging, cloud->points + node.first_point, node.point_count * sizeof(point_record));
+    load->done.store(true, std::memory_order_release);
+}
+
+static bool start_load(point_renderer * r, uint32_t node) {
+    for(int i = 0; i < POINT_LOADS_IN_FLIGHT; i++) {
+        point_load & load = r->loads[i];
+        if(load.node != POINT_NODE_NONE) {
+            continue;
+        }
+        load.node = node;
+        load.done.store(false, std::memory_order_relaxed);
+        load.requested_at = frame_timing_seconds();
+        r->nodes[node].load = i;
+        r->loads_started++;
+        point_load * p = &load;
+        job_run([p]() { load_node(p); }, &r->load_jobs);
+        return true;
+    }
+    return false;
+}
+
+static void finish_load(point_renderer * r, point_load * load) {
+    r->nodes[load->node].load = -1;
+    load->node = POINT_NODE_NONE;
+}
+
+// finished loads go into the pool while the upload budget lasts
+static void upload_loads(point_renderer * r) {
+    size_t slot_bytes = POINT_NODE_MAX * sizeof(point_record);
+    for(int i = 0; i < POINT_LOADS_IN_FLIGHT; i++) {
+        point_load & load = r->loads[i];
+        if(load.node == POINT_NODE_NONE || !load.done.load(std::memory_order_acquire)) {
+            continue;
+        }
+        point_node_state & state = r->nodes[load.node];
+        if(state.last_wanted + 1 < r->frame) {
+            // out of view again before it arrived
+            finish_load(r, &load);
+            r->loads_dropped++;
+            continue;
+        }
+        int slot = r->lru_tail;
+        uint32_t victim = r->slots[slot].node;
+        if(victim != POINT_NODE_NONE && r->nodes[victim].last_drawn + 1 >= r->frame) {
+            // everything resident was drawn last frame: the pool is smaller than the view
+            r->pool_full++;
+            continue;
+        }
+        const point_node & node = r->cloud->nodes[load.node];
+        size_t bytes = node.point_count * sizeof(point_record);
+        if(r->upload.region_size - r->upload.region_offset < (GLsizeiptr)(bytes + sizeof(point_record))) {
+            break;
+        }
+        if(victim != POINT_NODE_NONE) {
+            r->nodes[victim].slot = -1;
+            r->evictions++;
+        }
+        stream_allocation allocation;
+        if(!stream_buffer_alloc(&r->upload, bytes, sizeof(point_record), &allocation)) {
+            break;
+        }
+        memcpy(allocation.data, load.staging, bytes);
+        stream_buffer_commit(&r->upload, &allocation);
+        gl_state_bind_buffer(GL_COPY_READ_BUFFER, allocation.buffer);
+        gl_state_bind_buffer(GL_COPY_WRITE_BUFFER, r->pool);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, allocation.offset,
+            (GLintptr)slot * slot_bytes, bytes);
+        GLfloat cube[4] = { node.min[0], node.min[1], node.min[2], node.size };
+        gl_state_bind_buffer(GL_ARRAY_BUFFER, r->cubes);
+        glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)slot * sizeof(cube), sizeof(cube), cube);
+
+        r->slots[slot].node = load.node;
+        lru_unlink(r, slot);
+        lru_push_front(r, slot);
+        state.slot = slot;
+        // not evictable before it has had a frame to be drawn
+        state.last_drawn = r->frame;
+        frame_histogram_add(r->load_ms, (frame_timing_seconds() - load.requested_at) * 1000.0);
+        r->bytes_loaded += bytes;
+        r->loads_finished++;
+        finish_load(r, &load);
+    }
+    stream_buffer_end_frame(&r->upload);
+}
+
+static bool box_in_frustum(const vec4 planes[6], const point_node & node) {
+    for(int p = 0; p < 6; p++) {
+        // the corner furthest along the plane normal
+        float x = node.min[0] + (planes[p].x >= 0.0f ? node.size : 0.0f);
+        float y = node.min[1] + (planes[p].y >= 0.0f ? node.size : 0.0f);
+        float z = node.min[2] + (planes[p].z >= 0.0f ? node.size : 0.0f);
+        if(planes[p].x * x + planes[p].y * y + planes[p].z * z + planes[p].w < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static float box_distance(const point_node & node, vec3 eye) {
+    float e[3] = { eye.x, eye.y, eye.z };
+    float d2 = 0.0f;
+    for(int a = 0; a < 3; a++) {
+        float d = std::max(std::max(node.min[a] - e[a], e[a] - (node.min[a] + node.size)), 0.0f);
+        d2 += d * d;
+    }
+    return sqrtf(d2);
+}
+
+static bool candidate_less(const point_candidate & a, const point_candidate & b) {
+    return a.priority < b.priority;
+}
+
+void point_renderer_update(point_renderer * r, const mat4 & view_projection, vec3 eye, float fovy_radians,
+    int viewport_height) {
+    PROFILE_ZONE("point_renderer_update");
+    r->frame++;
+    upload_loads(r);
+
+    vec4 planes[6];
+    mat4_frustum_planes(view_projection, planes);
+    // pixels covered by one unit at distance one
+    float pixels_per_unit = viewport_height / (2.0f * tanf(fovy_radians * 0.5f));
+    const point_node * nodes = r->cloud->nodes;
+    point_candidate * heap = r->heap.data();
+    size_t heap_size = 0;
+    r->selected_count = 0;
+    r->selected_points = 0;
+    if(box_in_frustum(planes, nodes[0])) {
+        heap[heap_size++] = { 1e30f, 0 };
+    }
+    while(heap_size > 0) {
+        std::pop_heap(heap, heap + heap_size, candidate_less);
+        uint32_t index = heap[--heap_size].node;
+        const point_node & node = nodes[index];
+        point_node_state & state = r->nodes[index];
+        state.last_wanted = r->frame;
+        if(state.slot < 0) {
+            // popped in priority order, so the most important misses start loading first
+            if(state.load < 0) {
+                start_load(r, index);
+            }
+            continue;
+        }
+        if(r->selected_points + node.point_count > r->options.point_budget) {
+            break;
+        }
+        r->selected[r->selected_count++] = index;
+        r->selected_points += node.point_count;
+        state.last_drawn = r->frame;
+        lru_unlink(r, state.slot);
+        lru_push_front(r, state.slot);
+
+        float distance = std::max(box_distance(node, eye), 1e-3f);
+        float spacing = node.size / POINT_NODE_GRID;
+        if(!node.child_mask || spacing * pixels_per_unit / distance <= r->options.pixel_error) {
+            continue;
+        }
+        uint32_t child = node.first_child;
+        for(int octant = 0; octant < 8; octant++) {
+            if(!(node.child_mask & (1 << octant))) {
+                continue;
+            }
+            const point_node & c = nodes[child];
+            if(box_in_frustum(planes, c)) {
+                // projected size, so near and large nodes come first
+                heap[heap_size++] = { c.size * pixels_per_unit / std::max(box_distance(c, eye), 1e-3f), child };
+                std::push_heap(heap, heap + heap_size, candidate_less);
+            }
+            child++;
+        }
+    }
+}
+
+void point_renderer_draw(point_renderer * r) {
+    PROFILE_GPU_ZONE("point_renderer_draw");
+    if(r->selected_count > 0) {
+        gl_state_bind_vertex_array(r->vao);
+        if(r->multi_draw) {
+            GLsizeiptr size = r->selected_count * sizeof(draw_arrays_indirect_command);
+            stream_allocation allocation;
+            if(stream_buffer_alloc(&r->commands, size, sizeof(GLuint), &allocation)) {
+                draw_arrays_indirect_command * commands = (draw_arrays_indirect_command *)allocation.data;
+                for(int i = 0; i < r->selected_count; i++) {
+                    uint32_t index = r->selected[i];
+                    GLuint slot = (GLuint)r->nodes[index].slot;
+                    commands[i].count = r->cloud->nodes[index].point_count;
+                    commands[i].instance_count = 1;
+                    commands[i].first = slot * POINT_NODE_MAX;
+                    commands[i].base_instance = slot;
+                }
+                stream_buffer_commit(&r->commands, &allocation);
+                gl_state_bind_buffer(GL_DRAW_INDIRECT_BUFFER, allocation.buffer);
+                glMultiDrawArraysIndirect(GL_POINTS, (const void *)allocation.offset, r->selected_count, 0);
+            }
+        } else {
+            for(int i = 0; i < r->selected_count; i++) {
+                uint32_t index = r->selected[i];
+                GLuint slot = (GLuint)r->nodes[index].slot;
+                glDrawArraysInstancedBaseInstance(GL_POINTS, slot * POINT_NODE_MAX,
+                    r->cloud->nodes[index].point_count, 1, slot);
+            }
+        }
+    }
+    stream_buffer_end_frame(&r->commands);
+    r->points_drawn += r->selected_points;
+    r->nodes_drawn += r->selected_count;
+    r->frames_drawn++;
+}
+
+int point_renderer_resident(const point_renderer * r) {
+    int resident = 0;
+    for(int i = 0; i < r->slot_count; i++) {
+        resident += r->slots[i].node != POINT_NODE_NONE;
+    }
+    return resident;
+}
+
+int point_renderer_loading(const point_renderer * r) {
+    int loading = 0;
+    for(int i = 0; i < POINT_LOADS_IN_FLIGHT; i++) {
+        loading += r->loads[i].node != POINT_NODE_NONE;
+    }
+    return loading;
+}
+
+void log_point_renderer_stats(const point_renderer * r) {
+    unsigned long frames = r->frames_drawn ? r->frames_drawn : 1;
+    gl_log("point renderer: %.0f points and %.1f nodes per frame, %i of %i slots resident\n",
+        (double)r->points_drawn / frames, (double)r->nodes_drawn / frames, point_renderer_resident(r),
+        r->slot_count);
+    gl_log("  loads: %lu started, %lu resident, %lu dropped, %.1f MB; %lu evictions, %lu pool-full waits\n",
+        r->loads_started, r->loads_finished, r->loads_dropped, r->bytes_loaded / (1024.0 * 1024.0), r->evictions,
+        r->pool_full);
+    gl_log("  request to resident: p50 %.2f ms, p95 %.2f ms, max %.2f ms\n",
+        frame_histogram_percentile(r->load_ms, 0.5), frame_histogram_percentile(r->load_ms, 0.95),
+        r->load_ms.max_ms);
+}
+
+void point_renderer_destroy(point_renderer * r) {
+    // loads may still be copying into staging
+    job_wait(&r->load_jobs);
+    for(int i = 0; i < POINT_LOADS_IN_FLIGHT; i++) {
+        free(r->loads[i].staging);
+        r->loads[i].staging = NULL;
+        r->loads[i].node = POINT_NODE_NONE;
+    }
+    stream_buffer_destroy(&r->upload);
+    stream_buffer_destroy(&r->commands);
+    gl_state_delete_vertex_arrays(1, &r->vao);
+    gl_state_delete_buffers(1, &r->pool);
+    gl_state_delete_buffers(1, &r->cubes);
+    r->vao = r->pool = r->cubes = 0;
+}
@@ -0,0 +1,8 @@
+#version 410
+
+in vec4 colour;
+out vec4 frag_colour;
+
+void main() {
+    frag_colour = colour;
+}
@@ -0,0 +1,180 @@
+#pragma once
+#include <GL/glew.h>
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+#include "assetloader.h"
+#include "frametiming.h"
+#include "jobsystem.h"
+#include "streambuffer.h"
+#include "vecmath.h"
+
+// Level-of-detail octree for point clouds larger than memory, built
+// offline by pointbuilder.cpp into one file that is memory-mapped:
+//
+//   header | points | node table
+//
+// Every node is a cube holding at most POINT_NODE_MAX points: a sample of
+// its region, one point per cell of a POINT_NODE_GRID^3 grid. Its children
+// hold the points it left out, at twice the density (additive LOD, so
+// drawing a node and its children never draws a point twice). Points are
+// quantized to 16 bits per axis within their node's cube. Nodes are in
+// breadth-first order; a node's children are contiguous from first_child,
+// in octant order, present where child_mask has the octant's bit set.
+#define POINT_CLOUD_MAGIC "APCL"
+#define POINT_CLOUD_VERSION 1
+#define POINT_CLOUD_ALIGN 64
+#define POINT_NODE_MAX 8192
+#define POINT_NODE_GRID 64
+#define POINT_NODE_NONE 0xffffffffu
+
+struct point_cloud_header {
+    char magic[4];
+    uint32_t version;
+    uint64_t point_count;
+    uint32_t node_count;
+    uint32_t node_max;
+    uint32_t grid;
+    uint32_t depth;
+    // root cube
+    float min[3];
+    float size;
+    uint64_t points_offset;
+    uint64_t nodes_offset;
+};
+
+struct point_node {
+    float min[3];
+    float size;
+    uint64_t first_point;
+    uint32_t point_count;
+    uint32_t first_child;
+    uint8_t child_mask;
+    uint8_t depth;
+    uint16_t reserved;
+    uint32_t pad;
+};
+
+// position: 0..65535 across the node's cube; color: RGBA8
+struct point_record {
+    uint16_t position[3];
+    uint16_t pad;
+    uint8_t color[4];
+};
+
+static_assert(sizeof(point_cloud_header) == 64, "point_cloud_header must stay 64 bytes");
+static_assert(sizeof(point_node) == 40, "point_node must stay 40 bytes");
+static_assert(sizeof(point_record) == 12, "point_record must stay 12 bytes");
+
+// a validated view into the mapped file; nothing is read until it is touched
+struct point_cloud {
+    mapped_file file;
+    const point_cloud_header * header;
+    const point_node * nodes;
+    const point_record * points;
+};
+
+bool point_cloud_open(const char * path, point_cloud * cloud);
+void point_cloud_close(point_cloud * cloud);
+
+// Runtime: every frame point_renderer_update() walks the octree from the
+// root in order of projected node size, keeps the frustum-visible nodes
+// whose parent's point spacing still covers more than pixel_error pixels,
+// and stops when the point budget is spent. Selected nodes that are not
+// resident are loaded, highest priority first: a job copies the node's
+// points out of the mapping (where the disk reads happen) into staging
+// memory, and the GL thread streams it into a slot of one pooled vertex
+// buffer, evicting the least recently drawn node. A node is only descended
+// into once it is resident, so the coarse levels always fill in first.
+// point_renderer_draw() draws the selection with one multi-draw-indirect;
+// each node's slot is its base_instance, which fetches its cube.
+#define POINT_LOADS_IN_FLIGHT 16
+
+struct point_renderer_options {
+    // points drawn per frame at most
+    long point_budget;
+    // size of the node pool on the GPU
+    size_t gpu_bytes;
+    // bytes streamed into the pool per frame at most
+    size_t upload_bytes;
+    // parent point spacing, in pixels, that still asks for its children
+    float pixel_error;
+};
+
+struct point_load {
+    struct point_renderer * renderer;
+    uint32_t node;
+    point_record * staging;
+    std::atomic<bool> done;
+    double requested_at;
+};
+
+struct point_slot {
+    uint32_t node;
+    int prev;
+    int next;
+};
+
+// per node, parallel to the node table
+struct point_node_state {
+    int slot;
+    // index into loads while a load is in flight, -1 otherwise
+    int load;
+    unsigned long last_drawn;
+    unsigned long last_wanted;
+};
+
+struct point_candidate {
+    float priority;
+    uint32_t node;
+};
+
+struct point_renderer {
+    const point_cloud * cloud;
+    point_renderer_options options;
+    GLuint vao;
+    // slot_count slots of POINT_NODE_MAX points each
+    GLuint pool;
+    // per slot: xyz cube corner, w cube size
+    GLuint cubes;
+    stream_buffer upload;
+    stream_buffer commands;
+    bool multi_draw;
+    std::vector<point_node_state> nodes;
+    std::vector<point_slot> slots;
+    int slot_count;
+    // doubly linked by recency, most recently drawn first; free slots at the tail
+    int lru_head;
+    int lru_tail;
+    point_load loads[POINT_LOADS_IN_FLIGHT];
+    job_counter load_jobs;
+    // selection scratch, sized once from the node count
+    std::vector<point_candidate> heap;
+    std::vector<uint32_t> selected;
+    int selected_count;
+    long selected_points;
+    unsigned long frame;
+    // statistics
+    unsigned long loads_started;
+    unsigned long loads_finished;
+    unsigned long loads_dropped;
+    unsigned long evictions;
+    unsigned long pool_full;
+    unsigned long long bytes_loaded;
+    unsigned long long points_drawn;
+    unsigned long nodes_drawn;
+    unsigned long frames_drawn;
+    frame_histogram load_ms;
+};
+
+bool point_renderer_init(point_renderer * renderer, const point_cloud * cloud, const point_renderer_options * options);
+// picks this frame's nodes, starts loads and streams finished ones into the pool
+void point_renderer_update(point_renderer * renderer, const mat4 & view_projection, vec3 eye, float fovy_radians,
+    int viewport_height);
+// draws the nodes picked by the last update with the program in use
+void point_renderer_draw(point_renderer * renderer);
+// resident nodes and loads in flight
+int point_renderer_resident(const point_renderer * renderer);
+int point_renderer_loading(const point_renderer * renderer);
+void log_point_renderer_stats(const point_renderer * renderer);
+void point_renderer_destroy(point_renderer * renderer);
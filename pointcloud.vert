@@ -0,0 +1,15 @@
+#version 410
+
+// 16-bit positions within the node's cube
+layout(location = 0) in vec3 vertex_position;
+layout(location = 1) in vec4 vertex_colour;
+// xyz cube corner, w cube size, fetched through the draw's base_instance
+layout(location = 2) in vec4 node_cube;
+
+uniform mat4 view_projection;
+out vec4 colour;
+
+void main() {
+    colour = vertex_colour;
+    gl_Position = view_projection * vec4(node_cube.xyz + vertex_position * node_cube.w, 1.0);
+}
@@ -0,0 +1,11 @@
+set -e
+# hello-triangle with profiling zones compiled in; open profile-trace.json
+# in chrome://tracing or ui.perfetto.dev
+g++ -DGL_PROFILE hello-triangle.cpp profiler.cpp framepacing.cpp resourcepool.cpp alloccounter.cpp framecapture.cpp gldebug.cpp renderqueue.cpp \
+    jobsystem.cpp vecmath.cpp batchrenderer.cpp assetloader.cpp frametiming.cpp headless.cpp vertexformat.cpp glstate.cpp \
+    shadermanager.cpp programcache.cpp logging.cpp \
+    ../glew/lib/libGLEW.a ../glfw/build/src/libglfw3.a \
+    -I ../glfw/include -I ../glew/include/ \
+    -lGL -lEGL -lX11 -lGLU -pthread \
+    -o hello-triangle-profile
+./hello-triangle-profile --headless --frames 300
@@ -0,0 +1,337 @@
+#include <GL/glew.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include "logging.h"
+#include "profiler.h"
+
+#ifdef GL_PROFILE
+
+#define PROFILE_CHUNK_EVENTS 4096
+// per thread, ~100 MB of events; later zones are dropped and counted
+#define PROFILE_MAX_CHUNKS 1024
+// timestamp pairs in flight; a frame's GPU zones are usually read back
+// two or three frames later
+#define PROFILE_GPU_QUERIES 256
+// how often the GPU clock is matched to the CPU clock again
+#define PROFILE_CALIBRATE_NS 1000000000LL
+
+struct profile_event {
+    const char * name;
+    uint64_t begin;
+    uint64_t end;
+};
+
+struct profile_chunk {
+    // written only by the owning thread; release-published for the exporter
+    std::atomic<uint32_t> count;
+    std::atomic<profile_chunk *> next;
+    profile_event events[PROFILE_CHUNK_EVENTS];
+};
+
+struct profile_thread {
+    profile_thread * next;
+    int tid;
+    char name[32];
+    profile_chunk * first;
+    profile_chunk * current;
+    int chunks;
+    unsigned long dropped;
+};
+
+struct gpu_query {
+    GLuint begin;
+    GLuint end;
+    const char * name;
+    bool pending;
+};
+
+static std::chrono::steady_clock::time_point g_epoch = std::chrono::steady_clock::now();
+static std::atomic<bool> g_enabled(false);
+static std::atomic<profile_thread *> g_threads(NULL);
+static std::atomic<int> g_next_tid(1);
+static thread_local profile_thread * t_thread = NULL;
+static char g_trace_path[512];
+
+static profile_thread * g_gpu_thread = NULL;
+static bool g_gpu_timing = false;
+static bool g_debug_groups = false;
+static gpu_query g_queries[PROFILE_GPU_QUERIES];
+static unsigned long g_query_head = 0;
+static unsigned long g_query_tail = 0;
+static unsigned long g_gpu_dropped = 0;
+static long long g_gpu_offset = 0;
+static uint64_t g_last_calibration = 0;
+static uint64_t g_frame_start = 0;
+
+static uint64_t profile_now() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - g_epoch).count();
+}
+
+static profile_chunk * new_chunk() {
+    // malloc, not new: the profiler stays out of the heap allocation counts
+    profile_chunk * chunk = (profile_chunk *)malloc(sizeof(profile_chunk));
+    if(chunk) {
+        chunk->count.store(0, std::memory_order_relaxed);
+        chunk->next.store(NULL, std::memory_order_relaxed);
+    }
+    return chunk;
+}
+
+static profile_thread * register_thread(const char * name) {
+    profile_thread * thread = (profile_thread *)calloc(1, sizeof(profile_thread));
+    if(!thread) {
+        return NULL;
+    }
+    thread->tid = g_next_tid.fetch_add(1);
+    if(name) {
+        snprintf(thread->name, sizeof(thread->name), "%s", name);
+    } else {
+        snprintf(thread->name, sizeof(thread->name), "thread %i", thread->tid);
+    }
+    thread->first = thread->current = new_chunk();
+    thread->chunks = 1;
+    // push onto the lock-free list the exporter walks
+    profile_thread * head = g_threads.load();
+    do {
+        thread->next = head;
+    } while(!g_threads.compare_exchange_weak(head, thread));
+    return thread;
+}
+
+static void append(profile_thread * thread, const char * name, uint64_t begin, uint64_t end) {
+    profile_chunk * chunk = thread->current;
+    if(!chunk) {
+        thread->dropped++;
+        return;
+    }
+    uint32_t count = chunk->count.load(std::memory_order_relaxed);
+    if(count == PROFILE_CHUNK_EVENTS) {
+        profile_chunk * next = thread->chunks < PROFILE_MAX_CHUNKS ? new_chunk() : NULL;
+        if(!next) {
+            thread->dropped++;
+            return;
+        }
+        chunk->next.store(next, std::memory_order_release);
+        thread->current = chunk = next;
+        thread->chunks++;
+        count = 0;
+    }
+    profile_event & event = chunk->events[count];
+    event.name = name;
+    event.begin = begin;
+    event.end = end;
+    chunk->count.store(count + 1, std::memory_order_release);
+}
+
+static void record(const char * name, uint64_t begin, uint64_t end) {
+    if(!t_thread) {
+        t_thread = register_thread(NULL);
+        if(!t_thread) {
+            return;
+        }
+    }
+    append(t_thread, name, begin, end);
+}
+
+profile_zone::profile_zone(const char * zone_name) : name(zone_name) {
+    begin = g_enabled.load(std::memory_order_relaxed) ? profile_now() : 0;
+}
+
+profile_zone::~profile_zone() {
+    if(begin) {
+        record(name, begin, profile_now());
+    }
+}
+
+static void calibrate_gpu_clock() {
+    GLint64 gpu = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpu);
+    uint64_t cpu = profile_now();
+    g_gpu_offset = (long long)gpu - (long long)cpu;
+    g_last_calibration = cpu;
+}
+
+// oldest first, stopping at the first zone still open or still in flight
+static void collect_gpu_zones(bool wait) {
+    while(g_query_tail != g_query_head) {
+        gpu_query & q = g_queries[g_query_tail % PROFILE_GPU_QUERIES];
+        if(!q.pending) {
+            break;
+        }
+        if(!wait) {
+            GLint available = 0;
+            glGetQueryObjectiv(q.end, GL_QUERY_RESULT_AVAILABLE, &available);
+            if(!available) {
+                break;
+            }
+        }
+        GLuint64 begin = 0;
+        GLuint64 end = 0;
+        glGetQueryObjectui64v(q.begin, GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(q.end, GL_QUERY_RESULT, &end);
+        append(g_gpu_thread, q.name, (uint64_t)((long long)begin - g_gpu_offset),
+            (uint64_t)((long long)end - g_gpu_offset));
+        q.pending = false;
+        g_query_tail++;
+    }
+}
+
+profile_gpu_zone::profile_gpu_zone(const char * zone_name) : cpu(zone_name), query(-1) {
+    if(!cpu.begin) {
+        return;
+    }
+    if(g_debug_groups) {
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, zone_name);
+    }
+    if(!g_gpu_timing) {
+        return;
+    }
+    if(g_query_head - g_query_tail == PROFILE_GPU_QUERIES) {
+        collect_gpu_zones(false);
+        if(g_query_head - g_query_tail == PROFILE_GPU_QUERIES) {
+            g_gpu_dropped++;
+            return;
+        }
+    }
+    query = (int)(g_query_head % PROFILE_GPU_QUERIES);
+    g_query_head++;
+    gpu_query & q = g_queries[query];
+    q.name = zone_name;
+    q.pending = false;
+    glQueryCounter(q.begin, GL_TIMESTAMP);
+}
+
+profile_gpu_zone::~profile_gpu_zone() {
+    if(!cpu.begin) {
+        return;
+    }
+    if(query >= 0) {
+        glQueryCounter(g_queries[query].end, GL_TIMESTAMP);
+        g_queries[query].pending = true;
+    }
+    if(g_debug_groups) {
+        glPopDebugGroup();
+    }
+}
+
+bool profiler_init(const char * trace_path) {
+    snprintf(g_trace_path, sizeof(g_trace_path), "%s", trace_path);
+    if(!t_thread) {
+        t_thread = register_thread("main");
+    }
+    g_gpu_thread = register_thread("GPU");
+    if(!t_thread || !g_gpu_thread) {
+        gl_log_err("ERROR: could not allocate profiler buffers\n");
+        return false;
+    }
+    GLint bits = 0;
+    glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+    g_gpu_timing = bits > 0;
+    g_debug_groups = GLEW_KHR_debug || GLEW_VERSION_4_3;
+    if(g_gpu_timing) {
+        for(int i = 0; i < PROFILE_GPU_QUERIES; i++) {
+            glGenQueries(1, &g_queries[i].begin);
+            glGenQueries(1, &g_queries[i].end);
+            g_queries[i].pending = false;
+        }
+        calibrate_gpu_clock();
+    }
+    g_query_head = g_query_tail = 0;
+    g_frame_start = profile_now();
+    g_enabled.store(true);
+    gl_log("profiler: tracing to %s, GPU zones %s, debug groups %s\n", g_trace_path,
+        g_gpu_timing ? "timed" : "untimed", g_debug_groups ? "on" : "off");
+    return true;
+}
+
+void profiler_set_thread_name(const char * name) {
+    if(!t_thread) {
+        t_thread = register_thread(name);
+    } else {
+        snprintf(t_thread->name, sizeof(t_thread->name), "%s", name);
+    }
+}
+
+void profiler_frame() {
+    if(!g_enabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+    // frames show up as zones of their own on the thread that marks them
+    uint64_t now = profile_now();
+    record("frame", g_frame_start, now);
+    g_frame_start = now;
+    if(g_gpu_timing) {
+        collect_gpu_zones(false);
+        if(now - g_last_calibration > PROFILE_CALIBRATE_NS) {
+            calibrate_gpu_clock();
+        }
+    }
+}
+
+static void write_name(FILE * file, const char * name) {
+    fputc('"', file);
+    for(const char * c = name; *c; c++) {
+        if(*c == '"' || *c == '\\') {
+            fputc('\\', file);
+        }
+        fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+void profiler_shutdown() {
+    if(!g_enabled.exchange(false)) {
+        return;
+    }
+    if(g_gpu_timing) {
+        // the only place the profiler waits on the GPU
+        glFinish();
+        collect_gpu_zones(true);
+        for(int i = 0; i < PROFILE_GPU_QUERIES; i++) {
+            glDeleteQueries(1, &g_queries[i].begin);
+            glDeleteQueries(1, &g_queries[i].end);
+        }
+        g_gpu_timing = false;
+    }
+    FILE * file = fopen(g_trace_path, "w");
+    if(!file) {
+        gl_log_err("ERROR: could not write profile trace %s\n", g_trace_path);
+        return;
+    }
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    unsigned long events = 0;
+    unsigned long dropped = g_gpu_dropped;
+    int threads = 0;
+    bool first = true;
+    for(profile_thread * thread = g_threads.load(); thread; thread = thread->next) {
+        fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %i, \"args\": {\"name\": ",
+            first ? "" : ",\n", thread->tid);
+        write_name(file, thread->name);
+        fprintf(file, "}}");
+        first = false;
+        threads++;
+        dropped += thread->dropped;
+        for(profile_chunk * chunk = thread->first; chunk; chunk = chunk->next.load(std::memory_order_acquire)) {
+            uint32_t count = chunk->count.load(std::memory_order_acquire);
+            for(uint32_t i = 0; i < count; i++) {
+                const profile_event & event = chunk->events[i];
+                fprintf(file, ",\n{\"name\": ");
+                write_name(file, event.name);
+                fprintf(file, ", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %i, \"ts\": %.3f, \"dur\": %.3f}",
+                    thread == g_gpu_thread ? "gpu" : "cpu", thread->tid, event.begin / 1000.0,
+                    (event.end - event.begin) / 1000.0);
+                events++;
+            }
+        }
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    gl_log("profiler: %lu zones from %i threads written to %s (%lu dropped)\n", events, threads, g_trace_path,
+        dropped);
+}
+
+#endif
@@ -0,0 +1,54 @@
+#pragma once
+#include <GL/glew.h>
+#include <stdint.h>
+
+// Scoped CPU and GPU profiling zones, exported as Chrome trace event JSON
+// (chrome://tracing, ui.perfetto.dev). Compiled in with -DGL_PROFILE and
+// profiler.cpp; otherwise every macro below expands to nothing.
+//
+//   PROFILE_ZONE("name");      CPU zone until the end of the scope, any thread
+//   PROFILE_GPU_ZONE("name");  CPU zone plus a debug group and timestamp
+//                              queries around the same GL commands; GL thread
+//   PROFILE_FRAME();           frame marker; collects finished GPU zones
+//
+// Names must outlive the profiler (string literals). Each thread appends to
+// its own chunked buffer and publishes with a release store, so recording
+// takes no locks; the export at profiler_shutdown() reads all of them.
+#ifdef GL_PROFILE
+
+struct profile_zone {
+    const char * name;
+    uint64_t begin;
+    explicit profile_zone(const char * zone_name);
+    ~profile_zone();
+};
+
+struct profile_gpu_zone {
+    profile_zone cpu;
+    int query;
+    explicit profile_gpu_zone(const char * zone_name);
+    ~profile_gpu_zone();
+};
+
+bool profiler_init(const char * trace_path);
+void profiler_set_thread_name(const char * name);
+void profiler_frame();
+void profiler_shutdown();
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) profile_zone PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+#define PROFILE_GPU_ZONE(name) profile_gpu_zone PROFILE_CONCAT(profile_gpu_zone_, __LINE__)(name)
+#define PROFILE_FRAME() profiler_frame()
+
+#else
+
+inline bool profiler_init(const char *) { return true; }
+inline void profiler_set_thread_name(const char *) {}
+inline void profiler_shutdown() {}
+
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_GPU_ZONE(name) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+
+#endif
@@ -0,0 +1,156 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <mutex>
+#include <vector>
+#include "logging.h"
+#include "frametiming.h"
+#include "programcache.h"
+#include "assetloader.h"
+#include "glcapture.h"
+
+#define PROGRAM_CACHE_DIR "shader-cache"
+#define PROGRAM_CACHE_MAGIC 0x42504c47 // "GLPB"
+#define PROGRAM_CACHE_VERSION 1
+
+struct program_cache_header {
+    unsigned int magic;
+    unsigned int version;
+    unsigned long long key;
+    GLenum format;
+    GLint length;
+    // how long the source compile + link took, to estimate the time saved
+    double build_seconds;
+};
+
+// the shader watcher's worker thread loads programs too
+static std::mutex g_cache_stats_mutex;
+static int g_cache_hits = 0;
+static int g_cache_misses = 0;
+static int g_cache_rejected = 0;
+static double g_cache_saved_seconds = 0.0;
+
+static void count_miss(bool rejected) {
+    std::lock_guard<std::mutex> lock(g_cache_stats_mutex);
+    g_cache_misses++;
+    g_cache_rejected += rejected;
+}
+
+static void count_hit(double saved_seconds) {
+    std::lock_guard<std::mutex> lock(g_cache_stats_mutex);
+    g_cache_hits++;
+    if(saved_seconds > 0.0) {
+        g_cache_saved_seconds += saved_seconds;
+    }
+}
+
+static void cache_path(unsigned long long key, char * path, size_t size) {
+    snprintf(path, size, "%s/%016llx.bin", PROGRAM_CACHE_DIR, key);
+}
+
+static bool binaries_supported() {
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+unsigned long long program_cache_key(const unsigned long long * source_hashes, int count) {
+    unsigned long long hash = hash_bytes(source_hashes, count * sizeof(source_hashes[0]));
+    // include the terminators so the two strings cannot run together
+    const char * renderer = (const char *)glGetString(GL_RENDERER);
+    const char * version = (const char *)glGetString(GL_VERSION);
+    hash = hash_bytes(renderer, strlen(renderer) + 1, hash);
+    hash = hash_bytes(version, strlen(version) + 1, hash);
+    return hash;
+}
+
+bool program_cache_load(unsigned long long key, GLuint program) {
+    double start = frame_timing_seconds();
+    char path[256];
+    cache_path(key, path, sizeof(path));
+    FILE * file = fopen(path, "rb");
+    if(!file) {
+        count_miss(false);
+        return false;
+    }
+    program_cache_header header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1
+        && header.magic == PROGRAM_CACHE_MAGIC
+        && header.version == PROGRAM_CACHE_VERSION
+        && header.key == key
+        && header.length > 0;
+    std::vector<char> binary;
+    if(ok) {
+        binary.resize(header.length);
+        ok = fread(binary.data(), 1, header.length, file) == (size_t)header.length;
+    }
+    fclose(file);
+    if(!ok) {
+        gl_log("program cache: ignoring corrupt entry %s\n", path);
+        count_miss(false);
+        return false;
+    }
+
+    glProgramBinary(program, header.format, binary.data(), header.length);
+    GLint params = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &params);
+    if(GL_TRUE != params) {
+        // driver no longer accepts this format; caller compiles from source and refreshes
+        gl_log("program cache: binary format 0x%x rejected for %016llx\n", header.format, key);
+        count_miss(true);
+        return false;
+    }
+    double load_seconds = frame_timing_seconds() - start;
+    count_hit(header.build_seconds - load_seconds);
+    gl_log("program cache: hit %016llx in %.2f ms (source build took %.2f ms)\n",
+        key, load_seconds * 1000.0, header.build_seconds * 1000.0);
+    return true;
+}
+
+void program_cache_store(unsigned long long key, GLuint program, double build_seconds) {
+    if(!binaries_supported()) {
+        return;
+    }
+    program_cache_header header;
+    header.magic = PROGRAM_CACHE_MAGIC;
+    header.version = PROGRAM_CACHE_VERSION;
+    header.key = key;
+    header.format = 0;
+    header.length = 0;
+    header.build_seconds = build_seconds;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &header.length);
+    if(header.length <= 0) {
+        return;
+    }
+    std::vector<char> binary(header.length);
+    glGetProgramBinary(program, header.length, &header.length, &header.format, binary.data());
+
+    mkdir(PROGRAM_CACHE_DIR, 0755);
+    char path[256];
+    char tmp_path[272];
+    cache_path(key, path, sizeof(path));
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE * file = fopen(tmp_path, "wb");
+    if(!file) {
+        gl_log_err("ERROR: program cache could not write %s\n", tmp_path);
+        return;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(binary.data(), 1, header.length, file) == (size_t)header.length;
+    ok = (fclose(file) == 0) && ok;
+    // rename so a crash mid-write never leaves a truncated entry behind
+    if(!ok || rename(tmp_path, path) != 0) {
+        gl_log_err("ERROR: program cache could not store %s\n", path);
+        remove(tmp_path);
+        return;
+    }
+    gl_log("program cache: stored %016llx (%i bytes)\n", key, header.length);
+}
+
+void log_program_cache_stats() {
+    std::lock_guard<std::mutex> lock(g_cache_stats_mutex);
+    gl_log("program cache: %i hits, %i misses (%i rejected binaries), %.2f ms saved\n",
+        g_cache_hits, g_cache_misses, g_cache_rejected, g_cache_saved_seconds * 1000.0);
+}
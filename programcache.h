@@ -0,0 +1,10 @@
+#pragma once
+#include <GL/glew.h>
+
+// Program binaries on disk, keyed by the shader sources' content hashes plus
+// the driver's GL_RENDERER/GL_VERSION strings so a driver update invalidates
+// the entry.
+unsigned long long program_cache_key(const unsigned long long * source_hashes, int count);
+bool program_cache_load(unsigned long long key, GLuint program);
+void program_cache_store(unsigned long long key, GLuint program, double build_seconds);
+void log_program_cache_stats();
@@ -0,0 +1,184 @@
+#include <GL/glew.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include "logging.h"
+#include "shadermanager.h"
+#include "frametiming.h"
+#include "headless.h"
+#include "batchrenderer.h"
+#include "glstate.h"
+#include "renderqueue.h"
+#include "glcapture.h"
+
+// Render queue benchmark: N triangles spread over several programs, VAOs
+// and colours, recorded in scene order from 1..T threads, then submitted
+// either in record order or sorted by key.
+
+#define QUEUE_BENCH_PROGRAMS 4
+#define QUEUE_BENCH_VAOS 4
+#define QUEUE_BENCH_COLOURS 8
+
+struct scene_object {
+    int program;
+    int vao;
+    int colour;
+    GLint first;
+    float depth;
+};
+
+static int g_frames = 30;
+static GLuint g_programs[QUEUE_BENCH_PROGRAMS];
+static mesh_batch g_batches[QUEUE_BENCH_VAOS];
+static const float g_colours[QUEUE_BENCH_COLOURS][4] = {
+    { 1.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 1.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 1.0f, 1.0f }, { 1.0f, 1.0f, 0.0f, 1.0f },
+    { 1.0f, 0.0f, 1.0f, 1.0f }, { 0.0f, 1.0f, 1.0f, 1.0f }, { 1.0f, 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 0.0f, 1.0f },
+};
+
+static void record_range(render_queue * queue, const std::vector<scene_object> & objects,
+        size_t begin, size_t end, bool sorted) {
+    for(size_t i = begin; i < end; i++) {
+        const scene_object & o = objects[i];
+        render_command * c = render_queue_record(queue);
+        GLuint vao = g_batches[o.vao].vao.get();
+        // material = vao and colour, so equal colours end up adjacent within a VAO
+        c->key = sorted ? render_sort_key(0, o.program, o.vao * QUEUE_BENCH_COLOURS + o.colour, o.depth) : 0;
+        c->program = g_programs[o.program];
+        c->vao = vao;
+        c->mode = GL_TRIANGLES;
+        c->first = o.first;
+        c->count = 3;
+        c->color_uniform = "input_color";
+        for(int k = 0; k < 4; k++) {
+            c->color[k] = g_colours[o.colour][k];
+        }
+    }
+}
+
+static void bench(render_queue * queue, const std::vector<scene_object> & objects, int threads, bool sorted) {
+    std::vector<double> record_ms;
+    std::vector<double> frame_ms;
+    double sort_before = queue->sort_seconds;
+    double submit_before = queue->submit_seconds;
+    unsigned long issued = 0;
+    unsigned long elided = 0;
+    for(int frame = 0; frame < g_frames + 3; frame++) {
+        double start = frame_timing_seconds();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        std::vector<std::thread> workers;
+        size_t per_thread = (objects.size() + threads - 1) / threads;
+        for(int t = 0; t < threads; t++) {
+            size_t begin = std::min(objects.size(), t * per_thread);
+            size_t end = std::min(objects.size(), begin + per_thread);
+            workers.push_back(std::thread(record_range, queue, std::cref(objects), begin, end, sorted));
+        }
+        for(size_t t = 0; t < workers.size(); t++) {
+            workers[t].join();
+        }
+        double recorded = frame_timing_seconds();
+        render_queue_submit(queue);
+        gl_state_end_frame();
+        headless_present();
+        if(frame < 3) {
+            // warm-up frames also allocate the per-thread chunks
+            sort_before = queue->sort_seconds;
+            submit_before = queue->submit_seconds;
+            continue;
+        }
+        gl_state_frame_counters(&issued, &elided);
+        record_ms.push_back((recorded - start) * 1000.0);
+        frame_ms.push_back((frame_timing_seconds() - start) * 1000.0);
+    }
+    glFinish();
+    double record_sum = 0.0;
+    double frame_sum = 0.0;
+    for(int i = 0; i < g_frames; i++) {
+        record_sum += record_ms[i];
+        frame_sum += frame_ms[i];
+    }
+    gl_log("  %-8s %9zu %8i %11.3f %9.3f %11.3f %10.3f %13lu\n", sorted ? "sorted" : "unsorted",
+        objects.size(), threads, record_sum / g_frames,
+        (queue->sort_seconds - sort_before) * 1000.0 / g_frames,
+        (queue->submit_seconds - submit_before) * 1000.0 / g_frames,
+        frame_sum / g_frames, issued);
+}
+
+int main(int argc, char ** argv) {
+    headless_options options;
+    if(!parse_headless_args(argc, argv, &options)) {
+        return 1;
+    }
+    options.enabled = true;
+    if(options.frames > 0) {
+        g_frames = (int)options.frames;
+    }
+    if(!restart_gl_log()) {
+        fprintf(stderr, "Failed to open log file\n");
+        return 1;
+    }
+    gl_log_set_level(GL_LOG_WARN);
+    if(!headless_init(&options)) {
+        return 2;
+    }
+    gl_state_viewport(0, 0, options.width, options.height);
+    for(int i = 0; i < QUEUE_BENCH_PROGRAMS; i++) {
+        g_programs[i] = build_shader_program("./batch.vert", "./batch.frag");
+        if(!g_programs[i]) {
+            return 3;
+        }
+    }
+    glClearColor(0.6f, 0.6f, 0.8f, 1.0f);
+
+    int object_count = 100000;
+    int per_batch = object_count / QUEUE_BENCH_VAOS;
+    int side = (int)ceil(sqrt((double)per_batch));
+    float cell = 2.0f / side;
+    for(int b = 0; b < QUEUE_BENCH_VAOS; b++) {
+        batch_init(&g_batches[b]);
+        for(int i = 0; i < per_batch; i++) {
+            float x = -1.0f + cell * (i % side + 0.5f);
+            float y = -1.0f + cell * (i / side + 0.5f);
+            float size = cell * 0.4f;
+            GLfloat triangle[] = {
+                x,        y + size, 0.0f,
+                x + size, y - size, 0.0f,
+                x - size, y - size, 0.0f,
+            };
+            batch_add_mesh(&g_batches[b], triangle, 3, NULL, 0);
+        }
+        batch_upload(&g_batches[b]);
+    }
+    // scene order interleaves everything, the worst case for state changes
+    srand(1);
+    std::vector<scene_object> objects(object_count);
+    for(int i = 0; i < object_count; i++) {
+        objects[i].program = rand() % QUEUE_BENCH_PROGRAMS;
+        objects[i].vao = i % QUEUE_BENCH_VAOS;
+        objects[i].colour = rand() % QUEUE_BENCH_COLOURS;
+        objects[i].first = (i / QUEUE_BENCH_VAOS) * 3;
+        objects[i].depth = (float)rand() / RAND_MAX;
+    }
+    gl_log_set_level(GL_LOG_INFO);
+
+    int max_threads = std::max(4, (int)std::thread::hardware_concurrency());
+    gl_log("\nqueue-bench: %s, %i frames per case\n", glGetString(GL_RENDERER), g_frames);
+    gl_log("  %-8s %9s %8s %11s %9s %11s %10s %13s\n", "order", "commands", "threads",
+        "record ms", "sort ms", "submit ms", "frame ms", "gl state/frame");
+    render_queue queue;
+    render_queue_init(&queue);
+    bench(&queue, objects, 1, false);
+    for(int threads = 1; threads <= max_threads; threads *= 2) {
+        bench(&queue, objects, threads, true);
+    }
+    log_render_queue_stats(&queue);
+    render_queue_destroy(&queue);
+
+    for(int b = 0; b < QUEUE_BENCH_VAOS; b++) {
+        batch_destroy(&g_batches[b]);
+    }
+    headless_shutdown();
+    return 0;
+}
@@ -0,0 +1,203 @@
+#include <GL/glew.h>
+#include <string.h>
+#include "logging.h"
+#include "frametiming.h"
+#include "shadermanager.h"
+#include "glstate.h"
+#include "renderqueue.h"
+#include "profiler.h"
+#include "glcapture.h"
+
+// each thread remembers the buffer it took from each of the last few queues
+// it recorded into, so alternating between queues does not take a fresh
+// buffer every time it switches
+#define RENDER_QUEUE_THREAD_CACHE 4
+
+struct thread_buffer_entry {
+    const render_queue * queue;
+    unsigned long epoch;
+    render_command_buffer * buffer;
+};
+
+struct thread_buffer_cache {
+    thread_buffer_entry entries[RENDER_QUEUE_THREAD_CACHE];
+    // round-robin victim when every entry belongs to another queue
+    int next;
+};
+
+static std::atomic<unsigned long> g_epoch(0);
+static thread_local thread_buffer_cache t_cache = {};
+
+unsigned long long render_sort_key(unsigned int pass, unsigned int program, unsigned int material, float depth) {
+    if(depth < 0.0f) {
+        depth = 0.0f;
+    }
+    if(depth > 1.0f) {
+        depth = 1.0f;
+    }
+    unsigned long long quantized = (unsigned long long)(depth * 0xffffff);
+    return ((unsigned long long)(pass & 0xf) << 60)
+        | ((unsigned long long)(program & 0xfff) << 48)
+        | ((unsigned long long)(material & 0xffff) << 32)
+        | (quantized << 8);
+}
+
+void render_queue_init(render_queue * queue) {
+    queue->epoch = ++g_epoch;
+    queue->buffers.clear();
+    queue->buffers_in_use = 0;
+    queue->entries.clear();
+    queue->scratch.clear();
+    queue->submitted = 0;
+    queue->sort_seconds = 0.0;
+    queue->submit_seconds = 0.0;
+}
+
+render_command * render_queue_record(render_queue * queue) {
+    unsigned long epoch = queue->epoch.load(std::memory_order_acquire);
+    thread_buffer_entry * entry = NULL;
+    for(int i = 0; i < RENDER_QUEUE_THREAD_CACHE && !entry; i++) {
+        if(t_cache.entries[i].queue == queue) {
+            entry = &t_cache.entries[i];
+        }
+    }
+    if(!entry) {
+        entry = &t_cache.entries[t_cache.next];
+        t_cache.next = (t_cache.next + 1) % RENDER_QUEUE_THREAD_CACHE;
+        entry->queue = queue;
+        entry->epoch = 0;
+    }
+    if(entry->epoch != epoch) {
+        // first command from this thread since the last submit: the only locked step
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        if(queue->buffers_in_use == queue->buffers.size()) {
+            render_command_buffer * buffer = new render_command_buffer();
+            buffer->count = 0;
+            queue->buffers.push_back(buffer);
+        }
+        entry->epoch = epoch;
+        entry->buffer = queue->buffers[queue->buffers_in_use++];
+    }
+    render_command_buffer * buffer = entry->buffer;
+    size_t chunk = buffer->count / RENDER_COMMAND_CHUNK;
+    if(chunk == buffer->chunks.size()) {
+        // chunks are kept across frames, so steady-state recording never allocates
+        buffer->chunks.push_back(new render_command[RENDER_COMMAND_CHUNK]);
+    }
+    render_command * command = &buffer->chunks[chunk][buffer->count % RENDER_COMMAND_CHUNK];
+    buffer->count++;
+    memset(command, 0, sizeof(*command));
+    command->instance_count = 1;
+    return command;
+}
+
+// LSD radix sort, 8 bits per pass; passes where every key has the same byte are skipped
+static void radix_sort(std::vector<render_sort_entry> & entries, std::vector<render_sort_entry> & scratch) {
+    size_t n = entries.size();
+    scratch.resize(n);
+    size_t histograms[8][256];
+    memset(histograms, 0, sizeof(histograms));
+    for(size_t i = 0; i < n; i++) {
+        unsigned long long key = entries[i].key;
+        for(int byte = 0; byte < 8; byte++) {
+            histograms[byte][(key >> (byte * 8)) & 0xff]++;
+        }
+    }
+    render_sort_entry * from = entries.data();
+    render_sort_entry * to = scratch.data();
+    for(int byte = 0; byte < 8; byte++) {
+        size_t * counts = histograms[byte];
+        if(counts[(from[0].key >> (byte * 8)) & 0xff] == n) {
+            continue;
+        }
+        size_t offset = 0;
+        for(int i = 0; i < 256; i++) {
+            size_t count = counts[i];
+            counts[i] = offset;
+            offset += count;
+        }
+        for(size_t i = 0; i < n; i++) {
+            to[counts[(from[i].key >> (byte * 8)) & 0xff]++] = from[i];
+        }
+        render_sort_entry * swap = from;
+        from = to;
+        to = swap;
+    }
+    if(from != entries.data()) {
+        memcpy(entries.data(), from, n * sizeof(render_sort_entry));
+    }
+}
+
+static void execute(const render_command * command) {
+    gl_state_use_program(command->program);
+    gl_state_bind_vertex_array(command->vao);
+    if(command->point_size > 0.0f) {
+        gl_state_point_size(command->point_size);
+    }
+    if(command->color_uniform) {
+        const float * c = command->color;
+        set_uniform_vec4(command->program, command->color_uniform, c[0], c[1], c[2], c[3]);
+    }
+    if(command->indexed) {
+        glDrawElementsInstancedBaseVertex(command->mode, command->count, GL_UNSIGNED_INT,
+            (const void *)(command->first * sizeof(GLuint)), command->instance_count, command->base_vertex);
+    } else if(command->instance_count != 1) {
+        glDrawArraysInstanced(command->mode, command->first, command->count, command->instance_count);
+    } else {
+        glDrawArrays(command->mode, command->first, command->count);
+    }
+}
+
+void render_queue_submit(render_queue * queue) {
+    PROFILE_GPU_ZONE("render_queue_submit");
+    double start = frame_timing_seconds();
+    queue->entries.clear();
+    {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        for(size_t b = 0; b < queue->buffers.size(); b++) {
+            render_command_buffer * buffer = queue->buffers[b];
+            for(size_t i = 0; i < buffer->count; i++) {
+                const render_command * command = &buffer->chunks[i / RENDER_COMMAND_CHUNK][i % RENDER_COMMAND_CHUNK];
+                render_sort_entry entry = { command->key, command };
+                queue->entries.push_back(entry);
+            }
+        }
+    }
+    if(!queue->entries.empty()) {
+        PROFILE_ZONE("render_queue_sort");
+        radix_sort(queue->entries, queue->scratch);
+    }
+    double sorted = frame_timing_seconds();
+    for(size_t i = 0; i < queue->entries.size(); i++) {
+        execute(queue->entries[i].command);
+    }
+    queue->submitted += queue->entries.size();
+    queue->sort_seconds += sorted - start;
+    queue->submit_seconds += frame_timing_seconds() - sorted;
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    for(size_t b = 0; b < queue->buffers.size(); b++) {
+        queue->buffers[b]->count = 0;
+    }
+    queue->buffers_in_use = 0;
+    queue->epoch = ++g_epoch;
+}
+
+void log_render_queue_stats(const render_queue * queue) {
+    gl_log("render queue: %lu commands submitted, %zu thread buffers, %.3f ms sorting, %.3f ms submitting\n",
+        queue->submitted, queue->buffers.size(), queue->sort_seconds * 1000.0, queue->submit_seconds * 1000.0);
+}
+
+void render_queue_destroy(render_queue * queue) {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    for(size_t b = 0; b < queue->buffers.size(); b++) {
+        render_command_buffer * buffer = queue->buffers[b];
+        for(size_t c = 0; c < buffer->chunks.size(); c++) {
+            delete[] buffer->chunks[c];
+        }
+        delete buffer;
+    }
+    queue->buffers.clear();
+    queue->buffers_in_use = 0;
+    // threads still caching the old epoch take a fresh buffer if the queue is reused
+    queue->epoch = ++g_epoch;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <GL/glew.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+// Draw commands recorded from any thread into per-thread, chunk-allocated
+// command buffers, then merged, radix-sorted on a 64-bit key and submitted
+// from the GL thread through the state cache. Recording must be finished
+// (threads joined or their jobs complete) before render_queue_submit().
+//
+// key layout, most significant first:
+//   63..60 pass | 59..48 program | 47..32 VAO/material | 31..8 depth | 7..0 free
+#define RENDER_COMMAND_CHUNK 4096
+
+struct render_command {
+    unsigned long long key;
+    GLuint program;
+    GLuint vao;
+    GLenum mode;
+    GLint first;
+    GLsizei count;
+    GLsizei instance_count;
+    // indexed draws read GL_UNSIGNED_INT indices at first, offset by base_vertex
+    bool indexed;
+    GLint base_vertex;
+    float point_size;
+    // optional vec4 set through the uniform table before drawing
+    const char * color_uniform;
+    float color[4];
+};
+
+struct render_command_buffer {
+    std::vector<render_command *> chunks;
+    size_t count;
+};
+
+struct render_sort_entry {
+    unsigned long long key;
+    const render_command * command;
+};
+
+struct render_queue {
+    std::mutex mutex;
+    // bumped on init and every submit; a thread whose cached epoch for this
+    // queue differs takes a buffer from the pool again, so short-lived
+    // threads reuse buffers
+    std::atomic<unsigned long> epoch;
+    std::vector<render_command_buffer *> buffers;
+    size_t buffers_in_use;
+    std::vector<render_sort_entry> entries;
+    std::vector<render_sort_entry> scratch;
+    unsigned long submitted;
+    double sort_seconds;
+    double submit_seconds;
+};
+
+unsigned long long render_sort_key(unsigned int pass, unsigned int program, unsigned int material, float depth);
+void render_queue_init(render_queue * queue);
+render_command * render_queue_record(render_queue * queue);
+void render_queue_submit(render_queue * queue);
+void log_render_queue_stats(const render_queue * queue);
+void render_queue_destroy(render_queue * queue);
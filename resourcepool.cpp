@@ -0,0 +1,93 @@
+#include <GL/glew.h>
+#include "logging.h"
+#include "glstate.h"
+#include "shadermanager.h"
+#include "resourcepool.h"
+#include "glcapture.h"
+
+struct gl_resource {
+    gl_resource_type type;
+    GLuint name;
+};
+
+static object_pool<gl_resource, GL_RESOURCE_CAPACITY> g_resources;
+static bool g_resources_ready = false;
+static int g_live[GL_RESOURCE_TYPES];
+static unsigned long g_created[GL_RESOURCE_TYPES];
+static unsigned long g_destroyed[GL_RESOURCE_TYPES];
+
+static const char * g_type_names[GL_RESOURCE_TYPES] = {
+    "buffers", "vertex arrays", "textures", "shaders", "programs"
+};
+
+pool_handle gl_resource_create(gl_resource_type type, GLuint name) {
+    if(!g_resources_ready) {
+        object_pool_init(&g_resources);
+        g_resources_ready = true;
+    }
+    pool_handle handle = pool_handle();
+    if(!name) {
+        return handle;
+    }
+    gl_resource * resource = NULL;
+    handle = object_pool_alloc(&g_resources, &resource);
+    if(!resource) {
+        gl_log_err("ERROR: GL resource registry full (%i entries), %s %u is not tracked\n",
+            GL_RESOURCE_CAPACITY, g_type_names[type], name);
+        return handle;
+    }
+    resource->type = type;
+    resource->name = name;
+    g_live[type]++;
+    g_created[type]++;
+    return handle;
+}
+
+GLuint gl_resource_name(pool_handle handle) {
+    if(!g_resources_ready) {
+        return 0;
+    }
+    gl_resource * resource = object_pool_get(&g_resources, handle);
+    return resource ? resource->name : 0;
+}
+
+void gl_resource_destroy(pool_handle handle) {
+    if(!g_resources_ready) {
+        return;
+    }
+    gl_resource * resource = object_pool_get(&g_resources, handle);
+    if(!resource) {
+        return;
+    }
+    GLuint name = resource->name;
+    switch(resource->type) {
+        case GL_RESOURCE_BUFFER: gl_state_delete_buffers(1, &name); break;
+        case GL_RESOURCE_VERTEX_ARRAY: gl_state_delete_vertex_arrays(1, &name); break;
+        case GL_RESOURCE_TEXTURE: gl_state_delete_textures(1, &name); break;
+        case GL_RESOURCE_SHADER: glDeleteShader(name); break;
+        case GL_RESOURCE_PROGRAM:
+            release_uniform_table(name);
+            gl_state_delete_program(name);
+            break;
+        default: break;
+    }
+    g_live[resource->type]--;
+    g_destroyed[resource->type]++;
+    object_pool_free(&g_resources, handle);
+}
+
+int gl_resource_live(gl_resource_type type) {
+    return g_live[type];
+}
+
+void log_gl_resource_stats() {
+    gl_log("gl resources: %i live, high water %i of %i\n", g_resources.live_count, g_resources.high_water,
+        GL_RESOURCE_CAPACITY);
+    for(int i = 0; i < GL_RESOURCE_TYPES; i++) {
+        if(g_created[i] == 0) {
+            continue;
+        }
+        gl_log("  %-14s %lu created, %lu destroyed, %i live\n", g_type_names[i], g_created[i], g_destroyed[i],
+            g_live[i]);
+    }
+}
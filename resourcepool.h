@@ -0,0 +1,150 @@
+#pragma once
+#include <GL/glew.h>
+#include <stdint.h>
+
+// Fixed-capacity object pools addressed by generational handles. A handle is
+// a slot index plus the generation the slot had when it was handed out;
+// freeing bumps the generation, so a stale handle (a program replaced by a
+// reload, a buffer already torn down) resolves to nothing rather than to
+// whatever took the slot next. Slots are recycled through a free list, so
+// steady-state create/destroy never touches the heap.
+struct pool_handle {
+    uint32_t index;
+    // 0 is never handed out, so a zeroed handle is null
+    uint32_t generation;
+};
+
+template <typename T, int N>
+struct object_pool {
+    T items[N];
+    uint32_t generations[N];
+    bool live[N];
+    int free_list[N];
+    int free_count;
+    int live_count;
+    int high_water;
+    unsigned long exhausted;
+};
+
+template <typename T, int N>
+void object_pool_init(object_pool<T, N> * pool) {
+    for(int i = 0; i < N; i++) {
+        pool->generations[i] = 1;
+        pool->live[i] = false;
+        // lowest slots first
+        pool->free_list[i] = N - 1 - i;
+    }
+    pool->free_count = N;
+    pool->live_count = 0;
+    pool->high_water = 0;
+    pool->exhausted = 0;
+}
+
+// a null handle when the pool is full
+template <typename T, int N>
+pool_handle object_pool_alloc(object_pool<T, N> * pool, T ** item) {
+    pool_handle handle = { 0, 0 };
+    if(pool->free_count == 0) {
+        pool->exhausted++;
+        *item = NULL;
+        return handle;
+    }
+    int index = pool->free_list[--pool->free_count];
+    pool->live[index] = true;
+    if(++pool->live_count > pool->high_water) {
+        pool->high_water = pool->live_count;
+    }
+    handle.index = (uint32_t)index;
+    handle.generation = pool->generations[index];
+    *item = &pool->items[index];
+    return handle;
+}
+
+template <typename T, int N>
+T * object_pool_get(object_pool<T, N> * pool, pool_handle handle) {
+    if(handle.index >= (uint32_t)N || !pool->live[handle.index]
+        || pool->generations[handle.index] != handle.generation) {
+        return NULL;
+    }
+    return &pool->items[handle.index];
+}
+
+template <typename T, int N>
+bool object_pool_free(object_pool<T, N> * pool, pool_handle handle) {
+    if(!object_pool_get(pool, handle)) {
+        return false;
+    }
+    pool->live[handle.index] = false;
+    // skip 0 on wrap-around so null handles stay null
+    if(++pool->generations[handle.index] == 0) {
+        pool->generations[handle.index] = 1;
+    }
+    pool->free_list[pool->free_count++] = (int)handle.index;
+    pool->live_count--;
+    return true;
+}
+
+// GL objects owned through the registry. Destroying an entry deletes the GL
+// object through the state cache (and drops a program's uniform table), so
+// ownership is in one place; log_gl_resource_stats() at teardown lists
+// whatever is still alive.
+#define GL_RESOURCE_CAPACITY 4096
+
+enum gl_resource_type {
+    GL_RESOURCE_BUFFER,
+    GL_RESOURCE_VERTEX_ARRAY,
+    GL_RESOURCE_TEXTURE,
+    GL_RESOURCE_SHADER,
+    GL_RESOURCE_PROGRAM,
+    GL_RESOURCE_TYPES
+};
+
+// takes ownership of name; a null handle if name is 0 or the registry is full
+pool_handle gl_resource_create(gl_resource_type type, GLuint name);
+// 0 for null and stale handles
+GLuint gl_resource_name(pool_handle handle);
+void gl_resource_destroy(pool_handle handle);
+int gl_resource_live(gl_resource_type type);
+void log_gl_resource_stats();
+
+// Move-only owner of one registry entry: the GL object is deleted when the
+// handle is reset, reassigned or goes out of scope.
+class gl_handle {
+public:
+    gl_handle() : m_handle() {}
+    gl_handle(gl_resource_type type, GLuint name) : m_handle(gl_resource_create(type, name)) {}
+    gl_handle(gl_handle && other) : m_handle(other.m_handle) {
+        other.m_handle = pool_handle();
+    }
+    gl_handle & operator=(gl_handle && other) {
+        if(this != &other) {
+            gl_resource_destroy(m_handle);
+            m_handle = other.m_handle;
+            other.m_handle = pool_handle();
+        }
+        return *this;
+    }
+    ~gl_handle() {
+        gl_resource_destroy(m_handle);
+    }
+    GLuint get() const {
+        return gl_resource_name(m_handle);
+    }
+    pool_handle id() const {
+        return m_handle;
+    }
+    // deletes the current object, then owns name instead
+    void reset(gl_resource_type type, GLuint name) {
+        gl_resource_destroy(m_handle);
+        m_handle = gl_resource_create(type, name);
+    }
+    void reset() {
+        gl_resource_destroy(m_handle);
+        m_handle = pool_handle();
+    }
+
+private:
+    gl_handle(const gl_handle &);
+    gl_handle & operator=(const gl_handle &);
+    pool_handle m_handle;
+};
@@ -1,12 +1,25 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <stdio.h>
-#include <unistd.h>
+#include <string.h>
 #include <fstream>
 #include <string>
 #include <iostream>
 #include "logging.h"
 #include "shadermanager.h"
+#include "frametiming.h"
+#include "framepacing.h"
+#include "headless.h"
+#include "streambuffer.h"
+#include "shaderwatcher.h"
+#include "glstate.h"
+#include "framearena.h"
+#include "resourcepool.h"
+#include "alloccounter.h"
+#include "framecapture.h"
+#include "gldebug.h"
+#include "profiler.h"
+#include "glcapture.h"
 
 
 // GLFW callbacks
@@ -17,7 +30,14 @@ int g_window_height = 480;
 int g_fb_width = 640;
 int g_fb_height = 480;
 
-GLuint shader_programme;
+// owned through the resource registry; reloads swap what it points at
+gl_handle shader_programme;
+// frames rendered before the loop is expected to stop allocating
+#define WARMUP_FRAMES 60
+
+// cursor in normalised device coordinates; the points follow it
+float g_cursor_x = 0.0f;
+float g_cursor_y = 0.0f;
 
 void window_size_callback(GLFWwindow* window, int width, int height) {
     gl_log("GLFW: window size: %i x %i\n", width, height);
@@ -36,46 +56,81 @@ void error_callback(int error, const char* description) {
 }
 
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    frame_pacing_input_event();
     if (key == GLFW_KEY_R && action == GLFW_PRESS) {
-        shader_programme = get_shader_program();
+        // picked up by shader_watcher_update() without stalling the frame
+        shader_watcher_request_reload();
     }
     if(action == GLFW_PRESS && (key == GLFW_KEY_ESCAPE || key == GLFW_KEY_Q)) {
         glfwSetWindowShouldClose(window, 1);
     }
  }
 
-int main() {
+void cursor_position_callback(GLFWwindow* window, double x, double y) {
+    frame_pacing_input_event();
+    g_cursor_x = (float)(x / g_window_width * 2.0 - 1.0);
+    g_cursor_y = (float)(1.0 - y / g_window_height * 2.0);
+}
+
+int main(int argc, char ** argv) {
+    frame_pacing_options pacing;
+    if(!parse_frame_pacing_args(&argc, argv, &pacing)) {
+        return 1;
+    }
+    frame_capture_options capture;
+    if(!parse_frame_capture_args(&argc, argv, &capture)) {
+        return 1;
+    }
+    gl_debug_options debug;
+    if(!parse_gl_debug_args(&argc, argv, &debug)) {
+        return 1;
+    }
+    headless_options headless;
+    if(!parse_headless_args(argc, argv, &headless)) {
+        return 1;
+    }
+    headless.debug_context = debug.enabled;
     // start GL context and O/S window using the GLFW helper library
     if(!restart_gl_log()) {
         fprintf(stderr, "Failed to open log file\n");
         return 1;
     }
-    gl_log("Starting GLFW: %s\n", glfwGetVersionString());
-    glfwSetErrorCallback(error_callback);
-    if(!glfwInit()) {
-        fprintf(stderr, "Failed to initialize GLFW3\n");
-        return 2;
-    }
-
-    glfwWindowHint(GLFW_SAMPLES, 4);
-    GLFWmonitor* monitor = glfwGetPrimaryMonitor();
-    const GLFWvidmode* vmode = glfwGetVideoMode(monitor);
-    GLFWwindow* window = glfwCreateWindow(640, 480, "Shader Minimal", NULL, NULL);
-    // GLFWwindow* window = glfwCreateWindow(vmode->width, vmode->height, "HelloWindow", NULL, NULL);
-    if(!window) {
-        gl_log_err("ERROR: could not open window with GLFW3\n");
-        glfwTerminate();
-        return 1;
-    }
-    glfwSetWindowSizeCallback(window, window_size_callback);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetKeyCallback(window, key_callback);
-    glfwMakeContextCurrent(window);
+    GLFWwindow* window = NULL;
+    if(headless.enabled) {
+        // no display needed: EGL context rendering into an FBO
+        if(!headless_init(&headless)) {
+            return 2;
+        }
+        g_window_width = g_fb_width = headless.width;
+        g_window_height = g_fb_height = headless.height;
+    } else {
+        gl_log("Starting GLFW: %s\n", glfwGetVersionString());
+        glfwSetErrorCallback(error_callback);
+        if(!glfwInit()) {
+            fprintf(stderr, "Failed to initialize GLFW3\n");
+            return 2;
+        }
+
+        glfwWindowHint(GLFW_SAMPLES, 4);
+        gl_debug_context_hints(&debug);
+        window = glfwCreateWindow(640, 480, "Shader Minimal", NULL, NULL);
+        // GLFWwindow* window = glfwCreateWindow(vmode->width, vmode->height, "HelloWindow", NULL, NULL);
+        if(!window) {
+            gl_log_err("ERROR: could not open window with GLFW3\n");
+            glfwTerminate();
+            return 1;
+        }
+        glfwSetWindowSizeCallback(window, window_size_callback);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetKeyCallback(window, key_callback);
+        glfwSetCursorPosCallback(window, cursor_position_callback);
+        glfwMakeContextCurrent(window);
 
-    // start GLEW extension handler
-    gl_log("GLEW: %s\n", glewGetString(GLEW_VERSION));
-    glewExperimental = GL_TRUE;
-    glewInit();
+        // start GLEW extension handler
+        gl_log("GLEW: %s\n", glewGetString(GLEW_VERSION));
+        glewExperimental = GL_TRUE;
+        glewInit();
+    }
 
     // get version info
     const GLubyte* renderer = glGetString(GL_RENDERER);
@@ -83,8 +138,11 @@ int main() {
     gl_log("Renderer: %s\n", renderer);
     gl_log("OpenGL version supported %s\n", version);
     log_gl_params();
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LESS);
+    // driver messages from here on, first occurrences logged as they arrive
+    gl_debug_init(&debug);
+    gl_state_reset();
+    gl_state_enable(GL_DEPTH_TEST, true);
+    gl_state_depth_func(GL_LESS);
 
     /* Other stuff goes here*/
     // points
@@ -95,55 +153,147 @@ int main() {
         -size, -size, 0.0f,
     };
 
-    GLuint vbo = 0;
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(points), points, GL_STATIC_DRAW);
-
-    GLuint vao = 0;
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
-    glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-
-    shader_programme = get_shader_program();
-    glUseProgram(shader_programme);
-    if(!uniform_location(shader_programme, "input_color", 0.0f, 0.0f, 1.0f, 1.0f)) {
-        gl_log_err("ERROR: could not set uniform location\n");
+    // vertices are rewritten every frame into a ring of fenced regions
+    stream_buffer stream;
+    if(!stream_buffer_init(&stream, GL_ARRAY_BUFFER, 64 * 1024)) {
+        return 4;
+    }
+
+    GLuint vao_name = 0;
+    glGenVertexArrays(1, &vao_name);
+    gl_handle vao(GL_RESOURCE_VERTEX_ARRAY, vao_name);
+    // per-frame scratch, valid until the frame after next
+    frame_arena arena;
+    if(!frame_arena_init(&arena, 64 * 1024)) {
+        return 4;
+    }
+
+    shader_programme.reset(GL_RESOURCE_PROGRAM, get_shader_program());
+    if(!shader_programme.get()) {
+        gl_log_err("ERROR: could not build shader program\n");
+        return 5;
+    }
+    shader_watcher_init(SHADER_MINIMAL_VERT, SHADER_MINIMAL_FRAG, window);
+    gl_state_use_program(shader_programme.get());
+    if(!set_uniform_vec4(shader_programme.get(), "input_color", 0.0f, 0.0f, 1.0f, 1.0f)) {
+        gl_log_err("ERROR: could not set uniform input_color\n");
         return 5;
     }
 
+    frame_timing_init();
+    frame_timing_set_dump("frametimes.csv", "frametimes.json", 5.0);
+    frame_pacing_init(window, &pacing);
+    // a no-op unless built with -DGL_PROFILE
+    profiler_init("profile-trace.json");
+    if(!frame_capture_init(&capture, g_fb_width, g_fb_height)) {
+        return 9;
+    }
     glClearColor(0.6f, 0.6f, 0.8f, 1.0f);
-    while(!glfwWindowShouldClose(window)) {
-        update_fps_counter(window);
-        // wipe the drawing surface clear
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glViewport(0, 0, g_fb_width, g_fb_height);
-
-        glUseProgram(shader_programme);
-        if(!uniform_location(shader_programme, "input_color", 0.0f, 0.0f, 1.0f, 1.0f)) {
-            gl_log_err("ERROR: could not set uniform location\n");
-            return 6;
+    long frame = 0;
+    while(headless.enabled ? !headless_should_close() : !glfwWindowShouldClose(window)) {
+        // sleeps off the slack before the frame rather than after it, then polls input
+        frame_pacing_begin_frame();
+        frame_timing_begin_frame();
+        alloc_counter_set_steady(frame++ >= WARMUP_FRAMES);
+        alloc_counter_begin_frame();
+        if(window) {
+            frame_timing_update_title(window);
         }
-        // GLuint uniform_location = glGetUniformLocation(shader_programme, "input_color");
-        // glUniform4f(uniform_location, 0.0f, 0.0f, 1.0f, 1.0f);
-        
-        // draw points 0-3 from the currently bound VAO with current in-use shader
-        glBindVertexArray(vao);
-        // glDrawArrays(GL_TRIANGLES, 0, 3);
-        glPointSize(40.0f);
-        glDrawArrays(GL_POINTS, 0, 3);
-
-        // update other events like input handling
-        glfwPollEvents();
+        bool reloading = shader_watcher_pending();
+        shader_watcher_update(&shader_programme);
+        if(reloading || shader_watcher_pending()) {
+            // file reads and program builds are allowed to allocate
+            alloc_counter_skip_frame();
+        }
+        frame_timing_begin_pass("scene");
+        {
+            PROFILE_GPU_ZONE("scene");
+            // wipe the drawing surface clear
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            gl_state_viewport(0, 0, g_fb_width, g_fb_height);
+
+            GLuint program = shader_programme.get();
+            gl_state_use_program(program);
+            // no GL call unless the value changed or the program was reloaded
+            if(!set_uniform_vec4(program, "input_color", 0.0f, 0.0f, 1.0f, 1.0f)) {
+                gl_log_err("ERROR: could not set uniform input_color\n");
+                // the capture writer thread has to be joined before exit
+                frame_capture_shutdown();
+                return 6;
+            }
         
+            stream_allocation points_allocation;
+            if(!stream_buffer_alloc(&stream, sizeof(points), sizeof(GLfloat), &points_allocation)) {
+                frame_capture_shutdown();
+                return 7;
+            }
+            // the cursor is read as late as possible, right before the vertices are written
+            frame_pacing_latch();
+            // built in cached memory, then copied into the write-combined mapping in one go
+            GLfloat * moved = frame_arena_alloc_array<GLfloat>(&arena, 9);
+            for(int i = 0; i < 9; i += 3) {
+                moved[i] = points[i] + g_cursor_x;
+                moved[i + 1] = points[i + 1] + g_cursor_y;
+                moved[i + 2] = points[i + 2];
+            }
+            memcpy(points_allocation.data, moved, sizeof(points));
+            stream_buffer_commit(&stream, &points_allocation);
+            stream_buffer_vertex_attrib(&points_allocation, vao.get(), 0, 3, GL_FLOAT, 0);
+
+            // draw points 0-3 from the currently bound VAO with current in-use shader
+            // glDrawArrays(GL_TRIANGLES, 0, 3);
+            gl_state_bind_vertex_array(vao.get());
+            gl_state_point_size(40.0f);
+            glDrawArrays(GL_POINTS, 0, 3);
+        }
+        frame_timing_end_pass();
+        stream_buffer_end_frame(&stream);
+        gl_state_end_frame();
+        // queued behind the frame's draws, mapped a few frames from now
+        frame_capture_frame(g_fb_width, g_fb_height);
+
+        if(headless.enabled) {
+            // unthrottled unless --fps asked for pacing
+            headless_present();
+        }
         // put the stuff we've been drawing onto the display
-        glfwSwapBuffers(window);
-        usleep(10000);
+        frame_pacing_end_frame();
+        frame_arena_end_frame(&arena);
+        gl_debug_end_frame();
+        alloc_counter_end_frame();
+        PROFILE_FRAME();
     }
 
+    if(headless.enabled) {
+        headless_report("shader-minimal", 0, 3);
+    }
+    log_frame_pacing_stats();
+    shader_watcher_shutdown();
+    log_stream_buffer_stats(&stream);
+    log_gl_state_stats();
+    log_frame_arena_stats(&arena);
+    log_alloc_counter_stats();
+    stream_buffer_destroy(&stream);
+    frame_arena_destroy(&arena);
+    // while the context is still current; anything left live has leaked
+    vao.reset();
+    shader_programme.reset();
+    log_gl_resource_stats();
+    log_gl_debug_stats();
+    gl_debug_shutdown();
+    bool captured = frame_capture_shutdown();
+    log_frame_capture_stats();
+    profiler_shutdown();
+    frame_timing_shutdown();
+    if(headless.enabled) {
+        headless_shutdown();
+        // benchmark runs double as the zero-allocation check
+        if(alloc_counter_steady_violations()) {
+            return 8;
+        }
+        return captured ? 0 : 9;
+    }
     // close GL context and any other GLFW resources
     glfwTerminate();
-    return 0;
+    return captured ? 0 : 9;
 }
\ No newline at end of file
@@ -1,8 +1,9 @@
 set -e
-g++ shader-minimal.cpp shadermanager.cpp logging.cpp \
+g++ shader-minimal.cpp framepacing.cpp framearena.cpp resourcepool.cpp alloccounter.cpp framecapture.cpp gldebug.cpp shadermanager.cpp shaderwatcher.cpp programcache.cpp frametiming.cpp headless.cpp \
+    streambuffer.cpp assetloader.cpp glstate.cpp logging.cpp \
     ../glew/lib/libGLEW.a ../glfw/build/src/libglfw3.a \
     -I ../glfw/include -I ../glew/include/ \
-    -lGL -lX11 -lGLU \
+    -lGL -lEGL -lX11 -lGLU -pthread \
     -o shader-minimal
 ./shader-minimal
  
\ No newline at end of file
@@ -2,22 +2,22 @@
 #include <GLFW/glfw3.h>
 #include <stdio.h>
 #include <unistd.h>
-#include <fstream>
 #include <string>
 #include <iostream>
+#include <map>
+#include <vector>
+#include <string.h>
 #include "logging.h"
+#include "frametiming.h"
 #include "shadermanager.h"
+#include "programcache.h"
+#include "assetloader.h"
+#include "glstate.h"
+#include "profiler.h"
+#include "glcapture.h"
 
 
-void read_file(const char * file, std::string & content) {
-    std::ifstream ifs(file);
-    std::string line;
-    while(std::getline(ifs, line)) {
-        content += line + "\n";
-    }
-}
-
-void check_for_shader_compile_error(GLuint vs) {
+bool check_for_shader_compile_error(GLuint vs) {
     GLint params = -1;
     glGetShaderiv(vs, GL_COMPILE_STATUS, &params);
     if(GL_TRUE != params) {
@@ -27,11 +27,12 @@ void check_for_shader_compile_error(GLuint vs) {
         char log[2048];
         glGetShaderInfoLog(vs, max_length, &actual_length, log);
         gl_log("shader info log for GL index %u:\n%s\n", vs, log);
-        exit(22);
+        return false;
     }
+    return true;
 }
 
-void check_for_shader_link_error(GLuint shader_programme) {
+bool check_for_shader_link_error(GLuint shader_programme) {
     GLint params = -1;
     glGetProgramiv(shader_programme, GL_LINK_STATUS, &params);
     if(GL_TRUE != params) {
@@ -41,17 +42,17 @@ void check_for_shader_link_error(GLuint shader_programme) {
         char log[2048];
         glGetProgramInfoLog(shader_programme, max_length, &actual_length, log);
         gl_log("program info log for GL index %u:\n%s", shader_programme, log);
-        exit(23);
+        return false;
     }
     // Dev only
     glValidateProgram(shader_programme);
     glGetProgramiv(shader_programme, GL_VALIDATE_STATUS, &params);
     if(GL_TRUE != params) {
         gl_log("program %i GL_VALIDATE_STATUS = GL_FALSE\n", shader_programme);
-        exit(24);
-    } else {
-        gl_log("Program validated\n");
+        return false;
     }
+    gl_log("Program validated\n");
+    return true;
 }
 
 const char * GL_type_to_string(GLenum type) {
@@ -135,47 +136,371 @@ void print_all(GLuint programe) {
 }
 
 
-GLuint get_shader_program() {
-    gl_log("\nLoading shaders:\n");
-    std::string vertex_shader_file;
-    read_file("./shader-minimal.vert", vertex_shader_file);
-    const char * vertex_shader = vertex_shader_file.c_str();
-
-    std::string fragment_shader_file;
-    read_file("./shader-minimal.frag", fragment_shader_file);
-    const char * fragment_shader = fragment_shader_file.c_str();
+// Returns 0 and leaves nothing behind when compile or link fails. Only makes
+// GL calls, so it also runs on a worker thread with a shared context.
+GLuint compile_shader_program(const char * vertex_file, const char * fragment_file) {
+    PROFILE_ZONE("compile_shader_program");
+    gl_log("\nLoading shaders %s %s:\n", vertex_file, fragment_file);
+    double start = frame_timing_seconds();
+    shader_source vertex_source;
+    shader_source fragment_source;
+    if(!load_shader_source(vertex_file, &vertex_source) || !load_shader_source(fragment_file, &fragment_source)) {
+        return 0;
+    }
+    const char * vertex_shader = vertex_source.text.c_str();
+    const char * fragment_shader = fragment_source.text.c_str();
+
+    unsigned long long hashes[] = { vertex_source.hash, fragment_source.hash };
+    unsigned long long cache_key = program_cache_key(hashes, 2);
+    GLuint current_shader = glCreateProgram();
+    if(program_cache_load(cache_key, current_shader)) {
+        log_program_cache_stats();
+        return current_shader;
+    }
     
     GLuint vs = glCreateShader(GL_VERTEX_SHADER);
     glShaderSource(vs, 1, &vertex_shader, NULL);
     glCompileShader(vs);
-    check_for_shader_compile_error(vs);
 
     GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
     glShaderSource(fs, 1, &fragment_shader, NULL);
     glCompileShader(fs);
-    check_for_shader_compile_error(fs);
 
-    GLuint current_shader = glCreateProgram();
-    glAttachShader(current_shader, fs);
-    glAttachShader(current_shader, vs);
-    glLinkProgram(current_shader);
-    check_for_shader_link_error(current_shader);
+    bool compiled = check_for_shader_compile_error(vs);
+    compiled = check_for_shader_compile_error(fs) && compiled;
+    bool linked = false;
+    if(compiled) {
+        glAttachShader(current_shader, fs);
+        glAttachShader(current_shader, vs);
+        glProgramParameteri(current_shader, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(current_shader);
+        linked = check_for_shader_link_error(current_shader);
+        glDetachShader(current_shader, fs);
+        glDetachShader(current_shader, vs);
+    }
+    // the program keeps its own copy of the linked code
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+    if(!linked) {
+        glDeleteProgram(current_shader);
+        return 0;
+    }
+    program_cache_store(cache_key, current_shader, frame_timing_seconds() - start);
+    log_program_cache_stats();
     show_shader(current_shader);
     print_all(current_shader);
     return current_shader;
 }
 
-bool uniform_location(GLuint shader_programme, const char * uniform_name, 
-    float r, float g, float b, float alpha) {
-    GLint current_shader_programme;
-    glGetIntegerv(GL_CURRENT_PROGRAM, &current_shader_programme);
-    if(shader_programme != current_shader_programme) {
-        gl_log("Current shader program name %i\n", shader_programme);
-        gl_log("Current reported shader program name %i\n", current_shader_programme);
-        gl_log_err("ERROR: shader program %i is not current\n", shader_programme);
+// Same contract as compile_shader_program, for a single compute shader.
+// Needs GL 4.3 or ARB_compute_shader; returns 0 without them.
+GLuint compile_compute_program(const char * compute_file) {
+    PROFILE_ZONE("compile_compute_program");
+    gl_log("\nLoading compute shader %s:\n", compute_file);
+    if(!GLEW_VERSION_4_3 && !GLEW_ARB_compute_shader) {
+        gl_log_err("ERROR: compute shaders need GL 4.3 or ARB_compute_shader\n");
+        return 0;
+    }
+    double start = frame_timing_seconds();
+    shader_source compute_source;
+    if(!load_shader_source(compute_file, &compute_source)) {
+        return 0;
+    }
+    const char * compute_shader = compute_source.text.c_str();
+
+    // the stage is mixed into the key so a compute and a vertex shader with
+    // the same text never share a cache entry
+    unsigned long long hashes[] = { compute_source.hash, GL_COMPUTE_SHADER };
+    unsigned long long cache_key = program_cache_key(hashes, 2);
+    GLuint current_shader = glCreateProgram();
+    if(program_cache_load(cache_key, current_shader)) {
+        log_program_cache_stats();
+        return current_shader;
+    }
+
+    GLuint cs = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(cs, 1, &compute_shader, NULL);
+    glCompileShader(cs);
+    bool linked = false;
+    if(check_for_shader_compile_error(cs)) {
+        glAttachShader(current_shader, cs);
+        glProgramParameteri(current_shader, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(current_shader);
+        linked = check_for_shader_link_error(current_shader);
+        glDetachShader(current_shader, cs);
+    }
+    glDeleteShader(cs);
+    if(!linked) {
+        glDeleteProgram(current_shader);
+        return 0;
+    }
+    program_cache_store(cache_key, current_shader, frame_timing_seconds() - start);
+    log_program_cache_stats();
+    show_shader(current_shader);
+    return current_shader;
+}
+
+GLuint build_compute_program(const char * compute_file) {
+    GLuint program = compile_compute_program(compute_file);
+    if(program) {
+        build_uniform_table(program);
+    }
+    return program;
+}
+
+GLuint build_shader_program(const char * vertex_file, const char * fragment_file) {
+    GLuint program = compile_shader_program(vertex_file, fragment_file);
+    if(program) {
+        build_uniform_table(program);
+    }
+    return program;
+}
+
+GLuint get_shader_program() {
+    return build_shader_program(SHADER_MINIMAL_VERT, SHADER_MINIMAL_FRAG);
+}
+
+// Per-program uniform table, built once after link from GL_ACTIVE_UNIFORMS.
+// Setters go through glProgramUniform* so the program does not have to be
+// current, and skip the GL call when the value has not changed.
+struct uniform_entry {
+    std::string name;
+    GLint location;
+    GLenum type;
+    GLint size;
+    bool has_value;
+    GLfloat value[16];
+    GLint int_value;
+};
+
+struct uniform_table {
+    std::vector<uniform_entry> uniforms;
+};
+
+// blocks shared between programs, bound by name whenever a table is built
+struct shared_uniform_block {
+    std::string name;
+    GLuint binding;
+    GLuint buffer;
+    GLsizeiptr size;
+};
+
+static std::map<GLuint, uniform_table> g_uniform_tables;
+static std::vector<shared_uniform_block> g_shared_blocks;
+
+static void bind_shared_block(GLuint program, const shared_uniform_block & block) {
+    GLuint index = glGetUniformBlockIndex(program, block.name.c_str());
+    if(index != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, index, block.binding);
+    }
+}
+
+void build_uniform_table(GLuint program) {
+    uniform_table & table = g_uniform_tables[program];
+    table.uniforms.clear();
+    int params = -1;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &params);
+    for(GLuint i = 0; i < (GLuint)params; i++) {
+        char name[64];
+        int max_length = 64;
+        int actual_length = 0;
+        uniform_entry entry;
+        glGetActiveUniform(program, i, max_length, &actual_length, &entry.size, &entry.type, name);
+        entry.location = glGetUniformLocation(program, name);
+        if(entry.location < 0) {
+            // member of a uniform block, set through the block's buffer
+            continue;
+        }
+        // arrays are reported as "name[0]", look them up by the bare name
+        char * bracket = strchr(name, '[');
+        if(bracket) {
+            *bracket = '\0';
+        }
+        entry.name = name;
+        entry.has_value = false;
+        entry.int_value = 0;
+        gl_log("  uniform %i) type:%s name:%s location:%i\n", i, GL_type_to_string(entry.type), name, entry.location);
+        table.uniforms.push_back(entry);
+    }
+    for(size_t i = 0; i < g_shared_blocks.size(); i++) {
+        bind_shared_block(program, g_shared_blocks[i]);
+    }
+}
+
+void release_uniform_table(GLuint program) {
+    g_uniform_tables.erase(program);
+}
+
+static bool uniform_type_matches(GLenum actual, GLenum requested) {
+    if(actual == requested) {
+        return true;
+    }
+    // bools and samplers are set through the int setter
+    if(requested == GL_INT) {
+        switch(actual) {
+            case GL_BOOL:
+            case GL_SAMPLER_2D:
+            case GL_SAMPLER_3D:
+            case GL_SAMPLER_CUBE:
+            case GL_SAMPLER_2D_SHADOW:
+                return true;
+            default: break;
+        }
+    }
+    return false;
+}
+
+static uniform_entry * find_uniform(GLuint program, const char * uniform_name, GLenum type) {
+    std::map<GLuint, uniform_table>::iterator table = g_uniform_tables.find(program);
+    if(table == g_uniform_tables.end()) {
+        gl_log_err("ERROR: no uniform table for shader program %u\n", program);
+        return NULL;
+    }
+    std::vector<uniform_entry> & uniforms = table->second.uniforms;
+    for(size_t i = 0; i < uniforms.size(); i++) {
+        if(uniforms[i].name == uniform_name) {
+            if(!uniform_type_matches(uniforms[i].type, type)) {
+                gl_log_err("ERROR: uniform %s is %s, not %s\n", uniform_name,
+                    GL_type_to_string(uniforms[i].type), GL_type_to_string(type));
+                return NULL;
+            }
+            return &uniforms[i];
+        }
+    }
+    gl_log_err("ERROR: shader program %u has no active uniform %s\n", program, uniform_name);
+    return NULL;
+}
+
+// true when the GL call can be skipped
+static bool cached_floats(uniform_entry * entry, const GLfloat * value, int count) {
+    if(entry->has_value && memcmp(entry->value, value, count * sizeof(GLfloat)) == 0) {
+        return true;
+    }
+    memcpy(entry->value, value, count * sizeof(GLfloat));
+    entry->has_value = true;
+    return false;
+}
+
+bool set_uniform_float(GLuint program, const char * uniform_name, float x) {
+    uniform_entry * entry = find_uniform(program, uniform_name, GL_FLOAT);
+    if(!entry) {
+        return false;
+    }
+    if(!cached_floats(entry, &x, 1)) {
+        glProgramUniform1f(program, entry->location, x);
+    }
+    return true;
+}
+
+bool set_uniform_vec2(GLuint program, const char * uniform_name, float x, float y) {
+    uniform_entry * entry = find_uniform(program, uniform_name, GL_FLOAT_VEC2);
+    if(!entry) {
         return false;
     }
-    GLuint uniform_location = glGetUniformLocation(shader_programme, uniform_name);
-    glUniform4f(uniform_location, r, g, b, alpha);
+    GLfloat value[] = { x, y };
+    if(!cached_floats(entry, value, 2)) {
+        glProgramUniform2fv(program, entry->location, 1, value);
+    }
     return true;
 }
+
+bool set_uniform_vec3(GLuint program, const char * uniform_name, float x, float y, float z) {
+    uniform_entry * entry = find_uniform(program, uniform_name, GL_FLOAT_VEC3);
+    if(!entry) {
+        return false;
+    }
+    GLfloat value[] = { x, y, z };
+    if(!cached_floats(entry, value, 3)) {
+        glProgramUniform3fv(program, entry->location, 1, value);
+    }
+    return true;
+}
+
+bool set_uniform_vec4(GLuint program, const char * uniform_name, float x, float y, float z, float w) {
+    uniform_entry * entry = find_uniform(program, uniform_name, GL_FLOAT_VEC4);
+    if(!entry) {
+        return false;
+    }
+    GLfloat value[] = { x, y, z, w };
+    if(!cached_floats(entry, value, 4)) {
+        glProgramUniform4fv(program, entry->location, 1, value);
+    }
+    return true;
+}
+
+bool set_uniform_int(GLuint program, const char * uniform_name, int x) {
+    uniform_entry * entry = find_uniform(program, uniform_name, GL_INT);
+    if(!entry) {
+        return false;
+    }
+    if(!entry->has_value || entry->int_value != x) {
+        entry->int_value = x;
+        entry->has_value = true;
+        glProgramUniform1i(program, entry->location, x);
+    }
+    return true;
+}
+
+// column-major, as GL expects
+bool set_uniform_mat3(GLuint program, const char * uniform_name, const float * m) {
+    uniform_entry * entry = find_uniform(program, uniform_name, GL_FLOAT_MAT3);
+    if(!entry) {
+        return false;
+    }
+    if(!cached_floats(entry, m, 9)) {
+        glProgramUniformMatrix3fv(program, entry->location, 1, GL_FALSE, m);
+    }
+    return true;
+}
+
+bool set_uniform_mat4(GLuint program, const char * uniform_name, const float * m) {
+    uniform_entry * entry = find_uniform(program, uniform_name, GL_FLOAT_MAT4);
+    if(!entry) {
+        return false;
+    }
+    if(!cached_floats(entry, m, 16)) {
+        glProgramUniformMatrix4fv(program, entry->location, 1, GL_FALSE, m);
+    }
+    return true;
+}
+
+// mat4 is column-major already, so it uploads untransposed
+bool set_uniform_mat4(GLuint program, const char * uniform_name, const mat4 & m) {
+    return set_uniform_mat4(program, uniform_name, m.m);
+}
+
+GLuint create_uniform_buffer(const char * block_name, GLuint binding, GLsizeiptr size) {
+    shared_uniform_block block;
+    block.name = block_name;
+    block.binding = binding;
+    block.size = size;
+    glGenBuffers(1, &block.buffer);
+    gl_state_bind_buffer(GL_UNIFORM_BUFFER, block.buffer);
+    glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, block.buffer);
+    g_shared_blocks.push_back(block);
+    // programs linked before the block was registered
+    for(std::map<GLuint, uniform_table>::iterator it = g_uniform_tables.begin(); it != g_uniform_tables.end(); ++it) {
+        bind_shared_block(it->first, block);
+    }
+    return block.buffer;
+}
+
+bool update_uniform_buffer(const char * block_name, const void * data, GLsizeiptr size, GLintptr offset) {
+    for(size_t i = 0; i < g_shared_blocks.size(); i++) {
+        shared_uniform_block & block = g_shared_blocks[i];
+        if(block.name != block_name) {
+            continue;
+        }
+        if(offset + size > block.size) {
+            gl_log_err("ERROR: update of %li bytes at %li overflows uniform block %s\n",
+                (long)size, (long)offset, block_name);
+            return false;
+        }
+        gl_state_bind_buffer(GL_UNIFORM_BUFFER, block.buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+        return true;
+    }
+    gl_log_err("ERROR: no shared uniform block %s\n", block_name);
+    return false;
+}
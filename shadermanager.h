@@ -1,9 +1,28 @@
 #pragma once
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include "vecmath.h"
 
 
-GLuint get_shader_program();
-bool uniform_location(GLuint shader_programme, const char * uniform_name, 
-    float r, float g, float b, float alpha);
+#define SHADER_MINIMAL_VERT "./shader-minimal.vert"
+#define SHADER_MINIMAL_FRAG "./shader-minimal.frag"
 
+bool check_for_shader_compile_error(GLuint vs);
+bool check_for_shader_link_error(GLuint shader_programme);
+GLuint get_shader_program();
+GLuint compile_shader_program(const char * vertex_file, const char * fragment_file);
+GLuint build_shader_program(const char * vertex_file, const char * fragment_file);
+GLuint compile_compute_program(const char * compute_file);
+GLuint build_compute_program(const char * compute_file);
+void build_uniform_table(GLuint program);
+void release_uniform_table(GLuint program);
+bool set_uniform_float(GLuint program, const char * uniform_name, float x);
+bool set_uniform_vec2(GLuint program, const char * uniform_name, float x, float y);
+bool set_uniform_vec3(GLuint program, const char * uniform_name, float x, float y, float z);
+bool set_uniform_vec4(GLuint program, const char * uniform_name, float x, float y, float z, float w);
+bool set_uniform_int(GLuint program, const char * uniform_name, int x);
+bool set_uniform_mat3(GLuint program, const char * uniform_name, const float * m);
+bool set_uniform_mat4(GLuint program, const char * uniform_name, const float * m);
+bool set_uniform_mat4(GLuint program, const char * uniform_name, const mat4 & m);
+GLuint create_uniform_buffer(const char * block_name, GLuint binding, GLsizeiptr size);
+bool update_uniform_buffer(const char * block_name, const void * data, GLsizeiptr size, GLintptr offset = 0);
@@ -0,0 +1,261 @@
+#include <GL/glew.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "logging.h"
+#include "frametiming.h"
+#include "shadermanager.h"
+#include "shadervariants.h"
+#include "programcache.h"
+#include "assetloader.h"
+#include "glstate.h"
+#include "profiler.h"
+#include "glcapture.h"
+
+struct variant_build {
+    shader_variant_set * set;
+    unsigned mask;
+    GLuint program;
+    GLuint vs;
+    GLuint fs;
+    unsigned long long key;
+    bool from_cache;
+    // what the program cache records as this variant's cost
+    double build_seconds;
+};
+
+// "#pragma variant NAME" anywhere in text, in order of appearance
+static void parse_keywords(const std::string & text, std::vector<std::string> & keywords) {
+    size_t begin = 0;
+    while(begin < text.size()) {
+        size_t end = text.find('\n', begin);
+        if(end == std::string::npos) {
+            end = text.size();
+        }
+        char name[64];
+        std::string line = text.substr(begin, end - begin);
+        if(sscanf(line.c_str(), " #pragma variant %63s", name) == 1) {
+            bool known = false;
+            for(size_t i = 0; i < keywords.size(); i++) {
+                known = known || keywords[i] == name;
+            }
+            if(!known) {
+                keywords.push_back(name);
+            }
+        }
+        begin = end + 1;
+    }
+}
+
+bool shader_variants_declare(shader_variant_set * set, const char * vertex_file, const char * fragment_file) {
+    set->vertex_file = vertex_file;
+    set->fragment_file = fragment_file;
+    set->keywords.clear();
+    set->programs.clear();
+    shader_source vertex_source;
+    shader_source fragment_source;
+    if(!load_shader_source(vertex_file, &vertex_source) || !load_shader_source(fragment_file, &fragment_source)) {
+        return false;
+    }
+    parse_keywords(vertex_source.text, set->keywords);
+    parse_keywords(fragment_source.text, set->keywords);
+    if(set->keywords.size() > SHADER_VARIANT_KEYWORDS_MAX) {
+        gl_log_err("ERROR: %s and %s declare %i variant keywords, at most %i are supported\n", vertex_file,
+            fragment_file, (int)set->keywords.size(), SHADER_VARIANT_KEYWORDS_MAX);
+        set->keywords.clear();
+        return false;
+    }
+    set->programs.assign((size_t)1 << set->keywords.size(), 0);
+    return true;
+}
+
+unsigned shader_variant_bit(const shader_variant_set * set, const char * keyword) {
+    for(size_t i = 0; i < set->keywords.size(); i++) {
+        if(set->keywords[i] == keyword) {
+            return 1u << i;
+        }
+    }
+    return 0;
+}
+
+// the defines go right after #version, which has to stay first; #line puts
+// the compiler's line numbers back on the file's own
+static std::string variant_text(const std::string & text, const std::string & defines) {
+    size_t version = text.find("#version");
+    if(version == std::string::npos) {
+        return defines + text;
+    }
+    size_t end = text.find('\n', version);
+    if(end == std::string::npos) {
+        return text + "\n" + defines;
+    }
+    int line = 1;
+    for(size_t i = 0; i < end; i++) {
+        line += text[i] == '\n';
+    }
+    char directive[32];
+    snprintf(directive, sizeof(directive), "#line %i 0\n", line + 1);
+    return text.substr(0, end + 1) + defines + directive + text.substr(end + 1);
+}
+
+static std::string variant_defines(const shader_variant_set * set, unsigned mask, unsigned salt, int set_index) {
+    std::string defines;
+    for(size_t i = 0; i < set->keywords.size(); i++) {
+        if(mask & (1u << i)) {
+            defines += "#define " + set->keywords[i] + " 1\n";
+        }
+    }
+    if(salt) {
+        char comment[32];
+        snprintf(comment, sizeof(comment), "// salt %u.%i\n", salt, set_index);
+        defines += comment;
+    }
+    return defines;
+}
+
+// issues the compiles and the link without reading any status back
+static void start_variant(variant_build * build, int set_index, const shader_source & vertex_source,
+    const shader_source & fragment_source, const shader_variant_options * options) {
+    std::string defines = variant_defines(build->set, build->mask, options->salt, set_index);
+    std::string vertex_text = variant_text(vertex_source.text, defines);
+    std::string fragment_text = variant_text(fragment_source.text, defines);
+    unsigned long long hashes[] = {
+        hash_bytes(vertex_text.data(), vertex_text.size()),
+        hash_bytes(fragment_text.data(), fragment_text.size())
+    };
+    build->key = program_cache_key(hashes, 2);
+    build->program = glCreateProgram();
+    build->vs = build->fs = 0;
+    build->from_cache = options->use_cache && program_cache_load(build->key, build->program);
+    if(build->from_cache) {
+        return;
+    }
+    const char * vertex_shader = vertex_text.c_str();
+    const char * fragment_shader = fragment_text.c_str();
+    build->vs = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(build->vs, 1, &vertex_shader, NULL);
+    glCompileShader(build->vs);
+    build->fs = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(build->fs, 1, &fragment_shader, NULL);
+    glCompileShader(build->fs);
+    glAttachShader(build->program, build->vs);
+    glAttachShader(build->program, build->fs);
+    glProgramParameteri(build->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(build->program);
+}
+
+// reading the status waits for this variant only; the rest keep compiling
+static GLuint finish_variant(variant_build * build) {
+    if(build->from_cache) {
+        return build->program;
+    }
+    bool compiled = check_for_shader_compile_error(build->vs);
+    compiled = check_for_shader_compile_error(build->fs) && compiled;
+    bool linked = compiled && check_for_shader_link_error(build->program);
+    glDetachShader(build->program, build->vs);
+    glDetachShader(build->program, build->fs);
+    glDeleteShader(build->vs);
+    glDeleteShader(build->fs);
+    if(!linked) {
+        gl_log_err("ERROR: variant %#x of %s %s did not build\n", build->mask, build->set->vertex_file.c_str(),
+            build->set->fragment_file.c_str());
+        gl_state_delete_program(build->program);
+        return 0;
+    }
+    return build->program;
+}
+
+bool shader_variants_compile(shader_variant_set ** sets, int count, const shader_variant_options * options,
+    shader_variant_stats * stats) {
+    PROFILE_ZONE("shader_variants_compile");
+    memset(stats, 0, sizeof(*stats));
+    bool have_parallel = GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+    stats->parallel = options->parallel && have_parallel;
+    if(have_parallel) {
+        // 0 makes the compiler synchronous again, for the serial baseline
+        GLuint threads = stats->parallel ? 0xFFFFFFFF : 0;
+        if(GLEW_KHR_parallel_shader_compile) {
+            glMaxShaderCompilerThreadsKHR(threads);
+        } else {
+            glMaxShaderCompilerThreadsARB(threads);
+        }
+    }
+    double start = frame_timing_seconds();
+    std::vector<variant_build> builds;
+    bool sources_loaded = true;
+    for(int s = 0; s < count; s++) {
+        shader_variant_set * set = sets[s];
+        shader_source vertex_source;
+        shader_source fragment_source;
+        if(!load_shader_source(set->vertex_file.c_str(), &vertex_source)
+            || !load_shader_source(set->fragment_file.c_str(), &fragment_source)) {
+            stats->failed += (int)set->programs.size();
+            sources_loaded = false;
+            continue;
+        }
+        for(unsigned mask = 0; mask < set->programs.size(); mask++) {
+            variant_build build;
+            build.set = set;
+            build.mask = mask;
+            build.build_seconds = 0.0;
+            double variant_start = frame_timing_seconds();
+            start_variant(&build, s, vertex_source, fragment_source, options);
+            if(!stats->parallel) {
+                // serial: this variant is finished before the next one starts
+                set->programs[mask] = finish_variant(&build);
+                build.build_seconds = frame_timing_seconds() - variant_start;
+            }
+            builds.push_back(build);
+        }
+    }
+    for(size_t i = 0; i < builds.size(); i++) {
+        variant_build & build = builds[i];
+        if(stats->parallel) {
+            // in issue order: by the time the first is done, later ones have been compiling too
+            build.set->programs[build.mask] = finish_variant(&build);
+        }
+        GLuint program = build.set->programs[build.mask];
+        stats->variants++;
+        if(!program) {
+            stats->failed++;
+            continue;
+        }
+        if(build.from_cache) {
+            stats->cached++;
+        } else {
+            stats->compiled++;
+        }
+        build_uniform_table(program);
+    }
+    stats->wall_seconds = frame_timing_seconds() - start;
+    if(options->use_cache) {
+        // parallel builds overlap, so each is charged an even share of the batch
+        // rather than its issue-to-finish time, which counts the others' work too
+        for(size_t i = 0; i < builds.size(); i++) {
+            variant_build & build = builds[i];
+            GLuint program = build.set->programs[build.mask];
+            if(program && !build.from_cache) {
+                double seconds = stats->parallel ? stats->wall_seconds / stats->compiled : build.build_seconds;
+                program_cache_store(build.key, program, seconds);
+            }
+        }
+    }
+    return sources_loaded && stats->failed == 0;
+}
+
+void log_shader_variant_stats(const shader_variant_stats * stats) {
+    gl_log("shader variants: %i built %s in %.1f ms (%i compiled, %i from the program cache, %i failed)\n",
+        stats->variants, stats->parallel ? "in parallel" : "one by one", stats->wall_seconds * 1000.0,
+        stats->compiled, stats->cached, stats->failed);
+}
+
+void shader_variants_destroy(shader_variant_set * set) {
+    for(size_t i = 0; i < set->programs.size(); i++) {
+        if(set->programs[i]) {
+            release_uniform_table(set->programs[i]);
+            gl_state_delete_program(set->programs[i]);
+        }
+    }
+    set->programs.assign(set->programs.size(), 0);
+}
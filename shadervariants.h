@@ -0,0 +1,55 @@
+#pragma once
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+
+// Compile-time shader variants. A shader declares its feature keywords with
+//   #pragma variant NAME
+// lines after #version (drivers ignore pragmas they do not know). Every
+// combination of a set's keywords is a variant, built with "#define NAME 1"
+// inserted after #version for each keyword it enables. All variants of all
+// sets are built at startup in one batch: with KHR/ARB_parallel_shader_compile
+// every compile and link is issued before any status is read, so the
+// driver's compiler threads build them side by side. At draw time a variant
+// is an array lookup by keyword bitmask.
+#define SHADER_VARIANT_KEYWORDS_MAX 8
+
+struct shader_variant_set {
+    std::string vertex_file;
+    std::string fragment_file;
+    // bit i of a mask enables keywords[i]; vertex shader's first
+    std::vector<std::string> keywords;
+    // indexed by mask, 0 where the variant failed to build
+    std::vector<GLuint> programs;
+};
+
+struct shader_variant_options {
+    // false builds one variant after another, as compile_shader_program does
+    bool parallel;
+    bool use_cache;
+    // nonzero makes every set's sources unique, so benchmarks get past driver caches
+    unsigned salt;
+};
+
+struct shader_variant_stats {
+    int variants;
+    int compiled;
+    int cached;
+    int failed;
+    bool parallel;
+    double wall_seconds;
+};
+
+// reads both sources and their keywords; nothing is compiled yet
+bool shader_variants_declare(shader_variant_set * set, const char * vertex_file, const char * fragment_file);
+// mask bit for a keyword, 0 if the set does not declare it
+unsigned shader_variant_bit(const shader_variant_set * set, const char * keyword);
+bool shader_variants_compile(shader_variant_set ** sets, int count, const shader_variant_options * options,
+    shader_variant_stats * stats);
+
+inline GLuint shader_variant(const shader_variant_set * set, unsigned mask) {
+    return set->programs[mask];
+}
+
+void log_shader_variant_stats(const shader_variant_stats * stats);
+void shader_variants_destroy(shader_variant_set * set);
@@ -0,0 +1,337 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "logging.h"
+#include "frametiming.h"
+#include "shadermanager.h"
+#include "programcache.h"
+#include "assetloader.h"
+#include "shaderwatcher.h"
+#include "glstate.h"
+#include "glcapture.h"
+
+// editors often write a file in several steps; wait for them to settle
+#define RELOAD_DEBOUNCE_SECONDS 0.1
+
+enum {
+    RELOAD_PARALLEL,    // KHR/ARB_parallel_shader_compile on the render thread
+    RELOAD_WORKER,      // worker thread with a shared GLFW context
+    RELOAD_SYNC,        // neither available: compile inline, still non-fatal
+};
+
+struct watched_file {
+    int wd;
+    std::string name;
+};
+
+static std::string g_vertex_file;
+static std::string g_fragment_file;
+static int g_mode = RELOAD_SYNC;
+static int g_inotify_fd = -1;
+static std::vector<watched_file> g_watched;
+static std::atomic<bool> g_reload_requested(false);
+static double g_reload_at = -1.0;
+static bool g_building = false;
+static int g_reloads = 0;
+static int g_failures = 0;
+
+// parallel compile in flight
+static GLuint g_pending_program = 0;
+static GLuint g_pending_vs = 0;
+static GLuint g_pending_fs = 0;
+static unsigned long long g_pending_key = 0;
+static bool g_pending_from_cache = false;
+static double g_pending_start = 0.0;
+
+// worker thread
+static GLFWwindow* g_worker_window = NULL;
+static std::thread g_worker;
+static std::mutex g_worker_mutex;
+static std::condition_variable g_worker_wake;
+static bool g_worker_job = false;
+static bool g_worker_done = false;
+static bool g_worker_stop = false;
+static GLuint g_worker_result = 0;
+
+static void worker_main() {
+    glfwMakeContextCurrent(g_worker_window);
+    std::unique_lock<std::mutex> lock(g_worker_mutex);
+    for(;;) {
+        g_worker_wake.wait(lock, [] { return g_worker_job || g_worker_stop; });
+        if(g_worker_stop) {
+            break;
+        }
+        g_worker_job = false;
+        lock.unlock();
+        GLuint program = compile_shader_program(g_vertex_file.c_str(), g_fragment_file.c_str());
+        // the render context may only use the program once the worker's commands completed
+        glFinish();
+        lock.lock();
+        g_worker_result = program;
+        g_worker_done = true;
+    }
+    glfwMakeContextCurrent(NULL);
+}
+
+bool shader_watcher_watch_file(const char * file) {
+    if(g_inotify_fd < 0) {
+        return false;
+    }
+    std::string path = file;
+    size_t slash = path.rfind('/');
+    std::string dir = slash == std::string::npos ? "." : path.substr(0, slash);
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    // watch the directory: editors that save via rename replace the inode
+    int wd = inotify_add_watch(g_inotify_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if(wd < 0) {
+        gl_log_err("ERROR: shader watcher could not watch %s\n", dir.c_str());
+        return false;
+    }
+    for(size_t i = 0; i < g_watched.size(); i++) {
+        if(g_watched[i].wd == wd && g_watched[i].name == name) {
+            return true;
+        }
+    }
+    watched_file watched;
+    watched.wd = wd;
+    watched.name = name;
+    g_watched.push_back(watched);
+    return true;
+}
+
+// the roots plus everything they #include, from the loader's dependency graph
+static void watch_dependencies() {
+    std::vector<std::string> files;
+    asset_dependencies(g_vertex_file.c_str(), files);
+    asset_dependencies(g_fragment_file.c_str(), files);
+    for(size_t i = 0; i < files.size(); i++) {
+        shader_watcher_watch_file(files[i].c_str());
+    }
+}
+
+bool shader_watcher_init(const char * vertex_file, const char * fragment_file, GLFWwindow* share_window) {
+    g_vertex_file = vertex_file;
+    g_fragment_file = fragment_file;
+    g_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(g_inotify_fd < 0) {
+        gl_log_err("ERROR: inotify unavailable, shader reload only on request\n");
+    }
+    watch_dependencies();
+
+    if(GLEW_KHR_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        g_mode = RELOAD_PARALLEL;
+    } else if(GLEW_ARB_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+        g_mode = RELOAD_PARALLEL;
+    } else if(share_window) {
+        // windows may only be created on the main thread
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        g_worker_window = glfwCreateWindow(1, 1, "shader worker", NULL, share_window);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+        if(g_worker_window) {
+            g_worker_stop = false;
+            g_worker = std::thread(worker_main);
+            g_mode = RELOAD_WORKER;
+        }
+    }
+    const char * modes[] = { "parallel shader compile", "shared-context worker", "synchronous" };
+    gl_log("shader watcher: %s, %s\n", modes[g_mode], g_inotify_fd >= 0 ? "inotify" : "manual");
+    return true;
+}
+
+void shader_watcher_request_reload() {
+    g_reload_requested.store(true);
+}
+
+static void poll_inotify() {
+    if(g_inotify_fd < 0) {
+        return;
+    }
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    for(;;) {
+        ssize_t length = read(g_inotify_fd, buffer, sizeof(buffer));
+        if(length <= 0) {
+            return;
+        }
+        for(char * p = buffer; p < buffer + length; ) {
+            const struct inotify_event * event = (const struct inotify_event *)p;
+            for(size_t i = 0; event->len > 0 && i < g_watched.size(); i++) {
+                if(g_watched[i].wd == event->wd && g_watched[i].name == event->name) {
+                    gl_log("shader watcher: %s changed\n", event->name);
+                    g_reload_at = frame_timing_seconds() + RELOAD_DEBOUNCE_SECONDS;
+                }
+            }
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+}
+
+static void start_parallel_build() {
+    g_pending_start = frame_timing_seconds();
+    shader_source vertex_source;
+    shader_source fragment_source;
+    g_pending_program = glCreateProgram();
+    g_pending_vs = g_pending_fs = 0;
+    g_pending_from_cache = false;
+    if(!load_shader_source(g_vertex_file.c_str(), &vertex_source)
+        || !load_shader_source(g_fragment_file.c_str(), &fragment_source)) {
+        // no shaders attached: finish_parallel_build() reports the failure
+        return;
+    }
+    const char * vertex_shader = vertex_source.text.c_str();
+    const char * fragment_shader = fragment_source.text.c_str();
+    unsigned long long hashes[] = { vertex_source.hash, fragment_source.hash };
+    g_pending_key = program_cache_key(hashes, 2);
+    if(program_cache_load(g_pending_key, g_pending_program)) {
+        g_pending_from_cache = true;
+        return;
+    }
+    // none of these wait for the compiler; completion is polled per frame
+    g_pending_vs = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(g_pending_vs, 1, &vertex_shader, NULL);
+    glCompileShader(g_pending_vs);
+    g_pending_fs = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(g_pending_fs, 1, &fragment_shader, NULL);
+    glCompileShader(g_pending_fs);
+    glAttachShader(g_pending_program, g_pending_vs);
+    glAttachShader(g_pending_program, g_pending_fs);
+    glProgramParameteri(g_pending_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(g_pending_program);
+}
+
+// true once the build has finished; *program is 0 if it failed
+static bool finish_parallel_build(GLuint * program) {
+    GLint done = GL_FALSE;
+    if(g_pending_vs) {
+        glGetProgramiv(g_pending_program, GL_COMPLETION_STATUS_KHR, &done);
+        if(!done) {
+            return false;
+        }
+    }
+    *program = g_pending_program;
+    if(!g_pending_vs && !g_pending_from_cache) {
+        glDeleteProgram(g_pending_program);
+        *program = 0;
+    } else if(g_pending_vs) {
+        bool compiled = check_for_shader_compile_error(g_pending_vs);
+        compiled = check_for_shader_compile_error(g_pending_fs) && compiled;
+        bool linked = compiled && check_for_shader_link_error(g_pending_program);
+        glDetachShader(g_pending_program, g_pending_vs);
+        glDetachShader(g_pending_program, g_pending_fs);
+        glDeleteShader(g_pending_vs);
+        glDeleteShader(g_pending_fs);
+        if(linked) {
+            program_cache_store(g_pending_key, g_pending_program, frame_timing_seconds() - g_pending_start);
+        } else {
+            glDeleteProgram(g_pending_program);
+            *program = 0;
+        }
+    }
+    g_pending_program = g_pending_vs = g_pending_fs = 0;
+    return true;
+}
+
+static void start_build() {
+    g_building = true;
+    if(g_mode == RELOAD_PARALLEL) {
+        start_parallel_build();
+    } else if(g_mode == RELOAD_WORKER) {
+        std::lock_guard<std::mutex> lock(g_worker_mutex);
+        g_worker_job = true;
+        g_worker_done = false;
+        g_worker_wake.notify_one();
+    }
+}
+
+static bool finish_build(GLuint * program) {
+    if(g_mode == RELOAD_PARALLEL) {
+        return finish_parallel_build(program);
+    }
+    if(g_mode == RELOAD_WORKER) {
+        std::lock_guard<std::mutex> lock(g_worker_mutex);
+        if(!g_worker_done) {
+            return false;
+        }
+        *program = g_worker_result;
+        return true;
+    }
+    *program = compile_shader_program(g_vertex_file.c_str(), g_fragment_file.c_str());
+    return true;
+}
+
+bool shader_watcher_update(gl_handle * program) {
+    poll_inotify();
+    double now = frame_timing_seconds();
+    if(g_reload_requested.exchange(false)) {
+        g_reload_at = now;
+    }
+    if(!g_building && g_reload_at >= 0.0 && now >= g_reload_at) {
+        g_reload_at = -1.0;
+        start_build();
+    }
+    if(!g_building) {
+        return false;
+    }
+    GLuint built = 0;
+    if(!finish_build(&built)) {
+        return false;
+    }
+    g_building = false;
+    if(!built) {
+        g_failures++;
+        gl_log_err("ERROR: shader reload failed, keeping program %u\n", program->get());
+        return false;
+    }
+    build_uniform_table(built);
+    gl_log("shader watcher: program %u replaced by %u (%i reloads, %i failed)\n",
+        program->get(), built, ++g_reloads, g_failures);
+    // the handle deletes the old program; GL defers that while it is current
+    program->reset(GL_RESOURCE_PROGRAM, built);
+    // a reload may have added #includes
+    watch_dependencies();
+    return true;
+}
+
+bool shader_watcher_pending() {
+    return g_building || g_reload_at >= 0.0 || g_reload_requested.load();
+}
+
+void shader_watcher_shutdown() {
+    if(g_worker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(g_worker_mutex);
+            g_worker_stop = true;
+            g_worker_wake.notify_one();
+        }
+        g_worker.join();
+        if(g_worker_done && g_worker_result && g_building) {
+            glDeleteProgram(g_worker_result);
+        }
+    }
+    if(g_worker_window) {
+        glfwDestroyWindow(g_worker_window);
+        g_worker_window = NULL;
+    }
+    if(g_pending_program) {
+        glDeleteProgram(g_pending_program);
+        glDeleteShader(g_pending_vs);
+        glDeleteShader(g_pending_fs);
+        g_pending_program = g_pending_vs = g_pending_fs = 0;
+    }
+    if(g_inotify_fd >= 0) {
+        close(g_inotify_fd);
+        g_inotify_fd = -1;
+    }
+    g_watched.clear();
+    g_building = false;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "resourcepool.h"
+
+// Hot reload that never blocks the render loop or kills the process. Edits
+// are picked up with inotify (or requested with shader_watcher_request_reload),
+// compiled with KHR_parallel_shader_compile or on a worker thread with a
+// shared context, and swapped in by shader_watcher_update() only after a
+// successful link. The replaced program is deleted; on failure the old one
+// keeps running and the error is logged.
+bool shader_watcher_init(const char * vertex_file, const char * fragment_file, GLFWwindow* share_window);
+bool shader_watcher_watch_file(const char * file);
+void shader_watcher_request_reload();
+bool shader_watcher_update(gl_handle * program);
+// a reload is scheduled or being built
+bool shader_watcher_pending();
+void shader_watcher_shutdown();
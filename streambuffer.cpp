@@ -0,0 +1,146 @@
+#include <GL/glew.h>
+#include <stdlib.h>
+#include <string.h>
+#include "logging.h"
+#include "frametiming.h"
+#include "streambuffer.h"
+#include "glstate.h"
+#include "profiler.h"
+#include "glcapture.h"
+
+bool stream_buffer_init(stream_buffer * stream, GLenum target, GLsizeiptr region_size) {
+    stream->target = target;
+    stream->region_size = region_size;
+    stream->region = 0;
+    stream->region_offset = 0;
+    stream->mapped = NULL;
+    stream->staging = NULL;
+    memset(stream->fences, 0, sizeof(stream->fences));
+    stream->bytes_streamed = 0;
+    stream->frames = 0;
+    stream->fence_waits = 0;
+    stream->fence_wait_seconds = 0.0;
+    GLsizeiptr total = region_size * STREAM_REGIONS;
+    GLuint buffer = 0;
+    glGenBuffers(1, &buffer);
+    stream->buffer.reset(GL_RESOURCE_BUFFER, buffer);
+    gl_state_bind_buffer(target, buffer);
+    stream->persistent = GLEW_ARB_buffer_storage;
+    if(stream->persistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(target, total, NULL, flags);
+        stream->mapped = (char *)glMapBufferRange(target, 0, total, flags);
+        if(!stream->mapped) {
+            gl_log_err("ERROR: could not persistently map %li byte stream buffer\n", (long)total);
+            stream->buffer.reset();
+            return false;
+        }
+    } else {
+        glBufferData(target, region_size, NULL, GL_STREAM_DRAW);
+        stream->staging = (char *)malloc(region_size);
+    }
+    gl_log("stream buffer: %u, %i x %li bytes, %s\n", buffer, STREAM_REGIONS, (long)region_size,
+        stream->persistent ? "persistent coherent map" : "orphaning fallback");
+    return true;
+}
+
+bool stream_buffer_alloc(stream_buffer * stream, GLsizeiptr size, GLsizeiptr alignment, stream_allocation * allocation) {
+    GLsizeiptr offset = stream->region_offset;
+    if(alignment > 1) {
+        offset = (offset + alignment - 1) / alignment * alignment;
+    }
+    if(offset + size > stream->region_size) {
+        gl_log_err("ERROR: stream buffer region full (%li + %li > %li bytes)\n",
+            (long)offset, (long)size, (long)stream->region_size);
+        return false;
+    }
+    stream->region_offset = offset + size;
+    allocation->buffer = stream->buffer.get();
+    allocation->size = size;
+    if(stream->persistent) {
+        allocation->offset = stream->region * stream->region_size + offset;
+        allocation->data = stream->mapped + allocation->offset;
+    } else {
+        // after orphaning every frame writes from the start of the buffer
+        allocation->offset = offset;
+        allocation->data = stream->staging + offset;
+    }
+    stream->bytes_streamed += size;
+    return true;
+}
+
+// writes are visible to the GPU after this (a no-op for the coherent map)
+void stream_buffer_commit(stream_buffer * stream, const stream_allocation * allocation) {
+    PROFILE_ZONE("stream_buffer_commit");
+    if(stream->persistent) {
+        // coherent writes never pass through GL; a capture has to be told
+        gl_capture_buffer_write(allocation->buffer, allocation->offset, allocation->size, allocation->data);
+        return;
+    }
+    gl_state_bind_buffer(stream->target, stream->buffer.get());
+    glBufferSubData(stream->target, allocation->offset, allocation->size, allocation->data);
+}
+
+void stream_buffer_vertex_attrib(const stream_allocation * allocation, GLuint vao, GLuint index,
+    GLint components, GLenum type, GLsizei stride) {
+    gl_state_bind_vertex_array(vao);
+    glEnableVertexAttribArray(index);
+    gl_state_bind_buffer(GL_ARRAY_BUFFER, allocation->buffer);
+    glVertexAttribPointer(index, components, type, GL_FALSE, stride, (const void *)allocation->offset);
+}
+
+void stream_buffer_end_frame(stream_buffer * stream) {
+    stream->frames++;
+    stream->region_offset = 0;
+    if(!stream->persistent) {
+        // orphan: the driver hands back fresh storage while the GPU keeps the old one
+        gl_state_bind_buffer(stream->target, stream->buffer.get());
+        glBufferData(stream->target, stream->region_size, NULL, GL_STREAM_DRAW);
+        return;
+    }
+    stream->fences[stream->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    stream->region = (stream->region + 1) % STREAM_REGIONS;
+    GLsync fence = stream->fences[stream->region];
+    if(!fence) {
+        return;
+    }
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if(status == GL_TIMEOUT_EXPIRED) {
+        // GPU is still reading this region from STREAM_REGIONS frames ago
+        PROFILE_ZONE("stream_buffer_fence_wait");
+        double start = frame_timing_seconds();
+        do {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        } while(status == GL_TIMEOUT_EXPIRED);
+        stream->fence_wait_seconds += frame_timing_seconds() - start;
+        stream->fence_waits++;
+    }
+    if(status == GL_WAIT_FAILED) {
+        gl_log_err("ERROR: stream buffer fence wait failed\n");
+    }
+    glDeleteSync(fence);
+    stream->fences[stream->region] = 0;
+}
+
+void log_stream_buffer_stats(const stream_buffer * stream) {
+    gl_log("stream buffer %u: %llu bytes streamed over %lu frames, %lu fence waits totalling %.3f ms\n",
+        stream->buffer.get(), stream->bytes_streamed, stream->frames, stream->fence_waits,
+        stream->fence_wait_seconds * 1000.0);
+}
+
+void stream_buffer_destroy(stream_buffer * stream) {
+    for(int i = 0; i < STREAM_REGIONS; i++) {
+        if(stream->fences[i]) {
+            glDeleteSync(stream->fences[i]);
+            stream->fences[i] = 0;
+        }
+    }
+    if(stream->persistent) {
+        gl_state_bind_buffer(stream->target, stream->buffer.get());
+        glUnmapBuffer(stream->target);
+    }
+    stream->buffer.reset();
+    free(stream->staging);
+    stream->staging = NULL;
+    stream->mapped = NULL;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <GL/glew.h>
+#include "resourcepool.h"
+
+// Ring of per-frame regions in one persistently mapped buffer. The CPU
+// writes region N while the GPU reads N-1 and N-2; each region is fenced at
+// end of frame and waited on before it is reused. Without ARB_buffer_storage
+// the buffer is orphaned once per frame and allocations are copied in with
+// glBufferSubData instead. The buffer is owned through gl_handle.
+#define STREAM_REGIONS 3
+
+struct stream_allocation {
+    GLuint buffer;
+    GLintptr offset;
+    GLsizeiptr size;
+    void * data;
+};
+
+struct stream_buffer {
+    gl_handle buffer;
+    GLenum target;
+    GLsizeiptr region_size;
+    int region;
+    GLsizeiptr region_offset;
+    bool persistent;
+    char * mapped;
+    // orphaning fallback stages the frame's writes here
+    char * staging;
+    GLsync fences[STREAM_REGIONS];
+    unsigned long long bytes_streamed;
+    unsigned long frames;
+    unsigned long fence_waits;
+    double fence_wait_seconds;
+};
+
+bool stream_buffer_init(stream_buffer * stream, GLenum target, GLsizeiptr region_size);
+bool stream_buffer_alloc(stream_buffer * stream, GLsizeiptr size, GLsizeiptr alignment, stream_allocation * allocation);
+void stream_buffer_commit(stream_buffer * stream, const stream_allocation * allocation);
+void stream_buffer_vertex_attrib(const stream_allocation * allocation, GLuint vao, GLuint index,
+    GLint components, GLenum type, GLsizei stride);
+void stream_buffer_end_frame(stream_buffer * stream);
+void log_stream_buffer_stats(const stream_buffer * stream);
+void stream_buffer_destroy(stream_buffer * stream);
@@ -0,0 +1,190 @@
+#include <GL/glew.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include "logging.h"
+#include "shadermanager.h"
+#include "frametiming.h"
+#include "headless.h"
+#include "assetloader.h"
+#include "glstate.h"
+#include "jobsystem.h"
+#include "texturestream.h"
+#include "glcapture.h"
+
+// Texture streaming benchmark: a 4x2 wall of quads scrolls through more
+// 1024x1024 textures than fit the memory budget. Compared against loading
+// each texture on the render thread the first time it becomes visible
+// (read, expand to RGBA, glTexImage2D, glGenerateMipmap). Reports frame time
+// percentiles for both and the streaming statistics.
+
+#define TEXTURE_BENCH_COUNT 24
+#define TEXTURE_BENCH_SIZE 1024
+#define TEXTURE_BENCH_VISIBLE 8
+#define TEXTURE_BENCH_SCROLL_FRAMES 20
+
+static int g_frames = 300;
+
+static std::string texture_path(int i) {
+    char path[64];
+    snprintf(path, sizeof(path), "texture-bench-%02i.ppm", i);
+    return path;
+}
+
+static bool write_textures() {
+    std::vector<unsigned char> rgb(TEXTURE_BENCH_SIZE * TEXTURE_BENCH_SIZE * 3);
+    for(int i = 0; i < TEXTURE_BENCH_COUNT; i++) {
+        for(int y = 0; y < TEXTURE_BENCH_SIZE; y++) {
+            for(int x = 0; x < TEXTURE_BENCH_SIZE; x++) {
+                unsigned char * p = &rgb[(y * TEXTURE_BENCH_SIZE + x) * 3];
+                bool check = ((x >> 6) ^ (y >> 6)) & 1;
+                p[0] = (unsigned char)(check ? 40 + i * 8 : x >> 2);
+                p[1] = (unsigned char)(check ? 200 - i * 6 : y >> 2);
+                p[2] = (unsigned char)(i * 10);
+            }
+        }
+        FILE * file = fopen(texture_path(i).c_str(), "wb");
+        if(!file) {
+            gl_log_err("ERROR: could not write %s\n", texture_path(i).c_str());
+            return false;
+        }
+        fprintf(file, "P6\n%i %i\n255\n", TEXTURE_BENCH_SIZE, TEXTURE_BENCH_SIZE);
+        fwrite(rgb.data(), 1, rgb.size(), file);
+        fclose(file);
+    }
+    return true;
+}
+
+// the hitching way: everything on the render thread, the frame it is needed
+static GLuint load_texture_now(const char * path) {
+    std::string data;
+    if(!load_file(path, data)) {
+        return 0;
+    }
+    // the header is the one write_textures() produced
+    size_t pixels = data.size() - (size_t)TEXTURE_BENCH_SIZE * TEXTURE_BENCH_SIZE * 3;
+    std::vector<unsigned char> rgba(TEXTURE_BENCH_SIZE * TEXTURE_BENCH_SIZE * 4);
+    for(size_t i = 0; i < (size_t)TEXTURE_BENCH_SIZE * TEXTURE_BENCH_SIZE; i++) {
+        memcpy(&rgba[i * 4], &data[pixels + i * 3], 3);
+        rgba[i * 4 + 3] = 255;
+    }
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    gl_state_bind_texture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, TEXTURE_BENCH_SIZE, TEXTURE_BENCH_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+        rgba.data());
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    return texture;
+}
+
+static void draw_wall(GLuint program, int frame, bool streaming, std::vector<GLuint> & loaded) {
+    int first = (frame / TEXTURE_BENCH_SCROLL_FRAMES) % TEXTURE_BENCH_COUNT;
+    for(int q = 0; q < TEXTURE_BENCH_VISIBLE; q++) {
+        int texture = (first + q) % TEXTURE_BENCH_COUNT;
+        if(streaming) {
+            // nothing resident yet: the quad is drawn with texture 0 (black)
+            texture_stream_bind(texture_stream_request(texture_path(texture).c_str()), 0);
+        } else {
+            if(!loaded[texture]) {
+                loaded[texture] = load_texture_now(texture_path(texture).c_str());
+            }
+            gl_state_active_texture(GL_TEXTURE0);
+            gl_state_bind_texture(GL_TEXTURE_2D, loaded[texture]);
+        }
+        float x = -1.0f + 0.5f * (q % 4);
+        float y = q < 4 ? 0.0f : -1.0f;
+        set_uniform_vec4(program, "quad_rect", x, y, 0.5f, 1.0f);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    }
+}
+
+static void run(GLuint program, bool streaming) {
+    std::vector<GLuint> loaded(TEXTURE_BENCH_COUNT, 0);
+    std::vector<double> times;
+    for(int frame = 0; frame < g_frames; frame++) {
+        double start = frame_timing_seconds();
+        glClear(GL_COLOR_BUFFER_BIT);
+        if(streaming) {
+            texture_stream_update();
+        }
+        draw_wall(program, frame, streaming, loaded);
+        gl_state_end_frame();
+        headless_present();
+        times.push_back((frame_timing_seconds() - start) * 1000.0);
+    }
+    glFinish();
+    std::sort(times.begin(), times.end());
+    size_t n = times.size();
+    gl_log("  %-34s %9.3f %9.3f %9.3f %9.3f\n", streaming ? "streamed (decode jobs + PBO ring)" : "render-thread load",
+        times[n / 2], times[(size_t)(0.95 * (n - 1))], times[(size_t)(0.99 * (n - 1))], times[n - 1]);
+    for(size_t i = 0; i < loaded.size(); i++) {
+        if(loaded[i]) {
+            gl_state_delete_textures(1, &loaded[i]);
+        }
+    }
+}
+
+int main(int argc, char ** argv) {
+    headless_options options;
+    if(!parse_headless_args(argc, argv, &options)) {
+        return 1;
+    }
+    options.enabled = true;
+    if(options.frames > 0) {
+        g_frames = (int)options.frames;
+    }
+    if(!restart_gl_log()) {
+        fprintf(stderr, "Failed to open log file\n");
+        return 1;
+    }
+    gl_log_set_level(GL_LOG_WARN);
+    if(!headless_init(&options)) {
+        return 2;
+    }
+    gl_state_viewport(0, 0, options.width, options.height);
+    GLuint program = build_shader_program("./textured.vert", "./textured.frag");
+    if(!program || !write_textures()) {
+        return 3;
+    }
+    gl_state_use_program(program);
+    set_uniform_int(program, "image", 0);
+    GLfloat corners[] = { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    gl_state_bind_vertex_array(vao);
+    gl_state_bind_buffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+    glClearColor(0.6f, 0.6f, 0.8f, 1.0f);
+    gl_log_set_level(GL_LOG_INFO);
+
+    // decoding needs workers even on a single core machine
+    job_system_init(std::max(2, (int)std::thread::hardware_concurrency()));
+    gl_log("\ntexture-bench: %s, %i textures of %ix%i, %i visible, %i frames\n", glGetString(GL_RENDERER),
+        TEXTURE_BENCH_COUNT, TEXTURE_BENCH_SIZE, TEXTURE_BENCH_SIZE, TEXTURE_BENCH_VISIBLE, g_frames);
+    gl_log("  %-34s %9s %9s %9s %9s\n", "path", "p50 ms", "p95 ms", "p99 ms", "max ms");
+    run(program, false);
+    if(!texture_stream_init(2 * 1024 * 1024, 48 * 1024 * 1024)) {
+        return 4;
+    }
+    run(program, true);
+    log_texture_stream_stats();
+    texture_stream_shutdown();
+    job_system_shutdown();
+
+    for(int i = 0; i < TEXTURE_BENCH_COUNT; i++) {
+        remove(texture_path(i).c_str());
+    }
+    gl_state_delete_vertex_arrays(1, &vao);
+    gl_state_delete_buffers(1, &vbo);
+    headless_shutdown();
+    return 0;
+}
@@ -0,0 +1,7 @@
+set -e
+g++ texture-bench.cpp texturestream.cpp streambuffer.cpp jobsystem.cpp shadermanager.cpp programcache.cpp frametiming.cpp headless.cpp assetloader.cpp resourcepool.cpp glstate.cpp logging.cpp \
+    ../glew/lib/libGLEW.a ../glfw/build/src/libglfw3.a \
+    -I ../glfw/include -I ../glew/include/ \
+    -lGL -lEGL -lX11 -lGLU -pthread \
+    -o texture-bench
+./texture-bench
@@ -0,0 +1,9 @@
+#version 410
+
+uniform sampler2D image;
+in vec2 texcoord;
+out vec4 frag_colour;
+
+void main() {
+   frag_colour = texture(image, texcoord);
+};
@@ -0,0 +1,11 @@
+#version 410
+
+layout(location = 0) in vec2 corner;
+// x, y of the lower left corner, then width and height, in clip space
+uniform vec4 quad_rect;
+out vec2 texcoord;
+
+void main() {
+    texcoord = corner;
+    gl_Position = vec4(quad_rect.xy + corner * quad_rect.zw, 0.0, 1.0);
+};
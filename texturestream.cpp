@@ -0,0 +1,503 @@
+#include <GL/glew.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "logging.h"
+#include "frametiming.h"
+#include "assetloader.h"
+#include "streambuffer.h"
+#include "glstate.h"
+#include "jobsystem.h"
+#include "texturestream.h"
+#include "profiler.h"
+#include "glcapture.h"
+
+// decodes in flight at once, which bounds staging memory
+#define TEXTURE_STREAM_MAX_DECODES 4
+// staging blocks kept for reuse once released
+#define TEXTURE_STAGING_KEEP (64 * 1024 * 1024)
+
+enum {
+    TEXTURE_UNLOADED = 0,
+    TEXTURE_DECODING,
+    TEXTURE_DECODED,
+    TEXTURE_UPLOADING,
+    TEXTURE_RESIDENT,
+    // set by the decode job, turned into TEXTURE_FAILED on the GL thread
+    TEXTURE_DECODE_FAILED,
+    TEXTURE_FAILED,
+};
+
+struct streamed_texture {
+    std::string path;
+    std::atomic<int> state;
+    GLuint texture;
+    int width;
+    int height;
+    int levels;
+    // decoded RGBA8 mip chain, level 0 first, in one staging block
+    unsigned char * pixels;
+    size_t capacity;
+    size_t level_offset[TEXTURE_STREAM_MAX_LEVELS];
+    // next level to upload, counting down to 0, and rows of it done so far
+    int next_level;
+    int next_row;
+    size_t gpu_bytes;
+    unsigned long last_used_frame;
+    double requested_at;
+    bool first_level_logged;
+};
+
+static std::vector<streamed_texture *> g_textures;
+static std::map<std::string, int> g_by_path;
+static stream_buffer g_upload;
+static size_t g_upload_budget = 0;
+static size_t g_memory_budget = 0;
+// GL_MAX_TEXTURE_SIZE, read once at init for the decode jobs
+static int g_max_texture_size = 0;
+static size_t g_resident_bytes = 0;
+static unsigned long g_frame = 0;
+static int g_decodes_in_flight = 0;
+static job_counter g_decode_jobs;
+static unsigned long long g_uploaded_bytes = 0;
+static unsigned long g_evictions = 0;
+static std::vector<double> g_first_level_ms;
+static std::vector<double> g_full_ms;
+
+// staging pool: power-of-two blocks, shared with the decode jobs
+static std::mutex g_staging_mutex;
+static std::multimap<size_t, unsigned char *> g_staging_free;
+static size_t g_staging_free_bytes = 0;
+static std::atomic<size_t> g_staging_used(0);
+
+static unsigned char * staging_acquire(size_t size, size_t * capacity) {
+    size_t block = 64 * 1024;
+    while(block < size) {
+        block *= 2;
+    }
+    *capacity = block;
+    g_staging_used += block;
+    {
+        std::lock_guard<std::mutex> lock(g_staging_mutex);
+        std::multimap<size_t, unsigned char *>::iterator it = g_staging_free.find(block);
+        if(it != g_staging_free.end()) {
+            unsigned char * p = it->second;
+            g_staging_free.erase(it);
+            g_staging_free_bytes -= block;
+            return p;
+        }
+    }
+    unsigned char * p = (unsigned char *)malloc(block);
+    if(!p) {
+        gl_log_err("ERROR: texture stream could not allocate %zu bytes of staging memory\n", block);
+        g_staging_used -= block;
+        *capacity = 0;
+    }
+    return p;
+}
+
+static void staging_release(unsigned char * p, size_t capacity) {
+    if(!p) {
+        return;
+    }
+    g_staging_used -= capacity;
+    std::lock_guard<std::mutex> lock(g_staging_mutex);
+    if(g_staging_free_bytes + capacity > TEXTURE_STAGING_KEEP) {
+        free(p);
+        return;
+    }
+    g_staging_free.insert(std::make_pair(capacity, p));
+    g_staging_free_bytes += capacity;
+}
+
+// binary PPM: "P6 <width> <height> 255" then RGB bytes
+static bool parse_ppm_header(const std::string & data, int * width, int * height, size_t * pixel_offset) {
+    int values[3];
+    size_t p = 2;
+    if(data.size() < 2 || data[0] != 'P' || data[1] != '6') {
+        return false;
+    }
+    for(int i = 0; i < 3; i++) {
+        while(p < data.size() && (isspace((unsigned char)data[p]) || data[p] == '#')) {
+            if(data[p] == '#') {
+                p = data.find('\n', p);
+                if(p == std::string::npos) {
+                    return false;
+                }
+            }
+            p++;
+        }
+        values[i] = 0;
+        while(p < data.size() && isdigit((unsigned char)data[p])) {
+            values[i] = values[i] * 10 + (data[p++] - '0');
+        }
+    }
+    *width = values[0];
+    *height = values[1];
+    *pixel_offset = p + 1;
+    return values[2] == 255 && *width > 0 && *height > 0
+        && *pixel_offset + (size_t)*width * *height * 3 <= data.size();
+}
+
+static int mip_size(int size, int level) {
+    int s = size >> level;
+    return s > 0 ? s : 1;
+}
+
+// runs on a worker: file read, RGB to RGBA, then a 2x2 box-filtered mip chain
+static void decode_texture(streamed_texture * t) {
+    PROFILE_ZONE("decode_texture");
+    std::string data;
+    int width = 0;
+    int height = 0;
+    size_t pixel_offset = 0;
+    if(!load_file(t->path.c_str(), data) || !parse_ppm_header(data, &width, &height, &pixel_offset)) {
+        gl_log_err("ERROR: could not decode texture %s\n", t->path.c_str());
+        t->state = TEXTURE_DECODE_FAILED;
+        return;
+    }
+    // larger would not fit the upload ring a row at a time, and GL rejects it anyway
+    if(width > g_max_texture_size || height > g_max_texture_size) {
+        gl_log_err("ERROR: texture %s is %i x %i, larger than GL_MAX_TEXTURE_SIZE %i\n", t->path.c_str(), width,
+            height, g_max_texture_size);
+        t->state = TEXTURE_DECODE_FAILED;
+        return;
+    }
+    int levels = 1;
+    while(levels < TEXTURE_STREAM_MAX_LEVELS && ((width >> levels) > 0 || (height >> levels) > 0)) {
+        levels++;
+    }
+    size_t total = 0;
+    for(int l = 0; l < levels; l++) {
+        t->level_offset[l] = total;
+        total += (size_t)mip_size(width, l) * mip_size(height, l) * 4;
+    }
+    t->pixels = staging_acquire(total, &t->capacity);
+    if(!t->pixels) {
+        t->state = TEXTURE_DECODE_FAILED;
+        return;
+    }
+    const unsigned char * rgb = (const unsigned char *)data.data() + pixel_offset;
+    unsigned char * rgba = t->pixels;
+    for(size_t i = 0; i < (size_t)width * height; i++) {
+        rgba[i * 4 + 0] = rgb[i * 3 + 0];
+        rgba[i * 4 + 1] = rgb[i * 3 + 1];
+        rgba[i * 4 + 2] = rgb[i * 3 + 2];
+        rgba[i * 4 + 3] = 255;
+    }
+    for(int l = 1; l < levels; l++) {
+        int sw = mip_size(width, l - 1), sh = mip_size(height, l - 1);
+        int dw = mip_size(width, l), dh = mip_size(height, l);
+        const unsigned char * src = t->pixels + t->level_offset[l - 1];
+        unsigned char * dst = t->pixels + t->level_offset[l];
+        for(int y = 0; y < dh; y++) {
+            int y0 = std::min(y * 2, sh - 1), y1 = std::min(y * 2 + 1, sh - 1);
+            for(int x = 0; x < dw; x++) {
+                int x0 = std::min(x * 2, sw - 1), x1 = std::min(x * 2 + 1, sw - 1);
+                for(int c = 0; c < 4; c++) {
+                    int sum = src[(y0 * sw + x0) * 4 + c] + src[(y0 * sw + x1) * 4 + c]
+                        + src[(y1 * sw + x0) * 4 + c] + src[(y1 * sw + x1) * 4 + c];
+                    dst[(y * dw + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+    }
+    t->width = width;
+    t->height = height;
+    t->levels = levels;
+    t->next_level = levels - 1;
+    t->next_row = 0;
+    // publishes everything above to the GL thread
+    t->state.store(TEXTURE_DECODED, std::memory_order_release);
+}
+
+bool texture_stream_init(size_t upload_budget, size_t memory_budget) {
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &g_max_texture_size);
+    // at least one row of the widest texture GL allows per frame, plus the
+    // alignment slack upload_rows keeps back
+    size_t min_budget = std::max((size_t)64 * 1024, (size_t)g_max_texture_size * 4 + 4);
+    if(upload_budget < min_budget) {
+        upload_budget = min_budget;
+    }
+    if(!stream_buffer_init(&g_upload, GL_PIXEL_UNPACK_BUFFER, upload_budget)) {
+        return false;
+    }
+    gl_state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    g_upload_budget = upload_budget;
+    g_memory_budget = memory_budget;
+    job_counter_init(&g_decode_jobs);
+    if(job_system_threads() < 2) {
+        gl_log_at(GL_LOG_WARN, "texture stream: no job system workers, decodes wait for the next job_wait\n");
+    }
+    gl_log("texture stream: %zu byte upload budget per frame, %zu byte memory budget\n", upload_budget, memory_budget);
+    return true;
+}
+
+int texture_stream_request(const char * path) {
+    std::map<std::string, int>::iterator it = g_by_path.find(path);
+    if(it != g_by_path.end()) {
+        return it->second;
+    }
+    streamed_texture * t = new streamed_texture();
+    t->path = path;
+    t->state = TEXTURE_UNLOADED;
+    t->texture = 0;
+    t->pixels = NULL;
+    t->capacity = 0;
+    t->gpu_bytes = 0;
+    t->width = t->height = 0;
+    t->levels = 0;
+    t->next_level = 0;
+    t->next_row = 0;
+    t->last_used_frame = g_frame;
+    t->requested_at = frame_timing_seconds();
+    t->first_level_logged = false;
+    int handle = (int)g_textures.size();
+    g_textures.push_back(t);
+    g_by_path[path] = handle;
+    return handle;
+}
+
+bool texture_stream_bind(int handle, GLuint unit) {
+    streamed_texture * t = g_textures[handle];
+    t->last_used_frame = g_frame;
+    int state = t->state.load(std::memory_order_acquire);
+    if(state == TEXTURE_UNLOADED && t->texture == 0) {
+        // evicted earlier (or never started): queue it again
+        t->requested_at = frame_timing_seconds();
+        t->first_level_logged = false;
+    }
+    gl_state_active_texture(GL_TEXTURE0 + unit);
+    bool usable = t->texture != 0 && t->next_level < t->levels - 1;
+    gl_state_bind_texture(GL_TEXTURE_2D, usable ? t->texture : 0);
+    return usable;
+}
+
+int texture_stream_resident_level(int handle) {
+    streamed_texture * t = g_textures[handle];
+    if(t->texture == 0 || t->next_level == t->levels - 1) {
+        return -1;
+    }
+    return t->next_level + 1;
+}
+
+static double percentile(std::vector<double> values, double p) {
+    if(values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[(size_t)(p * (values.size() - 1))];
+}
+
+static void start_decodes() {
+    // oldest request first: textures are in request order
+    for(size_t i = 0; i < g_textures.size() && g_decodes_in_flight < TEXTURE_STREAM_MAX_DECODES; i++) {
+        streamed_texture * t = g_textures[i];
+        if(t->state.load() != TEXTURE_UNLOADED || t->texture != 0) {
+            continue;
+        }
+        // only stream what has been used recently
+        if(g_frame - t->last_used_frame > 1) {
+            continue;
+        }
+        t->state = TEXTURE_DECODING;
+        g_decodes_in_flight++;
+        job_run([t]() { decode_texture(t); }, &g_decode_jobs);
+    }
+}
+
+static void begin_upload(streamed_texture * t) {
+    glGenTextures(1, &t->texture);
+    gl_state_bind_texture(GL_TEXTURE_2D, t->texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, t->levels - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, t->levels - 1);
+    t->state = TEXTURE_UPLOADING;
+}
+
+// uploads rows of t's next level; returns false once the frame's budget is spent
+static bool upload_rows(streamed_texture * t) {
+    int level = t->next_level;
+    int w = mip_size(t->width, level);
+    int h = mip_size(t->height, level);
+    size_t row_bytes = (size_t)w * 4;
+    size_t available = g_upload.region_size - g_upload.region_offset;
+    // keep offsets 4-byte aligned for GL_UNPACK_ALIGNMENT
+    available = available > 4 ? available - 4 : 0;
+    int rows = (int)std::min((size_t)(h - t->next_row), available / row_bytes);
+    if(rows <= 0) {
+        return false;
+    }
+    gl_state_bind_texture(GL_TEXTURE_2D, t->texture);
+    if(t->next_row == 0) {
+        // define the level with no source data, so the unpack buffer must be unbound
+        gl_state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        t->gpu_bytes += row_bytes * h;
+        g_resident_bytes += row_bytes * h;
+    }
+    stream_allocation allocation;
+    size_t bytes = row_bytes * rows;
+    if(!stream_buffer_alloc(&g_upload, bytes, 4, &allocation)) {
+        return false;
+    }
+    memcpy(allocation.data, t->pixels + t->level_offset[level] + row_bytes * t->next_row, bytes);
+    stream_buffer_commit(&g_upload, &allocation);
+    gl_state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, allocation.buffer);
+    glTexSubImage2D(GL_TEXTURE_2D, level, 0, t->next_row, w, rows, GL_RGBA, GL_UNSIGNED_BYTE,
+        (const void *)allocation.offset);
+    g_uploaded_bytes += bytes;
+    t->next_row += rows;
+    if(t->next_row < h) {
+        return true;
+    }
+    // level complete: it and everything coarser can now be sampled
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+    t->next_row = 0;
+    t->next_level--;
+    double ms = (frame_timing_seconds() - t->requested_at) * 1000.0;
+    if(!t->first_level_logged) {
+        g_first_level_ms.push_back(ms);
+        t->first_level_logged = true;
+    }
+    if(t->next_level < 0) {
+        g_full_ms.push_back(ms);
+        staging_release(t->pixels, t->capacity);
+        t->pixels = NULL;
+        t->capacity = 0;
+        t->state = TEXTURE_RESIDENT;
+    }
+    return true;
+}
+
+static void evict(streamed_texture * t) {
+    gl_state_delete_textures(1, &t->texture);
+    t->texture = 0;
+    g_resident_bytes -= t->gpu_bytes;
+    t->gpu_bytes = 0;
+    staging_release(t->pixels, t->capacity);
+    t->pixels = NULL;
+    t->capacity = 0;
+    t->state = TEXTURE_UNLOADED;
+    g_evictions++;
+}
+
+void texture_stream_update() {
+    PROFILE_GPU_ZONE("texture_stream_update");
+    // decodes that finished since last frame free up a slot
+    for(size_t i = 0; i < g_textures.size(); i++) {
+        streamed_texture * t = g_textures[i];
+        int state = t->state.load(std::memory_order_acquire);
+        if(state == TEXTURE_DECODED) {
+            g_decodes_in_flight--;
+            begin_upload(t);
+        } else if(state == TEXTURE_DECODE_FAILED) {
+            g_decodes_in_flight--;
+            t->state = TEXTURE_FAILED;
+        }
+    }
+    start_decodes();
+
+    // coarse first across textures: always feed the one with the fewest resident levels
+    for(;;) {
+        streamed_texture * best = NULL;
+        int best_resident = TEXTURE_STREAM_MAX_LEVELS + 1;
+        for(size_t i = 0; i < g_textures.size(); i++) {
+            streamed_texture * t = g_textures[i];
+            if(t->state.load() != TEXTURE_UPLOADING) {
+                continue;
+            }
+            int resident = t->levels - 1 - t->next_level;
+            if(resident < best_resident) {
+                best = t;
+                best_resident = resident;
+            }
+        }
+        if(!best || !upload_rows(best)) {
+            break;
+        }
+    }
+    gl_state_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    stream_buffer_end_frame(&g_upload);
+
+    // least recently used first, never anything bound this frame
+    while(g_resident_bytes > g_memory_budget) {
+        streamed_texture * victim = NULL;
+        for(size_t i = 0; i < g_textures.size(); i++) {
+            streamed_texture * t = g_textures[i];
+            if(t->texture && t->last_used_frame < g_frame
+                    && (!victim || t->last_used_frame < victim->last_used_frame)) {
+                victim = t;
+            }
+        }
+        if(!victim) {
+            break;
+        }
+        evict(victim);
+    }
+    g_frame++;
+}
+
+void texture_stream_get_stats(texture_stream_stats * stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->textures = (int)g_textures.size();
+    for(size_t i = 0; i < g_textures.size(); i++) {
+        streamed_texture * t = g_textures[i];
+        int state = t->state.load();
+        stats->resident += texture_stream_resident_level((int)i) >= 0;
+        stats->fully_resident += state == TEXTURE_RESIDENT;
+        stats->decoding += state == TEXTURE_DECODING;
+    }
+    stats->resident_bytes = g_resident_bytes;
+    stats->staging_bytes = g_staging_used.load();
+    stats->uploaded_bytes = g_uploaded_bytes;
+    stats->evictions = g_evictions;
+    stats->first_level_ms_p50 = percentile(g_first_level_ms, 0.5);
+    stats->first_level_ms_p95 = percentile(g_first_level_ms, 0.95);
+    stats->full_ms_p50 = percentile(g_full_ms, 0.5);
+    stats->full_ms_p95 = percentile(g_full_ms, 0.95);
+    stats->full_ms_max = percentile(g_full_ms, 1.0);
+}
+
+void log_texture_stream_stats() {
+    texture_stream_stats s;
+    texture_stream_get_stats(&s);
+    gl_log("texture stream: %i textures, %i resident (%i with every level), %i decoding, %.1f MB resident, "
+        "%.1f MB staging\n", s.textures, s.resident, s.fully_resident, s.decoding,
+        s.resident_bytes / (1024.0 * 1024.0), s.staging_bytes / (1024.0 * 1024.0));
+    gl_log("  %.1f MB uploaded, %lu evictions; request to first level p50 %.1f ms p95 %.1f ms, "
+        "to all levels p50 %.1f ms p95 %.1f ms max %.1f ms\n", s.uploaded_bytes / (1024.0 * 1024.0), s.evictions,
+        s.first_level_ms_p50, s.first_level_ms_p95, s.full_ms_p50, s.full_ms_p95, s.full_ms_max);
+}
+
+void texture_stream_shutdown() {
+    // decodes still running write into their textures
+    job_wait(&g_decode_jobs);
+    for(size_t i = 0; i < g_textures.size(); i++) {
+        streamed_texture * t = g_textures[i];
+        if(t->texture) {
+            gl_state_delete_textures(1, &t->texture);
+        }
+        staging_release(t->pixels, t->capacity);
+        delete t;
+    }
+    g_textures.clear();
+    g_by_path.clear();
+    g_resident_bytes = 0;
+    g_decodes_in_flight = 0;
+    stream_buffer_destroy(&g_upload);
+    std::lock_guard<std::mutex> lock(g_staging_mutex);
+    for(std::multimap<size_t, unsigned char *>::iterator it = g_staging_free.begin(); it != g_staging_free.end(); ++it) {
+        free(it->second);
+    }
+    g_staging_free.clear();
+    g_staging_free_bytes = 0;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <GL/glew.h>
+#include <stddef.h>
+
+// Streamed 2D textures. texture_stream_request() returns at once; a job
+// decodes the image (binary PPM) into pooled staging memory and builds the
+// mip chain. texture_stream_update(), once per frame on the GL thread,
+// copies up to the upload budget into a fenced ring of pixel-unpack
+// buffers and uploads from there, coarsest mip level first, lowering
+// GL_TEXTURE_BASE_LEVEL as each finer level completes. Textures not bound
+// this frame are evicted, least recently used first, while resident
+// texture memory is over budget; binding an evicted texture streams it in
+// again. Decoding runs on the job system, so it needs at least one worker.
+#define TEXTURE_STREAM_MAX_LEVELS 16
+
+struct texture_stream_stats {
+    int textures;
+    int resident;
+    int fully_resident;
+    int decoding;
+    size_t resident_bytes;
+    size_t staging_bytes;
+    unsigned long long uploaded_bytes;
+    unsigned long evictions;
+    // request to coarsest level usable, and to every level resident
+    double first_level_ms_p50;
+    double first_level_ms_p95;
+    double full_ms_p50;
+    double full_ms_p95;
+    double full_ms_max;
+};
+
+bool texture_stream_init(size_t upload_budget, size_t memory_budget);
+int texture_stream_request(const char * path);
+bool texture_stream_bind(int handle, GLuint unit);
+int texture_stream_resident_level(int handle);
+void texture_stream_update();
+void texture_stream_get_stats(texture_stream_stats * stats);
+void log_texture_stream_stats();
+void texture_stream_shutdown();
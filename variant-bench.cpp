@@ -0,0 +1,197 @@
+#include <GL/glew.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "logging.h"
+#include "shadermanager.h"
+#include "shadervariants.h"
+#include "vertexformat.h"
+#include "frametiming.h"
+#include "headless.h"
+#include "glstate.h"
+#include "glcapture.h"
+
+// Shader variant benchmark: --copies sets of variant.vert/variant.frag
+// (three keywords, eight variants each) are built one by one and then all
+// at once with parallel shader compile, each time with fresh sources so
+// no cache helps, and the two wall times are compared. Then every frame
+// draws one quad per variant of the first set, picking the program by
+// keyword mask.
+//   variant-bench [--copies N] [--frames N] [--size WxH]
+
+#define VARIANT_BENCH_FRAMES 300
+#define VARIANT_BENCH_INSTANCES 4
+
+static bool parse_variant_args(int * argc, char ** argv, int * copies) {
+    *copies = 4;
+    int kept = 1;
+    for(int i = 1; i < *argc; i++) {
+        if(!strcmp(argv[i], "--copies") && i + 1 < *argc) {
+            *copies = atoi(argv[++i]);
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    *argc = kept;
+    argv[kept] = NULL;
+    if(*copies <= 0) {
+        fprintf(stderr, "--copies expects a positive number\n");
+        return false;
+    }
+    return true;
+}
+
+static bool build_all(std::vector<shader_variant_set> & sets, bool parallel, unsigned salt,
+    shader_variant_stats * stats) {
+    std::vector<shader_variant_set *> pointers;
+    for(size_t i = 0; i < sets.size(); i++) {
+        if(!shader_variants_declare(&sets[i], "./variant.vert", "./variant.frag")) {
+            return false;
+        }
+        pointers.push_back(&sets[i]);
+    }
+    shader_variant_options options;
+    options.parallel = parallel;
+    options.use_cache = false;
+    options.salt = salt;
+    bool built = shader_variants_compile(pointers.data(), (int)pointers.size(), &options, stats);
+    log_shader_variant_stats(stats);
+    return built;
+}
+
+int main(int argc, char ** argv) {
+    int copies = 0;
+    if(!parse_variant_args(&argc, argv, &copies)) {
+        return 1;
+    }
+    headless_options options;
+    if(!parse_headless_args(argc, argv, &options)) {
+        return 1;
+    }
+    options.enabled = true;
+    int frames = options.frames > 0 ? (int)options.frames : VARIANT_BENCH_FRAMES;
+    if(!restart_gl_log()) {
+        fprintf(stderr, "Failed to open log file\n");
+        return 1;
+    }
+    if(!headless_init(&options)) {
+        return 2;
+    }
+    gl_state_reset();
+    gl_state_viewport(0, 0, options.width, options.height);
+
+    // the salt is the run's start time, so a previous run's driver cache entries never match
+    unsigned salt = (unsigned)(frame_timing_seconds() * 1000.0) | 1;
+    std::vector<shader_variant_set> sets(copies);
+    shader_variant_stats serial;
+    shader_variant_stats parallel;
+    if(!build_all(sets, false, salt, &serial)) {
+        return 3;
+    }
+    for(size_t i = 0; i < sets.size(); i++) {
+        shader_variants_destroy(&sets[i]);
+    }
+    if(!build_all(sets, true, salt + 2, &parallel)) {
+        return 3;
+    }
+    for(size_t i = 1; i < sets.size(); i++) {
+        shader_variants_destroy(&sets[i]);
+    }
+    const shader_variant_set * set = &sets[0];
+    unsigned vertex_color = shader_variant_bit(set, "VERTEX_COLOR");
+    unsigned instanced = shader_variant_bit(set, "INSTANCED");
+    int variants = (int)set->programs.size();
+
+    // one quad, with per-instance placements inside its cell
+    GLfloat quad[] = {
+        -1.0f, -1.0f, 0.0f,  1.0f, 0.2f, 0.2f, 1.0f,
+         1.0f, -1.0f, 0.0f,  0.2f, 1.0f, 0.2f, 1.0f,
+        -1.0f,  1.0f, 0.0f,  0.2f, 0.2f, 1.0f, 1.0f,
+         1.0f,  1.0f, 0.0f,  1.0f, 1.0f, 0.2f, 1.0f,
+    };
+    GLfloat instances[VARIANT_BENCH_INSTANCES * 4];
+    GLuint vao = 0;
+    GLuint buffers[2];
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(2, buffers);
+    gl_state_bind_buffer(GL_ARRAY_BUFFER, buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    gl_state_bind_buffer(GL_ARRAY_BUFFER, buffers[1]);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(instances), NULL, GL_STATIC_DRAW);
+    // position and colour per vertex, placement per instance
+    vertex_format format;
+    vertex_format_init(&format);
+    vertex_format_add(&format, 0, 3, VERTEX_FLOAT32, 0);
+    vertex_format_add(&format, 1, 4, VERTEX_FLOAT32, 0);
+    vertex_format_add(&format, 2, 4, VERTEX_FLOAT32, 1);
+    vertex_format_set_divisor(&format, 1, 1);
+    GLintptr offsets[] = { 0, 0 };
+    vertex_format_apply(&format, vao, buffers, offsets);
+
+    // variants side by side in a 4-wide grid; instanced ones split their cell in four
+    float cell = 2.0f / 4;
+    std::vector<GLfloat> placements(variants * 4);
+    for(int mask = 0; mask < variants; mask++) {
+        placements[mask * 4 + 0] = -1.0f + cell * (mask % 4 + 0.5f);
+        placements[mask * 4 + 1] = -1.0f + cell * (mask / 4 + 0.5f);
+        placements[mask * 4 + 2] = 0.0f;
+        placements[mask * 4 + 3] = cell * 0.4f;
+        GLuint program = shader_variant(set, mask);
+        if(!(mask & vertex_color)) {
+            set_uniform_vec4(program, "input_color", 0.9f, 0.6f, 0.1f, 1.0f);
+        }
+        if(!(mask & instanced)) {
+            set_uniform_vec4(program, "offset", placements[mask * 4 + 0], placements[mask * 4 + 1], 0.0f,
+                placements[mask * 4 + 3]);
+        }
+    }
+    glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+
+    frame_histogram frame_ms;
+    frame_histogram_clear(frame_ms);
+    glFinish();
+    for(int frame = 0; frame < frames; frame++) {
+        double frame_start = frame_timing_seconds();
+        glClear(GL_COLOR_BUFFER_BIT);
+        for(int mask = 0; mask < variants; mask++) {
+            gl_state_use_program(shader_variant(set, mask));
+            if(mask & instanced) {
+                const GLfloat * placement = &placements[mask * 4];
+                float half = placement[3] * 0.5f;
+                for(int i = 0; i < VARIANT_BENCH_INSTANCES; i++) {
+                    instances[i * 4 + 0] = placement[0] + (i & 1 ? half : -half);
+                    instances[i * 4 + 1] = placement[1] + (i & 2 ? half : -half);
+                    instances[i * 4 + 2] = 0.0f;
+                    instances[i * 4 + 3] = half * 0.8f;
+                }
+                gl_state_bind_buffer(GL_ARRAY_BUFFER, buffers[1]);
+                glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(instances), instances);
+                glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, VARIANT_BENCH_INSTANCES);
+            } else {
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            }
+        }
+        gl_state_end_frame();
+        headless_present();
+        frame_histogram_add(frame_ms, (frame_timing_seconds() - frame_start) * 1000.0);
+    }
+    glFinish();
+
+    gl_log("\nvariant-bench: %s, %i sets of %i variants\n", glGetString(GL_RENDERER), copies, variants);
+    gl_log("  one by one:   %8.1f ms (%.2f ms per variant)\n", serial.wall_seconds * 1000.0,
+        serial.wall_seconds * 1000.0 / serial.variants);
+    gl_log("  parallel:     %8.1f ms (%.2f ms per variant)%s\n", parallel.wall_seconds * 1000.0,
+        parallel.wall_seconds * 1000.0 / parallel.variants,
+        parallel.parallel ? "" : ", no parallel shader compile: built one by one");
+    gl_log("  speedup:      %8.2fx\n", serial.wall_seconds / parallel.wall_seconds);
+    gl_log("  frames with every variant drawn: p50 %.3f ms, p95 %.3f ms\n",
+        frame_histogram_percentile(frame_ms, 0.5), frame_histogram_percentile(frame_ms, 0.95));
+
+    gl_state_delete_vertex_arrays(1, &vao);
+    gl_state_delete_buffers(2, buffers);
+    shader_variants_destroy(&sets[0]);
+    log_gl_state_stats();
+    headless_shutdown();
+    return 0;
+}
@@ -0,0 +1,7 @@
+set -e
+g++ variant-bench.cpp shadervariants.cpp shadermanager.cpp programcache.cpp frametiming.cpp headless.cpp assetloader.cpp vertexformat.cpp glstate.cpp logging.cpp \
+    ../glew/lib/libGLEW.a ../glfw/build/src/libglfw3.a \
+    -I ../glfw/include -I ../glew/include/ \
+    -lGL -lEGL -lX11 -lGLU -pthread \
+    -o variant-bench
+./variant-bench
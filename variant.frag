@@ -0,0 +1,22 @@
+#version 410
+#pragma variant VERTEX_COLOR
+#pragma variant GAMMA
+
+#ifdef VERTEX_COLOR
+in vec4 colour;
+#else
+uniform vec4 input_color;
+#endif
+out vec4 frag_colour;
+
+void main() {
+#ifdef VERTEX_COLOR
+    vec4 c = colour;
+#else
+    vec4 c = input_color;
+#endif
+#ifdef GAMMA
+    c.rgb = pow(c.rgb, vec3(1.0 / 2.2));
+#endif
+    frag_colour = c;
+}
@@ -0,0 +1,27 @@
+#version 410
+#pragma variant VERTEX_COLOR
+#pragma variant INSTANCED
+
+layout(location = 0) in vec3 vertex_position;
+#ifdef VERTEX_COLOR
+layout(location = 1) in vec4 vertex_color;
+out vec4 colour;
+#endif
+#ifdef INSTANCED
+// xyz offset, w scale
+layout(location = 2) in vec4 instance_offset;
+#else
+uniform vec4 offset;
+#endif
+
+void main() {
+#ifdef INSTANCED
+    vec4 placement = instance_offset;
+#else
+    vec4 placement = offset;
+#endif
+#ifdef VERTEX_COLOR
+    colour = vertex_color;
+#endif
+    gl_Position = vec4(vertex_position * placement.w + placement.xyz, 1.0);
+}
@@ -0,0 +1,508 @@
+#include <math.h>
+#include <string.h>
+#include "vecmath.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define VECMATH_X86 1
+#include <immintrin.h>
+#endif
+
+vec3 vec3_make(float x, float y, float z) {
+    vec3 v = { x, y, z };
+    return v;
+}
+
+vec3 vec3_add(vec3 a, vec3 b) {
+    return vec3_make(a.x + b.x, a.y + b.y, a.z + b.z);
+}
+
+vec3 vec3_sub(vec3 a, vec3 b) {
+    return vec3_make(a.x - b.x, a.y - b.y, a.z - b.z);
+}
+
+vec3 vec3_scale(vec3 a, float s) {
+    return vec3_make(a.x * s, a.y * s, a.z * s);
+}
+
+float vec3_dot(vec3 a, vec3 b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+vec3 vec3_cross(vec3 a, vec3 b) {
+    return vec3_make(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+float vec3_length(vec3 a) {
+    return sqrtf(vec3_dot(a, a));
+}
+
+vec3 vec3_normalize(vec3 a) {
+    float length = vec3_length(a);
+    return length > 0.0f ? vec3_scale(a, 1.0f / length) : a;
+}
+
+vec4 vec4_make(float x, float y, float z, float w) {
+    vec4 v = { x, y, z, w };
+    return v;
+}
+
+mat4 mat4_identity() {
+    mat4 r;
+    memset(r.m, 0, sizeof(r.m));
+    r.m[0] = r.m[5] = r.m[10] = r.m[15] = 1.0f;
+    return r;
+}
+
+// the reference every SIMD path has to match bit for bit: same products,
+// summed in the same order, no fused multiply-add
+static void mat4_mul_scalar(const float * a, const float * b, float * out) {
+    float r[16];
+    for(int col = 0; col < 4; col++) {
+        for(int row = 0; row < 4; row++) {
+            r[col * 4 + row] = a[row] * b[col * 4] + a[4 + row] * b[col * 4 + 1]
+                + a[8 + row] * b[col * 4 + 2] + a[12 + row] * b[col * 4 + 3];
+        }
+    }
+    memcpy(out, r, sizeof(r));
+}
+
+mat4 mat4_mul(const mat4 & a, const mat4 & b) {
+    mat4 r;
+    mat4_mul_scalar(a.m, b.m, r.m);
+    return r;
+}
+
+mat4 mat4_translate(float x, float y, float z) {
+    mat4 r = mat4_identity();
+    r.m[12] = x;
+    r.m[13] = y;
+    r.m[14] = z;
+    return r;
+}
+
+mat4 mat4_scale(float x, float y, float z) {
+    mat4 r = mat4_identity();
+    r.m[0] = x;
+    r.m[5] = y;
+    r.m[10] = z;
+    return r;
+}
+
+mat4 mat4_from_quat(quat q) {
+    mat4 r = mat4_identity();
+    float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+    r.m[0] = 1.0f - 2.0f * (yy + zz);
+    r.m[1] = 2.0f * (xy + wz);
+    r.m[2] = 2.0f * (xz - wy);
+    r.m[4] = 2.0f * (xy - wz);
+    r.m[5] = 1.0f - 2.0f * (xx + zz);
+    r.m[6] = 2.0f * (yz + wx);
+    r.m[8] = 2.0f * (xz + wy);
+    r.m[9] = 2.0f * (yz - wx);
+    r.m[10] = 1.0f - 2.0f * (xx + yy);
+    return r;
+}
+
+mat4 mat4_perspective(float fovy_radians, float aspect, float near_plane, float far_plane) {
+    mat4 r;
+    memset(r.m, 0, sizeof(r.m));
+    float f = 1.0f / tanf(fovy_radians * 0.5f);
+    r.m[0] = f / aspect;
+    r.m[5] = f;
+    r.m[10] = (far_plane + near_plane) / (near_plane - far_plane);
+    r.m[11] = -1.0f;
+    r.m[14] = 2.0f * far_plane * near_plane / (near_plane - far_plane);
+    return r;
+}
+
+mat4 mat4_look_at(vec3 eye, vec3 target, vec3 up) {
+    vec3 f = vec3_normalize(vec3_sub(target, eye));
+    vec3 s = vec3_normalize(vec3_cross(f, up));
+    vec3 u = vec3_cross(s, f);
+    mat4 r = mat4_identity();
+    r.m[0] = s.x;
+    r.m[4] = s.y;
+    r.m[8] = s.z;
+    r.m[1] = u.x;
+    r.m[5] = u.y;
+    r.m[9] = u.z;
+    r.m[2] = -f.x;
+    r.m[6] = -f.y;
+    r.m[10] = -f.z;
+    r.m[12] = -vec3_dot(s, eye);
+    r.m[13] = -vec3_dot(u, eye);
+    r.m[14] = vec3_dot(f, eye);
+    return r;
+}
+
+vec4 mat4_transform(const mat4 & m, vec4 v) {
+    const float * a = m.m;
+    return vec4_make(a[0] * v.x + a[4] * v.y + a[8] * v.z + a[12] * v.w,
+        a[1] * v.x + a[5] * v.y + a[9] * v.z + a[13] * v.w,
+        a[2] * v.x + a[6] * v.y + a[10] * v.z + a[14] * v.w,
+        a[3] * v.x + a[7] * v.y + a[11] * v.z + a[15] * v.w);
+}
+
+vec3 mat4_transform_point(const mat4 & m, vec3 p) {
+    const float * a = m.m;
+    return vec3_make(a[0] * p.x + a[4] * p.y + a[8] * p.z + a[12],
+        a[1] * p.x + a[5] * p.y + a[9] * p.z + a[13],
+        a[2] * p.x + a[6] * p.y + a[10] * p.z + a[14]);
+}
+
+// Gribb/Hartmann: each plane is row 3 plus or minus row 0, 1 or 2 of the
+// clip matrix; normals point inwards and are normalised so the w term is a
+// true distance, which is what sphere tests need
+void mat4_frustum_planes(const mat4 & m, vec4 planes[6]) {
+    const float * a = m.m;
+    for(int i = 0; i < 6; i++) {
+        int row = i / 2;
+        float sign = (i & 1) ? -1.0f : 1.0f;
+        vec3 n = vec3_make(a[3] + sign * a[row], a[7] + sign * a[4 + row], a[11] + sign * a[8 + row]);
+        float d = a[15] + sign * a[12 + row];
+        float inv = 1.0f / vec3_length(n);
+        planes[i] = vec4_make(n.x * inv, n.y * inv, n.z * inv, d * inv);
+    }
+}
+
+quat quat_identity() {
+    quat q = { 0.0f, 0.0f, 0.0f, 1.0f };
+    return q;
+}
+
+quat quat_from_axis_angle(vec3 axis, float radians) {
+    vec3 n = vec3_normalize(axis);
+    float s = sinf(radians * 0.5f);
+    quat q = { n.x * s, n.y * s, n.z * s, cosf(radians * 0.5f) };
+    return q;
+}
+
+quat quat_mul(quat a, quat b) {
+    quat q = {
+        a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+        a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+        a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+        a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+    };
+    return q;
+}
+
+quat quat_normalize(quat q) {
+    float length = sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+    if(length <= 0.0f) {
+        return quat_identity();
+    }
+    quat r = { q.x / length, q.y / length, q.z / length, q.w / length };
+    return r;
+}
+
+quat quat_slerp(quat a, quat b, float t) {
+    float cosine = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+    // take the short way round
+    if(cosine < 0.0f) {
+        cosine = -cosine;
+        b.x = -b.x;
+        b.y = -b.y;
+        b.z = -b.z;
+        b.w = -b.w;
+    }
+    float wa = 1.0f - t;
+    float wb = t;
+    if(cosine < 0.9995f) {
+        float angle = acosf(cosine);
+        float s = sinf(angle);
+        wa = sinf((1.0f - t) * angle) / s;
+        wb = sinf(t * angle) / s;
+    }
+    quat r = { wa * a.x + wb * b.x, wa * a.y + wb * b.y, wa * a.z + wb * b.z, wa * a.w + wb * b.w };
+    return quat_normalize(r);
+}
+
+vec3 quat_rotate(quat q, vec3 v) {
+    vec3 u = vec3_make(q.x, q.y, q.z);
+    vec3 t = vec3_scale(vec3_cross(u, v), 2.0f);
+    return vec3_add(vec3_add(v, vec3_scale(t, q.w)), vec3_cross(u, t));
+}
+
+// scalar kernels, also used for the tails of the SIMD ones
+
+static void transform_points_scalar(const float * m, const float * x, const float * y, const float * z,
+        float * ox, float * oy, float * oz, size_t begin, size_t n) {
+    for(size_t i = begin; i < n; i++) {
+        float px = x[i], py = y[i], pz = z[i];
+        ox[i] = m[0] * px + m[4] * py + m[8] * pz + m[12];
+        oy[i] = m[1] * px + m[5] * py + m[9] * pz + m[13];
+        oz[i] = m[2] * px + m[6] * py + m[10] * pz + m[14];
+    }
+}
+
+static void bounds_scalar(const float * v, size_t begin, size_t end, float * lo, float * hi) {
+    for(size_t i = begin; i < end; i++) {
+        *lo = v[i] < *lo ? v[i] : *lo;
+        *hi = v[i] > *hi ? v[i] : *hi;
+    }
+}
+
+static void compute_bounds_scalar(const float * x, const float * y, const float * z,
+        const unsigned * first, const unsigned * count, size_t n,
+        float * min_x, float * min_y, float * min_z, float * max_x, float * max_y, float * max_z) {
+    for(size_t i = 0; i < n; i++) {
+        min_x[i] = min_y[i] = min_z[i] = INFINITY;
+        max_x[i] = max_y[i] = max_z[i] = -INFINITY;
+        bounds_scalar(x, first[i], first[i] + count[i], &min_x[i], &max_x[i]);
+        bounds_scalar(y, first[i], first[i] + count[i], &min_y[i], &max_y[i]);
+        bounds_scalar(z, first[i], first[i] + count[i], &min_z[i], &max_z[i]);
+    }
+}
+
+static void mat4_mul_batch_scalar(const mat4 * a, const mat4 * b, mat4 * out, size_t n) {
+    for(size_t i = 0; i < n; i++) {
+        mat4_mul_scalar(a[i].m, b[i].m, out[i].m);
+    }
+}
+
+#ifdef VECMATH_X86
+
+// SSE2 is part of x86-64, so these need no target attribute
+
+static void transform_points_sse(const float * m, const float * x, const float * y, const float * z,
+        float * ox, float * oy, float * oz, size_t n) {
+    __m128 m0 = _mm_set1_ps(m[0]), m1 = _mm_set1_ps(m[1]), m2 = _mm_set1_ps(m[2]);
+    __m128 m4 = _mm_set1_ps(m[4]), m5 = _mm_set1_ps(m[5]), m6 = _mm_set1_ps(m[6]);
+    __m128 m8 = _mm_set1_ps(m[8]), m9 = _mm_set1_ps(m[9]), m10 = _mm_set1_ps(m[10]);
+    __m128 m12 = _mm_set1_ps(m[12]), m13 = _mm_set1_ps(m[13]), m14 = _mm_set1_ps(m[14]);
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4) {
+        __m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+        __m128 rx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, px), _mm_mul_ps(m4, py)), _mm_mul_ps(m8, pz)), m12);
+        __m128 ry = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m1, px), _mm_mul_ps(m5, py)), _mm_mul_ps(m9, pz)), m13);
+        __m128 rz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m2, px), _mm_mul_ps(m6, py)), _mm_mul_ps(m10, pz)), m14);
+        _mm_storeu_ps(ox + i, rx);
+        _mm_storeu_ps(oy + i, ry);
+        _mm_storeu_ps(oz + i, rz);
+    }
+    transform_points_scalar(m, x, y, z, ox, oy, oz, i, n);
+}
+
+// min/max_ps return their second operand unless the first compares less
+// (greater), so with the new value first a NaN is skipped and the running
+// bound kept, exactly as bounds_scalar does. The lanes never hold a NaN, so
+// they can be folded in any order.
+static inline float min_lanes_sse(__m128 v) {
+    v = _mm_min_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_min_ss(v, _mm_shuffle_ps(v, v, 0x55));
+    return _mm_cvtss_f32(v);
+}
+
+static inline float max_lanes_sse(__m128 v) {
+    v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_max_ss(v, _mm_shuffle_ps(v, v, 0x55));
+    return _mm_cvtss_f32(v);
+}
+
+static void bounds_sse(const float * v, size_t begin, size_t end, float * lo, float * hi) {
+    size_t i = begin;
+    if(end - begin >= 4) {
+        __m128 vlo = _mm_set1_ps(*lo), vhi = _mm_set1_ps(*hi);
+        for(; i + 4 <= end; i += 4) {
+            __m128 p = _mm_loadu_ps(v + i);
+            vlo = _mm_min_ps(p, vlo);
+            vhi = _mm_max_ps(p, vhi);
+        }
+        *lo = min_lanes_sse(vlo);
+        *hi = max_lanes_sse(vhi);
+    }
+    bounds_scalar(v, i, end, lo, hi);
+}
+
+static void compute_bounds_sse(const float * x, const float * y, const float * z,
+        const unsigned * first, const unsigned * count, size_t n,
+        float * min_x, float * min_y, float * min_z, float * max_x, float * max_y, float * max_z) {
+    for(size_t i = 0; i < n; i++) {
+        min_x[i] = min_y[i] = min_z[i] = INFINITY;
+        max_x[i] = max_y[i] = max_z[i] = -INFINITY;
+        bounds_sse(x, first[i], first[i] + count[i], &min_x[i], &max_x[i]);
+        bounds_sse(y, first[i], first[i] + count[i], &min_y[i], &max_y[i]);
+        bounds_sse(z, first[i], first[i] + count[i], &min_z[i], &max_z[i]);
+    }
+}
+
+static void mat4_mul_batch_sse(const mat4 * a, const mat4 * b, mat4 * out, size_t n) {
+    for(size_t i = 0; i < n; i++) {
+        const float * am = a[i].m;
+        const float * bm = b[i].m;
+        __m128 a0 = _mm_loadu_ps(am), a1 = _mm_loadu_ps(am + 4);
+        __m128 a2 = _mm_loadu_ps(am + 8), a3 = _mm_loadu_ps(am + 12);
+        __m128 r[4];
+        for(int col = 0; col < 4; col++) {
+            const float * bc = bm + col * 4;
+            __m128 sum = _mm_mul_ps(a0, _mm_set1_ps(bc[0]));
+            sum = _mm_add_ps(sum, _mm_mul_ps(a1, _mm_set1_ps(bc[1])));
+            sum = _mm_add_ps(sum, _mm_mul_ps(a2, _mm_set1_ps(bc[2])));
+            r[col] = _mm_add_ps(sum, _mm_mul_ps(a3, _mm_set1_ps(bc[3])));
+        }
+        // out may alias a or b, so store only after every column is done
+        for(int col = 0; col < 4; col++) {
+            _mm_storeu_ps(out[i].m + col * 4, r[col]);
+        }
+    }
+}
+
+// AVX2 paths: plain mul + add, never FMA, so results match the scalar code
+
+__attribute__((target("avx2")))
+static void transform_points_avx2(const float * m, const float * x, const float * y, const float * z,
+        float * ox, float * oy, float * oz, size_t n) {
+    __m256 m0 = _mm256_set1_ps(m[0]), m1 = _mm256_set1_ps(m[1]), m2 = _mm256_set1_ps(m[2]);
+    __m256 m4 = _mm256_set1_ps(m[4]), m5 = _mm256_set1_ps(m[5]), m6 = _mm256_set1_ps(m[6]);
+    __m256 m8 = _mm256_set1_ps(m[8]), m9 = _mm256_set1_ps(m[9]), m10 = _mm256_set1_ps(m[10]);
+    __m256 m12 = _mm256_set1_ps(m[12]), m13 = _mm256_set1_ps(m[13]), m14 = _mm256_set1_ps(m[14]);
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+        __m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+        __m256 rx = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m0, px), _mm256_mul_ps(m4, py)),
+            _mm256_mul_ps(m8, pz)), m12);
+        __m256 ry = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m1, px), _mm256_mul_ps(m5, py)),
+            _mm256_mul_ps(m9, pz)), m13);
+        __m256 rz = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m2, px), _mm256_mul_ps(m6, py)),
+            _mm256_mul_ps(m10, pz)), m14);
+        _mm256_storeu_ps(ox + i, rx);
+        _mm256_storeu_ps(oy + i, ry);
+        _mm256_storeu_ps(oz + i, rz);
+    }
+    transform_points_scalar(m, x, y, z, ox, oy, oz, i, n);
+}
+
+__attribute__((target("avx2")))
+static void bounds_avx2(const float * v, size_t begin, size_t end, float * lo, float * hi) {
+    size_t i = begin;
+    if(end - begin >= 8) {
+        __m256 vlo = _mm256_set1_ps(*lo), vhi = _mm256_set1_ps(*hi);
+        for(; i + 8 <= end; i += 8) {
+            __m256 p = _mm256_loadu_ps(v + i);
+            vlo = _mm256_min_ps(p, vlo);
+            vhi = _mm256_max_ps(p, vhi);
+        }
+        *lo = min_lanes_sse(_mm_min_ps(_mm256_castps256_ps128(vlo), _mm256_extractf128_ps(vlo, 1)));
+        *hi = max_lanes_sse(_mm_max_ps(_mm256_castps256_ps128(vhi), _mm256_extractf128_ps(vhi, 1)));
+    }
+    bounds_scalar(v, i, end, lo, hi);
+}
+
+__attribute__((target("avx2")))
+static void compute_bounds_avx2(const float * x, const float * y, const float * z,
+        const unsigned * first, const unsigned * count, size_t n,
+        float * min_x, float * min_y, float * min_z, float * max_x, float * max_y, float * max_z) {
+    for(size_t i = 0; i < n; i++) {
+        min_x[i] = min_y[i] = min_z[i] = INFINITY;
+        max_x[i] = max_y[i] = max_z[i] = -INFINITY;
+        bounds_avx2(x, first[i], first[i] + count[i], &min_x[i], &max_x[i]);
+        bounds_avx2(y, first[i], first[i] + count[i], &min_y[i], &max_y[i]);
+        bounds_avx2(z, first[i], first[i] + count[i], &min_z[i], &max_z[i]);
+    }
+}
+
+__attribute__((target("avx2")))
+static void mat4_mul_batch_avx2(const mat4 * a, const mat4 * b, mat4 * out, size_t n) {
+    for(size_t i = 0; i < n; i++) {
+        const float * am = a[i].m;
+        const float * bm = b[i].m;
+        // each a column in both 128-bit lanes; two result columns per register
+        __m256 a0 = _mm256_broadcast_ps((const __m128 *)am);
+        __m256 a1 = _mm256_broadcast_ps((const __m128 *)(am + 4));
+        __m256 a2 = _mm256_broadcast_ps((const __m128 *)(am + 8));
+        __m256 a3 = _mm256_broadcast_ps((const __m128 *)(am + 12));
+        __m256 r[2];
+        for(int half = 0; half < 2; half++) {
+            __m256 bc = _mm256_loadu_ps(bm + half * 8);
+            __m256 sum = _mm256_mul_ps(a0, _mm256_permute_ps(bc, 0x00));
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(a1, _mm256_permute_ps(bc, 0x55)));
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(a2, _mm256_permute_ps(bc, 0xaa)));
+            r[half] = _mm256_add_ps(sum, _mm256_mul_ps(a3, _mm256_permute_ps(bc, 0xff)));
+        }
+        _mm256_storeu_ps(out[i].m, r[0]);
+        _mm256_storeu_ps(out[i].m + 8, r[1]);
+    }
+}
+
+#endif
+
+static int g_simd_level = -1;
+
+int math_simd_level() {
+    if(g_simd_level < 0) {
+        g_simd_level = MATH_SCALAR;
+#ifdef VECMATH_X86
+        g_simd_level = MATH_SSE;
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2")) {
+            g_simd_level = MATH_AVX2;
+        }
+#endif
+    }
+    return g_simd_level;
+}
+
+void math_force_simd_level(int level) {
+    g_simd_level = -1;
+    int supported = math_simd_level();
+    g_simd_level = level < supported ? level : supported;
+}
+
+const char * math_simd_name(int level) {
+    switch(level) {
+        case MATH_AVX2: return "avx2";
+        case MATH_SSE: return "sse";
+        default: return "scalar";
+    }
+}
+
+void transform_points(const mat4 & m, const float * x, const float * y, const float * z,
+        float * out_x, float * out_y, float * out_z, size_t n) {
+    switch(math_simd_level()) {
+#ifdef VECMATH_X86
+        case MATH_AVX2:
+            transform_points_avx2(m.m, x, y, z, out_x, out_y, out_z, n);
+            return;
+        case MATH_SSE:
+            transform_points_sse(m.m, x, y, z, out_x, out_y, out_z, n);
+            return;
+#endif
+        default:
+            transform_points_scalar(m.m, x, y, z, out_x, out_y, out_z, 0, n);
+    }
+}
+
+void compute_bounds(const float * x, const float * y, const float * z,
+        const unsigned * first, const unsigned * count, size_t n,
+        float * min_x, float * min_y, float * min_z, float * max_x, float * max_y, float * max_z) {
+    switch(math_simd_level()) {
+#ifdef VECMATH_X86
+        case MATH_AVX2:
+            compute_bounds_avx2(x, y, z, first, count, n, min_x, min_y, min_z, max_x, max_y, max_z);
+            return;
+        case MATH_SSE:
+            compute_bounds_sse(x, y, z, first, count, n, min_x, min_y, min_z, max_x, max_y, max_z);
+            return;
+#endif
+        default:
+            compute_bounds_scalar(x, y, z, first, count, n, min_x, min_y, min_z, max_x, max_y, max_z);
+    }
+}
+
+void mat4_mul_batch(const mat4 * a, const mat4 * b, mat4 * out, size_t n) {
+    switch(math_simd_level()) {
+#ifdef VECMATH_X86
+        case MATH_AVX2:
+            mat4_mul_batch_avx2(a, b, out, n);
+            return;
+        case MATH_SSE:
+            mat4_mul_batch_sse(a, b, out, n);
+            return;
+#endif
+        default:
+            mat4_mul_batch_scalar(a, b, out, n);
+    }
+}
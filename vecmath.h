@@ -0,0 +1,78 @@
+#pragma once
+#include <stddef.h>
+
+// Small vector/matrix/quaternion types plus batch kernels over SoA arrays.
+// mat4 is column-major, m[col * 4 + row], so m can go straight to
+// set_uniform_mat4 / glUniformMatrix4fv without transposing.
+// The batch kernels pick an SSE or AVX2 implementation at runtime and fall
+// back to scalar code; every path rounds exactly like the scalar one. Where
+// the scalar result is a NaN the others are NaN too, though sign and payload
+// may differ. compute_bounds skips NaN inputs on every path, but a zero bound
+// may come out with the other sign (-0 == +0).
+struct vec3 {
+    float x, y, z;
+};
+
+struct vec4 {
+    float x, y, z, w;
+};
+
+struct quat {
+    float x, y, z, w;
+};
+
+struct mat4 {
+    float m[16];
+};
+
+enum {
+    MATH_SCALAR = 0,
+    MATH_SSE,
+    MATH_AVX2,
+};
+
+vec3 vec3_make(float x, float y, float z);
+vec3 vec3_add(vec3 a, vec3 b);
+vec3 vec3_sub(vec3 a, vec3 b);
+vec3 vec3_scale(vec3 a, float s);
+float vec3_dot(vec3 a, vec3 b);
+vec3 vec3_cross(vec3 a, vec3 b);
+float vec3_length(vec3 a);
+vec3 vec3_normalize(vec3 a);
+vec4 vec4_make(float x, float y, float z, float w);
+
+mat4 mat4_identity();
+mat4 mat4_mul(const mat4 & a, const mat4 & b);
+mat4 mat4_translate(float x, float y, float z);
+mat4 mat4_scale(float x, float y, float z);
+mat4 mat4_from_quat(quat q);
+mat4 mat4_perspective(float fovy_radians, float aspect, float near_plane, float far_plane);
+mat4 mat4_look_at(vec3 eye, vec3 target, vec3 up);
+vec4 mat4_transform(const mat4 & m, vec4 v);
+vec3 mat4_transform_point(const mat4 & m, vec3 p);
+// left, right, bottom, top, near, far of a view-projection matrix;
+// a point p is inside plane i when dot(xyz, p) + w >= 0
+void mat4_frustum_planes(const mat4 & m, vec4 planes[6]);
+
+quat quat_identity();
+quat quat_from_axis_angle(vec3 axis, float radians);
+quat quat_mul(quat a, quat b);
+quat quat_normalize(quat q);
+quat quat_slerp(quat a, quat b, float t);
+vec3 quat_rotate(quat q, vec3 v);
+
+// affine transform of n points: out = m * (x, y, z, 1), no perspective divide
+void transform_points(const mat4 & m, const float * x, const float * y, const float * z,
+    float * out_x, float * out_y, float * out_z, size_t n);
+// per-object bounding boxes over point ranges; mins and maxs are SoA, 3 arrays of n
+void compute_bounds(const float * x, const float * y, const float * z,
+    const unsigned * first, const unsigned * count, size_t n,
+    float * min_x, float * min_y, float * min_z, float * max_x, float * max_y, float * max_z);
+// out[i] = a[i] * b[i]; out may alias a or b
+void mat4_mul_batch(const mat4 * a, const mat4 * b, mat4 * out, size_t n);
+
+// picks the widest supported path on first use; force lowers it, for
+// benchmarks and exactness checks
+int math_simd_level();
+void math_force_simd_level(int level);
+const char * math_simd_name(int level);
@@ -0,0 +1,227 @@
+#include <GL/glew.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include "logging.h"
+#include "shadermanager.h"
+#include "frametiming.h"
+#include "headless.h"
+#include "glstate.h"
+#include "meshfile.h"
+#include "vertexformat.h"
+#include "glcapture.h"
+
+// Vertex format benchmark: one sphere (position, normal, uv) stored as
+// plain floats, as half floats with packed normals, and as 16-bit
+// quantized positions, interleaved and split into two streams. Reports
+// bytes per vertex, encode speed (scalar vs SIMD, checked for identical
+// output) and draw time with every attribute fetched.
+
+#define VERTEX_BENCH_FLOATS 8
+
+struct layout_case {
+    const char * name;
+    vertex_format format;
+    bool quantized;
+};
+
+static int g_frames = 10;
+static int g_draws_per_frame = 4;
+// the sphere is drawn a few pixels wide so vertex fetch, not rasterisation, is timed
+static float g_draw_scale = 0.02f;
+
+static void make_sphere(int rings, int segments, std::vector<float> & vertices, std::vector<GLuint> & indices) {
+    for(int r = 0; r <= rings; r++) {
+        float theta = (float)M_PI * r / rings;
+        for(int s = 0; s <= segments; s++) {
+            float phi = 2.0f * (float)M_PI * s / segments;
+            float x = sinf(theta) * cosf(phi), y = cosf(theta), z = sinf(theta) * sinf(phi);
+            float v[VERTEX_BENCH_FLOATS] = { x, y, z, x, y, z, (float)s / segments, (float)r / rings };
+            vertices.insert(vertices.end(), v, v + VERTEX_BENCH_FLOATS);
+        }
+    }
+    for(int r = 0; r < rings; r++) {
+        for(int s = 0; s < segments; s++) {
+            GLuint a = r * (segments + 1) + s;
+            GLuint b = a + segments + 1;
+            GLuint quad[] = { a, b, a + 1, a + 1, b, b + 1 };
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+}
+
+static void encode_all(const layout_case & c, const std::vector<float> & source, size_t n,
+        std::vector<unsigned char> * streams, const float * bias, const float * scale) {
+    const size_t stride = VERTEX_BENCH_FLOATS * sizeof(float);
+    for(int e = 0; e < c.format.element_count; e++) {
+        const vertex_element & element = c.format.elements[e];
+        // source floats: position at 0, normal at 3, uv at 6
+        int first = element.location == MESH_ATTRIB_POSITION ? 0 : element.location == MESH_ATTRIB_NORMAL ? 3 : 6;
+        bool position = element.location == MESH_ATTRIB_POSITION;
+        static const float unit_bias[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        static const float unit_scale[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        vertex_format_encode(&c.format, e, &source[first], stride, streams[element.stream].data(), n,
+            position ? bias : unit_bias, position ? scale : unit_scale);
+    }
+}
+
+static double median(std::vector<double> & times) {
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+// float_draw_ms is the first case's draw time, the baseline for the speedup column
+static bool bench(GLuint program, const layout_case & c, const std::vector<float> & source, GLuint ibo,
+        GLsizei index_count, double * float_draw_ms) {
+    size_t n = source.size() / VERTEX_BENCH_FLOATS;
+    float bias[3];
+    float scale[3];
+    quantization_range(source.data(), VERTEX_BENCH_FLOATS * sizeof(float), 3, n, bias, scale);
+    std::vector<unsigned char> streams[VERTEX_FORMAT_MAX_STREAMS];
+    std::vector<unsigned char> reference[VERTEX_FORMAT_MAX_STREAMS];
+    size_t bytes = 0;
+    for(int s = 0; s < c.format.stream_count; s++) {
+        streams[s].assign((size_t)vertex_format_stride(&c.format, s) * n, 0);
+        reference[s] = streams[s];
+        bytes += streams[s].size();
+    }
+
+    std::vector<double> scalar_times, simd_times;
+    for(int run = 0; run < 5; run++) {
+        vertex_encode_force_scalar(true);
+        double start = frame_timing_seconds();
+        encode_all(c, source, n, reference, bias, scale);
+        scalar_times.push_back(frame_timing_seconds() - start);
+        vertex_encode_force_scalar(false);
+        start = frame_timing_seconds();
+        encode_all(c, source, n, streams, bias, scale);
+        simd_times.push_back(frame_timing_seconds() - start);
+    }
+    bool exact = true;
+    for(int s = 0; s < c.format.stream_count; s++) {
+        exact = exact && streams[s] == reference[s];
+    }
+
+    GLuint vao = 0;
+    GLuint buffers[VERTEX_FORMAT_MAX_STREAMS] = { 0 };
+    GLintptr offsets[VERTEX_FORMAT_MAX_STREAMS] = { 0 };
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(c.format.stream_count, buffers);
+    for(int s = 0; s < c.format.stream_count; s++) {
+        gl_state_bind_buffer(GL_ARRAY_BUFFER, buffers[s]);
+        glBufferData(GL_ARRAY_BUFFER, streams[s].size(), streams[s].data(), GL_STATIC_DRAW);
+    }
+    vertex_format_apply(&c.format, vao, buffers, offsets);
+    gl_state_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+    float k = g_draw_scale;
+    if(c.quantized) {
+        set_uniform_vec3(program, "position_scale", scale[0] * k, scale[1] * k, scale[2] * k);
+        set_uniform_vec3(program, "position_bias", bias[0] * k, bias[1] * k, bias[2] * k);
+    } else {
+        set_uniform_vec3(program, "position_scale", k, k, k);
+        set_uniform_vec3(program, "position_bias", 0.0f, 0.0f, 0.0f);
+    }
+    std::vector<double> draw_times;
+    for(int frame = 0; frame < g_frames + 2; frame++) {
+        glFinish();
+        double start = frame_timing_seconds();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        for(int d = 0; d < g_draws_per_frame; d++) {
+            glDrawElements(GL_TRIANGLES, index_count, GL_UNSIGNED_INT, NULL);
+        }
+        glFinish();
+        if(frame >= 2) {
+            draw_times.push_back(frame_timing_seconds() - start);
+        }
+    }
+    double draw_ms = median(draw_times) * 1000.0;
+    if(*float_draw_ms <= 0.0) {
+        *float_draw_ms = draw_ms;
+    }
+    double scalar_ms = median(scalar_times) * 1000.0;
+    double simd_ms = median(simd_times) * 1000.0;
+    gl_log("  %-28s %7i %9.1f %10.2f %10.2f %10.3f %7.2fx  %s\n", c.name, (int)(bytes / n), bytes / (1024.0 * 1024.0),
+        scalar_ms, simd_ms, draw_ms, *float_draw_ms / draw_ms, exact ? "exact" : "MISMATCH");
+    gl_state_delete_vertex_arrays(1, &vao);
+    gl_state_delete_buffers(c.format.stream_count, buffers);
+    return exact;
+}
+
+int main(int argc, char ** argv) {
+    headless_options options;
+    if(!parse_headless_args(argc, argv, &options)) {
+        return 1;
+    }
+    options.enabled = true;
+    if(options.frames > 0) {
+        g_frames = (int)options.frames;
+    }
+    if(!restart_gl_log()) {
+        fprintf(stderr, "Failed to open log file\n");
+        return 1;
+    }
+    gl_log_set_level(GL_LOG_WARN);
+    if(!headless_init(&options)) {
+        return 2;
+    }
+    gl_state_viewport(0, 0, options.width, options.height);
+    gl_state_enable(GL_DEPTH_TEST, true);
+    GLuint program = build_shader_program("./packed.vert", "./packed.frag");
+    if(!program) {
+        return 3;
+    }
+    gl_state_use_program(program);
+    gl_log_set_level(GL_LOG_INFO);
+
+    std::vector<float> source;
+    std::vector<GLuint> indices;
+    make_sphere(512, 512, source, indices);
+    GLuint ibo = 0;
+    glGenBuffers(1, &ibo);
+    gl_state_bind_vertex_array(0);
+    gl_state_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+
+    layout_case cases[4];
+    cases[0].name = "float32";
+    cases[0].quantized = false;
+    vertex_format_init(&cases[0].format);
+    vertex_format_add(&cases[0].format, MESH_ATTRIB_POSITION, 3, VERTEX_FLOAT32);
+    vertex_format_add(&cases[0].format, MESH_ATTRIB_NORMAL, 3, VERTEX_FLOAT32);
+    vertex_format_add(&cases[0].format, MESH_ATTRIB_TEXCOORD, 2, VERTEX_FLOAT32);
+    cases[1].name = "half + 2_10_10_10";
+    cases[1].quantized = false;
+    vertex_format_init(&cases[1].format);
+    vertex_format_add(&cases[1].format, MESH_ATTRIB_POSITION, 3, VERTEX_HALF);
+    vertex_format_add(&cases[1].format, MESH_ATTRIB_NORMAL, 3, VERTEX_SNORM_2_10_10_10);
+    vertex_format_add(&cases[1].format, MESH_ATTRIB_TEXCOORD, 2, VERTEX_HALF);
+    cases[2].name = "unorm16 + 2_10_10_10";
+    cases[2].quantized = true;
+    vertex_format_init(&cases[2].format);
+    vertex_format_add(&cases[2].format, MESH_ATTRIB_POSITION, 3, VERTEX_UNORM16);
+    vertex_format_add(&cases[2].format, MESH_ATTRIB_NORMAL, 3, VERTEX_SNORM_2_10_10_10);
+    vertex_format_add(&cases[2].format, MESH_ATTRIB_TEXCOORD, 2, VERTEX_UNORM16);
+    // positions alone in stream 0, as a depth-only pass would want them
+    cases[3].name = "unorm16, 2 streams";
+    cases[3].quantized = true;
+    vertex_format_init(&cases[3].format);
+    vertex_format_add(&cases[3].format, MESH_ATTRIB_POSITION, 3, VERTEX_UNORM16, 0);
+    vertex_format_add(&cases[3].format, MESH_ATTRIB_NORMAL, 3, VERTEX_SNORM_2_10_10_10, 1);
+    vertex_format_add(&cases[3].format, MESH_ATTRIB_TEXCOORD, 2, VERTEX_UNORM16, 1);
+
+    size_t n = source.size() / VERTEX_BENCH_FLOATS;
+    gl_log("\nvertex-bench: %s, %zu vertices, %zu triangles x %i draws, encoders %s\n", glGetString(GL_RENDERER), n,
+        indices.size() / 3, g_draws_per_frame, vertex_encode_simd() ? "sse4.1/f16c" : "scalar only");
+    gl_log("  %-28s %7s %9s %10s %10s %10s %8s\n", "layout", "B/vert", "MB", "scalar ms", "simd ms", "draw ms",
+        "speedup");
+    bool ok = true;
+    double float_draw_ms = 0.0;
+    for(int i = 0; i < 4; i++) {
+        ok = bench(program, cases[i], source, ibo, (GLsizei)indices.size(), &float_draw_ms) && ok;
+    }
+    gl_state_delete_buffers(1, &ibo);
+    headless_shutdown();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,7 @@
+set -e
+g++ vertex-bench.cpp vertexformat.cpp shadermanager.cpp programcache.cpp frametiming.cpp headless.cpp assetloader.cpp glstate.cpp logging.cpp \
+    ../glew/lib/libGLEW.a ../glfw/build/src/libglfw3.a \
+    -I ../glfw/include -I ../glew/include/ \
+    -lGL -lEGL -lX11 -lGLU -pthread \
+    -o vertex-bench
+./vertex-bench
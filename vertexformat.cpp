@@ -0,0 +1,364 @@
+#include <GL/glew.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include "logging.h"
+#include "glstate.h"
+#include "vertexformat.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define VERTEXFORMAT_X86 1
+#include <immintrin.h>
+#endif
+#include "glcapture.h"
+
+GLenum vertex_encoding_type(int encoding) {
+    switch(encoding) {
+        case VERTEX_HALF: return GL_HALF_FLOAT;
+        case VERTEX_SNORM_2_10_10_10: return GL_INT_2_10_10_10_REV;
+        case VERTEX_UNORM16: return GL_UNSIGNED_SHORT;
+        case VERTEX_UNORM8: return GL_UNSIGNED_BYTE;
+        default: return GL_FLOAT;
+    }
+}
+
+bool vertex_encoding_normalized(int encoding) {
+    return encoding == VERTEX_SNORM_2_10_10_10 || encoding == VERTEX_UNORM16 || encoding == VERTEX_UNORM8;
+}
+
+int vertex_encoding_of(GLenum type, bool normalized) {
+    for(int encoding = VERTEX_FLOAT32; encoding <= VERTEX_UNORM8; encoding++) {
+        if(vertex_encoding_type(encoding) == type && vertex_encoding_normalized(encoding) == normalized) {
+            return encoding;
+        }
+    }
+    return -1;
+}
+
+static GLuint encoding_size(int encoding, int components) {
+    switch(encoding) {
+        case VERTEX_HALF: return 2 * components;
+        case VERTEX_SNORM_2_10_10_10: return 4;
+        case VERTEX_UNORM16: return 2 * components;
+        case VERTEX_UNORM8: return components;
+        default: return 4 * components;
+    }
+}
+
+void vertex_format_init(vertex_format * format) {
+    memset(format, 0, sizeof(*format));
+}
+
+int vertex_format_add(vertex_format * format, GLuint location, int components, int encoding, int stream) {
+    if(format->element_count == VERTEX_FORMAT_MAX_ELEMENTS || stream < 0 || stream >= VERTEX_FORMAT_MAX_STREAMS
+            || components < 1 || components > 4 || encoding < VERTEX_FLOAT32 || encoding > VERTEX_UNORM8) {
+        gl_log_err("ERROR: vertex format cannot take element at location %u\n", location);
+        return -1;
+    }
+    if(encoding == VERTEX_SNORM_2_10_10_10) {
+        components = 4;
+    }
+    vertex_element & e = format->elements[format->element_count];
+    e.location = location;
+    e.components = components;
+    e.encoding = encoding;
+    e.stream = stream;
+    e.offset = format->strides[stream];
+    format->strides[stream] += (encoding_size(encoding, components) + 3) & ~3u;
+    if(stream + 1 > format->stream_count) {
+        format->stream_count = stream + 1;
+    }
+    return format->element_count++;
+}
+
+GLsizei vertex_format_stride(const vertex_format * format, int stream) {
+    return format->strides[stream];
+}
+
+void vertex_format_set_divisor(vertex_format * format, int stream, GLuint divisor) {
+    format->divisors[stream] = divisor;
+}
+
+void vertex_format_apply(const vertex_format * format, GLuint vao, const GLuint * buffers, const GLintptr * offsets) {
+    gl_state_bind_vertex_array(vao);
+    for(int i = 0; i < format->element_count; i++) {
+        const vertex_element & e = format->elements[i];
+        gl_state_bind_buffer(GL_ARRAY_BUFFER, buffers[e.stream]);
+        glEnableVertexAttribArray(e.location);
+        glVertexAttribPointer(e.location, e.components, vertex_encoding_type(e.encoding),
+            vertex_encoding_normalized(e.encoding) ? GL_TRUE : GL_FALSE, format->strides[e.stream],
+            (const void *)(offsets[e.stream] + e.offset));
+        glVertexAttribDivisor(e.location, format->divisors[e.stream]);
+    }
+}
+
+// scalar reference encoders; the SIMD ones below must produce the same bits
+
+static uint16_t float_to_half(float value) {
+    uint32_t f;
+    memcpy(&f, &value, 4);
+    uint32_t sign = (f >> 16) & 0x8000;
+    uint32_t exponent = (f >> 23) & 0xff;
+    uint32_t mantissa = f & 0x7fffff;
+    if(exponent == 0xff) {
+        // inf stays inf, NaN stays a quiet NaN
+        return (uint16_t)(sign | 0x7c00 | (mantissa ? 0x200 | (mantissa >> 13) : 0));
+    }
+    int e = (int)exponent - 127 + 15;
+    if(e >= 31) {
+        return (uint16_t)(sign | 0x7c00);
+    }
+    if(e <= 0) {
+        if(e < -10) {
+            return (uint16_t)sign;
+        }
+        // subnormal half: shift the implicit 1 in, round to nearest even
+        mantissa |= 0x800000;
+        int shift = 14 - e;
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t midpoint = 1u << (shift - 1);
+        if(rest > midpoint || (rest == midpoint && (half & 1))) {
+            half++;
+        }
+        return (uint16_t)(sign | half);
+    }
+    uint32_t half = ((uint32_t)e << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fff;
+    // a carry out of the mantissa correctly bumps the exponent, up to inf
+    if(rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+        half++;
+    }
+    return (uint16_t)(sign | half);
+}
+
+static float clampf(float v, float lo, float hi) {
+    // NaN maps to lo, like the SIMD max/min order below
+    return v > lo ? (v < hi ? v : hi) : lo;
+}
+
+static int32_t snorm10(float v) {
+    return (int32_t)nearbyintf(clampf(v, -1.0f, 1.0f) * 511.0f);
+}
+
+static uint32_t pack_2_10_10_10(int32_t x, int32_t y, int32_t z) {
+    return ((uint32_t)x & 0x3ff) | (((uint32_t)y & 0x3ff) << 10) | (((uint32_t)z & 0x3ff) << 20);
+}
+
+static void encode_half_scalar(const char * src, size_t src_stride, int components, char * dst, size_t dst_stride,
+        size_t begin, size_t n) {
+    for(size_t i = begin; i < n; i++) {
+        const float * in = (const float *)(src + i * src_stride);
+        uint16_t * out = (uint16_t *)(dst + i * dst_stride);
+        for(int c = 0; c < components; c++) {
+            out[c] = float_to_half(in[c]);
+        }
+    }
+}
+
+static void encode_snorm_scalar(const char * src, size_t src_stride, char * dst, size_t dst_stride,
+        size_t begin, size_t n) {
+    for(size_t i = begin; i < n; i++) {
+        const float * in = (const float *)(src + i * src_stride);
+        uint32_t packed = pack_2_10_10_10(snorm10(in[0]), snorm10(in[1]), snorm10(in[2]));
+        memcpy(dst + i * dst_stride, &packed, 4);
+    }
+}
+
+static void encode_unorm16_scalar(const char * src, size_t src_stride, int components, const float * bias,
+        const float * inverse, char * dst, size_t dst_stride, size_t begin, size_t n) {
+    for(size_t i = begin; i < n; i++) {
+        const float * in = (const float *)(src + i * src_stride);
+        uint16_t * out = (uint16_t *)(dst + i * dst_stride);
+        for(int c = 0; c < components; c++) {
+            out[c] = (uint16_t)nearbyintf(clampf((in[c] - bias[c]) * inverse[c], 0.0f, 1.0f) * 65535.0f);
+        }
+    }
+}
+
+#ifdef VERTEXFORMAT_X86
+
+// one vertex per register, all components at once; the vertices whose
+// 16-byte load would run past the end of the source go through scalar code
+
+static size_t simd_vertex_count(size_t n, size_t src_stride, int components) {
+    size_t over = 16 - components * sizeof(float);
+    if(over == 0) {
+        return n;
+    }
+    size_t tail = src_stride ? (over + src_stride - 1) / src_stride : n;
+    return n > tail ? n - tail : 0;
+}
+
+__attribute__((target("sse4.1,f16c")))
+static void encode_half_simd(const char * src, size_t src_stride, int components, char * dst, size_t dst_stride,
+        size_t n) {
+    size_t count = simd_vertex_count(n, src_stride, components);
+    size_t i = 0;
+    for(; i < count; i++) {
+        __m128 v = _mm_loadu_ps((const float *)(src + i * src_stride));
+        uint16_t bits[8];
+        _mm_storel_epi64((__m128i *)bits, _mm_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+        memcpy(dst + i * dst_stride, bits, components * 2);
+    }
+    encode_half_scalar(src, src_stride, components, dst, dst_stride, i, n);
+}
+
+__attribute__((target("sse4.1")))
+static void encode_snorm_simd(const char * src, size_t src_stride, char * dst, size_t dst_stride, size_t n) {
+    const __m128 lo = _mm_set1_ps(-1.0f);
+    const __m128 hi = _mm_set1_ps(1.0f);
+    const __m128 range = _mm_set1_ps(511.0f);
+    const __m128i mask = _mm_set1_epi32(0x3ff);
+    size_t count = simd_vertex_count(n, src_stride, 3);
+    size_t i = 0;
+    for(; i < count; i++) {
+        __m128 v = _mm_loadu_ps((const float *)(src + i * src_stride));
+        v = _mm_min_ps(_mm_max_ps(v, lo), hi);
+        __m128i q = _mm_and_si128(_mm_cvtps_epi32(_mm_mul_ps(v, range)), mask);
+        uint32_t packed = (uint32_t)_mm_extract_epi32(q, 0) | ((uint32_t)_mm_extract_epi32(q, 1) << 10)
+            | ((uint32_t)_mm_extract_epi32(q, 2) << 20);
+        memcpy(dst + i * dst_stride, &packed, 4);
+    }
+    encode_snorm_scalar(src, src_stride, dst, dst_stride, i, n);
+}
+
+__attribute__((target("sse4.1")))
+static void encode_unorm16_simd(const char * src, size_t src_stride, int components, const float * bias,
+        const float * inverse, char * dst, size_t dst_stride, size_t n) {
+    float b[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    float s[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    memcpy(b, bias, components * sizeof(float));
+    memcpy(s, inverse, components * sizeof(float));
+    const __m128 vb = _mm_loadu_ps(b);
+    const __m128 vs = _mm_loadu_ps(s);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 range = _mm_set1_ps(65535.0f);
+    size_t count = simd_vertex_count(n, src_stride, components);
+    size_t i = 0;
+    for(; i < count; i++) {
+        __m128 v = _mm_loadu_ps((const float *)(src + i * src_stride));
+        v = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(v, vb), vs), zero), one);
+        __m128i q = _mm_cvtps_epi32(_mm_mul_ps(v, range));
+        uint16_t bits[8];
+        _mm_storel_epi64((__m128i *)bits, _mm_packus_epi32(q, q));
+        memcpy(dst + i * dst_stride, bits, components * 2);
+    }
+    encode_unorm16_scalar(src, src_stride, components, bias, inverse, dst, dst_stride, i, n);
+}
+
+#endif
+
+static int g_simd = -1;
+
+bool vertex_encode_simd() {
+    if(g_simd < 0) {
+        g_simd = 0;
+#ifdef VERTEXFORMAT_X86
+        __builtin_cpu_init();
+        g_simd = __builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("f16c");
+#endif
+    }
+    return g_simd == 1;
+}
+
+void vertex_encode_force_scalar(bool scalar) {
+    g_simd = -1;
+    if(scalar) {
+        g_simd = 0;
+    }
+}
+
+void encode_float32(const float * src, size_t src_stride, int components, void * dst, size_t dst_stride, size_t n) {
+    for(size_t i = 0; i < n; i++) {
+        memcpy((char *)dst + i * dst_stride, (const char *)src + i * src_stride, components * sizeof(float));
+    }
+}
+
+void encode_half(const float * src, size_t src_stride, int components, void * dst, size_t dst_stride, size_t n) {
+#ifdef VERTEXFORMAT_X86
+    if(vertex_encode_simd()) {
+        encode_half_simd((const char *)src, src_stride, components, (char *)dst, dst_stride, n);
+        return;
+    }
+#endif
+    encode_half_scalar((const char *)src, src_stride, components, (char *)dst, dst_stride, 0, n);
+}
+
+void encode_snorm_2_10_10_10(const float * src, size_t src_stride, void * dst, size_t dst_stride, size_t n) {
+#ifdef VERTEXFORMAT_X86
+    if(vertex_encode_simd()) {
+        encode_snorm_simd((const char *)src, src_stride, (char *)dst, dst_stride, n);
+        return;
+    }
+#endif
+    encode_snorm_scalar((const char *)src, src_stride, (char *)dst, dst_stride, 0, n);
+}
+
+void encode_unorm16(const float * src, size_t src_stride, int components, const float * bias, const float * scale,
+        void * dst, size_t dst_stride, size_t n) {
+    float inverse[4];
+    for(int c = 0; c < components; c++) {
+        inverse[c] = scale[c] > 0.0f ? 1.0f / scale[c] : 0.0f;
+    }
+#ifdef VERTEXFORMAT_X86
+    if(vertex_encode_simd()) {
+        encode_unorm16_simd((const char *)src, src_stride, components, bias, inverse, (char *)dst, dst_stride, n);
+        return;
+    }
+#endif
+    encode_unorm16_scalar((const char *)src, src_stride, components, bias, inverse, (char *)dst, dst_stride, 0, n);
+}
+
+// only colours use it, so there is no SIMD version
+void encode_unorm8(const float * src, size_t src_stride, int components, void * dst, size_t dst_stride, size_t n) {
+    for(size_t i = 0; i < n; i++) {
+        const float * in = (const float *)((const char *)src + i * src_stride);
+        uint8_t * out = (uint8_t *)dst + i * dst_stride;
+        for(int c = 0; c < components; c++) {
+            out[c] = (uint8_t)nearbyintf(clampf(in[c], 0.0f, 1.0f) * 255.0f);
+        }
+    }
+}
+
+void quantization_range(const float * src, size_t src_stride, int components, size_t n, float * bias, float * scale) {
+    for(int c = 0; c < components; c++) {
+        bias[c] = INFINITY;
+        scale[c] = -INFINITY;
+    }
+    for(size_t i = 0; i < n; i++) {
+        const float * in = (const float *)((const char *)src + i * src_stride);
+        for(int c = 0; c < components; c++) {
+            bias[c] = in[c] < bias[c] ? in[c] : bias[c];
+            scale[c] = in[c] > scale[c] ? in[c] : scale[c];
+        }
+    }
+    for(int c = 0; c < components; c++) {
+        scale[c] = n ? scale[c] - bias[c] : 0.0f;
+        bias[c] = n ? bias[c] : 0.0f;
+    }
+}
+
+void vertex_format_encode(const vertex_format * format, int element, const float * src, size_t src_stride,
+        void * stream_data, size_t n, const float * bias, const float * scale) {
+    const vertex_element & e = format->elements[element];
+    char * dst = (char *)stream_data + e.offset;
+    size_t dst_stride = format->strides[e.stream];
+    switch(e.encoding) {
+        case VERTEX_HALF:
+            encode_half(src, src_stride, e.components, dst, dst_stride, n);
+            break;
+        case VERTEX_SNORM_2_10_10_10:
+            encode_snorm_2_10_10_10(src, src_stride, dst, dst_stride, n);
+            break;
+        case VERTEX_UNORM16:
+            encode_unorm16(src, src_stride, e.components, bias, scale, dst, dst_stride, n);
+            break;
+        case VERTEX_UNORM8:
+            encode_unorm8(src, src_stride, e.components, dst, dst_stride, n);
+            break;
+        default:
+            encode_float32(src, src_stride, e.components, dst, dst_stride, n);
+    }
+}
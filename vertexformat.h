@@ -0,0 +1,73 @@
+#pragma once
+#include <GL/glew.h>
+#include <stddef.h>
+
+// Vertex layout descriptors: each element names a shader location, a
+// component count, how it is encoded and which buffer stream it lives in.
+// Offsets and strides are derived, every element starts on a 4-byte
+// boundary; a stream can advance per instance instead of per vertex. Mesh
+// files, batches and point clouds describe their vertices with one and set
+// up their VAOs through vertex_format_apply(). Encoders turn float input
+// into each encoding, reading and writing with byte strides so they can
+// fill interleaved buffers directly.
+#define VERTEX_FORMAT_MAX_ELEMENTS 8
+#define VERTEX_FORMAT_MAX_STREAMS 4
+
+enum {
+    // GL_FLOAT
+    VERTEX_FLOAT32 = 0,
+    // GL_HALF_FLOAT
+    VERTEX_HALF,
+    // GL_INT_2_10_10_10_REV, normalized; always 4 components, w is 0
+    VERTEX_SNORM_2_10_10_10,
+    // GL_UNSIGNED_SHORT, normalized; the shader maps [0, 1] back with a
+    // per-mesh scale and bias from quantization_range()
+    VERTEX_UNORM16,
+    // GL_UNSIGNED_BYTE, normalized; colours
+    VERTEX_UNORM8,
+};
+
+struct vertex_element {
+    GLuint location;
+    int components;
+    int encoding;
+    int stream;
+    GLuint offset;
+};
+
+struct vertex_format {
+    vertex_element elements[VERTEX_FORMAT_MAX_ELEMENTS];
+    int element_count;
+    GLsizei strides[VERTEX_FORMAT_MAX_STREAMS];
+    // 0 advances per vertex, N every N instances
+    GLuint divisors[VERTEX_FORMAT_MAX_STREAMS];
+    int stream_count;
+};
+
+void vertex_format_init(vertex_format * format);
+int vertex_format_add(vertex_format * format, GLuint location, int components, int encoding, int stream = 0);
+GLsizei vertex_format_stride(const vertex_format * format, int stream);
+void vertex_format_set_divisor(vertex_format * format, int stream, GLuint divisor);
+// points the VAO at one buffer (and base offset) per stream
+void vertex_format_apply(const vertex_format * format, GLuint vao, const GLuint * buffers, const GLintptr * offsets);
+// the GL type and normalized flag glVertexAttribPointer gets for an encoding,
+// and back; -1 for a type and flag no encoding stands for
+GLenum vertex_encoding_type(int encoding);
+bool vertex_encoding_normalized(int encoding);
+int vertex_encoding_of(GLenum type, bool normalized);
+
+void encode_float32(const float * src, size_t src_stride, int components, void * dst, size_t dst_stride, size_t n);
+void encode_half(const float * src, size_t src_stride, int components, void * dst, size_t dst_stride, size_t n);
+void encode_snorm_2_10_10_10(const float * src, size_t src_stride, void * dst, size_t dst_stride, size_t n);
+void encode_unorm16(const float * src, size_t src_stride, int components, const float * bias, const float * scale,
+    void * dst, size_t dst_stride, size_t n);
+void encode_unorm8(const float * src, size_t src_stride, int components, void * dst, size_t dst_stride, size_t n);
+// bias = min, scale = max - min per component, for encode_unorm16 and the shader
+void quantization_range(const float * src, size_t src_stride, int components, size_t n, float * bias, float * scale);
+// encodes one element of a format from float input
+void vertex_format_encode(const vertex_format * format, int element, const float * src, size_t src_stride,
+    void * stream_data, size_t n, const float * bias = NULL, const float * scale = NULL);
+
+// true when the SSE4.1/F16C encoders are in use; they match the scalar ones bit for bit
+bool vertex_encode_simd();
+void vertex_encode_force_scalar(bool scalar);